@@ -0,0 +1,75 @@
+#include "alloccounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// NOTE: Per thread so counting costs no atomics and jobs running on other
+// threads don't show up in a measurement
+static thread_local unsigned long long ThreadCount = 0;
+
+static void*
+allocate(std::size_t size) {
+    ++ThreadCount;
+    void* Memory = std::malloc(size ? size : 1);
+    if (!Memory) {
+        throw std::bad_alloc();
+    }
+    return Memory;
+}
+
+unsigned long long
+AllocCounter::GetThreadCount() {
+    return ThreadCount;
+}
+
+void*
+operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void*
+operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++ThreadCount;
+    return std::malloc(size ? size : 1);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    ++ThreadCount;
+    return std::malloc(size ? size : 1);
+}
+
+void
+operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void
+operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
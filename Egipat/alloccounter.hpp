@@ -0,0 +1,22 @@
+/**
+ * @file alloccounter.hpp
+ * @brief Heap allocation counting. The global operator new is replaced with
+ * one that counts calls per thread, so benchmarks can check how many
+ * allocations a piece of code makes
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+namespace AllocCounter {
+    /**
+     * @brief Allocations made by the calling thread since it started. Take the
+     * difference of two calls around the code being measured
+     *
+     */
+    unsigned long long GetThreadCount();
+}
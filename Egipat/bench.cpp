@@ -0,0 +1,252 @@
+#include "bench.hpp"
+#include "alloccounter.hpp"
+#include "capture.hpp"
+#include "commandbuffer.hpp"
+#include "frameuniforms.hpp"
+#include "jobsystem.hpp"
+#include "model.hpp"
+#include "particles.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double
+elapsedMs(BenchClock::time_point start, BenchClock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int
+Bench::RunParticles(GLFWwindow* window) {
+    const unsigned Counts[] = { 10000, 50000, 100000, 250000, 500000, 1000000 };
+    const unsigned WarmupFrames = 10;
+    const unsigned MeasuredFrames = 100;
+    const float Dt = 1.0f / 60.0f;
+    // NOTE: The CPU backend updates on jobs, without workers it runs single threaded
+    Jobs::Init();
+
+    FrameUniforms Uniforms;
+    CommandBuffer Commands;
+    Uniforms.Camera.Projection = glm::perspective(45.0f, 1.0f, 0.1f, 1000.0f);
+    Uniforms.Camera.View = glm::lookAt(glm::vec3(0.0f, 2.0f, 12.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Uniforms.Camera.ViewPosition = glm::vec4(0.0f, 2.0f, 12.0f, 1.0f);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    unsigned Query;
+    glGenQueries(1, &Query);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "backend     count   update ms   update gpu ms   render ms" << std::endl;
+    for (unsigned BackendIdx = 0; BackendIdx < 2; ++BackendIdx) {
+        ParticleSystem::EBackend Backend = BackendIdx == 0 ? ParticleSystem::BACKEND_GPU : ParticleSystem::BACKEND_CPU;
+        for (unsigned CountIdx = 0; CountIdx < sizeof(Counts) / sizeof(Counts[0]); ++CountIdx) {
+            ParticleSystem Particles(Counts[CountIdx], Backend);
+            // NOTE: Keep shader compiles out of the measured frames
+            Shader::FinishPending();
+            double UpdateMs = 0.0, UpdateGpuMs = 0.0, RenderMs = 0.0;
+
+            for (unsigned Frame = 0; Frame < WarmupFrames + MeasuredFrames; ++Frame) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                BenchClock::time_point Start = BenchClock::now();
+                glBeginQuery(GL_TIME_ELAPSED, Query);
+                Particles.Update(Dt);
+                glEndQuery(GL_TIME_ELAPSED);
+                glFinish();
+                BenchClock::time_point Updated = BenchClock::now();
+                Uniforms.Upload();
+                Commands.Reset();
+                Particles.Record(Commands);
+                Commands.Execute(Uniforms);
+                Uniforms.EndFrame();
+                glFinish();
+                BenchClock::time_point Rendered = BenchClock::now();
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+
+                if (Frame >= WarmupFrames) {
+                    GLuint64 Nanoseconds = 0;
+                    glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Nanoseconds);
+                    UpdateMs += elapsedMs(Start, Updated);
+                    UpdateGpuMs += Nanoseconds / 1e6;
+                    RenderMs += elapsedMs(Updated, Rendered);
+                }
+            }
+
+            std::cout << (Backend == ParticleSystem::BACKEND_GPU ? "gpu " : "cpu ")
+                      << std::setw(13) << Counts[CountIdx]
+                      << std::setw(12) << UpdateMs / MeasuredFrames
+                      << std::setw(16) << UpdateGpuMs / MeasuredFrames
+                      << std::setw(12) << RenderMs / MeasuredFrames << std::endl;
+        }
+    }
+    glDeleteQueries(1, &Query);
+
+    // NOTE: Same seed and step on both backends, states should stay within float noise
+    ParticleSystem Gpu(10000, ParticleSystem::BACKEND_GPU);
+    ParticleSystem Cpu(10000, ParticleSystem::BACKEND_CPU);
+    Shader::FinishPending();
+    for (unsigned Frame = 0; Frame < 60; ++Frame) {
+        Gpu.Update(Dt);
+        Cpu.Update(Dt);
+    }
+    std::vector<glm::vec4> GpuState, CpuState;
+    Gpu.ReadBack(GpuState);
+    Cpu.ReadBack(CpuState);
+    float MaxDeviation = 0.0f;
+    for (unsigned Idx = 0; Idx < GpuState.size(); Idx += 2) {
+        MaxDeviation = std::max(MaxDeviation, glm::length(glm::vec3(GpuState[Idx]) - glm::vec3(CpuState[Idx])));
+    }
+    std::cout << "gpu/cpu max position deviation after 60 frames: " << MaxDeviation << std::endl;
+
+    Jobs::Shutdown();
+    return 0;
+}
+
+int
+Bench::RunImport(const std::vector<std::string>& paths) {
+    std::vector<std::string> Files = paths;
+    if (Files.empty()) {
+        Files.push_back("res/moon/moon.obj");
+        Files.push_back("res/pharaoh/pharaoh.obj");
+        Files.push_back("res/rug/rug.obj");
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "model                      pass   meshes   vertices   build ms   allocs   allocs/mesh   allocs/vertex" << std::endl;
+    int Result = 0;
+    for (unsigned FileIdx = 0; FileIdx < Files.size(); ++FileIdx) {
+        Assimp::Importer Importer;
+        const aiScene* Scene = Importer.ReadFile(Files[FileIdx], POSTPROCESS_FLAGS);
+        if (!Scene || Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !Scene->mRootNode) {
+            std::cerr << "[Err] Failed to load model " << Files[FileIdx] << ":" << std::endl << Importer.GetErrorString() << std::endl;
+            Result = -1;
+            continue;
+        }
+
+        unsigned long long VertexCount = 0;
+        for (unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
+            VertexCount += Scene->mMeshes[MeshIdx]->mNumVertices;
+        }
+
+        for (unsigned Pass = 0; Pass < 2; ++Pass) {
+            // NOTE: Sized up front like Model::Import, only Build is measured
+            std::vector<Mesh> Meshes(Scene->mNumMeshes);
+            unsigned long long Allocs = 0;
+            double BuildMs = 0.0;
+            for (unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
+                unsigned long long AllocsBefore = AllocCounter::GetThreadCount();
+                BenchClock::time_point Start = BenchClock::now();
+                Meshes[MeshIdx].Build(Scene->mMeshes[MeshIdx]);
+                BuildMs += elapsedMs(Start, BenchClock::now());
+                unsigned long long MeshAllocs = AllocCounter::GetThreadCount() - AllocsBefore;
+                Allocs += MeshAllocs;
+
+                // NOTE: The cold pass also grows the scratch, only the warm one
+                // is checked. Meshes without meshlets or LODs allocate fewer
+                if (Pass == 1 && MeshAllocs > MESH_BUILD_ALLOCATIONS) {
+                    std::cerr << "[Err] " << Files[FileIdx] << " mesh " << MeshIdx << ": " << MeshAllocs << " allocations for "
+                              << Scene->mMeshes[MeshIdx]->mNumVertices << " vertices, a build owns "
+                              << MESH_BUILD_ALLOCATIONS << std::endl;
+                    Result = 1;
+                }
+            }
+
+            std::cout << std::left << std::setw(27) << Files[FileIdx] << std::right
+                      << std::setw(4) << (Pass == 0 ? "cold" : "warm")
+                      << std::setw(9) << Scene->mNumMeshes
+                      << std::setw(11) << VertexCount
+                      << std::setw(11) << BuildMs
+                      << std::setw(9) << Allocs
+                      << std::setw(14) << (Scene->mNumMeshes ? (double)Allocs / Scene->mNumMeshes : 0.0)
+                      << std::setw(16) << (VertexCount ? (double)Allocs / VertexCount : 0.0) << std::endl;
+        }
+    }
+    return Result;
+}
+
+int
+Bench::RunReplay(GLFWwindow* window, const std::string& path, unsigned loops) {
+    FrameUniforms Uniforms;
+    CaptureReplay Replay;
+    if (!Replay.Load(path)) {
+        return -1;
+    }
+    if (!Replay.GetFrameCount()) {
+        std::cerr << "[Err] " << path << " holds no frames" << std::endl;
+        return -1;
+    }
+
+    // NOTE: Fixed state the scene sets once, it isn't part of the capture
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    int Width = 0, Height = 0;
+    glfwGetFramebufferSize(window, &Width, &Height);
+    glViewport(0, 0, Width, Height);
+    glfwSwapInterval(0);
+
+    // NOTE: One unmeasured pass compiles the shader variants
+    for (unsigned Frame = 0; Frame < Replay.GetFrameCount(); ++Frame) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Replay.ExecuteFrame(Frame, Uniforms);
+        Uniforms.EndFrame();
+    }
+    glFinish();
+
+    // NOTE: Timer results are read BENCH_REPLAY_QUERY_LATENCY frames late, so
+    // waiting on them doesn't serialise the CPU and the GPU
+    GLuint Queries[BENCH_REPLAY_QUERY_LATENCY];
+    glGenQueries(BENCH_REPLAY_QUERY_LATENCY, Queries);
+    loops = std::max(loops, 1u);
+    double SubmitMs = 0.0, GpuMs = 0.0;
+    unsigned FrameCount = 0;
+    BenchClock::time_point Start = BenchClock::now();
+    for (unsigned Loop = 0; Loop < loops; ++Loop) {
+        for (unsigned Frame = 0; Frame < Replay.GetFrameCount(); ++Frame) {
+            GLuint Query = Queries[FrameCount % BENCH_REPLAY_QUERY_LATENCY];
+            if (FrameCount >= BENCH_REPLAY_QUERY_LATENCY) {
+                GLuint64 Elapsed = 0;
+                glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Elapsed);
+                GpuMs += Elapsed / 1e6;
+            }
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            BenchClock::time_point Submit = BenchClock::now();
+            glBeginQuery(GL_TIME_ELAPSED, Query);
+            Replay.ExecuteFrame(Frame, Uniforms);
+            glEndQuery(GL_TIME_ELAPSED);
+            SubmitMs += elapsedMs(Submit, BenchClock::now());
+            Uniforms.EndFrame();
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            ++FrameCount;
+        }
+    }
+    glFinish();
+    double WallMs = elapsedMs(Start, BenchClock::now());
+    for (unsigned Pending = FrameCount > BENCH_REPLAY_QUERY_LATENCY ? FrameCount - BENCH_REPLAY_QUERY_LATENCY : 0; Pending < FrameCount; ++Pending) {
+        GLuint64 Elapsed = 0;
+        glGetQueryObjectui64v(Queries[Pending % BENCH_REPLAY_QUERY_LATENCY], GL_QUERY_RESULT, &Elapsed);
+        GpuMs += Elapsed / 1e6;
+    }
+    glDeleteQueries(BENCH_REPLAY_QUERY_LATENCY, Queries);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Replayed " << Replay.GetFrameCount() << " frames " << loops << " times, "
+              << Replay.GetCommandCount() << " commands, " << Replay.GetResourceBytes() / (1024 * 1024) << " MB of resources" << std::endl;
+    std::cout << "  " << SubmitMs / FrameCount << " ms/frame submit, " << GpuMs / FrameCount << " ms/frame gpu, "
+              << WallMs / FrameCount << " ms/frame wall, " << FrameCount / (WallMs / 1e3) << " FPS" << std::endl;
+    std::cout << "  " << glGetString(GL_RENDERER) << std::endl;
+    // NOTE: Work the main loop does outside command buffers isn't captured
+    std::cout << "  Not replayed: particle simulation, occlusion depth readback, texture streaming and terrain uploads" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * @file bench.hpp
+ * @brief Benchmark modes, selected from the command line. Each mode runs on
+ * the already created GL context and prints its results to stdout
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+
+// NOTE: Frames between issuing a replay timer query and reading it back
+#define BENCH_REPLAY_QUERY_LATENCY 4
+
+namespace Bench {
+    /**
+     * @brief Sweeps particle counts from 10K to 1M on the GPU and CPU backends,
+     * printing per-frame update and render times. Also reports how far the two
+     * backends drift apart from the same seed
+     *
+     * @param window - Window owning the current GL context
+     *
+     * @returns Process exit code
+     */
+    int RunParticles(GLFWwindow* window);
+
+    /**
+     * @brief Builds every mesh of the given models twice on the calling
+     * thread and counts heap allocations per mesh and per vertex. The first
+     * pass warms the per-thread import scratch, the second shows the steady
+     * state. Assimp's own file reading is not counted
+     *
+     * @param paths - Model files, the scene models when empty
+     *
+     * @returns Process exit code, non-zero when a warm build of any mesh
+     * allocates more than the MESH_BUILD_ALLOCATIONS containers it owns,
+     * which means allocations per vertex or triangle crept back in
+     */
+    int RunImport(const std::vector<std::string>& paths);
+
+    /**
+     * @brief Replays a file written with --capture as fast as the context
+     * allows, without the application around it. Prints CPU submit time,
+     * GPU time and wall time per frame
+     *
+     * @param window - Window owning the current GL context
+     * @param path - Capture file
+     * @param loops - Times the captured frames are replayed
+     *
+     * @returns Process exit code
+     */
+    int RunReplay(GLFWwindow* window, const std::string& path, unsigned loops);
+}
\ No newline at end of file
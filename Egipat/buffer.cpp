@@ -3,12 +3,12 @@
 Buffer::Buffer(IBufferable& bufferable) : mEBO(0) {
     mIndexCount = bufferable.GetIndexCount();
     mVertexCount = bufferable.GetVertexCount() / bufferable.GetVertexElementCount();
-    glGenVertexArrays(1, &mVAO);
+    mVAO = GpuMemory::CreateVertexArray("Buffer");
     glBindVertexArray(mVAO);
 
-    glGenBuffers(1, &mVBO);
+    mVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "Buffer");
     glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, bufferable.GetVertexCount() * sizeof(float), bufferable.GetVertices(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(mVBO, GL_ARRAY_BUFFER, bufferable.GetVertexCount() * sizeof(float), bufferable.GetVertices(), GL_STATIC_DRAW);
 
     float Stride = bufferable.GetVertexElementCount() * sizeof(float);
     glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, Stride, (void*)0);
@@ -18,9 +18,9 @@ Buffer::Buffer(IBufferable& bufferable) : mEBO(0) {
     glEnableVertexAttribArray(COLOUR_LOCATION);
 
     if (mIndexCount) {
-        glGenBuffers(1, &mEBO);
+        mEBO = GpuMemory::CreateBuffer(GPU_INDEX_BUFFER, "Buffer");
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferable.GetIndexCount() * sizeof(float), bufferable.GetIndices(), GL_STATIC_DRAW);
+        GpuMemory::BufferData(mEBO, GL_ELEMENT_ARRAY_BUFFER, bufferable.GetIndexCount() * sizeof(float), bufferable.GetIndices(), GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
@@ -28,6 +28,12 @@ Buffer::Buffer(IBufferable& bufferable) : mEBO(0) {
     glBindVertexArray(0);
 }
 
+Buffer::~Buffer() {
+    GpuMemory::DeleteBuffer(mEBO);
+    GpuMemory::DeleteBuffer(mVBO);
+    GpuMemory::DeleteVertexArray(mVAO);
+}
+
 void
 Buffer::Render() {
     glBindVertexArray(mVAO);
@@ -13,6 +13,7 @@
 #include <GL/glew.h>
 #include <iostream>
 #include "ibufferable.hpp"
+#include "gpumemory.hpp"
 
 #define POSITION_LOCATION 0
 #define COLOUR_LOCATION 1
@@ -31,6 +32,10 @@ public:
 	 * @param bufferable Bufferable object
 	 */
 	Buffer(IBufferable& bufferable);
+	~Buffer();
+	Buffer(const Buffer&) = delete;
+	Buffer& operator=(const Buffer&) = delete;
+
 	/**
 	 * @brief Renders the buffered object
 	 *
@@ -0,0 +1,592 @@
+#include "bvh.hpp"
+#include "jobsystem.hpp"
+#include "simd.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// NOTE: Relative cost of visiting a node against intersecting a primitive
+static const float TraversalCost = 1.0f;
+
+static inline float
+surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 Extent = max - min;
+    return 2.0f * (Extent.x * Extent.y + Extent.y * Extent.z + Extent.z * Extent.x);
+}
+
+Bvh::Bvh()
+    : mNodeCount(0),
+      mBoxes(0) {}
+
+void
+Bvh::Build(const std::vector<BvhBox>& boxes) {
+    unsigned Count = (unsigned)boxes.size();
+    mNodes.clear();
+    mPrimitives.resize(Count);
+    mNodeCount = 0;
+    if (!Count) {
+        return;
+    }
+
+    mBoxes = boxes.data();
+    mCentroids.resize(Count);
+    for (unsigned PrimitiveIdx = 0; PrimitiveIdx < Count; ++PrimitiveIdx) {
+        mPrimitives[PrimitiveIdx] = PrimitiveIdx;
+        mCentroids[PrimitiveIdx] = (boxes[PrimitiveIdx].Min + boxes[PrimitiveIdx].Max) * 0.5f;
+    }
+
+    // NOTE: A binary tree over N leaves never has more than 2N - 1 nodes,
+    // so jobs can claim nodes without the array moving under them
+    mNodes.resize(2 * Count - 1);
+    mNodeCount = 1;
+    buildNode(0, 0, Count, 0);
+    mNodes.resize(mNodeCount);
+    mBoxes = 0;
+    std::vector<glm::vec3>().swap(mCentroids);
+}
+
+void
+Bvh::buildNode(unsigned node, unsigned begin, unsigned end, unsigned depth) {
+    BvhNode& Node = mNodes[node];
+    glm::vec3 CentroidMin(1e30f), CentroidMax(-1e30f);
+    Node.Min = glm::vec3(1e30f);
+    Node.Max = glm::vec3(-1e30f);
+    for (unsigned Idx = begin; Idx < end; ++Idx) {
+        unsigned Primitive = mPrimitives[Idx];
+        Node.Min = glm::min(Node.Min, mBoxes[Primitive].Min);
+        Node.Max = glm::max(Node.Max, mBoxes[Primitive].Max);
+        CentroidMin = glm::min(CentroidMin, mCentroids[Primitive]);
+        CentroidMax = glm::max(CentroidMax, mCentroids[Primitive]);
+    }
+
+    unsigned Count = end - begin;
+    Node.Start = begin;
+    Node.Count = Count;
+    if (Count <= 2) {
+        return;
+    }
+
+    // NOTE: Binned SAH on all three axes, cost relative to the parent area
+    float BestCost = 1e30f;
+    int BestAxis = -1;
+    unsigned BestBin = 0;
+    for (int Axis = 0; Axis < 3 && depth < BVH_SAH_MAX_DEPTH; ++Axis) {
+        float Extent = CentroidMax[Axis] - CentroidMin[Axis];
+        if (Extent <= 0.0f) {
+            continue;
+        }
+
+        struct Bin {
+            glm::vec3 Min;
+            glm::vec3 Max;
+            unsigned Count;
+        } Bins[BVH_BINS];
+        for (unsigned BinIdx = 0; BinIdx < BVH_BINS; ++BinIdx) {
+            Bins[BinIdx].Min = glm::vec3(1e30f);
+            Bins[BinIdx].Max = glm::vec3(-1e30f);
+            Bins[BinIdx].Count = 0;
+        }
+        float Scale = BVH_BINS / Extent;
+        for (unsigned Idx = begin; Idx < end; ++Idx) {
+            unsigned Primitive = mPrimitives[Idx];
+            unsigned BinIdx = std::min((unsigned)((mCentroids[Primitive][Axis] - CentroidMin[Axis]) * Scale), (unsigned)BVH_BINS - 1);
+            Bins[BinIdx].Min = glm::min(Bins[BinIdx].Min, mBoxes[Primitive].Min);
+            Bins[BinIdx].Max = glm::max(Bins[BinIdx].Max, mBoxes[Primitive].Max);
+            ++Bins[BinIdx].Count;
+        }
+
+        float RightArea[BVH_BINS];
+        unsigned RightCount[BVH_BINS];
+        glm::vec3 SweepMin(1e30f), SweepMax(-1e30f);
+        unsigned SweepCount = 0;
+        for (unsigned BinIdx = BVH_BINS - 1; BinIdx > 0; --BinIdx) {
+            SweepMin = glm::min(SweepMin, Bins[BinIdx].Min);
+            SweepMax = glm::max(SweepMax, Bins[BinIdx].Max);
+            SweepCount += Bins[BinIdx].Count;
+            RightArea[BinIdx] = SweepCount ? surfaceArea(SweepMin, SweepMax) : 0.0f;
+            RightCount[BinIdx] = SweepCount;
+        }
+        SweepMin = glm::vec3(1e30f);
+        SweepMax = glm::vec3(-1e30f);
+        SweepCount = 0;
+        for (unsigned Split = 1; Split < BVH_BINS; ++Split) {
+            SweepMin = glm::min(SweepMin, Bins[Split - 1].Min);
+            SweepMax = glm::max(SweepMax, Bins[Split - 1].Max);
+            SweepCount += Bins[Split - 1].Count;
+            if (!SweepCount || !RightCount[Split]) {
+                continue;
+            }
+            float Cost = surfaceArea(SweepMin, SweepMax) * SweepCount + RightArea[Split] * RightCount[Split];
+            if (Cost < BestCost) {
+                BestCost = Cost;
+                BestAxis = Axis;
+                BestBin = Split;
+            }
+        }
+    }
+
+    float ParentArea = surfaceArea(Node.Min, Node.Max);
+    bool SplitPays = BestAxis >= 0 && TraversalCost * ParentArea + BestCost < Count * ParentArea;
+    if (!SplitPays && Count <= BVH_MAX_LEAF_SIZE) {
+        return;
+    }
+
+    unsigned* First = mPrimitives.data() + begin;
+    unsigned* Last = mPrimitives.data() + end;
+    unsigned* Middle = First;
+    if (BestAxis >= 0) {
+        float Min = CentroidMin[BestAxis];
+        float Scale = BVH_BINS / (CentroidMax[BestAxis] - Min);
+        Middle = std::partition(First, Last, [this, BestAxis, BestBin, Min, Scale](unsigned primitive) {
+            return std::min((unsigned)((mCentroids[primitive][BestAxis] - Min) * Scale), (unsigned)BVH_BINS - 1) < BestBin;
+        });
+    }
+    if (Middle == First || Middle == Last) {
+        // NOTE: Coincident centroids, a split SAH rejected on an oversized
+        // leaf or a node past BVH_SAH_MAX_DEPTH, fall back to the median of
+        // the widest axis
+        glm::vec3 Extent = CentroidMax - CentroidMin;
+        int Axis = Extent.x > Extent.y ? (Extent.x > Extent.z ? 0 : 2) : (Extent.y > Extent.z ? 1 : 2);
+        Middle = First + Count / 2;
+        std::nth_element(First, Middle, Last, [this, Axis](unsigned a, unsigned b) {
+            return mCentroids[a][Axis] < mCentroids[b][Axis];
+        });
+    }
+    unsigned Split = begin + (unsigned)(Middle - First);
+
+    unsigned Children = mNodeCount.fetch_add(2);
+    Node.Start = Children;
+    Node.Count = 0;
+    if (Count > BVH_PARALLEL_MIN) {
+        JobCounter Left;
+        Jobs::Run([this, Children, begin, Split, depth]() { buildNode(Children, begin, Split, depth + 1); }, &Left);
+        buildNode(Children + 1, Split, end, depth + 1);
+        Jobs::Wait(Left);
+    } else {
+        buildNode(Children, begin, Split, depth + 1);
+        buildNode(Children + 1, Split, end, depth + 1);
+    }
+}
+
+void
+Bvh::Refit(const std::vector<BvhBox>& boxes) {
+    // NOTE: Children are always claimed after their parent, so walking
+    // backwards visits them first
+    for (unsigned NodeIdx = mNodeCount; NodeIdx-- > 0;) {
+        BvhNode& Node = mNodes[NodeIdx];
+        if (Node.Count) {
+            Node.Min = glm::vec3(1e30f);
+            Node.Max = glm::vec3(-1e30f);
+            for (unsigned Idx = Node.Start; Idx < Node.Start + Node.Count; ++Idx) {
+                Node.Min = glm::min(Node.Min, boxes[mPrimitives[Idx]].Min);
+                Node.Max = glm::max(Node.Max, boxes[mPrimitives[Idx]].Max);
+            }
+        } else {
+            Node.Min = glm::min(mNodes[Node.Start].Min, mNodes[Node.Start + 1].Min);
+            Node.Max = glm::max(mNodes[Node.Start].Max, mNodes[Node.Start + 1].Max);
+        }
+    }
+}
+
+void
+RayMesh::Build(const float* vertices, unsigned vertexCount, unsigned stride, const unsigned* indices, unsigned indexCount) {
+    TRACE_ZONE("Build ray mesh");
+    unsigned TriangleCount = (indices ? indexCount : vertexCount) / 3;
+    std::vector<glm::vec3> Corners(TriangleCount * 3);
+    std::vector<BvhBox> Boxes(TriangleCount);
+    for (unsigned Triangle = 0; Triangle < TriangleCount; ++Triangle) {
+        BvhBox& Box = Boxes[Triangle];
+        Box.Min = glm::vec3(1e30f);
+        Box.Max = glm::vec3(-1e30f);
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Index = indices ? indices[Triangle * 3 + Corner] : Triangle * 3 + Corner;
+            const float* Position = vertices + (size_t)Index * stride;
+            glm::vec3& Target = Corners[Triangle * 3 + Corner];
+            Target = glm::vec3(Position[0], Position[1], Position[2]);
+            Box.Min = glm::min(Box.Min, Target);
+            Box.Max = glm::max(Box.Max, Target);
+        }
+    }
+    mBvh.Build(Boxes);
+
+    // NOTE: Stored in leaf order so leaves read their triangles contiguously
+    const std::vector<unsigned>& Order = mBvh.GetPrimitives();
+    mTriangles.resize(Corners.size());
+    for (unsigned Idx = 0; Idx < Order.size(); ++Idx) {
+        std::copy_n(&Corners[Order[Idx] * 3], 3, &mTriangles[Idx * 3]);
+    }
+}
+
+static inline bool
+hitBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance, float& entry) {
+    float Near = 0.0f, Far = maxDistance;
+    for (int Axis = 0; Axis < 3; ++Axis) {
+        float T0 = (node.Min[Axis] - origin[Axis]) * inverse[Axis];
+        float T1 = (node.Max[Axis] - origin[Axis]) * inverse[Axis];
+        Near = std::max(Near, std::min(T0, T1));
+        Far = std::min(Far, std::max(T0, T1));
+    }
+    entry = Near;
+    return Near <= Far;
+}
+
+/**
+ * @brief Möller-Trumbore, two sided
+ *
+ */
+static inline bool
+hitTriangle(const glm::vec3* corners, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) {
+    glm::vec3 Edge1 = corners[1] - corners[0];
+    glm::vec3 Edge2 = corners[2] - corners[0];
+    glm::vec3 P = glm::cross(direction, Edge2);
+    float Determinant = glm::dot(Edge1, P);
+    if (std::fabs(Determinant) < 1e-12f) {
+        return false;
+    }
+
+    float InvDeterminant = 1.0f / Determinant;
+    glm::vec3 T = origin - corners[0];
+    float U = glm::dot(T, P) * InvDeterminant;
+    if (U < 0.0f || U > 1.0f) {
+        return false;
+    }
+    glm::vec3 Q = glm::cross(T, Edge1);
+    float V = glm::dot(direction, Q) * InvDeterminant;
+    if (V < 0.0f || U + V > 1.0f) {
+        return false;
+    }
+    float Distance = glm::dot(Edge2, Q) * InvDeterminant;
+    if (Distance <= 0.0f || Distance >= maxDistance) {
+        return false;
+    }
+    distance = Distance;
+    return true;
+}
+
+/**
+ * @brief Walks a BVH front to back. The leaf callback may shorten maxDistance
+ *
+ */
+template<class LeafFunction>
+static void
+traverse(const Bvh& bvh, const glm::vec3& origin, const glm::vec3& inverse, float& maxDistance, LeafFunction leaf) {
+    const BvhNode* Nodes = bvh.GetNodes();
+    float Entry;
+    if (!bvh.GetNodeCount() || !hitBox(Nodes[0], origin, inverse, maxDistance, Entry)) {
+        return;
+    }
+
+    unsigned Stack[BVH_STACK_SIZE];
+    unsigned StackSize = 0;
+    unsigned Current = 0;
+    for (;;) {
+        const BvhNode& Node = Nodes[Current];
+        if (Node.Count) {
+            leaf(Node.Start, Node.Count);
+        } else {
+            unsigned Near = Node.Start, Far = Node.Start + 1;
+            float NearEntry, FarEntry;
+            bool HitNear = hitBox(Nodes[Near], origin, inverse, maxDistance, NearEntry);
+            bool HitFar = hitBox(Nodes[Far], origin, inverse, maxDistance, FarEntry);
+            if (HitNear && HitFar) {
+                if (FarEntry < NearEntry) {
+                    std::swap(Near, Far);
+                }
+                Stack[StackSize++] = Far;
+                Current = Near;
+                continue;
+            }
+            if (HitNear || HitFar) {
+                Current = HitNear ? Near : Far;
+                continue;
+            }
+        }
+        if (!StackSize) {
+            return;
+        }
+        Current = Stack[--StackSize];
+    }
+}
+
+// NOTE: Four rays in SoA layout
+struct RayPacket {
+    float OriginX[4], OriginY[4], OriginZ[4];
+    float DirectionX[4], DirectionY[4], DirectionZ[4];
+    float InverseX[4], InverseY[4], InverseZ[4];
+    float MaxDistance[4];
+    unsigned Instance[4];
+    unsigned Triangle[4];
+
+    glm::vec3 GetOrigin(unsigned lane) const { return glm::vec3(OriginX[lane], OriginY[lane], OriginZ[lane]); }
+    glm::vec3 GetDirection(unsigned lane) const { return glm::vec3(DirectionX[lane], DirectionY[lane], DirectionZ[lane]); }
+
+    void SetRay(unsigned lane, const glm::vec3& origin, const glm::vec3& direction) {
+        OriginX[lane] = origin.x;
+        OriginY[lane] = origin.y;
+        OriginZ[lane] = origin.z;
+        DirectionX[lane] = direction.x;
+        DirectionY[lane] = direction.y;
+        DirectionZ[lane] = direction.z;
+        InverseX[lane] = 1.0f / direction.x;
+        InverseY[lane] = 1.0f / direction.y;
+        InverseZ[lane] = 1.0f / direction.z;
+    }
+};
+
+/**
+ * @brief Tests one box against all four rays
+ *
+ * @returns Mask of active lanes that hit the box
+ */
+static inline unsigned
+hitBox4(const BvhNode& node, const RayPacket& packet, unsigned active) {
+#ifdef EGIPAT_SSE
+    __m128 T0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Min.x), _mm_loadu_ps(packet.OriginX)), _mm_loadu_ps(packet.InverseX));
+    __m128 T1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Max.x), _mm_loadu_ps(packet.OriginX)), _mm_loadu_ps(packet.InverseX));
+    __m128 Near = _mm_max_ps(_mm_min_ps(T0, T1), _mm_setzero_ps());
+    __m128 Far = _mm_min_ps(_mm_max_ps(T0, T1), _mm_loadu_ps(packet.MaxDistance));
+    T0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Min.y), _mm_loadu_ps(packet.OriginY)), _mm_loadu_ps(packet.InverseY));
+    T1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Max.y), _mm_loadu_ps(packet.OriginY)), _mm_loadu_ps(packet.InverseY));
+    Near = _mm_max_ps(Near, _mm_min_ps(T0, T1));
+    Far = _mm_min_ps(Far, _mm_max_ps(T0, T1));
+    T0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Min.z), _mm_loadu_ps(packet.OriginZ)), _mm_loadu_ps(packet.InverseZ));
+    T1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.Max.z), _mm_loadu_ps(packet.OriginZ)), _mm_loadu_ps(packet.InverseZ));
+    Near = _mm_max_ps(Near, _mm_min_ps(T0, T1));
+    Far = _mm_min_ps(Far, _mm_max_ps(T0, T1));
+    return (unsigned)_mm_movemask_ps(_mm_cmple_ps(Near, Far)) & active;
+#else
+    unsigned Mask = 0;
+    float Entry;
+    for (unsigned Lane = 0; Lane < 4; ++Lane) {
+        glm::vec3 Inverse(packet.InverseX[Lane], packet.InverseY[Lane], packet.InverseZ[Lane]);
+        if ((active & (1u << Lane)) && hitBox(node, packet.GetOrigin(Lane), Inverse, packet.MaxDistance[Lane], Entry)) {
+            Mask |= 1u << Lane;
+        }
+    }
+    return Mask;
+#endif
+}
+
+static inline unsigned
+firstLane(unsigned mask) {
+    unsigned Lane = 0;
+    while (!(mask & (1u << Lane))) {
+        ++Lane;
+    }
+    return Lane;
+}
+
+/**
+ * @brief Walks a BVH with a packet. A node is entered once for every lane
+ * that hits it, in the order the first of those lanes would visit it
+ *
+ */
+template<class LeafFunction>
+static void
+traversePacket(const Bvh& bvh, const RayPacket& packet, unsigned active, LeafFunction leaf) {
+    const BvhNode* Nodes = bvh.GetNodes();
+    unsigned Mask = bvh.GetNodeCount() ? hitBox4(Nodes[0], packet, active) : 0;
+    if (!Mask) {
+        return;
+    }
+
+    unsigned Stack[BVH_STACK_SIZE];
+    unsigned StackMask[BVH_STACK_SIZE];
+    unsigned StackSize = 0;
+    unsigned Current = 0;
+    for (;;) {
+        const BvhNode& Node = Nodes[Current];
+        if (Node.Count) {
+            leaf(Node.Start, Node.Count, Mask);
+        } else {
+            unsigned Near = Node.Start, Far = Node.Start + 1;
+            unsigned NearMask = hitBox4(Nodes[Near], packet, Mask);
+            unsigned FarMask = hitBox4(Nodes[Far], packet, Mask);
+            if (NearMask && FarMask) {
+                unsigned Lane = firstLane(NearMask | FarMask);
+                glm::vec3 Between = (Nodes[Far].Min + Nodes[Far].Max) - (Nodes[Near].Min + Nodes[Near].Max);
+                if (glm::dot(Between, packet.GetDirection(Lane)) < 0.0f) {
+                    std::swap(Near, Far);
+                    std::swap(NearMask, FarMask);
+                }
+                Stack[StackSize] = Far;
+                StackMask[StackSize++] = FarMask;
+                Current = Near;
+                Mask = NearMask;
+                continue;
+            }
+            if (NearMask || FarMask) {
+                Current = NearMask ? Near : Far;
+                Mask = NearMask | FarMask;
+                continue;
+            }
+        }
+        if (!StackSize) {
+            return;
+        }
+        --StackSize;
+        Current = Stack[StackSize];
+        Mask = StackMask[StackSize];
+    }
+}
+
+unsigned
+RayScene::AddInstance(const RayMesh& mesh, const glm::mat4& world, const std::string& name) {
+    Instance NewInstance;
+    NewInstance.Mesh = &mesh;
+    NewInstance.World = world;
+    NewInstance.InverseWorld = glm::inverse(world);
+    NewInstance.Name = name;
+    mInstances.push_back(NewInstance);
+    mBounds.push_back(worldBounds(NewInstance));
+    return (unsigned)mInstances.size() - 1;
+}
+
+void
+RayScene::SetTransform(unsigned instance, const glm::mat4& world) {
+    Instance& Target = mInstances[instance];
+    Target.World = world;
+    Target.InverseWorld = glm::inverse(world);
+    mBounds[instance] = worldBounds(Target);
+}
+
+void
+RayScene::Build() {
+    mBvh.Build(mBounds);
+}
+
+void
+RayScene::Refit() {
+    mBvh.Refit(mBounds);
+}
+
+BvhBox
+RayScene::worldBounds(const Instance& instance) const {
+    BvhBox Box;
+    Box.Min = glm::vec3(1e30f);
+    Box.Max = glm::vec3(-1e30f);
+    const Bvh& MeshBvh = instance.Mesh->GetBvh();
+    if (!MeshBvh.GetNodeCount()) {
+        Box.Min = Box.Max = glm::vec3(instance.World[3]);
+        return Box;
+    }
+
+    const BvhNode& Root = MeshBvh.GetNodes()[0];
+    for (unsigned Corner = 0; Corner < 8; ++Corner) {
+        glm::vec3 Local((Corner & 1) ? Root.Max.x : Root.Min.x, (Corner & 2) ? Root.Max.y : Root.Min.y, (Corner & 4) ? Root.Max.z : Root.Min.z);
+        glm::vec3 World = glm::vec3(instance.World * glm::vec4(Local, 1.0f));
+        Box.Min = glm::min(Box.Min, World);
+        Box.Max = glm::max(Box.Max, World);
+    }
+    return Box;
+}
+
+void
+RayScene::finishHit(const Ray& ray, RayHit& hit) const {
+    const Instance& Target = mInstances[hit.Instance];
+    const glm::vec3* Corners = Target.Mesh->GetTriangle(hit.Triangle);
+    glm::vec3 Normal = glm::cross(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+    Normal = glm::normalize(glm::transpose(glm::mat3(Target.InverseWorld)) * Normal);
+    if (glm::dot(Normal, ray.Direction) > 0.0f) {
+        Normal = -Normal;
+    }
+    hit.Normal = Normal;
+}
+
+bool
+RayScene::Intersect(const Ray& ray, RayHit& hit) const {
+    hit.Distance = ray.MaxDistance;
+    hit.Instance = RAY_NO_HIT;
+    hit.Triangle = 0;
+    glm::vec3 Inverse = glm::vec3(1.0f) / ray.Direction;
+    const std::vector<unsigned>& Order = mBvh.GetPrimitives();
+
+    traverse(mBvh, ray.Origin, Inverse, hit.Distance, [&](unsigned start, unsigned count) {
+        for (unsigned Idx = start; Idx < start + count; ++Idx) {
+            unsigned InstanceIdx = Order[Idx];
+            const Instance& Target = mInstances[InstanceIdx];
+            // NOTE: Distances stay in units of the world direction
+            glm::vec3 LocalOrigin = glm::vec3(Target.InverseWorld * glm::vec4(ray.Origin, 1.0f));
+            glm::vec3 LocalDirection = glm::vec3(Target.InverseWorld * glm::vec4(ray.Direction, 0.0f));
+            glm::vec3 LocalInverse = glm::vec3(1.0f) / LocalDirection;
+            const RayMesh& Mesh = *Target.Mesh;
+            traverse(Mesh.GetBvh(), LocalOrigin, LocalInverse, hit.Distance, [&](unsigned first, unsigned triangles) {
+                float Distance;
+                for (unsigned Triangle = first; Triangle < first + triangles; ++Triangle) {
+                    if (hitTriangle(Mesh.GetTriangle(Triangle), LocalOrigin, LocalDirection, hit.Distance, Distance)) {
+                        hit.Distance = Distance;
+                        hit.Instance = InstanceIdx;
+                        hit.Triangle = Triangle;
+                    }
+                }
+            });
+        }
+    });
+
+    if (hit.Instance == RAY_NO_HIT) {
+        return false;
+    }
+    finishHit(ray, hit);
+    return true;
+}
+
+void
+RayScene::IntersectStream(const Ray* rays, unsigned count, RayHit* hits) const {
+    const std::vector<unsigned>& Order = mBvh.GetPrimitives();
+    for (unsigned First = 0; First < count; First += 4) {
+        unsigned LaneCount = std::min(count - First, 4u);
+        unsigned Active = (1u << LaneCount) - 1;
+
+        // NOTE: Unused lanes repeat the first ray so they stay finite
+        RayPacket Packet;
+        for (unsigned Lane = 0; Lane < 4; ++Lane) {
+            const Ray& Source = rays[First + (Lane < LaneCount ? Lane : 0)];
+            Packet.SetRay(Lane, Source.Origin, Source.Direction);
+            Packet.MaxDistance[Lane] = Source.MaxDistance;
+            Packet.Instance[Lane] = RAY_NO_HIT;
+            Packet.Triangle[Lane] = 0;
+        }
+
+        traversePacket(mBvh, Packet, Active, [&](unsigned start, unsigned instances, unsigned mask) {
+            for (unsigned Idx = start; Idx < start + instances; ++Idx) {
+                unsigned InstanceIdx = Order[Idx];
+                const Instance& Target = mInstances[InstanceIdx];
+                const RayMesh& Mesh = *Target.Mesh;
+
+                RayPacket Local = Packet;
+                for (unsigned Lane = 0; Lane < 4; ++Lane) {
+                    Local.SetRay(Lane, glm::vec3(Target.InverseWorld * glm::vec4(Packet.GetOrigin(Lane), 1.0f)),
+                                 glm::vec3(Target.InverseWorld * glm::vec4(Packet.GetDirection(Lane), 0.0f)));
+                }
+                traversePacket(Mesh.GetBvh(), Local, mask, [&](unsigned first, unsigned triangles, unsigned laneMask) {
+                    float Distance;
+                    for (unsigned Triangle = first; Triangle < first + triangles; ++Triangle) {
+                        const glm::vec3* Corners = Mesh.GetTriangle(Triangle);
+                        for (unsigned Lane = 0; Lane < 4; ++Lane) {
+                            if ((laneMask & (1u << Lane))
+                                && hitTriangle(Corners, Local.GetOrigin(Lane), Local.GetDirection(Lane), Local.MaxDistance[Lane], Distance)) {
+                                Local.MaxDistance[Lane] = Distance;
+                                Local.Instance[Lane] = InstanceIdx;
+                                Local.Triangle[Lane] = Triangle;
+                            }
+                        }
+                    }
+                });
+                std::copy_n(Local.MaxDistance, 4, Packet.MaxDistance);
+                std::copy_n(Local.Instance, 4, Packet.Instance);
+                std::copy_n(Local.Triangle, 4, Packet.Triangle);
+            }
+        });
+
+        for (unsigned Lane = 0; Lane < LaneCount; ++Lane) {
+            RayHit& Hit = hits[First + Lane];
+            Hit.Distance = Packet.MaxDistance[Lane];
+            Hit.Instance = Packet.Instance[Lane];
+            Hit.Triangle = Packet.Triangle[Lane];
+            if (Hit.Instance != RAY_NO_HIT) {
+                finishHit(rays[First + Lane], Hit);
+            }
+        }
+    }
+}
@@ -0,0 +1,214 @@
+/**
+ * @file bvh.hpp
+ * @brief Bounding volume hierarchies for ray queries. Meshes get a triangle
+ * BVH built with binned SAH, large subtrees in parallel on the job system.
+ * A RayScene places meshes with world transforms under a top level BVH that
+ * is refit when dynamic instances move. Rays are traced one at a time or in
+ * packets of four that share the traversal
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define BVH_BINS 12
+// NOTE: Leaves stop splitting at this size even when SAH would allow more
+#define BVH_MAX_LEAF_SIZE 8
+// NOTE: Subtrees with more primitives than this are built on their own job
+#define BVH_PARALLEL_MIN 4096
+#define BVH_STACK_SIZE 64
+// NOTE: Deeper nodes split at the median, which halves them, so the last 32
+// levels hold any 32-bit primitive count and traversal stacks can't overflow
+#define BVH_SAH_MAX_DEPTH (BVH_STACK_SIZE - 32)
+#define RAY_NO_HIT 0xFFFFFFFF
+
+struct BvhBox {
+    glm::vec3 Min;
+    glm::vec3 Max;
+};
+
+struct BvhNode {
+    glm::vec3 Min;
+    // NOTE: First primitive of a leaf, left child of an inner node
+    unsigned Start;
+    glm::vec3 Max;
+    // NOTE: 0 for inner nodes, whose children are Start and Start + 1
+    unsigned Count;
+};
+
+/**
+ * @brief Hierarchy over primitive bounds. Knows nothing about the primitives
+ * themselves, leaves reference them through GetPrimitives
+ *
+ */
+class Bvh {
+public:
+    Bvh();
+
+    /**
+     * @brief Builds the hierarchy with binned SAH. Runs on the job system
+     * when there are enough primitives
+     *
+     * @param boxes - Primitive bounds
+     */
+    void Build(const std::vector<BvhBox>& boxes);
+
+    /**
+     * @brief Recomputes node bounds after primitives moved, keeping the topology
+     *
+     * @param boxes - Primitive bounds in the order passed to Build
+     */
+    void Refit(const std::vector<BvhBox>& boxes);
+
+    const BvhNode* GetNodes() const { return mNodes.data(); }
+    unsigned GetNodeCount() const { return mNodeCount; }
+
+    /**
+     * @brief Primitive indices in leaf order. Leaves cover ranges of it
+     *
+     */
+    const std::vector<unsigned>& GetPrimitives() const { return mPrimitives; }
+
+private:
+    std::vector<BvhNode> mNodes;
+    std::vector<unsigned> mPrimitives;
+    std::atomic<unsigned> mNodeCount;
+    // NOTE: Only valid during Build
+    const BvhBox* mBoxes;
+    std::vector<glm::vec3> mCentroids;
+
+    void buildNode(unsigned node, unsigned begin, unsigned end, unsigned depth);
+};
+
+struct Ray {
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+    float MaxDistance;
+};
+
+struct RayHit {
+    // NOTE: In units of the ray direction
+    float Distance;
+    // NOTE: RAY_NO_HIT when nothing was hit
+    unsigned Instance;
+    unsigned Triangle;
+    // NOTE: World space geometric normal facing the ray origin
+    glm::vec3 Normal;
+};
+
+/**
+ * @brief Triangles of one mesh in object space with their BVH
+ *
+ */
+class RayMesh {
+public:
+    /**
+     * @brief Copies the triangles and builds their BVH. Thread safe, meshes
+     * can be built on jobs
+     *
+     * @param vertices - Interleaved vertex data, position first
+     * @param vertexCount - Vertex count
+     * @param stride - Floats per vertex
+     * @param indices - Triangle list, 0 to use the vertices in order
+     * @param indexCount - Index count, ignored without indices
+     */
+    void Build(const float* vertices, unsigned vertexCount, unsigned stride, const unsigned* indices, unsigned indexCount);
+
+    const Bvh& GetBvh() const { return mBvh; }
+    unsigned GetTriangleCount() const { return (unsigned)mTriangles.size() / 3; }
+
+    /**
+     * @brief Corners of a triangle in leaf order
+     *
+     */
+    const glm::vec3* GetTriangle(unsigned triangle) const { return &mTriangles[triangle * 3]; }
+
+private:
+    Bvh mBvh;
+    std::vector<glm::vec3> mTriangles;
+};
+
+/**
+ * @brief Two level ray query structure. Instances reference meshes, which
+ * must outlive the scene
+ *
+ */
+class RayScene {
+public:
+    /**
+     * @brief Adds an instance. Call Build once all instances are in
+     *
+     * @param mesh - Mesh to place
+     * @param world - World matrix
+     * @param name - Reported by GetName, for picking
+     *
+     * @returns Instance index
+     */
+    unsigned AddInstance(const RayMesh& mesh, const glm::mat4& world, const std::string& name);
+
+    /**
+     * @brief Moves an instance. Queries see it once Refit runs
+     *
+     * @param instance - Instance index
+     * @param world - World matrix
+     */
+    void SetTransform(unsigned instance, const glm::mat4& world);
+
+    /**
+     * @brief Builds the top level BVH over all instances
+     *
+     */
+    void Build();
+
+    /**
+     * @brief Updates the top level bounds after SetTransform. Cheaper than
+     * Build while instances stay roughly where they were built
+     *
+     */
+    void Refit();
+
+    /**
+     * @brief Finds the closest hit along a ray
+     *
+     * @param ray - Ray, direction need not be normalized
+     * @param hit - Receives the closest hit
+     *
+     * @returns true - Something was hit, false - Nothing was hit
+     */
+    bool Intersect(const Ray& ray, RayHit& hit) const;
+
+    /**
+     * @brief Finds the closest hits of many rays, traced in packets of four.
+     * Coherent rays, like probes around one point, share most node visits
+     *
+     * @param rays - Rays
+     * @param count - Ray count
+     * @param hits - Receives one hit per ray, Instance is RAY_NO_HIT on a miss
+     */
+    void IntersectStream(const Ray* rays, unsigned count, RayHit* hits) const;
+
+    unsigned GetInstanceCount() const { return (unsigned)mInstances.size(); }
+    const std::string& GetName(unsigned instance) const { return mInstances[instance].Name; }
+
+private:
+    struct Instance {
+        const RayMesh* Mesh;
+        glm::mat4 World;
+        glm::mat4 InverseWorld;
+        std::string Name;
+    };
+
+    std::vector<Instance> mInstances;
+    std::vector<BvhBox> mBounds;
+    Bvh mBvh;
+
+    BvhBox worldBounds(const Instance& instance) const;
+    void finishHit(const Ray& ray, RayHit& hit) const;
+};
@@ -1,4 +1,5 @@
 #include "camera.hpp"
+#include "bvh.hpp"
 
 #include <glm/gtc/constants.hpp>
 
@@ -14,6 +15,8 @@ OrbitalCamera::OrbitalCamera(float fov, float distance, float rotateSpeed, float
     mTarget = target;
     mYaw = -90.0f;
     mPitch = 0.0f;
+    mCollider = 0;
+    mCollisionRadius = 0.1f;
     updateVectors();
 }
 
@@ -43,10 +46,76 @@ OrbitalCamera::Move(float dx, float dy, float dt) {
     if ((dx == 0 or dy == 0) and dx != dy)
         speed = speed / sqrt(2.0f);
 
-    mPosition += (dx * mRight + dy * mFront) * speed * dt;
+    glm::vec3 Delta = (dx * mRight + dy * mFront) * speed * dt;
+    if (mCollider) {
+        mPosition += slide(Delta);
+        keepAboveGround();
+    } else {
+        mPosition += Delta;
+    }
     updateVectors();
 }
 
+void
+OrbitalCamera::SetView(const glm::vec3& position, float yaw, float pitch) {
+    mPosition = position;
+    mYaw = yaw;
+    mPitch = glm::clamp(pitch, -89.0f, 89.0f);
+    updateVectors();
+}
+
+glm::vec3
+OrbitalCamera::slide(glm::vec3 delta) const {
+    // NOTE: Centre, both sides and the bottom of the camera, traced as one packet
+    const glm::vec3 Offsets[4] = { glm::vec3(0.0f), mRight * mCollisionRadius, -mRight * mCollisionRadius, -mWorldUp * mCollisionRadius };
+    for (int Iteration = 0; Iteration < 3; ++Iteration) {
+        float Length = glm::length(delta);
+        if (Length <= 0.0f) {
+            break;
+        }
+
+        Ray Probes[4];
+        RayHit Hits[4];
+        for (unsigned ProbeIdx = 0; ProbeIdx < 4; ++ProbeIdx) {
+            Probes[ProbeIdx].Origin = mPosition + Offsets[ProbeIdx];
+            Probes[ProbeIdx].Direction = delta / Length;
+            Probes[ProbeIdx].MaxDistance = Length + mCollisionRadius;
+        }
+        mCollider->IntersectStream(Probes, 4, Hits);
+
+        const RayHit* Closest = 0;
+        for (unsigned ProbeIdx = 0; ProbeIdx < 4; ++ProbeIdx) {
+            if (Hits[ProbeIdx].Instance != RAY_NO_HIT && (!Closest || Hits[ProbeIdx].Distance < Closest->Distance)) {
+                Closest = &Hits[ProbeIdx];
+            }
+        }
+        if (!Closest) {
+            break;
+        }
+        // NOTE: Wedged into a corner, stay put
+        if (Iteration == 2) {
+            return glm::vec3(0.0f);
+        }
+
+        // NOTE: Normals face the probes, so this removes the part of the move
+        // going into the surface and keeps the part along it
+        delta -= glm::dot(delta, Closest->Normal) * Closest->Normal;
+    }
+    return delta;
+}
+
+void
+OrbitalCamera::keepAboveGround() {
+    Ray Down;
+    Down.Origin = mPosition + mWorldUp * mCollisionRadius;
+    Down.Direction = -mWorldUp;
+    Down.MaxDistance = 2.0f * mCollisionRadius;
+    RayHit Hit;
+    if (mCollider->Intersect(Down, Hit)) {
+        mPosition = Down.Origin + Down.Direction * Hit.Distance + mWorldUp * mCollisionRadius;
+    }
+}
+
 
 void
 OrbitalCamera::updateVectors() {
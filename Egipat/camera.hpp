@@ -14,6 +14,8 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+class RayScene;
+
 class OrbitalCamera {
 public:
     float mFOV;
@@ -29,6 +31,9 @@ public:
     glm::vec3 mUp;
     glm::vec3 mRight;
     glm::vec3 mTarget;
+    // NOTE: Geometry the camera can't move through, 0 to fly freely
+    const RayScene* mCollider;
+    float mCollisionRadius;
 
     /**
      * @brief Ctor
@@ -59,6 +64,15 @@ public:
      */
     void Move(float dx, float dy, float dt);
 
+    /**
+     * @brief Places the camera, ignoring mCollider
+     *
+     * @param position - Camera position
+     * @param yaw - Yaw in degrees
+     * @param pitch - Pitch in degrees, clamped like Rotate
+     */
+    void SetView(const glm::vec3& position, float yaw, float pitch);
+
 private:
 
     /**
@@ -66,4 +80,19 @@ private:
      *
      */
     void updateVectors();
+
+    /**
+     * @brief Clips a move against mCollider, sliding along whatever it would hit
+     *
+     * @param delta - Intended move
+     *
+     * @returns Move that keeps mCollisionRadius from the surfaces in the way
+     */
+    glm::vec3 slide(glm::vec3 delta) const;
+
+    /**
+     * @brief Lifts the camera onto the ground below it when it sank into it
+     *
+     */
+    void keepAboveGround();
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "camerapath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+/**
+ * @brief One segment of the spline between p1 and p2. Keys needn't be evenly
+ * spaced in time, so tangents are per second and scaled to the segment
+ *
+ */
+template<class T>
+static T
+bezierSegment(const T& p0, const T& p1, const T& p2, const T& p3, float t0, float t1, float t2, float t3, float u) {
+    float Span = t2 - t1;
+    T Tangent1 = (p2 - p0) * (Span / std::max(t2 - t0, 1e-6f));
+    T Tangent2 = (p3 - p1) * (Span / std::max(t3 - t1, 1e-6f));
+    T Control1 = p1 + Tangent1 * (1.0f / 3.0f);
+    T Control2 = p2 - Tangent2 * (1.0f / 3.0f);
+    float V = 1.0f - u;
+    return p1 * (V * V * V) + Control1 * (3.0f * V * V * u) + Control2 * (3.0f * V * u * u) + p2 * (u * u * u);
+}
+
+void
+CameraPath::AddKey(float time, const glm::vec3& position, float yaw, float pitch) {
+    CameraKey Key;
+    Key.Time = mKeys.empty() ? time : std::max(time, mKeys.back().Time);
+    Key.Position = position;
+    Key.Yaw = yaw;
+    Key.Pitch = pitch;
+    if (!mKeys.empty()) {
+        Key.Yaw -= 360.0f * std::round((Key.Yaw - mKeys.back().Yaw) / 360.0f);
+    }
+    mKeys.push_back(Key);
+}
+
+void
+CameraPath::Sample(float time, glm::vec3& position, float& yaw, float& pitch) const {
+    if (mKeys.empty()) {
+        return;
+    }
+
+    // NOTE: First key after time, the segment ends there
+    unsigned Next = (unsigned)(std::upper_bound(mKeys.begin(), mKeys.end(), time, [](float value, const CameraKey& key) { return value < key.Time; }) - mKeys.begin());
+    if (Next == 0 || Next == mKeys.size()) {
+        const CameraKey& End = Next ? mKeys.back() : mKeys.front();
+        position = End.Position;
+        yaw = End.Yaw;
+        pitch = End.Pitch;
+        return;
+    }
+
+    // NOTE: The end keys are repeated to close off the first and last segment
+    const CameraKey& K1 = mKeys[Next - 1];
+    const CameraKey& K2 = mKeys[Next];
+    const CameraKey& K0 = Next >= 2 ? mKeys[Next - 2] : K1;
+    const CameraKey& K3 = Next + 1 < mKeys.size() ? mKeys[Next + 1] : K2;
+    float U = (time - K1.Time) / (K2.Time - K1.Time);
+    position = bezierSegment(K0.Position, K1.Position, K2.Position, K3.Position, K0.Time, K1.Time, K2.Time, K3.Time, U);
+    yaw = bezierSegment(K0.Yaw, K1.Yaw, K2.Yaw, K3.Yaw, K0.Time, K1.Time, K2.Time, K3.Time, U);
+    pitch = bezierSegment(K0.Pitch, K1.Pitch, K2.Pitch, K3.Pitch, K0.Time, K1.Time, K2.Time, K3.Time, U);
+}
+
+bool
+CameraPath::Load(const std::string& path) {
+    std::ifstream File(path.c_str());
+    if (!File) {
+        std::cerr << "[Err] Failed to open camera path " << path << std::endl;
+        return false;
+    }
+
+    mKeys.clear();
+    std::string Line;
+    while (std::getline(File, Line)) {
+        if (Line.empty() || Line[0] == '#') {
+            continue;
+        }
+        std::istringstream Fields(Line);
+        float Time, Yaw, Pitch;
+        glm::vec3 Position;
+        if (!(Fields >> Time >> Position.x >> Position.y >> Position.z >> Yaw >> Pitch)) {
+            std::cerr << "[Err] Bad camera path key in " << path << ": " << Line << std::endl;
+            mKeys.clear();
+            return false;
+        }
+        AddKey(Time, Position, Yaw, Pitch);
+    }
+    return true;
+}
+
+bool
+CameraPath::Save(const std::string& path) const {
+    std::ofstream File(path.c_str(), std::ios::trunc);
+    File << std::fixed << std::setprecision(4);
+    File << "# time x y z yaw pitch" << std::endl;
+    for (unsigned KeyIdx = 0; KeyIdx < mKeys.size(); ++KeyIdx) {
+        const CameraKey& Key = mKeys[KeyIdx];
+        File << Key.Time << " " << Key.Position.x << " " << Key.Position.y << " " << Key.Position.z << " " << Key.Yaw << " " << Key.Pitch << std::endl;
+    }
+    if (!File) {
+        std::cerr << "[Err] Failed to write camera path " << path << std::endl;
+        return false;
+    }
+    return true;
+}
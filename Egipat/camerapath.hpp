@@ -0,0 +1,70 @@
+/**
+ * @file camerapath.hpp
+ * @brief Scripted camera paths. Keyframes hold a time, position, yaw and
+ * pitch, playback runs a Catmull-Rom spline through them. Paths are recorded
+ * from the live camera and saved as text, so benchmarks and captures can
+ * replay exactly the same views
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct CameraKey {
+    // NOTE: Seconds from the start of the path
+    float Time;
+    glm::vec3 Position;
+    float Yaw;
+    float Pitch;
+};
+
+class CameraPath {
+public:
+    void Clear() { mKeys.clear(); }
+
+    /**
+     * @brief Appends a keyframe. Yaw is unwrapped against the previous key so
+     * playback turns the short way
+     *
+     * @param time - Seconds, must not be before the last key
+     * @param position - Camera position
+     * @param yaw - Yaw in degrees
+     * @param pitch - Pitch in degrees
+     */
+    void AddKey(float time, const glm::vec3& position, float yaw, float pitch);
+
+    /**
+     * @brief Evaluates the spline. Each segment is a cubic Bezier whose inner
+     * control points come from Catmull-Rom tangents, so the curve passes
+     * through every key. Times outside the path clamp to its ends
+     *
+     * @param time - Seconds from the start of the path
+     * @param position - Receives the camera position
+     * @param yaw - Receives the yaw in degrees
+     * @param pitch - Receives the pitch in degrees
+     */
+    void Sample(float time, glm::vec3& position, float& yaw, float& pitch) const;
+
+    /**
+     * @brief Reads keys written by Save, one "time x y z yaw pitch" per line
+     *
+     * @param path - Path file
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    bool IsEmpty() const { return mKeys.empty(); }
+    unsigned GetKeyCount() const { return (unsigned)mKeys.size(); }
+    float GetDuration() const { return mKeys.empty() ? 0.0f : mKeys.back().Time; }
+
+private:
+    std::vector<CameraKey> mKeys;
+};
@@ -0,0 +1,741 @@
+#include "capture.hpp"
+#include "gpumemory.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+enum ECaptureRecord {
+    RECORD_END = 0,
+    RECORD_FRAME_BEGIN,
+    RECORD_FRAME_END,
+    RECORD_BUFFER,
+    RECORD_VERTEX_ARRAY,
+    RECORD_TEXTURE,
+    RECORD_PIPELINE,
+    RECORD_BIND_PIPELINE,
+    RECORD_BIND_TEXTURE,
+    RECORD_BIND_VERTEX_ARRAY,
+    RECORD_BIND_INDEX_BUFFER,
+    RECORD_SET_CONSTANTS,
+    RECORD_DRAW,
+    RECORD_DRAW_INDEXED,
+    RECORD_MULTI_DRAW_INDEXED,
+    RECORD_SET_RENDER_STATE,
+    RECORD_BEGIN_QUERY,
+    RECORD_END_QUERY,
+    RECORD_BEGIN_CONDITIONAL,
+    RECORD_END_CONDITIONAL,
+};
+
+struct CapturedAttribute {
+    unsigned Index;
+    int Size;
+    unsigned Type;
+    int Normalized;
+    int Integer;
+    int Stride;
+    unsigned Divisor;
+    unsigned Buffer;
+    unsigned long long Offset;
+};
+
+struct CapturedLevel {
+    int Width;
+    int Height;
+    int Depth;
+};
+
+// NOTE: Texels are captured and replayed as RGBA8 whatever the source format
+static const size_t TexelBytes = 4;
+static const GLenum TextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+static const GLenum TextureBindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP };
+
+FrameCapture::FrameCapture()
+    : mFramesLeft(0),
+      mFrameCount(0),
+      mCommandCount(0),
+      mResourceBytes(0) {}
+
+bool
+FrameCapture::Start(const std::string& path, unsigned frameCount) {
+    mFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!mFile || !frameCount) {
+        std::cerr << "[Err] Failed to open capture file " << path << std::endl;
+        return false;
+    }
+
+    mPath = path;
+    mFramesLeft = frameCount;
+    write((unsigned)CAPTURE_MAGIC);
+    write((unsigned)CAPTURE_VERSION);
+    return true;
+}
+
+void
+FrameCapture::BeginFrame(const FrameUniforms& frame) {
+    if (!IsCapturing()) {
+        return;
+    }
+
+    write((unsigned)RECORD_FRAME_BEGIN);
+    write(frame.Camera);
+    write(frame.Lights);
+    write(frame.PointLightCount);
+}
+
+void
+FrameCapture::Capture(const CommandBuffer& commands) {
+    if (IsCapturing()) {
+        commands.RecordInto(*this);
+    }
+}
+
+void
+FrameCapture::EndFrame() {
+    if (!IsCapturing()) {
+        return;
+    }
+
+    write((unsigned)RECORD_FRAME_END);
+    ++mFrameCount;
+    if (--mFramesLeft) {
+        return;
+    }
+
+    write((unsigned)RECORD_END);
+    mFile.close();
+    if (!mFile) {
+        std::cerr << "[Err] Failed to write capture file " << mPath << std::endl;
+        return;
+    }
+    std::cout << "Captured " << mFrameCount << " frames, " << mCommandCount << " commands and "
+              << mResourceBytes / (1024 * 1024) << " MB of resources to " << mPath << std::endl;
+}
+
+void
+FrameCapture::writeString(const std::string& value) {
+    write((unsigned)value.size());
+    writeBytes(value.data(), value.size());
+}
+
+void
+FrameCapture::BindPipeline(ShaderVariants& variants, unsigned key) {
+    unsigned Pipeline = capturePipeline(variants, key);
+    write((unsigned)RECORD_BIND_PIPELINE);
+    write(Pipeline);
+    write(key);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::BindTexture(unsigned slot, ETextureTarget target, unsigned texture) {
+    if (texture && !mTextures.count(texture)) {
+        captureTexture(texture, target);
+    }
+    write((unsigned)RECORD_BIND_TEXTURE);
+    write(slot);
+    write((unsigned)target);
+    write(texture);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::BindVertexArray(unsigned vertexArray) {
+    if (vertexArray && !mVertexArrays.count(vertexArray)) {
+        captureVertexArray(vertexArray);
+    }
+    write((unsigned)RECORD_BIND_VERTEX_ARRAY);
+    write(vertexArray);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::BindIndexBuffer(unsigned buffer) {
+    if (buffer && !mBuffers.count(buffer)) {
+        captureBuffer(buffer);
+    }
+    write((unsigned)RECORD_BIND_INDEX_BUFFER);
+    write(buffer);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::SetConstants(unsigned binding, const void* data, unsigned size) {
+    write((unsigned)RECORD_SET_CONSTANTS);
+    write(binding);
+    write(size);
+    writeBytes(data, size);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::SetRenderState(unsigned state) {
+    write((unsigned)RECORD_SET_RENDER_STATE);
+    write(state);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::Draw(unsigned first, unsigned count, unsigned instanceCount, EPrimitive primitive) {
+    write((unsigned)RECORD_DRAW);
+    write(first);
+    write(count);
+    write(instanceCount);
+    write((unsigned)primitive);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::DrawIndexed(unsigned count, size_t offset, EPrimitive primitive) {
+    write((unsigned)RECORD_DRAW_INDEXED);
+    write(count);
+    write((unsigned long long)offset);
+    write((unsigned)primitive);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::MultiDrawIndexed(const int* counts, const void* const* offsets, const int* baseVertices, unsigned drawCount) {
+    write((unsigned)RECORD_MULTI_DRAW_INDEXED);
+    write(drawCount);
+    write((unsigned)(baseVertices != 0));
+    for (unsigned DrawIdx = 0; DrawIdx < drawCount; ++DrawIdx) {
+        write(counts[DrawIdx]);
+        write((unsigned long long)(size_t)offsets[DrawIdx]);
+        write(baseVertices ? baseVertices[DrawIdx] : 0);
+    }
+    ++mCommandCount;
+}
+
+void
+FrameCapture::BeginQuery(unsigned query) {
+    write((unsigned)RECORD_BEGIN_QUERY);
+    write(query);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::EndQuery() {
+    write((unsigned)RECORD_END_QUERY);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::BeginConditional(unsigned query) {
+    write((unsigned)RECORD_BEGIN_CONDITIONAL);
+    write(query);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::EndConditional() {
+    write((unsigned)RECORD_END_CONDITIONAL);
+    ++mCommandCount;
+}
+
+void
+FrameCapture::captureBuffer(unsigned buffer) {
+    mBuffers.insert(buffer);
+    GLint Previous = 0;
+    glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &Previous);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    GLint Size = 0;
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &Size);
+    std::vector<unsigned char> Data(Size);
+    if (Size) {
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, Size, Data.data());
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, Previous);
+
+    write((unsigned)RECORD_BUFFER);
+    write(buffer);
+    write((unsigned)Size);
+    writeBytes(Data.data(), Data.size());
+    mResourceBytes += Data.size();
+}
+
+void
+FrameCapture::captureVertexArray(unsigned vertexArray) {
+    mVertexArrays.insert(vertexArray);
+    GLint Previous = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &Previous);
+    glBindVertexArray(vertexArray);
+
+    GLint MaxAttributes = 0;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &MaxAttributes);
+    std::vector<CapturedAttribute> Attributes;
+    for (GLint Index = 0; Index < MaxAttributes; ++Index) {
+        GLint Enabled = 0;
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &Enabled);
+        if (!Enabled) {
+            continue;
+        }
+
+        CapturedAttribute Attribute;
+        GLint Value = 0;
+        Attribute.Index = Index;
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_SIZE, &Attribute.Size);
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_TYPE, &Value);
+        Attribute.Type = Value;
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &Attribute.Normalized);
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &Attribute.Integer);
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &Attribute.Stride);
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &Value);
+        Attribute.Divisor = Value;
+        glGetVertexAttribiv(Index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &Value);
+        Attribute.Buffer = Value;
+        void* Pointer = 0;
+        glGetVertexAttribPointerv(Index, GL_VERTEX_ATTRIB_ARRAY_POINTER, &Pointer);
+        Attribute.Offset = (unsigned long long)(size_t)Pointer;
+        Attributes.push_back(Attribute);
+    }
+    GLint ElementBuffer = 0;
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &ElementBuffer);
+    glBindVertexArray(Previous);
+
+    // NOTE: Buffers go first so replay can resolve them while building the layout
+    for (unsigned AttributeIdx = 0; AttributeIdx < Attributes.size(); ++AttributeIdx) {
+        if (Attributes[AttributeIdx].Buffer && !mBuffers.count(Attributes[AttributeIdx].Buffer)) {
+            captureBuffer(Attributes[AttributeIdx].Buffer);
+        }
+    }
+    if (ElementBuffer && !mBuffers.count(ElementBuffer)) {
+        captureBuffer(ElementBuffer);
+    }
+
+    write((unsigned)RECORD_VERTEX_ARRAY);
+    write(vertexArray);
+    write((unsigned)ElementBuffer);
+    write((unsigned)Attributes.size());
+    writeBytes(Attributes.data(), Attributes.size() * sizeof(CapturedAttribute));
+}
+
+void
+FrameCapture::captureTexture(unsigned texture, ETextureTarget target) {
+    mTextures.insert(texture);
+    GLenum Target = TextureTargets[target];
+    GLint Previous = 0;
+    glGetIntegerv(TextureBindings[target], &Previous);
+    glBindTexture(Target, texture);
+
+    GLint Parameters[6];
+    glGetTexParameteriv(Target, GL_TEXTURE_MIN_FILTER, &Parameters[0]);
+    glGetTexParameteriv(Target, GL_TEXTURE_MAG_FILTER, &Parameters[1]);
+    glGetTexParameteriv(Target, GL_TEXTURE_WRAP_S, &Parameters[2]);
+    glGetTexParameteriv(Target, GL_TEXTURE_WRAP_T, &Parameters[3]);
+    glGetTexParameteriv(Target, GL_TEXTURE_BASE_LEVEL, &Parameters[4]);
+    glGetTexParameteriv(Target, GL_TEXTURE_MAX_LEVEL, &Parameters[5]);
+
+    // NOTE: Streamed textures may only have their coarse levels resident,
+    // levels are read from the base level until the first missing one.
+    // Cube map levels hold their faces as 6 layers
+    const bool Cube = target == TEXTURE_TARGET_CUBE_MAP;
+    const GLenum LevelTarget = Cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : Target;
+    std::vector<CapturedLevel> Levels;
+    std::vector<unsigned char> Texels;
+    for (GLint Level = Parameters[4]; Level <= std::min(Parameters[5], 16); ++Level) {
+        CapturedLevel Current;
+        glGetTexLevelParameteriv(LevelTarget, Level, GL_TEXTURE_WIDTH, &Current.Width);
+        glGetTexLevelParameteriv(LevelTarget, Level, GL_TEXTURE_HEIGHT, &Current.Height);
+        glGetTexLevelParameteriv(LevelTarget, Level, GL_TEXTURE_DEPTH, &Current.Depth);
+        if (Current.Width <= 0 || Current.Height <= 0) {
+            break;
+        }
+        if (Cube) {
+            Current.Depth = 6;
+        }
+
+        size_t Offset = Texels.size();
+        size_t LayerBytes = (size_t)Current.Width * Current.Height * TexelBytes;
+        Texels.resize(Offset + LayerBytes * std::max(Current.Depth, 1));
+        if (Cube) {
+            for (unsigned Face = 0; Face < 6; ++Face) {
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face, Level, GL_RGBA, GL_UNSIGNED_BYTE, &Texels[Offset + Face * LayerBytes]);
+            }
+        } else {
+            glGetTexImage(Target, Level, GL_RGBA, GL_UNSIGNED_BYTE, &Texels[Offset]);
+        }
+        Levels.push_back(Current);
+    }
+    glBindTexture(Target, Previous);
+
+    write((unsigned)RECORD_TEXTURE);
+    write(texture);
+    write((unsigned)target);
+    writeBytes(Parameters, sizeof(Parameters));
+    write((unsigned)Levels.size());
+    writeBytes(Levels.data(), Levels.size() * sizeof(CapturedLevel));
+    writeBytes(Texels.data(), Texels.size());
+    mResourceBytes += Texels.size();
+}
+
+unsigned
+FrameCapture::capturePipeline(ShaderVariants& variants, unsigned key) {
+    std::vector<const ShaderVariants*>::iterator Found = std::find(mPipelines.begin(), mPipelines.end(), &variants);
+    if (Found != mPipelines.end()) {
+        return (unsigned)(Found - mPipelines.begin());
+    }
+    mPipelines.push_back(&variants);
+
+    // NOTE: Plain uniforms are set once per program by the setup callback,
+    // which can't be captured. Its results are read back from the first
+    // variant instead and applied to every variant on replay
+    unsigned Program = variants.Get(key).GetId();
+    GLint UniformCount = 0;
+    glGetProgramiv(Program, GL_ACTIVE_UNIFORMS, &UniformCount);
+    std::vector<std::string> Names;
+    std::vector<unsigned char> IsFloat;
+    std::vector<float> Floats;
+    std::vector<int> Ints;
+    for (GLint UniformIdx = 0; UniformIdx < UniformCount; ++UniformIdx) {
+        char Name[256];
+        GLsizei Length = 0;
+        GLint Size = 0;
+        GLenum Type = 0;
+        glGetActiveUniform(Program, UniformIdx, sizeof(Name), &Length, &Size, &Type, Name);
+        GLint Location = glGetUniformLocation(Program, Name);
+        bool Float = Type == GL_FLOAT;
+        bool Int = Type == GL_INT || Type == GL_SAMPLER_2D || Type == GL_SAMPLER_2D_ARRAY || Type == GL_SAMPLER_CUBE;
+        if (Size != 1 || Location < 0 || (!Float && !Int)) {
+            continue;
+        }
+
+        float FloatValue = 0.0f;
+        int IntValue = 0;
+        if (Float) {
+            glGetUniformfv(Program, Location, &FloatValue);
+        } else {
+            glGetUniformiv(Program, Location, &IntValue);
+        }
+        Names.push_back(std::string(Name, Length));
+        IsFloat.push_back(Float);
+        Floats.push_back(FloatValue);
+        Ints.push_back(IntValue);
+    }
+
+    write((unsigned)RECORD_PIPELINE);
+    writeString(variants.GetVertexPath());
+    writeString(variants.GetFragmentPath());
+    write((unsigned)Names.size());
+    for (unsigned UniformIdx = 0; UniformIdx < Names.size(); ++UniformIdx) {
+        writeString(Names[UniformIdx]);
+        write(IsFloat[UniformIdx]);
+        write(Floats[UniformIdx]);
+        write(Ints[UniformIdx]);
+    }
+    return (unsigned)mPipelines.size() - 1;
+}
+
+template<class T>
+static bool
+read(std::ifstream& file, T& value) {
+    file.read((char*)&value, sizeof(T));
+    return (bool)file;
+}
+
+static bool
+readString(std::ifstream& file, std::string& value) {
+    unsigned Length = 0;
+    if (!read(file, Length)) {
+        return false;
+    }
+    value.resize(Length);
+    file.read(&value[0], Length);
+    return (bool)file;
+}
+
+CaptureReplay::CaptureReplay()
+    : mCommandCount(0),
+      mResourceBytes(0) {}
+
+CaptureReplay::~CaptureReplay() {
+    for (std::map<unsigned, unsigned>::iterator It = mVertexArrays.begin(); It != mVertexArrays.end(); ++It) {
+        GpuMemory::DeleteVertexArray(It->second);
+    }
+    for (std::map<unsigned, unsigned>::iterator It = mBuffers.begin(); It != mBuffers.end(); ++It) {
+        GpuMemory::DeleteBuffer(It->second);
+    }
+    for (std::map<unsigned, unsigned>::iterator It = mTextures.begin(); It != mTextures.end(); ++It) {
+        GpuMemory::DeleteTexture(It->second);
+    }
+    for (std::map<unsigned, unsigned>::iterator It = mQueries.begin(); It != mQueries.end(); ++It) {
+        glDeleteQueries(1, &It->second);
+    }
+}
+
+unsigned
+CaptureReplay::mapName(const std::map<unsigned, unsigned>& names, unsigned name) const {
+    std::map<unsigned, unsigned>::const_iterator Found = names.find(name);
+    return Found != names.end() ? Found->second : 0;
+}
+
+unsigned
+CaptureReplay::mapQuery(unsigned query) {
+    // NOTE: Queries hold no captured state, they're created on first use
+    std::map<unsigned, unsigned>::iterator Found = mQueries.find(query);
+    if (Found != mQueries.end()) {
+        return Found->second;
+    }
+    unsigned Query = 0;
+    glGenQueries(1, &Query);
+    mQueries[query] = Query;
+    return Query;
+}
+
+bool
+CaptureReplay::Load(const std::string& path) {
+    std::ifstream File(path, std::ios::binary);
+    unsigned Magic = 0, Version = 0;
+    if (!read(File, Magic) || !read(File, Version) || Magic != CAPTURE_MAGIC || Version != CAPTURE_VERSION) {
+        std::cerr << "[Err] " << path << " is not a capture file" << std::endl;
+        return false;
+    }
+
+    CapturedFrame* Frame = 0;
+    for (;;) {
+        unsigned Record = 0;
+        if (!read(File, Record)) {
+            break;
+        }
+        if (Record == RECORD_END) {
+            return true;
+        }
+
+        bool Ok = true;
+        unsigned A = 0, B = 0, C = 0;
+        switch (Record) {
+        case RECORD_FRAME_BEGIN:
+            mFrames.emplace_back();
+            Frame = &mFrames.back();
+            Ok = read(File, Frame->Camera) && read(File, Frame->Lights) && read(File, Frame->PointLightCount);
+            break;
+        case RECORD_FRAME_END:
+            Frame = 0;
+            break;
+        case RECORD_BUFFER: Ok = readBuffer(File); break;
+        case RECORD_VERTEX_ARRAY: Ok = readVertexArray(File); break;
+        case RECORD_TEXTURE: Ok = readTexture(File); break;
+        case RECORD_PIPELINE: Ok = readPipeline(File); break;
+        default:
+            // NOTE: Everything else is a command and belongs to a frame
+            if (!Frame) {
+                Ok = false;
+                break;
+            }
+            ++mCommandCount;
+            if (Record == RECORD_BIND_PIPELINE) {
+                Ok = read(File, A) && read(File, B) && A < mPipelines.size();
+                if (Ok) {
+                    Frame->Commands.BindPipeline(*mPipelines[A], B);
+                }
+            } else if (Record == RECORD_BIND_TEXTURE) {
+                Ok = read(File, A) && read(File, B) && read(File, C) && B <= TEXTURE_TARGET_CUBE_MAP;
+                if (Ok) {
+                    Frame->Commands.BindTexture(A, (ETextureTarget)B, mapName(mTextures, C));
+                }
+            } else if (Record == RECORD_BIND_VERTEX_ARRAY) {
+                Ok = read(File, A);
+                Frame->Commands.BindVertexArray(mapName(mVertexArrays, A));
+            } else if (Record == RECORD_BIND_INDEX_BUFFER) {
+                Ok = read(File, A);
+                Frame->Commands.BindIndexBuffer(mapName(mBuffers, A));
+            } else if (Record == RECORD_SET_CONSTANTS) {
+                Ok = read(File, A) && read(File, B);
+                std::vector<unsigned char> Data(Ok ? B : 0);
+                Ok = Ok && File.read((char*)Data.data(), B);
+                if (Ok) {
+                    Frame->Commands.SetConstants(A, Data.data(), B);
+                }
+            } else if (Record == RECORD_SET_RENDER_STATE) {
+                Ok = read(File, A);
+                Frame->Commands.SetRenderState(A);
+            } else if (Record == RECORD_DRAW) {
+                unsigned Primitive = 0;
+                Ok = read(File, A) && read(File, B) && read(File, C) && read(File, Primitive) && Primitive <= PRIMITIVE_LINES;
+                if (Ok) {
+                    Frame->Commands.Draw(A, B, C, (EPrimitive)Primitive);
+                }
+            } else if (Record == RECORD_DRAW_INDEXED) {
+                unsigned long long Offset = 0;
+                Ok = read(File, A) && read(File, Offset) && read(File, B) && B <= PRIMITIVE_LINES;
+                if (Ok) {
+                    Frame->Commands.DrawIndexed(A, (size_t)Offset, (EPrimitive)B);
+                }
+            } else if (Record == RECORD_MULTI_DRAW_INDEXED) {
+                Ok = read(File, A) && read(File, B);
+                std::vector<int> Counts(Ok ? A : 0), BaseVertices(Ok ? A : 0);
+                std::vector<const void*> Offsets(Ok ? A : 0);
+                for (unsigned DrawIdx = 0; Ok && DrawIdx < A; ++DrawIdx) {
+                    unsigned long long Offset = 0;
+                    Ok = read(File, Counts[DrawIdx]) && read(File, Offset) && read(File, BaseVertices[DrawIdx]);
+                    Offsets[DrawIdx] = (const void*)(size_t)Offset;
+                }
+                if (Ok) {
+                    Frame->Commands.MultiDrawIndexed(Counts.data(), Offsets.data(), B ? BaseVertices.data() : 0, A);
+                }
+            } else if (Record == RECORD_BEGIN_QUERY) {
+                Ok = read(File, A);
+                Frame->Commands.BeginQuery(mapQuery(A));
+            } else if (Record == RECORD_END_QUERY) {
+                Frame->Commands.EndQuery();
+            } else if (Record == RECORD_BEGIN_CONDITIONAL) {
+                Ok = read(File, A);
+                Frame->Commands.BeginConditional(mapQuery(A));
+            } else if (Record == RECORD_END_CONDITIONAL) {
+                Frame->Commands.EndConditional();
+            } else {
+                Ok = false;
+            }
+            break;
+        }
+        if (!Ok) {
+            break;
+        }
+    }
+
+    std::cerr << "[Err] Capture file " << path << " is truncated or corrupt" << std::endl;
+    return false;
+}
+
+bool
+CaptureReplay::readBuffer(std::ifstream& file) {
+    unsigned Captured = 0, Size = 0;
+    if (!read(file, Captured) || !read(file, Size)) {
+        return false;
+    }
+    std::vector<unsigned char> Data(Size);
+    if (!file.read((char*)Data.data(), Size)) {
+        return false;
+    }
+
+    // NOTE: Vertex and index data aren't told apart in the capture
+    unsigned Buffer = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "CaptureReplay");
+    glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+    GpuMemory::BufferData(Buffer, GL_COPY_WRITE_BUFFER, Size, Data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    mBuffers[Captured] = Buffer;
+    mResourceBytes += Size;
+    return true;
+}
+
+bool
+CaptureReplay::readVertexArray(std::ifstream& file) {
+    unsigned Captured = 0, ElementBuffer = 0, AttributeCount = 0;
+    if (!read(file, Captured) || !read(file, ElementBuffer) || !read(file, AttributeCount)) {
+        return false;
+    }
+    std::vector<CapturedAttribute> Attributes(AttributeCount);
+    if (!file.read((char*)Attributes.data(), AttributeCount * sizeof(CapturedAttribute))) {
+        return false;
+    }
+
+    unsigned VertexArray = GpuMemory::CreateVertexArray("CaptureReplay");
+    glBindVertexArray(VertexArray);
+    for (unsigned AttributeIdx = 0; AttributeIdx < AttributeCount; ++AttributeIdx) {
+        const CapturedAttribute& Attribute = Attributes[AttributeIdx];
+        glBindBuffer(GL_ARRAY_BUFFER, mapName(mBuffers, Attribute.Buffer));
+        glEnableVertexAttribArray(Attribute.Index);
+        if (Attribute.Integer) {
+            glVertexAttribIPointer(Attribute.Index, Attribute.Size, Attribute.Type, Attribute.Stride, (const void*)(size_t)Attribute.Offset);
+        } else {
+            glVertexAttribPointer(Attribute.Index, Attribute.Size, Attribute.Type, (GLboolean)Attribute.Normalized, Attribute.Stride, (const void*)(size_t)Attribute.Offset);
+        }
+        glVertexAttribDivisor(Attribute.Index, Attribute.Divisor);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mapName(mBuffers, ElementBuffer));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mVertexArrays[Captured] = VertexArray;
+    return true;
+}
+
+bool
+CaptureReplay::readTexture(std::ifstream& file) {
+    unsigned Captured = 0, Target = 0, LevelCount = 0;
+    GLint Parameters[6];
+    if (!read(file, Captured) || !read(file, Target) || Target > TEXTURE_TARGET_CUBE_MAP || !read(file, Parameters) || !read(file, LevelCount)) {
+        return false;
+    }
+    std::vector<CapturedLevel> Levels(LevelCount);
+    if (!file.read((char*)Levels.data(), LevelCount * sizeof(CapturedLevel))) {
+        return false;
+    }
+
+    GLenum GlTarget = TextureTargets[Target];
+    unsigned Texture = GpuMemory::CreateTexture("CaptureReplay");
+    glBindTexture(GlTarget, Texture);
+    glTexParameteri(GlTarget, GL_TEXTURE_MIN_FILTER, Parameters[0]);
+    glTexParameteri(GlTarget, GL_TEXTURE_MAG_FILTER, Parameters[1]);
+    glTexParameteri(GlTarget, GL_TEXTURE_WRAP_S, Parameters[2]);
+    glTexParameteri(GlTarget, GL_TEXTURE_WRAP_T, Parameters[3]);
+    glTexParameteri(GlTarget, GL_TEXTURE_BASE_LEVEL, Parameters[4]);
+    glTexParameteri(GlTarget, GL_TEXTURE_MAX_LEVEL, LevelCount ? Parameters[4] + LevelCount - 1 : Parameters[5]);
+
+    size_t Bytes = 0;
+    std::vector<unsigned char> Texels;
+    for (unsigned LevelIdx = 0; LevelIdx < LevelCount; ++LevelIdx) {
+        const CapturedLevel& Level = Levels[LevelIdx];
+        Texels.resize((size_t)Level.Width * Level.Height * std::max(Level.Depth, 1) * TexelBytes);
+        if (!file.read((char*)Texels.data(), Texels.size())) {
+            glBindTexture(GlTarget, 0);
+            GpuMemory::DeleteTexture(Texture);
+            return false;
+        }
+        if (Target == TEXTURE_TARGET_2D_ARRAY) {
+            glTexImage3D(GlTarget, Parameters[4] + LevelIdx, GL_RGBA8, Level.Width, Level.Height, Level.Depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, Texels.data());
+        } else if (Target == TEXTURE_TARGET_CUBE_MAP) {
+            size_t LayerBytes = (size_t)Level.Width * Level.Height * TexelBytes;
+            for (unsigned Face = 0; Face < 6; ++Face) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face, Parameters[4] + LevelIdx, GL_RGBA8, Level.Width, Level.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &Texels[Face * LayerBytes]);
+            }
+        } else {
+            glTexImage2D(GlTarget, Parameters[4] + LevelIdx, GL_RGBA8, Level.Width, Level.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, Texels.data());
+        }
+        Bytes += Texels.size();
+    }
+    glBindTexture(GlTarget, 0);
+    GpuMemory::SetTextureBytes(Texture, Bytes);
+    mTextures[Captured] = Texture;
+    mResourceBytes += Bytes;
+    return true;
+}
+
+bool
+CaptureReplay::readPipeline(std::ifstream& file) {
+    std::string VertexPath, FragmentPath;
+    unsigned UniformCount = 0;
+    if (!readString(file, VertexPath) || !readString(file, FragmentPath) || !read(file, UniformCount)) {
+        return false;
+    }
+    std::vector<CapturedUniform> Uniforms(UniformCount);
+    for (unsigned UniformIdx = 0; UniformIdx < UniformCount; ++UniformIdx) {
+        CapturedUniform& Uniform = Uniforms[UniformIdx];
+        unsigned char IsFloat = 0;
+        if (!readString(file, Uniform.Name) || !read(file, IsFloat) || !read(file, Uniform.Float) || !read(file, Uniform.Int)) {
+            return false;
+        }
+        Uniform.IsFloat = IsFloat != 0;
+    }
+
+    // NOTE: Sources are loaded from the paths, run the replay where the capture was made
+    mPipelines.emplace_back(new ShaderVariants(VertexPath, FragmentPath, [Uniforms](const Shader& variant) {
+        for (unsigned UniformIdx = 0; UniformIdx < Uniforms.size(); ++UniformIdx) {
+            if (Uniforms[UniformIdx].IsFloat) {
+                variant.SetUniform1f(Uniforms[UniformIdx].Name, Uniforms[UniformIdx].Float);
+            } else {
+                variant.SetUniform1i(Uniforms[UniformIdx].Name, Uniforms[UniformIdx].Int);
+            }
+        }
+    }));
+    return true;
+}
+
+void
+CaptureReplay::ExecuteFrame(unsigned frame, FrameUniforms& uniforms) const {
+    const CapturedFrame& Frame = mFrames[frame];
+    uniforms.Camera = Frame.Camera;
+    uniforms.Lights = Frame.Lights;
+    uniforms.PointLightCount = Frame.PointLightCount;
+    uniforms.Upload();
+    Frame.Commands.Execute(uniforms);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file capture.hpp
+ * @brief Offline reproduction of frames. FrameCapture writes the command
+ * buffers of a run of frames to a file. The file also holds the frame
+ * uniforms and a snapshot of every buffer, vertex array layout, texture and
+ * shader uniform the commands reference. CaptureReplay loads the file into
+ * a fresh context and executes the frames without the application, so
+ * driver and GPU cost can be timed on their own
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "commandbuffer.hpp"
+#include "frameuniforms.hpp"
+#include "shadervariants.hpp"
+
+#define CAPTURE_MAGIC 0x50414345
+#define CAPTURE_VERSION 2
+
+/**
+ * @brief Writes captured frames. Resources are snapshot the first time a
+ * command references them, later changes to them aren't seen. GL thread only
+ *
+ */
+class FrameCapture {
+public:
+    FrameCapture();
+
+    /**
+     * @brief Opens the file and captures the next frames
+     *
+     * @param path - Output file
+     * @param frameCount - Frames to capture
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Start(const std::string& path, unsigned frameCount);
+
+    bool IsCapturing() const { return mFramesLeft != 0; }
+
+    /**
+     * @brief Starts a frame with the blocks FrameUniforms::Upload binds
+     *
+     * @param frame - Frame uniforms after Upload
+     */
+    void BeginFrame(const FrameUniforms& frame);
+
+    /**
+     * @brief Appends a command buffer. Call right before executing it
+     *
+     * @param commands - Command buffer
+     */
+    void Capture(const CommandBuffer& commands);
+
+    /**
+     * @brief Ends the frame, closes the file after the last one
+     *
+     */
+    void EndFrame();
+
+    // NOTE: Recorder interface for CommandBuffer::RecordInto
+    void BindPipeline(ShaderVariants& variants, unsigned key);
+    void BindTexture(unsigned slot, ETextureTarget target, unsigned texture);
+    void BindVertexArray(unsigned vertexArray);
+    void BindIndexBuffer(unsigned buffer);
+    void SetConstants(unsigned binding, const void* data, unsigned size);
+    void SetRenderState(unsigned state);
+    void Draw(unsigned first, unsigned count, unsigned instanceCount, EPrimitive primitive);
+    void DrawIndexed(unsigned count, size_t offset, EPrimitive primitive);
+    void MultiDrawIndexed(const int* counts, const void* const* offsets, const int* baseVertices, unsigned drawCount);
+    void BeginQuery(unsigned query);
+    void EndQuery();
+    void BeginConditional(unsigned query);
+    void EndConditional();
+
+private:
+    std::ofstream mFile;
+    std::string mPath;
+    unsigned mFramesLeft;
+    unsigned mFrameCount;
+    unsigned mCommandCount;
+    size_t mResourceBytes;
+    std::set<unsigned> mBuffers;
+    std::set<unsigned> mVertexArrays;
+    std::set<unsigned> mTextures;
+    std::vector<const ShaderVariants*> mPipelines;
+
+    template<class T>
+    void write(const T& value) { mFile.write((const char*)&value, sizeof(T)); }
+    void writeBytes(const void* data, size_t size) { mFile.write((const char*)data, size); }
+    void writeString(const std::string& value);
+
+    void captureBuffer(unsigned buffer);
+    void captureVertexArray(unsigned vertexArray);
+    void captureTexture(unsigned texture, ETextureTarget target);
+    unsigned capturePipeline(ShaderVariants& variants, unsigned key);
+};
+
+/**
+ * @brief Recreates a capture on the current context. GL thread only
+ *
+ */
+class CaptureReplay {
+public:
+    CaptureReplay();
+    ~CaptureReplay();
+    CaptureReplay(const CaptureReplay&) = delete;
+    CaptureReplay& operator=(const CaptureReplay&) = delete;
+
+    /**
+     * @brief Reads the file and uploads its resources
+     *
+     * @param path - Capture file
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Load(const std::string& path);
+
+    /**
+     * @brief Uploads a frame's uniforms and executes its commands
+     *
+     * @param frame - Frame index
+     * @param uniforms - Frame uniforms to upload through
+     */
+    void ExecuteFrame(unsigned frame, FrameUniforms& uniforms) const;
+
+    unsigned GetFrameCount() const { return (unsigned)mFrames.size(); }
+    unsigned GetCommandCount() const { return mCommandCount; }
+    size_t GetResourceBytes() const { return mResourceBytes; }
+
+private:
+    struct CapturedFrame {
+        CameraUniforms Camera;
+        LightUniforms Lights;
+        unsigned PointLightCount;
+        CommandBuffer Commands;
+    };
+
+    struct CapturedUniform {
+        std::string Name;
+        bool IsFloat;
+        float Float;
+        int Int;
+    };
+
+    std::vector<CapturedFrame> mFrames;
+    // NOTE: Captured names to the names created here
+    std::map<unsigned, unsigned> mBuffers;
+    std::map<unsigned, unsigned> mVertexArrays;
+    std::map<unsigned, unsigned> mTextures;
+    std::map<unsigned, unsigned> mQueries;
+    std::vector<std::unique_ptr<ShaderVariants> > mPipelines;
+    unsigned mCommandCount;
+    size_t mResourceBytes;
+
+    unsigned mapName(const std::map<unsigned, unsigned>& names, unsigned name) const;
+    unsigned mapQuery(unsigned query);
+    bool readBuffer(std::ifstream& file);
+    bool readVertexArray(std::ifstream& file);
+    bool readTexture(std::ifstream& file);
+    bool readPipeline(std::ifstream& file);
+};
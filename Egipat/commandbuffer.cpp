@@ -0,0 +1,230 @@
+#include "commandbuffer.hpp"
+#include "frameuniforms.hpp"
+#include "shadervariants.hpp"
+
+#include <GL/glew.h>
+#include <cstring>
+
+static const GLenum TextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+static const GLenum PrimitiveModes[] = { GL_TRIANGLES, GL_TRIANGLE_STRIP, GL_LINES };
+
+void
+CommandBuffer::Reset() {
+    mCommands.clear();
+    mPayload.clear();
+}
+
+size_t
+CommandBuffer::allocatePayload(size_t size) {
+    size_t Offset = (mPayload.size() + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    mPayload.resize(Offset + size);
+    return Offset;
+}
+
+void
+CommandBuffer::BindPipeline(ShaderVariants& variants, unsigned key) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BIND_PIPELINE;
+    NewCommand.Pipeline.Variants = &variants;
+    NewCommand.Pipeline.Key = key;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::BindTexture(unsigned slot, ETextureTarget target, unsigned texture) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BIND_TEXTURE;
+    NewCommand.Texture.Slot = slot;
+    NewCommand.Texture.Target = target;
+    NewCommand.Texture.Id = texture;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::BindVertexArray(unsigned vertexArray) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BIND_VERTEX_ARRAY;
+    NewCommand.Object = vertexArray;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::BindIndexBuffer(unsigned buffer) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BIND_INDEX_BUFFER;
+    NewCommand.Object = buffer;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::SetConstants(unsigned binding, const void* data, unsigned size) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_SET_CONSTANTS;
+    NewCommand.Payload.Binding = binding;
+    NewCommand.Payload.Count = size;
+    NewCommand.Payload.BaseVertex = false;
+    NewCommand.Payload.Offset = allocatePayload(size);
+    std::memcpy(&mPayload[NewCommand.Payload.Offset], data, size);
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::SetRenderState(unsigned state) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_SET_RENDER_STATE;
+    NewCommand.Object = state;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::Draw(unsigned first, unsigned count, unsigned instanceCount, EPrimitive primitive) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_DRAW;
+    NewCommand.Draw.First = first;
+    NewCommand.Draw.Count = count;
+    NewCommand.Draw.Instances = instanceCount;
+    NewCommand.Draw.Primitive = primitive;
+    NewCommand.Draw.Offset = 0;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::DrawIndexed(unsigned count, size_t offset, EPrimitive primitive) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_DRAW_INDEXED;
+    NewCommand.Draw.First = 0;
+    NewCommand.Draw.Count = count;
+    NewCommand.Draw.Instances = 1;
+    NewCommand.Draw.Primitive = primitive;
+    NewCommand.Draw.Offset = offset;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::MultiDrawIndexed(const int* counts, const void* const* offsets, const int* baseVertices, unsigned drawCount) {
+    if (!drawCount) {
+        return;
+    }
+
+    // NOTE: Offsets first so the pointer array is aligned, then counts and base vertices
+    Command NewCommand;
+    NewCommand.Type = COMMAND_MULTI_DRAW_INDEXED;
+    NewCommand.Payload.Binding = 0;
+    NewCommand.Payload.Count = drawCount;
+    NewCommand.Payload.BaseVertex = baseVertices != 0;
+    size_t Size = drawCount * (sizeof(const void*) + sizeof(int) + (baseVertices ? sizeof(int) : 0));
+    NewCommand.Payload.Offset = allocatePayload(Size);
+    unsigned char* Target = &mPayload[NewCommand.Payload.Offset];
+    std::memcpy(Target, offsets, drawCount * sizeof(const void*));
+    std::memcpy(Target + drawCount * sizeof(const void*), counts, drawCount * sizeof(int));
+    if (baseVertices) {
+        std::memcpy(Target + drawCount * (sizeof(const void*) + sizeof(int)), baseVertices, drawCount * sizeof(int));
+    }
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::BeginQuery(unsigned query) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BEGIN_QUERY;
+    NewCommand.Object = query;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::EndQuery() {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_END_QUERY;
+    NewCommand.Object = 0;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::BeginConditional(unsigned query) {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_BEGIN_CONDITIONAL;
+    NewCommand.Object = query;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::EndConditional() {
+    Command NewCommand;
+    NewCommand.Type = COMMAND_END_CONDITIONAL;
+    NewCommand.Object = 0;
+    mCommands.push_back(NewCommand);
+}
+
+void
+CommandBuffer::Execute(FrameUniforms& frame) const {
+    for (unsigned CommandIdx = 0; CommandIdx < mCommands.size(); ++CommandIdx) {
+        const Command& Current = mCommands[CommandIdx];
+        switch (Current.Type) {
+        case COMMAND_BIND_PIPELINE:
+            Current.Pipeline.Variants->Use(Current.Pipeline.Key);
+            break;
+        case COMMAND_BIND_TEXTURE:
+            glActiveTexture(GL_TEXTURE0 + Current.Texture.Slot);
+            glBindTexture(TextureTargets[Current.Texture.Target], Current.Texture.Id);
+            break;
+        case COMMAND_BIND_VERTEX_ARRAY:
+            glBindVertexArray(Current.Object);
+            break;
+        case COMMAND_BIND_INDEX_BUFFER:
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Current.Object);
+            break;
+        case COMMAND_SET_CONSTANTS:
+            frame.PushConstants(Current.Payload.Binding, &mPayload[Current.Payload.Offset], Current.Payload.Count);
+            break;
+        case COMMAND_SET_RENDER_STATE:
+            glDepthMask((Current.Object & RENDER_DEPTH_WRITE) ? GL_TRUE : GL_FALSE);
+            glDepthFunc((Current.Object & RENDER_DEPTH_LEQUAL) ? GL_LEQUAL : GL_LESS);
+            if (Current.Object & RENDER_COLOR_WRITE) {
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            } else {
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            }
+            if (Current.Object & RENDER_CULL_FACE) {
+                glEnable(GL_CULL_FACE);
+            } else {
+                glDisable(GL_CULL_FACE);
+            }
+            break;
+        case COMMAND_DRAW:
+            if (Current.Draw.Instances != 1) {
+                glDrawArraysInstanced(PrimitiveModes[Current.Draw.Primitive], Current.Draw.First, Current.Draw.Count, Current.Draw.Instances);
+            } else {
+                glDrawArrays(PrimitiveModes[Current.Draw.Primitive], Current.Draw.First, Current.Draw.Count);
+            }
+            break;
+        case COMMAND_DRAW_INDEXED:
+            glDrawElements(PrimitiveModes[Current.Draw.Primitive], Current.Draw.Count, GL_UNSIGNED_INT, (const void*)Current.Draw.Offset);
+            break;
+        case COMMAND_MULTI_DRAW_INDEXED: {
+            GLsizei DrawCount = (GLsizei)Current.Payload.Count;
+            const unsigned char* Source = &mPayload[Current.Payload.Offset];
+            const void* const* Offsets = (const void* const*)Source;
+            const GLsizei* Counts = (const GLsizei*)(Source + DrawCount * sizeof(const void*));
+            if (Current.Payload.BaseVertex) {
+                const GLint* BaseVertices = (const GLint*)(Source + DrawCount * (sizeof(const void*) + sizeof(int)));
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, Counts, GL_UNSIGNED_INT, Offsets, DrawCount, BaseVertices);
+            } else {
+                glMultiDrawElements(GL_TRIANGLES, Counts, GL_UNSIGNED_INT, Offsets, DrawCount);
+            }
+            break;
+        }
+        case COMMAND_BEGIN_QUERY:
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, Current.Object);
+            break;
+        case COMMAND_END_QUERY:
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            break;
+        case COMMAND_BEGIN_CONDITIONAL:
+            glBeginConditionalRender(Current.Object, GL_QUERY_WAIT);
+            break;
+        case COMMAND_END_CONDITIONAL:
+            glEndConditionalRender();
+            break;
+        }
+    }
+}
@@ -0,0 +1,253 @@
+/**
+ * @file commandbuffer.hpp
+ * @brief Recorded draw commands. Recording only stores object names and
+ * copies of the data, it never touches the GL context, so any thread can
+ * build part of a frame into its own buffer. The GL thread then executes the
+ * buffers in the order the frame needs them
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class FrameUniforms;
+class ShaderVariants;
+
+enum ETextureTarget {
+    TEXTURE_TARGET_2D = 0,
+    TEXTURE_TARGET_2D_ARRAY,
+    TEXTURE_TARGET_CUBE_MAP,
+};
+
+enum EPrimitive {
+    PRIMITIVE_TRIANGLES = 0,
+    PRIMITIVE_TRIANGLE_STRIP,
+    PRIMITIVE_LINES,
+};
+
+enum ERenderState {
+    RENDER_DEPTH_WRITE = 1 << 0,
+    RENDER_COLOR_WRITE = 1 << 1,
+    RENDER_CULL_FACE = 1 << 2,
+    // NOTE: Depth test also passes on equal depth, for the sky at the far plane
+    RENDER_DEPTH_LEQUAL = 1 << 3,
+};
+
+// NOTE: What the scene passes expect, buffers that change it restore this
+#define RENDER_STATE_DEFAULT (RENDER_DEPTH_WRITE | RENDER_COLOR_WRITE | RENDER_CULL_FACE)
+
+/**
+ * @brief One thread records at a time. Storage is kept across Reset, so a
+ * buffer recorded every frame stops allocating once it has grown
+ *
+ */
+class CommandBuffer {
+public:
+    /**
+     * @brief Drops every recorded command
+     *
+     */
+    void Reset();
+
+    /**
+     * @brief Binds a shader variant, compiled on execution if needed
+     *
+     * @param variants - Shader variants, must outlive execution
+     * @param key - Key from MakeShaderKey
+     */
+    void BindPipeline(ShaderVariants& variants, unsigned key);
+
+    /**
+     * @brief Binds a texture to a texture unit
+     *
+     * @param slot - Texture unit
+     * @param target - Texture kind
+     * @param texture - Texture name, 0 to unbind
+     */
+    void BindTexture(unsigned slot, ETextureTarget target, unsigned texture);
+
+    void BindVertexArray(unsigned vertexArray);
+    void BindIndexBuffer(unsigned buffer);
+
+    /**
+     * @brief Copies a uniform block. Executing writes it into the frame ring
+     * buffer and binds it for the following draws
+     *
+     * @param binding - Uniform block binding point
+     * @param data - Block data
+     * @param size - Size in bytes
+     */
+    void SetConstants(unsigned binding, const void* data, unsigned size);
+
+    /**
+     * @brief Sets depth, color and culling state for the following draws
+     *
+     * @param state - ERenderState flags
+     */
+    void SetRenderState(unsigned state);
+
+    /**
+     * @brief Draws from the bound vertex array
+     *
+     * @param first - First vertex
+     * @param count - Vertex count
+     * @param instanceCount - Instances, 1 for a plain draw
+     * @param primitive - Primitive type
+     */
+    void Draw(unsigned first, unsigned count, unsigned instanceCount = 1, EPrimitive primitive = PRIMITIVE_TRIANGLES);
+
+    /**
+     * @brief Draws from the bound index buffer
+     *
+     * @param count - Index count
+     * @param offset - Byte offset of the first index
+     * @param primitive - Primitive type
+     */
+    void DrawIndexed(unsigned count, size_t offset, EPrimitive primitive = PRIMITIVE_TRIANGLES);
+
+    /**
+     * @brief Draws several index ranges at once. The arrays are copied
+     *
+     * @param counts - Index count per draw
+     * @param offsets - Byte offset of the first index per draw
+     * @param baseVertices - Base vertex per draw, 0 for none
+     * @param drawCount - Number of draws
+     */
+    void MultiDrawIndexed(const int* counts, const void* const* offsets, const int* baseVertices, unsigned drawCount);
+
+    /**
+     * @brief Starts an any samples passed query around the following draws
+     *
+     * @param query - Query name
+     */
+    void BeginQuery(unsigned query);
+    void EndQuery();
+
+    /**
+     * @brief Renders the following draws only if a query passed. The GPU
+     * waits for the query, the CPU doesn't
+     *
+     * @param query - Query name, ended earlier in the frame
+     */
+    void BeginConditional(unsigned query);
+    void EndConditional();
+
+    /**
+     * @brief Replays the commands on the GL context. GL thread only
+     *
+     * @param frame - Frame uniforms, receives the constants
+     */
+    void Execute(FrameUniforms& frame) const;
+
+    /**
+     * @brief Hands every command, in order, to an object with the recording
+     * methods above, such as another buffer or a capture
+     *
+     * @param recorder - Receives the commands
+     */
+    template<class Recorder>
+    void RecordInto(Recorder& recorder) const;
+
+    bool IsEmpty() const { return mCommands.empty(); }
+    unsigned GetCommandCount() const { return (unsigned)mCommands.size(); }
+
+private:
+    enum ECommandType {
+        COMMAND_BIND_PIPELINE = 0,
+        COMMAND_BIND_TEXTURE,
+        COMMAND_BIND_VERTEX_ARRAY,
+        COMMAND_BIND_INDEX_BUFFER,
+        COMMAND_SET_CONSTANTS,
+        COMMAND_SET_RENDER_STATE,
+        COMMAND_DRAW,
+        COMMAND_DRAW_INDEXED,
+        COMMAND_MULTI_DRAW_INDEXED,
+        COMMAND_BEGIN_QUERY,
+        COMMAND_END_QUERY,
+        COMMAND_BEGIN_CONDITIONAL,
+        COMMAND_END_CONDITIONAL,
+    };
+
+    struct PipelineArgs {
+        ShaderVariants* Variants;
+        unsigned Key;
+    };
+
+    struct TextureArgs {
+        unsigned Slot;
+        ETextureTarget Target;
+        unsigned Id;
+    };
+
+    // NOTE: Variable sized data lives in mPayload, Offset is in bytes
+    struct PayloadArgs {
+        unsigned Binding;
+        unsigned Count;
+        bool BaseVertex;
+        size_t Offset;
+    };
+
+    struct DrawArgs {
+        unsigned First;
+        unsigned Count;
+        unsigned Instances;
+        EPrimitive Primitive;
+        size_t Offset;
+    };
+
+    struct Command {
+        ECommandType Type;
+        union {
+            PipelineArgs Pipeline;
+            TextureArgs Texture;
+            unsigned Object;
+            PayloadArgs Payload;
+            DrawArgs Draw;
+        };
+    };
+
+    std::vector<Command> mCommands;
+    std::vector<unsigned char> mPayload;
+
+    /**
+     * @brief Reserves payload space aligned for pointer arrays
+     *
+     * @returns Offset of the space
+     */
+    size_t allocatePayload(size_t size);
+};
+
+template<class Recorder>
+void
+CommandBuffer::RecordInto(Recorder& recorder) const {
+    for (unsigned CommandIdx = 0; CommandIdx < mCommands.size(); ++CommandIdx) {
+        const Command& Current = mCommands[CommandIdx];
+        switch (Current.Type) {
+        case COMMAND_BIND_PIPELINE: recorder.BindPipeline(*Current.Pipeline.Variants, Current.Pipeline.Key); break;
+        case COMMAND_BIND_TEXTURE: recorder.BindTexture(Current.Texture.Slot, Current.Texture.Target, Current.Texture.Id); break;
+        case COMMAND_BIND_VERTEX_ARRAY: recorder.BindVertexArray(Current.Object); break;
+        case COMMAND_BIND_INDEX_BUFFER: recorder.BindIndexBuffer(Current.Object); break;
+        case COMMAND_SET_CONSTANTS: recorder.SetConstants(Current.Payload.Binding, &mPayload[Current.Payload.Offset], Current.Payload.Count); break;
+        case COMMAND_SET_RENDER_STATE: recorder.SetRenderState(Current.Object); break;
+        case COMMAND_DRAW: recorder.Draw(Current.Draw.First, Current.Draw.Count, Current.Draw.Instances, Current.Draw.Primitive); break;
+        case COMMAND_DRAW_INDEXED: recorder.DrawIndexed(Current.Draw.Count, Current.Draw.Offset, Current.Draw.Primitive); break;
+        case COMMAND_BEGIN_QUERY: recorder.BeginQuery(Current.Object); break;
+        case COMMAND_END_QUERY: recorder.EndQuery(); break;
+        case COMMAND_BEGIN_CONDITIONAL: recorder.BeginConditional(Current.Object); break;
+        case COMMAND_END_CONDITIONAL: recorder.EndConditional(); break;
+        case COMMAND_MULTI_DRAW_INDEXED: {
+            unsigned DrawCount = Current.Payload.Count;
+            const unsigned char* Source = &mPayload[Current.Payload.Offset];
+            const int* Counts = (const int*)(Source + DrawCount * sizeof(const void*));
+            const int* BaseVertices = Current.Payload.BaseVertex ? Counts + DrawCount : 0;
+            recorder.MultiDrawIndexed(Counts, (const void* const*)Source, BaseVertices, DrawCount);
+            break;
+        }
+        }
+    }
+}
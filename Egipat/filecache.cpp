@@ -0,0 +1,64 @@
+#include "filecache.hpp"
+
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+uint64_t
+FileCache::Hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* Bytes = (const unsigned char*)data;
+    uint64_t Result = seed;
+    for (size_t Idx = 0; Idx < size; ++Idx) {
+        Result ^= Bytes[Idx];
+        Result *= 1099511628211ULL;
+    }
+    return Result;
+}
+
+uint64_t
+FileCache::Hash(const std::string& str, uint64_t seed) {
+    return Hash(str.data(), str.size(), seed);
+}
+
+bool
+FileCache::ReadFile(const std::string& path, std::vector<unsigned char>& out) {
+    std::ifstream In(path, std::ios::binary);
+    if (!In) {
+        return false;
+    }
+
+    In.seekg(0, std::ios::end);
+    std::streamoff Size = In.tellg();
+    In.seekg(0, std::ios::beg);
+    out.resize((size_t)Size);
+    if (Size > 0) {
+        In.read((char*)out.data(), Size);
+    }
+    return (bool)In;
+}
+
+bool
+FileCache::WriteFile(const std::string& path, const void* data, size_t size) {
+#ifdef _WIN32
+    _mkdir(CACHE_DIRECTORY);
+#else
+    mkdir(CACHE_DIRECTORY, 0755);
+#endif
+
+    std::ofstream Out(path, std::ios::binary | std::ios::trunc);
+    if (!Out) {
+        std::cerr << "[Err] Failed to write cache file: " << path << std::endl;
+        return false;
+    }
+    Out.write((const char*)data, size);
+    return (bool)Out;
+}
+
+std::string
+FileCache::GetPath(const std::string& name) {
+    return std::string(CACHE_DIRECTORY) + "/" + name;
+}
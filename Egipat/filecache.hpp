@@ -0,0 +1,64 @@
+/**
+ * @file filecache.hpp
+ * @brief Helpers for on-disk caches of derived data (converted textures,
+ * program binaries, ...). Cached files live under CACHE_DIRECTORY and are
+ * validated by a content hash stored by the caller
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define CACHE_DIRECTORY "cache"
+
+namespace FileCache {
+    /**
+     * @brief FNV-1a 64-bit hash, chainable through the seed
+     *
+     * @param data - Bytes to hash
+     * @param size - Byte count
+     * @param seed - Previous hash value to continue from
+     *
+     * @returns Hash value
+     */
+    uint64_t Hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+    /**
+     * @brief Hashes a string, chainable through the seed
+     *
+     */
+    uint64_t Hash(const std::string& str, uint64_t seed = 14695981039346656037ULL);
+
+    /**
+     * @brief Reads whole file into memory
+     *
+     * @param path - File path
+     * @param out - Destination buffer
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool ReadFile(const std::string& path, std::vector<unsigned char>& out);
+
+    /**
+     * @brief Writes buffer to file, creating the cache directory if needed
+     *
+     * @param path - File path
+     * @param data - Bytes to write
+     * @param size - Byte count
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool WriteFile(const std::string& path, const void* data, size_t size);
+
+    /**
+     * @brief Builds path of a cache entry: CACHE_DIRECTORY/name
+     *
+     */
+    std::string GetPath(const std::string& name);
+}
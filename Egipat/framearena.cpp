@@ -0,0 +1,134 @@
+#include "framearena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+static size_t
+alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameArena::FrameArena(const char* name, size_t capacity)
+    : mName(name),
+      mBase(0),
+      mCapacity(0),
+      mHead(0),
+      mOverflowBytes(0),
+      mOverflowReported(false),
+      mLastFrame(0),
+      mHighWater(0) {
+    Reserve(capacity);
+}
+
+FrameArena::~FrameArena() {
+    Reset();
+    std::free(mBase);
+}
+
+void
+FrameArena::Reserve(size_t capacity) {
+    std::free(mBase);
+    mBase = capacity ? (unsigned char*)std::malloc(capacity) : 0;
+    mCapacity = mBase ? capacity : 0;
+    mHead = 0;
+    if (capacity && !mBase) {
+        std::cerr << "[Err] Failed to reserve " << capacity << " bytes for frame arena " << mName << std::endl;
+    }
+}
+
+void*
+FrameArena::Allocate(size_t size, size_t alignment) {
+    // NOTE: Aligned on the address, malloc only guarantees max_align_t
+    uintptr_t Base = (uintptr_t)mBase;
+    size_t Head = mHead.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t Start = alignUp(Base + Head, alignment) - Base;
+        size_t End = Start + size;
+        if (End > mCapacity) {
+            break;
+        }
+        if (mHead.compare_exchange_weak(Head, End, std::memory_order_relaxed)) {
+            return mBase + Start;
+        }
+    }
+
+    void* Block = std::malloc(size + alignment);
+    if (!Block) {
+        std::cerr << "[Err] Frame arena " << mName << " failed to allocate " << size << " bytes" << std::endl;
+        return 0;
+    }
+    mOverflowBytes += size;
+    {
+        std::lock_guard<std::mutex> Lock(mOverflowLock);
+        mOverflow.push_back(Block);
+    }
+    return (void*)alignUp((uintptr_t)Block, alignment);
+}
+
+size_t
+FrameArena::GetUsed() const {
+    return std::min(mHead.load(), mCapacity) + mOverflowBytes.load();
+}
+
+void
+FrameArena::Reset() {
+    mLastFrame = GetUsed();
+    mHighWater = std::max(mHighWater, mLastFrame);
+    if (!mOverflow.empty() && !mOverflowReported && mCapacity) {
+        std::cerr << "[Err] Frame arena " << mName << " needed " << mLastFrame << " of its " << mCapacity
+                  << " bytes, the rest came from the heap" << std::endl;
+        mOverflowReported = true;
+    }
+
+    for (unsigned BlockIdx = 0; BlockIdx < mOverflow.size(); ++BlockIdx) {
+        std::free(mOverflow[BlockIdx]);
+    }
+    mOverflow.clear();
+    mOverflowBytes = 0;
+    mHead = 0;
+}
+
+static FrameArena SingleFrame("frame");
+static FrameArena BufferedEven("buffered even");
+static FrameArena BufferedOdd("buffered odd");
+static unsigned long long FrameIndex = 0;
+
+void
+FrameMemory::Init(size_t frameBytes, size_t bufferedBytes) {
+    SingleFrame.Reset();
+    BufferedEven.Reset();
+    BufferedOdd.Reset();
+    SingleFrame.Reserve(frameBytes);
+    BufferedEven.Reserve(bufferedBytes);
+    BufferedOdd.Reserve(bufferedBytes);
+}
+
+FrameArena&
+FrameMemory::GetFrame() {
+    return SingleFrame;
+}
+
+FrameArena&
+FrameMemory::GetBuffered() {
+    return FrameIndex % 2 ? BufferedOdd : BufferedEven;
+}
+
+void
+FrameMemory::EndFrame() {
+    SingleFrame.Reset();
+    ++FrameIndex;
+    // NOTE: Last written the frame before the one that just ended
+    GetBuffered().Reset();
+}
+
+void
+FrameMemory::PrintStats() {
+    FrameArena* Arenas[] = { &SingleFrame, &BufferedEven, &BufferedOdd };
+    for (unsigned ArenaIdx = 0; ArenaIdx < sizeof(Arenas) / sizeof(Arenas[0]); ++ArenaIdx) {
+        const FrameArena& Arena = *Arenas[ArenaIdx];
+        std::cout << "Frame arena " << Arena.GetName() << ": " << Arena.GetLastFrameBytes() / 1024 << " KB last frame, "
+                  << Arena.GetHighWater() / 1024 << " KB high water of " << Arena.GetCapacity() / 1024 << " KB" << std::endl;
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file framearena.hpp
+ * @brief Linear allocators for transient per-frame data. Allocating bumps a
+ * pointer, nothing is freed individually and the whole arena is reset at the
+ * end of the frame. A second, double-buffered pair keeps data alive through
+ * the following frame for consumers that read it late
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#define FRAME_ARENA_ALIGNMENT 16
+#define FRAME_ARENA_BYTES (1024 * 1024)
+#define FRAME_BUFFERED_BYTES (256 * 1024)
+
+class FrameArena {
+public:
+    /**
+     * @brief Ctor
+     *
+     * @param name - Shown in stats and overflow reports
+     * @param capacity - Bytes available per frame before falling back to the heap
+     */
+    FrameArena(const char* name, size_t capacity = 0);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief Replaces the backing memory. Only call while nothing is allocated
+     *
+     */
+    void Reserve(size_t capacity);
+
+    /**
+     * @brief Bumps the arena, safe to call from jobs. Falls back to the heap
+     * when the arena is full, those blocks are also released by Reset
+     *
+     * @param size - Bytes
+     * @param alignment - Power of two
+     *
+     * @returns Memory valid until the next Reset
+     */
+    void* Allocate(size_t size, size_t alignment = FRAME_ARENA_ALIGNMENT);
+
+    /**
+     * @brief Uninitialised storage for count objects of type T
+     *
+     */
+    template <typename T>
+    T* AllocateArray(size_t count) { return (T*)Allocate(sizeof(T) * count, alignof(T)); }
+
+    /**
+     * @brief Releases everything allocated since the last Reset and records
+     * the frame's usage. No job may still be using the arena
+     *
+     */
+    void Reset();
+
+    const char* GetName() const { return mName; }
+    size_t GetCapacity() const { return mCapacity; }
+
+    /**
+     * @brief Bytes allocated since the last Reset, heap fallbacks included
+     *
+     */
+    size_t GetUsed() const;
+
+    /**
+     * @brief Bytes used by the frame before the last Reset
+     *
+     */
+    size_t GetLastFrameBytes() const { return mLastFrame; }
+
+    /**
+     * @brief Most bytes any single frame used. Above the capacity means some
+     * frames fell back to the heap
+     *
+     */
+    size_t GetHighWater() const { return mHighWater; }
+
+private:
+    const char* mName;
+    unsigned char* mBase;
+    size_t mCapacity;
+    std::atomic<size_t> mHead;
+
+    std::mutex mOverflowLock;
+    std::vector<void*> mOverflow;
+    std::atomic<size_t> mOverflowBytes;
+    bool mOverflowReported;
+
+    size_t mLastFrame;
+    size_t mHighWater;
+};
+
+/**
+ * @brief STL allocator drawing from a FrameArena. Deallocation is a no-op, so
+ * containers using it must not outlive the arena's next Reset
+ *
+ */
+template <typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+
+    FrameAllocator(FrameArena& arena) : mArena(&arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : mArena(other.GetArena()) {}
+
+    T* allocate(size_t count) { return mArena->AllocateArray<T>(count); }
+    // NOTE: Memory goes back all at once on FrameArena::Reset
+    void deallocate(T*, size_t) {}
+
+    FrameArena* GetArena() const { return mArena; }
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return mArena == other.GetArena(); }
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return mArena != other.GetArena(); }
+
+private:
+    FrameArena* mArena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+namespace FrameMemory {
+    /**
+     * @brief Sizes the arenas. Before Init they work, but every allocation
+     * falls back to the heap
+     *
+     * @param frameBytes - Capacity of the single frame arena
+     * @param bufferedBytes - Capacity of each of the double-buffered arenas
+     */
+    void Init(size_t frameBytes = FRAME_ARENA_BYTES, size_t bufferedBytes = FRAME_BUFFERED_BYTES);
+
+    /**
+     * @brief Arena for data that dies with the current frame
+     *
+     */
+    FrameArena& GetFrame();
+
+    /**
+     * @brief Arena for data that is still read during the next frame
+     *
+     */
+    FrameArena& GetBuffered();
+
+    /**
+     * @brief Resets the frame arena and the buffered arena written two
+     * frames ago, which becomes the current buffered arena. Call once all
+     * jobs of the frame are done
+     *
+     */
+    void EndFrame();
+
+    /**
+     * @brief Prints last frame usage and high-water marks of every arena
+     *
+     */
+    void PrintStats();
+}
@@ -0,0 +1,111 @@
+#include "frameuniforms.hpp"
+#include "gpumemory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// NOTE: A light stops mattering once its strongest term falls under one
+// 8 bit colour step
+static const float LightCutoff = 1.0f / 256.0f;
+
+FrameUniforms::FrameUniforms()
+    : PointLightCount(0),
+      mRing(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BYTES, "FrameUniforms") {
+    // NOTE: glm types don't initialise themselves
+    std::memset((void*)&Camera, 0, sizeof(Camera));
+    std::memset((void*)&Lights, 0, sizeof(Lights));
+    std::memset(mFallbackBuffers, 0, sizeof(mFallbackBuffers));
+}
+
+FrameUniforms::~FrameUniforms() {
+    for (unsigned Binding = 0; Binding < FRAME_FALLBACK_BINDINGS; ++Binding) {
+        GpuMemory::DeleteBuffer(mFallbackBuffers[Binding]);
+    }
+}
+
+void
+FrameUniforms::writeAndBind(unsigned binding, const void* data, size_t size) {
+    // NOTE: The ring reports the overflow itself, once
+    if (mRing.WriteAndBind(binding, data, size)) {
+        return;
+    }
+    if (binding >= FRAME_FALLBACK_BINDINGS) {
+        std::cerr << "[Err] No fallback uniform buffer for binding " << binding << ", block dropped" << std::endl;
+        return;
+    }
+
+    GLuint& Buffer = mFallbackBuffers[binding];
+    if (!Buffer) {
+        Buffer = GpuMemory::CreateBuffer(GPU_UNIFORM_BUFFER, "FrameUniforms");
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+    GpuMemory::BufferData(Buffer, GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, Buffer);
+}
+
+void
+FrameUniforms::Upload() {
+    mRing.BeginFrame();
+    writeAndBind(CAMERA_BLOCK_BINDING, &Camera, sizeof(CameraUniforms));
+    writeAndBind(LIGHTS_BLOCK_BINDING, &Lights, sizeof(LightUniforms));
+}
+
+void
+FrameUniforms::PushObject(const glm::mat4& world, const glm::mat3& normal, const int* pointLightIndices) {
+    ObjectUniforms Object = MakeObject(world, normal, pointLightIndices);
+    writeAndBind(OBJECT_BLOCK_BINDING, &Object, sizeof(ObjectUniforms));
+}
+
+ObjectUniforms
+FrameUniforms::MakeObject(const glm::mat4& world, const glm::mat3& normal, const int* pointLightIndices) {
+    ObjectUniforms Object;
+    Object.Model = world;
+    for (unsigned Column = 0; Column < 3; ++Column) {
+        Object.Normal[Column] = glm::vec4(normal[Column], 0.0f);
+    }
+    Object.PointLightIndices = glm::ivec4(pointLightIndices[0], pointLightIndices[1], pointLightIndices[2], pointLightIndices[3]);
+    return Object;
+}
+
+void
+FrameUniforms::PushConstants(unsigned binding, const void* data, size_t size) {
+    writeAndBind(binding, data, size);
+}
+
+void
+FrameUniforms::EndFrame() {
+    mRing.EndFrame();
+}
+
+unsigned
+FrameUniforms::SelectPointLights(const glm::vec3& center, float radius, int* indices) const {
+    unsigned Count = 0;
+    for (unsigned LightIdx = 0; LightIdx < PointLightCount && LightIdx < MAX_POINT_LIGHTS; ++LightIdx) {
+        const PointLightUniforms& Light = Lights.PointLights[LightIdx];
+        float Strength = std::max(std::max(Light.Ka.x, std::max(Light.Ka.y, Light.Ka.z)),
+                                  std::max(std::max(Light.Kd.x, std::max(Light.Kd.y, Light.Kd.z)),
+                                           std::max(Light.Ks.x, std::max(Light.Ks.y, Light.Ks.z))));
+
+        // NOTE: Solve Kc + Kl * d + Kq * d^2 = Strength / Cutoff for the range
+        float Kc = Light.Attenuation.x;
+        float Kl = Light.Attenuation.y;
+        float Kq = Light.Attenuation.z;
+        float Target = Strength / LightCutoff;
+        float Range;
+        if (Kq > 0.0f) {
+            Range = (-Kl + std::sqrt(std::max(Kl * Kl - 4.0f * Kq * (Kc - Target), 0.0f))) / (2.0f * Kq);
+        } else if (Kl > 0.0f) {
+            Range = (Target - Kc) / Kl;
+        } else {
+            Range = 1e30f;
+        }
+
+        if (glm::length(glm::vec3(Light.Position) - center) <= Range + radius) {
+            indices[Count++] = (int)LightIdx;
+        }
+    }
+    return Count;
+}
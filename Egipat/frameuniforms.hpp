@@ -0,0 +1,149 @@
+/**
+ * @file frameuniforms.hpp
+ * @brief Per-frame camera and light data shared by every scene shader variant
+ * through std140 uniform buffers, so switching programs between draws doesn't
+ * require re-uploading lights. Per-draw transforms go through the same ring
+ * buffer and are bound as ranges
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ringbuffer.hpp"
+
+#define MAX_POINT_LIGHTS 4
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHTS_BLOCK_BINDING 1
+#define OBJECT_BLOCK_BINDING 2
+// NOTE: Camera, lights and a few hundred draws with room to spare
+#define FRAME_UNIFORM_BYTES (64u * 1024u)
+// NOTE: Binding points that get a plain buffer once the ring region is full
+#define FRAME_FALLBACK_BINDINGS (OBJECT_BLOCK_BINDING + 1)
+
+// NOTE: Layouts mirror the std140 blocks in shader.vert and shader.frag.
+// Everything is a vec4 so no padding rules come into play
+
+struct CameraUniforms {
+    glm::mat4 Projection;
+    glm::mat4 View;
+    glm::vec4 ViewPosition;
+};
+
+struct PointLightUniforms {
+    glm::vec4 Position;
+    glm::vec4 Ka;
+    glm::vec4 Kd;
+    glm::vec4 Ks;
+    // NOTE: Constant, linear and quadratic terms
+    glm::vec4 Attenuation;
+};
+
+struct DirectionalLightUniforms {
+    glm::vec4 Position;
+    glm::vec4 Direction;
+    glm::vec4 Ka;
+    glm::vec4 Kd;
+    glm::vec4 Ks;
+    // NOTE: Constant, linear and quadratic terms
+    glm::vec4 Attenuation;
+    // NOTE: Inner and outer cutoff cosines
+    glm::vec4 CutOff;
+};
+
+struct ObjectUniforms {
+    glm::mat4 Model;
+    // NOTE: std140 mat3 columns are padded to vec4
+    glm::vec4 Normal[3];
+    glm::ivec4 PointLightIndices;
+};
+
+struct LightUniforms {
+    DirectionalLightUniforms DirLight;
+    DirectionalLightUniforms Spotlight;
+    PointLightUniforms PointLights[MAX_POINT_LIGHTS];
+};
+
+class FrameUniforms {
+public:
+    FrameUniforms();
+    ~FrameUniforms();
+
+    /**
+     * @brief Starts a new ring buffer frame, writes Camera and Lights into it
+     * and binds both ranges to their binding points
+     *
+     */
+    void Upload();
+
+    /**
+     * @brief Writes the per-draw block and binds it for the following draws
+     *
+     * @param world - World matrix
+     * @param normal - Normal matrix
+     * @param pointLightIndices - MAX_POINT_LIGHTS light indices, see SelectPointLights
+     */
+    void PushObject(const glm::mat4& world, const glm::mat3& normal, const int* pointLightIndices);
+
+    /**
+     * @brief Builds the per-draw block PushObject writes, for recording into
+     * a command buffer
+     *
+     * @param world - World matrix
+     * @param normal - Normal matrix
+     * @param pointLightIndices - MAX_POINT_LIGHTS light indices, see SelectPointLights
+     *
+     * @returns Per-draw block
+     */
+    static ObjectUniforms MakeObject(const glm::mat4& world, const glm::mat3& normal, const int* pointLightIndices);
+
+    /**
+     * @brief Writes a block into this frame's region and binds it
+     *
+     * @param binding - Uniform block binding point
+     * @param data - Block data
+     * @param size - Size in bytes
+     */
+    void PushConstants(unsigned binding, const void* data, size_t size);
+
+    /**
+     * @brief Fences this frame's data. Call after the last draw of the frame
+     *
+     */
+    void EndFrame();
+
+    /**
+     * @brief Finds the point lights whose range reaches a bounding sphere
+     *
+     * @param center - Sphere center
+     * @param radius - Sphere radius
+     * @param indices - Receives up to MAX_POINT_LIGHTS light indices
+     *
+     * @returns Number of lights written to indices
+     */
+    unsigned SelectPointLights(const glm::vec3& center, float radius, int* indices) const;
+
+    CameraUniforms Camera;
+    LightUniforms Lights;
+    unsigned PointLightCount;
+
+private:
+    RingBuffer mRing;
+    // NOTE: Created on the first overflow, re-specified on every write so
+    // the driver renames them instead of stalling on draws still using them
+    unsigned mFallbackBuffers[FRAME_FALLBACK_BINDINGS];
+
+    /**
+     * @brief Writes into the ring, or into the binding's fallback buffer
+     * when this frame's region is full, and binds the result
+     *
+     * @param binding - Uniform block binding point
+     * @param data - Block data
+     * @param size - Size in bytes
+     */
+    void writeAndBind(unsigned binding, const void* data, size_t size);
+};
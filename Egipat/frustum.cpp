@@ -0,0 +1,52 @@
+#include "frustum.hpp"
+
+Frustum::Frustum() {
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        mPlanes[PlaneIdx] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    glm::vec4 Row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 Row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 Row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 Row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    mPlanes[0] = Row3 + Row0;
+    mPlanes[1] = Row3 - Row0;
+    mPlanes[2] = Row3 + Row1;
+    mPlanes[3] = Row3 - Row1;
+    mPlanes[4] = Row3 + Row2;
+    mPlanes[5] = Row3 - Row2;
+
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        float Length = glm::length(glm::vec3(mPlanes[PlaneIdx]));
+        mPlanes[PlaneIdx] = mPlanes[PlaneIdx] * (1.0f / Length);
+    }
+}
+
+bool
+Frustum::IntersectsBox(const glm::vec3& min, const glm::vec3& max) const {
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        const glm::vec4& Plane = mPlanes[PlaneIdx];
+        // NOTE: Corner furthest along the plane normal
+        glm::vec3 Positive(Plane.x > 0.0f ? max.x : min.x,
+                           Plane.y > 0.0f ? max.y : min.y,
+                           Plane.z > 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(Plane), Positive) + Plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Frustum::IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        const glm::vec4& Plane = mPlanes[PlaneIdx];
+        if (glm::dot(glm::vec3(Plane), center) + Plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file frustum.hpp
+ * @brief View frustum planes for bounding volume culling
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+
+class Frustum {
+public:
+    Frustum();
+
+    /**
+     * @brief Ctor - extracts the six planes from a combined matrix
+     *
+     * @param viewProjection - Projection * View
+     */
+    Frustum(const glm::mat4& viewProjection);
+
+    /**
+     * @brief Tests axis aligned box against the frustum
+     *
+     * @param min - Box minimum corner
+     * @param max - Box maximum corner
+     *
+     * @returns false if the box is fully outside, true otherwise
+     */
+    bool IntersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+
+    /**
+     * @brief Tests sphere against the frustum
+     *
+     * @param center - Sphere center
+     * @param radius - Sphere radius
+     *
+     * @returns false if the sphere is fully outside, true otherwise
+     */
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+
+    /**
+     * @brief Planes as (normal, distance), normals point inside
+     *
+     */
+    glm::vec4 mPlanes[6];
+};
@@ -0,0 +1,174 @@
+#include "gpumemory.hpp"
+
+#include <iostream>
+#include <map>
+
+struct GpuAllocation {
+    EGpuCategory Category;
+    std::string Owner;
+    size_t Bytes;
+};
+
+// NOTE: Buffers, textures and vertex arrays have separate name spaces
+static std::map<unsigned, GpuAllocation> Buffers;
+static std::map<unsigned, GpuAllocation> Textures;
+static std::map<unsigned, GpuAllocation> VertexArrays;
+
+static size_t LiveBytes[GPU_CATEGORY_COUNT];
+static size_t PeakBytes[GPU_CATEGORY_COUNT];
+static unsigned LiveObjects[GPU_CATEGORY_COUNT];
+
+static void
+track(std::map<unsigned, GpuAllocation>& objects, unsigned name, EGpuCategory category, const std::string& owner) {
+    GpuAllocation Allocation = { category, owner, 0 };
+    objects[name] = Allocation;
+    ++LiveObjects[category];
+}
+
+static void
+resize(std::map<unsigned, GpuAllocation>& objects, unsigned name, size_t bytes) {
+    std::map<unsigned, GpuAllocation>::iterator Found = objects.find(name);
+    if (Found == objects.end()) {
+        return;
+    }
+    EGpuCategory Category = Found->second.Category;
+    LiveBytes[Category] = LiveBytes[Category] - Found->second.Bytes + bytes;
+    PeakBytes[Category] = std::max(PeakBytes[Category], LiveBytes[Category]);
+    Found->second.Bytes = bytes;
+}
+
+static void
+untrack(std::map<unsigned, GpuAllocation>& objects, unsigned name) {
+    std::map<unsigned, GpuAllocation>::iterator Found = objects.find(name);
+    if (Found == objects.end()) {
+        return;
+    }
+    LiveBytes[Found->second.Category] -= Found->second.Bytes;
+    --LiveObjects[Found->second.Category];
+    objects.erase(Found);
+}
+
+unsigned
+GpuMemory::CreateBuffer(EGpuCategory category, const std::string& owner) {
+    unsigned Buffer = 0;
+    glGenBuffers(1, &Buffer);
+    track(Buffers, Buffer, category, owner);
+    return Buffer;
+}
+
+void
+GpuMemory::BufferData(unsigned buffer, GLenum target, size_t size, const void* data, GLenum usage) {
+    glBufferData(target, size, data, usage);
+    resize(Buffers, buffer, size);
+}
+
+void
+GpuMemory::SetBufferBytes(unsigned buffer, size_t bytes) {
+    resize(Buffers, buffer, bytes);
+}
+
+void
+GpuMemory::DeleteBuffer(unsigned& buffer) {
+    if (!buffer) {
+        return;
+    }
+    glDeleteBuffers(1, &buffer);
+    untrack(Buffers, buffer);
+    buffer = 0;
+}
+
+unsigned
+GpuMemory::CreateTexture(const std::string& owner) {
+    unsigned Texture = 0;
+    glGenTextures(1, &Texture);
+    track(Textures, Texture, GPU_TEXTURE, owner);
+    return Texture;
+}
+
+void
+GpuMemory::SetTextureBytes(unsigned texture, size_t bytes) {
+    resize(Textures, texture, bytes);
+}
+
+void
+GpuMemory::DeleteTexture(unsigned& texture) {
+    if (!texture) {
+        return;
+    }
+    glDeleteTextures(1, &texture);
+    untrack(Textures, texture);
+    texture = 0;
+}
+
+unsigned
+GpuMemory::CreateVertexArray(const std::string& owner) {
+    unsigned VertexArray = 0;
+    glGenVertexArrays(1, &VertexArray);
+    track(VertexArrays, VertexArray, GPU_VERTEX_ARRAY, owner);
+    return VertexArray;
+}
+
+void
+GpuMemory::DeleteVertexArray(unsigned& vertexArray) {
+    if (!vertexArray) {
+        return;
+    }
+    glDeleteVertexArrays(1, &vertexArray);
+    untrack(VertexArrays, vertexArray);
+    vertexArray = 0;
+}
+
+size_t
+GpuMemory::GetLiveBytes(EGpuCategory category) {
+    return LiveBytes[category];
+}
+
+size_t
+GpuMemory::GetPeakBytes(EGpuCategory category) {
+    return PeakBytes[category];
+}
+
+unsigned
+GpuMemory::GetLiveObjects(EGpuCategory category) {
+    return LiveObjects[category];
+}
+
+const char*
+GpuMemory::GetCategoryName(EGpuCategory category) {
+    switch (category) {
+    case GPU_VERTEX_BUFFER: return "vertex buffers";
+    case GPU_INDEX_BUFFER: return "index buffers";
+    case GPU_UNIFORM_BUFFER: return "uniform buffers";
+    case GPU_STAGING_BUFFER: return "staging buffers";
+    case GPU_TEXTURE: return "textures";
+    case GPU_VERTEX_ARRAY: return "vertex arrays";
+    default: return "unknown";
+    }
+}
+
+void
+GpuMemory::PrintStats() {
+    for (unsigned Category = 0; Category < GPU_CATEGORY_COUNT; ++Category) {
+        EGpuCategory Current = (EGpuCategory)Category;
+        std::cout << GetCategoryName(Current) << ": " << LiveObjects[Category] << " objects, "
+                  << LiveBytes[Category] / 1024 << " KiB live, " << PeakBytes[Category] / 1024 << " KiB peak" << std::endl;
+    }
+}
+
+static unsigned
+reportLeaks(const std::map<unsigned, GpuAllocation>& objects, const char* kind) {
+    for (std::map<unsigned, GpuAllocation>::const_iterator It = objects.begin(); It != objects.end(); ++It) {
+        std::cerr << "[Err] Leaked " << kind << " " << It->first << " (" << GpuMemory::GetCategoryName(It->second.Category)
+                  << ", " << It->second.Bytes << " bytes) owned by " << It->second.Owner << std::endl;
+    }
+    return (unsigned)objects.size();
+}
+
+unsigned
+GpuMemory::ReportLeaks() {
+    unsigned Leaked = reportLeaks(Buffers, "buffer") + reportLeaks(Textures, "texture") + reportLeaks(VertexArrays, "vertex array");
+    if (!Leaked) {
+        std::cout << "No GL objects leaked" << std::endl;
+    }
+    return Leaked;
+}
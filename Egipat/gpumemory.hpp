@@ -0,0 +1,148 @@
+/**
+ * @file gpumemory.hpp
+ * @brief Accounting for GL buffers, textures and vertex arrays. Every object
+ * is tagged with a category and the asset that owns it, so live and peak
+ * memory per category can be queried and objects that were never deleted
+ * are listed at shutdown
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+enum EGpuCategory {
+    GPU_VERTEX_BUFFER = 0,
+    GPU_INDEX_BUFFER,
+    GPU_UNIFORM_BUFFER,
+    // NOTE: Pixel pack/unpack and other transfer buffers
+    GPU_STAGING_BUFFER,
+    GPU_TEXTURE,
+    // NOTE: Vertex arrays hold no memory, they're tracked for leaks only
+    GPU_VERTEX_ARRAY,
+    GPU_CATEGORY_COUNT,
+};
+
+namespace GpuMemory {
+    /**
+     * @brief Generates a buffer
+     *
+     * @param category - Accounting category
+     * @param owner - Owning asset, shown in reports
+     *
+     * @returns Buffer name
+     */
+    unsigned CreateBuffer(EGpuCategory category, const std::string& owner);
+
+    /**
+     * @brief glBufferData on the buffer bound to target, recording its size
+     *
+     * @param buffer - Buffer name, must be bound to target
+     * @param target - Binding target
+     * @param size - Size in bytes
+     * @param data - Initial contents, may be 0
+     * @param usage - Usage hint
+     */
+    void BufferData(unsigned buffer, GLenum target, size_t size, const void* data, GLenum usage);
+
+    /**
+     * @brief Records the size of immutable or externally allocated buffer storage
+     *
+     */
+    void SetBufferBytes(unsigned buffer, size_t bytes);
+
+    /**
+     * @brief Deletes a buffer and zeroes the name, 0 is ignored
+     *
+     */
+    void DeleteBuffer(unsigned& buffer);
+
+    /**
+     * @brief Generates a texture
+     *
+     * @param owner - Owning asset, shown in reports
+     *
+     * @returns Texture name
+     */
+    unsigned CreateTexture(const std::string& owner);
+
+    /**
+     * @brief Records the bytes currently held by a texture's levels. Called
+     * again whenever levels are added or dropped
+     *
+     */
+    void SetTextureBytes(unsigned texture, size_t bytes);
+
+    /**
+     * @brief Deletes a texture and zeroes the name, 0 is ignored
+     *
+     */
+    void DeleteTexture(unsigned& texture);
+
+    unsigned CreateVertexArray(const std::string& owner);
+    void DeleteVertexArray(unsigned& vertexArray);
+
+    size_t GetLiveBytes(EGpuCategory category);
+    size_t GetPeakBytes(EGpuCategory category);
+    unsigned GetLiveObjects(EGpuCategory category);
+    const char* GetCategoryName(EGpuCategory category);
+
+    /**
+     * @brief Prints live and peak totals of every category
+     *
+     */
+    void PrintStats();
+
+    /**
+     * @brief Lists every object that is still alive. Call after everything
+     * owning GL objects is destroyed
+     *
+     * @returns Number of leaked objects
+     */
+    unsigned ReportLeaks();
+
+    /**
+     * @brief Estimated bytes of a texture with a full mip chain
+     *
+     */
+    inline size_t
+    MipChainBytes(int width, int height, size_t texelBytes) {
+        size_t Bytes = 0;
+        for (;;) {
+            Bytes += (size_t)width * height * texelBytes;
+            if (width == 1 && height == 1) {
+                return Bytes;
+            }
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+    }
+}
+
+/**
+ * @brief GL object name that only one owner holds. Moving leaves 0 behind, so
+ * classes holding these can be moved into containers without double deletes
+ *
+ */
+class GpuHandle {
+public:
+    GpuHandle() : mName(0) {}
+    GpuHandle(GpuHandle&& other) : mName(other.mName) { other.mName = 0; }
+    GpuHandle& operator=(GpuHandle&& other) { std::swap(mName, other.mName); return *this; }
+    GpuHandle& operator=(unsigned name) { mName = name; return *this; }
+    GpuHandle(const GpuHandle&) = delete;
+    GpuHandle& operator=(const GpuHandle&) = delete;
+
+    operator unsigned() const { return mName; }
+    unsigned& Get() { return mName; }
+
+private:
+    unsigned mName;
+};
@@ -0,0 +1,280 @@
+#include "jobsystem.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+typedef std::chrono::steady_clock JobClock;
+
+struct Worker {
+    std::mutex Lock;
+    // NOTE: Owner pushes and pops at the back, thieves take from the front
+    std::deque<Job> Queue;
+    std::thread Thread;
+    std::atomic<unsigned long long> BusyNanoseconds;
+    std::atomic<unsigned> JobsRun;
+    std::atomic<unsigned> JobsStolen;
+};
+
+static std::vector<std::unique_ptr<Worker> > Workers;
+static std::atomic<int> Queued(0);
+static std::atomic<unsigned> NextWorker(0);
+static std::mutex SleepLock;
+static std::condition_variable SleepCondition;
+static bool Stopping = false;
+static JobClock::time_point StatsStart = JobClock::now();
+
+// NOTE: Index of the worker running on this thread, -1 for other threads
+static thread_local int CurrentWorker = -1;
+
+static void finish(JobCounter* counter);
+
+static void
+push(const Job& job) {
+    if (Workers.empty()) {
+        job.Work();
+        finish(job.Counter);
+        return;
+    }
+
+    // NOTE: Workers keep their own jobs local, other threads spread them out
+    unsigned Target = CurrentWorker >= 0 ? (unsigned)CurrentWorker : NextWorker++ % Workers.size();
+    {
+        std::lock_guard<std::mutex> Lock(Workers[Target]->Lock);
+        Workers[Target]->Queue.push_back(job);
+    }
+    ++Queued;
+    // NOTE: Taking the lock orders the push against a worker about to sleep
+    {
+        std::lock_guard<std::mutex> Lock(SleepLock);
+    }
+    SleepCondition.notify_one();
+}
+
+static void
+finish(JobCounter* counter) {
+    if (!counter) {
+        return;
+    }
+
+    std::vector<Job> Ready;
+    {
+        std::lock_guard<std::mutex> Lock(counter->Lock);
+        if (--counter->Pending == 0) {
+            Ready.swap(counter->Continuations);
+        }
+    }
+    for (unsigned JobIdx = 0; JobIdx < Ready.size(); ++JobIdx) {
+        push(Ready[JobIdx]);
+    }
+}
+
+static bool
+pop(int self, Job& job) {
+    unsigned Count = (unsigned)Workers.size();
+    if (self >= 0) {
+        Worker& Own = *Workers[self];
+        std::lock_guard<std::mutex> Lock(Own.Lock);
+        if (!Own.Queue.empty()) {
+            job = Own.Queue.back();
+            Own.Queue.pop_back();
+            --Queued;
+            return true;
+        }
+    }
+
+    unsigned Start = self >= 0 ? (unsigned)self + 1 : NextWorker.load();
+    for (unsigned Offset = 0; Offset < Count; ++Offset) {
+        unsigned Victim = (Start + Offset) % Count;
+        if ((int)Victim == self) {
+            continue;
+        }
+        Worker& Other = *Workers[Victim];
+        std::lock_guard<std::mutex> Lock(Other.Lock);
+        if (!Other.Queue.empty()) {
+            job = Other.Queue.front();
+            Other.Queue.pop_front();
+            --Queued;
+            if (self >= 0) {
+                ++Workers[self]->JobsStolen;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+execute(int self, const Job& job) {
+    if (self < 0) {
+        job.Work();
+        finish(job.Counter);
+        return;
+    }
+
+    TRACE_ZONE("Job");
+    JobClock::time_point Start = JobClock::now();
+    job.Work();
+    finish(job.Counter);
+    Worker& Self = *Workers[self];
+    Self.BusyNanoseconds += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(JobClock::now() - Start).count();
+    ++Self.JobsRun;
+}
+
+static void
+workerLoop(int self) {
+    CurrentWorker = self;
+    Trace::SetThreadName("Worker " + std::to_string(self));
+    for (;;) {
+        Job Current;
+        if (pop(self, Current)) {
+            execute(self, Current);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(SleepLock);
+        SleepCondition.wait(Lock, []() { return Stopping || Queued > 0; });
+        if (Stopping && Queued <= 0) {
+            return;
+        }
+    }
+}
+
+void
+Jobs::Init(unsigned workerCount) {
+    if (!Workers.empty()) {
+        return;
+    }
+    if (!workerCount) {
+        unsigned Hardware = std::thread::hardware_concurrency();
+        workerCount = Hardware > 1 ? Hardware - 1 : 1;
+    }
+
+    Stopping = false;
+    Workers.resize(workerCount);
+    for (unsigned WorkerIdx = 0; WorkerIdx < workerCount; ++WorkerIdx) {
+        Workers[WorkerIdx].reset(new Worker());
+        Workers[WorkerIdx]->BusyNanoseconds = 0;
+        Workers[WorkerIdx]->JobsRun = 0;
+        Workers[WorkerIdx]->JobsStolen = 0;
+    }
+    ResetStats();
+    // NOTE: Started only once every deque exists since workers steal from all of them
+    for (unsigned WorkerIdx = 0; WorkerIdx < workerCount; ++WorkerIdx) {
+        Workers[WorkerIdx]->Thread = std::thread(workerLoop, (int)WorkerIdx);
+    }
+    std::cout << "Job system started " << workerCount << " workers" << std::endl;
+}
+
+void
+Jobs::Shutdown() {
+    if (Workers.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> Lock(SleepLock);
+        Stopping = true;
+    }
+    SleepCondition.notify_all();
+    for (unsigned WorkerIdx = 0; WorkerIdx < Workers.size(); ++WorkerIdx) {
+        Workers[WorkerIdx]->Thread.join();
+    }
+    Workers.clear();
+}
+
+void
+Jobs::Run(const std::function<void()>& work, JobCounter* counter, JobCounter* dependency) {
+    Job NewJob = { work, counter };
+    if (counter) {
+        ++counter->Pending;
+    }
+    if (dependency) {
+        std::lock_guard<std::mutex> Lock(dependency->Lock);
+        if (dependency->Pending > 0) {
+            dependency->Continuations.push_back(NewJob);
+            return;
+        }
+    }
+    push(NewJob);
+}
+
+void
+Jobs::Wait(JobCounter& counter) {
+    while (counter.Pending > 0) {
+        Job Current;
+        if (!Workers.empty() && pop(CurrentWorker, Current)) {
+            execute(CurrentWorker, Current);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    // NOTE: The last job may still be inside finish, don't let the caller
+    // destroy the counter before it lets go of the lock
+    std::lock_guard<std::mutex> Lock(counter.Lock);
+}
+
+void
+Jobs::ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& body, JobCounter* counter) {
+    if (!count) {
+        return;
+    }
+    grain = grain ? grain : 1;
+
+    JobCounter Local;
+    JobCounter* Target = counter ? counter : &Local;
+    for (unsigned Begin = 0; Begin < count; Begin += grain) {
+        unsigned End = std::min(Begin + grain, count);
+        Run([body, Begin, End]() { body(Begin, End); }, Target);
+    }
+    if (!counter) {
+        Wait(Local);
+    }
+}
+
+unsigned
+Jobs::GetWorkerCount() {
+    return (unsigned)Workers.size();
+}
+
+float
+Jobs::GetUtilisation(unsigned worker) {
+    if (worker >= Workers.size()) {
+        return 0.0f;
+    }
+    double Elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(JobClock::now() - StatsStart).count();
+    return Elapsed > 0.0 ? (float)(Workers[worker]->BusyNanoseconds / Elapsed) : 0.0f;
+}
+
+unsigned
+Jobs::GetJobsRun(unsigned worker) {
+    return worker < Workers.size() ? Workers[worker]->JobsRun.load() : 0;
+}
+
+unsigned
+Jobs::GetJobsStolen(unsigned worker) {
+    return worker < Workers.size() ? Workers[worker]->JobsStolen.load() : 0;
+}
+
+void
+Jobs::ResetStats() {
+    for (unsigned WorkerIdx = 0; WorkerIdx < Workers.size(); ++WorkerIdx) {
+        Workers[WorkerIdx]->BusyNanoseconds = 0;
+        Workers[WorkerIdx]->JobsRun = 0;
+        Workers[WorkerIdx]->JobsStolen = 0;
+    }
+    StatsStart = JobClock::now();
+}
+
+void
+Jobs::PrintStats() {
+    for (unsigned WorkerIdx = 0; WorkerIdx < Workers.size(); ++WorkerIdx) {
+        std::cout << "Worker " << WorkerIdx << ": " << (unsigned)(GetUtilisation(WorkerIdx) * 100.0f) << "% busy, "
+                  << GetJobsRun(WorkerIdx) << " jobs, " << GetJobsStolen(WorkerIdx) << " stolen" << std::endl;
+    }
+}
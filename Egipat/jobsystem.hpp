@@ -0,0 +1,115 @@
+/**
+ * @file jobsystem.hpp
+ * @brief Work-stealing job scheduler. Every worker owns a deque, takes its
+ * newest job first and steals the oldest job of another worker when it runs
+ * dry. Counters track groups of jobs so callers can wait on them or chain
+ * jobs that only start once a counter drops to zero
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct JobCounter;
+
+struct Job {
+    std::function<void()> Work;
+    // NOTE: Decremented once Work returns, may be 0
+    JobCounter* Counter;
+};
+
+/**
+ * @brief Number of unfinished jobs in a group. Must outlive every job that
+ * references it, which Jobs::Wait guarantees
+ *
+ */
+struct JobCounter {
+    JobCounter() : Pending(0) {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    std::atomic<int> Pending;
+    // NOTE: Guards Continuations and the final decrement
+    std::mutex Lock;
+    // NOTE: Jobs queued once Pending reaches zero
+    std::vector<Job> Continuations;
+};
+
+namespace Jobs {
+    /**
+     * @brief Starts the workers. Before Init and after Shutdown jobs run
+     * inline on the calling thread
+     *
+     * @param workerCount - Worker threads, 0 for one less than the hardware
+     * threads since the waiting thread helps out
+     */
+    void Init(unsigned workerCount = 0);
+
+    /**
+     * @brief Runs the remaining jobs and joins the workers
+     *
+     */
+    void Shutdown();
+
+    /**
+     * @brief Queues a job
+     *
+     * @param work - Job body
+     * @param counter - Incremented now and decremented when the job is done, optional
+     * @param dependency - Job is held back until this counter reaches zero, optional
+     */
+    void Run(const std::function<void()>& work, JobCounter* counter = 0, JobCounter* dependency = 0);
+
+    /**
+     * @brief Runs queued jobs on the calling thread until the counter reaches zero
+     *
+     */
+    void Wait(JobCounter& counter);
+
+    /**
+     * @brief Splits [0, count) into ranges of at most grain items and runs
+     * body on each range as a separate job
+     *
+     * @param count - Item count
+     * @param grain - Items per job
+     * @param body - Called with [begin, end) of each range
+     * @param counter - Tracks the ranges without waiting, optional. Without
+     * it ParallelFor returns once every range is done
+     */
+    void ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& body, JobCounter* counter = 0);
+
+    unsigned GetWorkerCount();
+
+    /**
+     * @brief Fraction of the time since the last ResetStats a worker spent running jobs
+     *
+     */
+    float GetUtilisation(unsigned worker);
+
+    /**
+     * @brief Jobs a worker ran since the last ResetStats
+     *
+     */
+    unsigned GetJobsRun(unsigned worker);
+
+    /**
+     * @brief Jobs a worker took from another worker's deque since the last ResetStats
+     *
+     */
+    unsigned GetJobsStolen(unsigned worker);
+
+    void ResetStats();
+
+    /**
+     * @brief Prints utilisation and job counts of every worker
+     *
+     */
+    void PrintStats();
+}
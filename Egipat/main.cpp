@@ -11,19 +11,42 @@
 // ReSharper disable All
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <iostream>
 
+#include "bench.hpp"
+#include "bvh.hpp"
 #include "camera.hpp"
+#include "camerapath.hpp"
+#include "capture.hpp"
+#include "commandbuffer.hpp"
 #include "irenderable.hpp"
+#include "frameuniforms.hpp"
+#include "framearena.hpp"
+#include "gpumemory.hpp"
+#include "jobsystem.hpp"
 #include "shader.hpp"
+#include "shadervariants.hpp"
+#include "simulation.hpp"
+#include "softrasterizer.hpp"
+#include "skybox.hpp"
 #include "model.hpp"
+#include "occlusion.hpp"
+#include "particles.hpp"
+#include "perftest.hpp"
+#include "terrain.hpp"
 #include "texture.hpp"
+#include "trace.hpp"
+#include "transform.hpp"
 
 const int WindowWidth = 800;
 const int WindowHeight = 800;
@@ -33,48 +56,123 @@ const float TargetFrameTime = 1.0f / TargetFPS;
 const unsigned int Stride = 8 * sizeof(float);
 OrbitalCamera Camera(90.0f, 5.0f, 3.0f, 4.0f);
 
+bool ShowOcclusionBounds = false;
+
+// NOTE: Local bounds of the pyramid mesh, shared by the capstones
+static const glm::vec3 PyramidMin(-1.0f, 0.0f, -1.0f);
+static const glm::vec3 PyramidMax(1.0f, 1.5f, 1.0f);
+
+// NOTE: Position, UV, normal. Drawn by both renderers
+static const float PyramidVertices[] = {
+    -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    -1.0f, 0.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+     1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+     1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    -1.0f, 0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+     1.0f, 0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+
+     0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.00000f, 0.5547f,  0.83205f,
+    -1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.00000f, 0.5547f,  0.83205f,
+     1.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.00000f, 0.5547f,  0.83205f,
+
+     0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.83205f, 0.5547f,  0.00000f,
+     1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.83205f, 0.5547f,  0.00000f,
+     1.0f, 0.0f, -1.0f, 1.0f, 0.0f,  0.83205f, 0.5547f,  0.00000f,
+
+     0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.00000f, 0.5547f, -0.83205f,
+     1.0f, 0.0f, -1.0f, 0.0f, 0.0f,  0.00000f, 0.5547f, -0.83205f,
+    -1.0f, 0.0f, -1.0f, 1.0f, 0.0f,  0.00000f, 0.5547f, -0.83205f,
+
+     0.0f, 1.5f,  0.0f, 0.5f, 1.0f, -0.83205f, 0.5547f,  0.00000f,
+    -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, -0.83205f, 0.5547f,  0.00000f,
+    -1.0f, 0.0f,  1.0f, 1.0f, 0.0f, -0.83205f, 0.5547f,  0.00000f
+};
+static const unsigned PyramidVertexCount = sizeof(PyramidVertices) / Stride;
+
+// NOTE: Moonlight direction, the moon sits opposite it relative to the camera
+static const glm::vec3 LightDirection(0.33f, -0.66f, 1.33f);
+
 float FrameStartTime = (float)glfwGetTime();
 float FrameEndTime = (float)glfwGetTime();
 float dt = FrameEndTime - FrameStartTime;
 
+float LastX = WindowWidth / 2;
+float LastY = WindowHeight / 2;
+bool FirstMouse = true;
+// NOTE: Mouse motion since the last processInput, the simulation thread turns the camera
+float MouseDX = 0.0f;
+float MouseDY = 0.0f;
+
+/**
+ * @brief Samples input for the simulation thread and handles the toggles the
+ * render thread owns
+ *
+ * @param window Window
+ * @param input Receives held keys and the mouse motion since the last call
+ */
 static void
-processInput(GLFWwindow* window, float &x, float &y, float &z, float dt) {
+processInput(GLFWwindow* window, InputState& input) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-        Camera.mMoveFaster = true;
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE)
-        Camera.mMoveFaster = false;
-
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        Camera.Move(0.0f, 1.0f, dt);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        Camera.Move(-1.0f, 0.0f, dt);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        Camera.Move(0.0f, -1.0f, dt);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        Camera.Move(1.0f, 0.0f, dt);
+    input.MoveFaster = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+    input.MoveForward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.MoveLeft = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.MoveBack = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.MoveRight = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
 
+    input.RugDelta = glm::vec3(0.0f);
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-		y += 0.1f;
+		input.RugDelta.y += 0.1f;
     if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		x -= 0.1f;
+		input.RugDelta.x -= 0.1f;
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-		y -= 0.1f;
+		input.RugDelta.y -= 0.1f;
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		x += 0.1f;
+		input.RugDelta.x += 0.1f;
 
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
-		z += 0.1f;
+		input.RugDelta.z += 0.1f;
 	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
-		z -= 0.1f;
+		input.RugDelta.z -= 0.1f;
+
+    input.Pick = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+    input.RecordKey = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    input.SavePath = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+
+    input.MouseDX = MouseDX;
+    input.MouseDY = MouseDY;
+    MouseDX = MouseDY = 0.0f;
+
+    static bool BoundsKeyDown = false;
+    bool BoundsKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (BoundsKey && !BoundsKeyDown)
+        ShowOcclusionBounds = !ShowOcclusionBounds;
+    BoundsKeyDown = BoundsKey;
+
+    // NOTE: Worker utilisation since the last press
+    static bool JobsKeyDown = false;
+    bool JobsKey = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+    if (JobsKey && !JobsKeyDown) {
+        Jobs::PrintStats();
+        Jobs::ResetStats();
+    }
+    JobsKeyDown = JobsKey;
+
+    // NOTE: First press starts tracing, the next one writes trace.json
+    static bool TraceKeyDown = false;
+    bool TraceKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (TraceKey && !TraceKeyDown) {
+        if (Trace::IsEnabled()) {
+            Trace::Dump("trace.json");
+        } else {
+            Trace::SetEnabled(true);
+            std::cout << "Tracing started" << std::endl;
+        }
+    }
+    TraceKeyDown = TraceKey;
 }
 
-float LastX = WindowWidth / 2;
-float LastY = WindowHeight / 2;
-bool FirstMouse = true;
-
 void
 mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if (FirstMouse) {
@@ -88,7 +186,8 @@ mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 	LastX = (float)xpos;
 	LastY = (float)ypos;
 
-    Camera.Rotate(xoffset, yoffset, dt);
+    MouseDX += xoffset;
+    MouseDY += yoffset;
 }  
 
 /**
@@ -125,7 +224,461 @@ std::vector<float> calculateTriangleNormals(const std::vector<float>& vertices)
     return normals;
 }
 
-int main() {
+/**
+ * @brief Tests a transformed local box for occlusion
+ *
+ * @param occlusion Occlusion culler
+ * @param world World matrix
+ * @param localMin Local box minimum corner
+ * @param localMax Local box maximum corner
+ * @param worldMin Receives the world box minimum corner, for RecordBounds
+ * @param worldMax Receives the world box maximum corner, for RecordBounds
+ *
+ * @returns false if the box is hidden
+ */
+static bool
+testOcclusion(OcclusionCuller& occlusion, const glm::mat4& world, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& worldMin, glm::vec3& worldMax) {
+    worldMin = glm::vec3(1e30f);
+    worldMax = glm::vec3(-1e30f);
+    for (unsigned Corner = 0; Corner < 8; ++Corner) {
+        glm::vec3 Local((Corner & 1) ? localMax.x : localMin.x, (Corner & 2) ? localMax.y : localMin.y, (Corner & 4) ? localMax.z : localMin.z);
+        glm::vec3 World = glm::vec3(world * glm::vec4(Local, 1.0f));
+        worldMin = glm::min(worldMin, World);
+        worldMax = glm::max(worldMax, World);
+    }
+    return occlusion.IsVisible(worldMin, worldMax);
+}
+
+/**
+ * @brief Reports GPU memory and leaked GL objects once everything in main is
+ * destroyed, then tears down GLFW
+ *
+ */
+struct ShutdownGuard {
+    ~ShutdownGuard() {
+        Jobs::Shutdown();
+        GpuMemory::PrintStats();
+        FrameMemory::PrintStats();
+        GpuMemory::ReportLeaks();
+        glfwTerminate();
+    }
+};
+
+/**
+ * @brief Records the scene shader variant for a draw and its per-draw block.
+ * Safe on jobs, frame is only read
+ *
+ * @param commands Command buffer
+ * @param variants Scene shader variants
+ * @param frame Frame uniforms, picks the point lights reaching the draw
+ * @param features EShaderFeature flags of the material
+ * @param world World matrix
+ * @param normal Normal matrix
+ * @param center Bounding sphere center
+ * @param radius Bounding sphere radius
+ */
+static void
+recordSceneVariant(CommandBuffer& commands, ShaderVariants& variants, const FrameUniforms& frame, unsigned features, const glm::mat4& world, const glm::mat3& normal, const glm::vec3& center, float radius) {
+    int Lights[MAX_POINT_LIGHTS] = { 0 };
+    unsigned LightCount = frame.SelectPointLights(center, radius, Lights);
+    ObjectUniforms Object = FrameUniforms::MakeObject(world, normal, Lights);
+    commands.BindPipeline(variants, MakeShaderKey(features, LightCount));
+    commands.SetConstants(OBJECT_BLOCK_BINDING, &Object, sizeof(Object));
+}
+
+/**
+ * @brief Records a pyramid shaped mesh
+ *
+ * @param commands Command buffer
+ * @param variants Scene shader variants
+ * @param frame Frame uniforms
+ * @param world World matrix
+ * @param normal Normal matrix
+ * @param vao Vertex array
+ * @param vertexCount Vertex count
+ */
+static void
+recordPyramid(CommandBuffer& commands, ShaderVariants& variants, const FrameUniforms& frame, const glm::mat4& world, const glm::mat3& normal, unsigned vao, unsigned vertexCount) {
+    glm::vec3 Center = glm::vec3(world * glm::vec4((PyramidMin + PyramidMax) * 0.5f, 1.0f));
+    float Radius = glm::length(PyramidMax - PyramidMin) * 0.5f * glm::length(glm::vec3(world[0]));
+    recordSceneVariant(commands, variants, frame, 0, world, normal, Center, Radius);
+    commands.BindVertexArray(vao);
+    commands.Draw(0, vertexCount);
+}
+
+/**
+ * @brief Records a model with the point lights reaching its bounds
+ *
+ * @param commands Command buffer
+ * @param model Model, recorded by one job at a time
+ * @param variants Scene shader variants
+ * @param frame Frame uniforms
+ * @param world World matrix
+ * @param normal Normal matrix
+ * @param min World bounds minimum corner
+ * @param max World bounds maximum corner
+ */
+static void
+recordModel(CommandBuffer& commands, Model& model, ShaderVariants& variants, const FrameUniforms& frame, const glm::mat4& world, const glm::mat3& normal, const glm::vec3& min, const glm::vec3& max) {
+    int Lights[MAX_POINT_LIGHTS] = { 0 };
+    glm::vec3 Center = (min + max) * 0.5f;
+    unsigned LightCount = frame.SelectPointLights(Center, glm::length(max - Center), Lights);
+    ObjectUniforms Object = FrameUniforms::MakeObject(world, normal, Lights);
+    commands.SetConstants(OBJECT_BLOCK_BINDING, &Object, sizeof(Object));
+    model.Record(commands, variants, LightCount);
+}
+
+/**
+ * @brief Scene hierarchy handles of everything drawn with a transform
+ *
+ */
+struct SceneNodes {
+    unsigned Khufu;
+    unsigned Khafre;
+    unsigned Menkaure;
+    unsigned KhufuTop;
+    unsigned KhafreTop;
+    unsigned MenkaureTop;
+    unsigned Rug;
+    unsigned Pharaoh;
+    unsigned Moon;
+};
+
+/**
+ * @brief Adds the pyramids, capstones and models to the scene hierarchy
+ *
+ * @param scene Scene hierarchy
+ * @param nodes Receives the node handles
+ */
+static void
+buildScene(TransformHierarchy& scene, SceneNodes& nodes) {
+    // NOTE: Capstones are parented to their pyramids, so their local
+    // transforms are relative to the pyramid's translation, rotation and scale
+    const glm::quat PyramidRotation = glm::angleAxis(glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    nodes.Khufu = scene.Add();
+    scene.SetPosition(nodes.Khufu, glm::vec3(2.5f, 0.0f, -5.0f));
+    scene.SetRotation(nodes.Khufu, PyramidRotation);
+    scene.SetScale(nodes.Khufu, glm::vec3(1.46f));
+
+    nodes.Khafre = scene.Add();
+    scene.SetRotation(nodes.Khafre, PyramidRotation);
+    scene.SetScale(nodes.Khafre, glm::vec3(1.47f));
+
+    nodes.Menkaure = scene.Add();
+    scene.SetPosition(nodes.Menkaure, glm::vec3(-1.0f, 0.0f, 3.0f));
+    scene.SetRotation(nodes.Menkaure, PyramidRotation);
+    scene.SetScale(nodes.Menkaure, glm::vec3(0.65f));
+
+    nodes.KhufuTop = scene.Add(nodes.Khufu);
+    scene.SetPosition(nodes.KhufuTop, glm::vec3(0.0f, 2.065f / 1.46f, 0.0f));
+    scene.SetScale(nodes.KhufuTop, glm::vec3(0.084f / 1.46f));
+
+    nodes.KhafreTop = scene.Add(nodes.Khafre);
+    scene.SetPosition(nodes.KhafreTop, glm::vec3(0.0f, 2.08f / 1.47f, 0.0f));
+    scene.SetScale(nodes.KhafreTop, glm::vec3(0.084f / 1.47f));
+
+    nodes.MenkaureTop = scene.Add(nodes.Menkaure);
+    scene.SetPosition(nodes.MenkaureTop, glm::vec3(0.0f, 0.85f / 0.65f, 0.0f));
+    scene.SetScale(nodes.MenkaureTop, glm::vec3(0.084f / 0.65f));
+
+    nodes.Rug = scene.Add();
+    scene.SetRotation(nodes.Rug, glm::angleAxis(glm::radians(5.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    nodes.Pharaoh = scene.Add();
+    scene.SetPosition(nodes.Pharaoh, glm::vec3(-0.3f, 0.0f, 3.7f));
+    scene.SetRotation(nodes.Pharaoh, glm::angleAxis(glm::radians(3.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    nodes.Moon = scene.Add();
+}
+
+/**
+ * @brief Sets up the moonlight, the capstone point lights and the moon spotlight
+ *
+ * @param lights Light block
+ * @param pointLightCount Receives the number of point lights
+ * @param cameraPosition Camera position, the moon follows it
+ */
+static void
+setupLights(LightUniforms& lights, unsigned& pointLightCount, const glm::vec3& cameraPosition) {
+    glm::vec3 MoonTranslation = 30.0f * (-LightDirection) + cameraPosition;
+
+    lights.DirLight.Direction = glm::vec4(LightDirection, 0.0f);
+    lights.DirLight.Ka = glm::vec4(glm::vec3(0.1f), 0.0f);
+    lights.DirLight.Kd = glm::vec4(79.0f/255.0f, 105.0f/255.0f, 136.0f/255.0f, 0.0f);
+    lights.DirLight.Ks = glm::vec4(glm::vec3(1.0f), 0.0f);
+
+    // NOTE: One point light per capstone: Khufu, Khafre, Menkaure
+    pointLightCount = 3;
+    for (unsigned LightIdx = 0; LightIdx < pointLightCount; ++LightIdx) {
+        PointLightUniforms& Light = lights.PointLights[LightIdx];
+        Light.Ka = glm::vec4(212.0f/255.0f, 175.0f/255.0f, 55.0f/255.0f, 0.0f);
+        Light.Kd = glm::vec4(255.0f/255.0f, 215.0f/255.0f, 0.0f, 0.0f);
+        Light.Ks = glm::vec4(glm::vec3(1.0f), 0.0f);
+        Light.Attenuation = glm::vec4(1.0f, 0.5f, 1.1f, 0.0f);
+    }
+
+    lights.Spotlight.Position = glm::vec4(MoonTranslation, 1.0f);
+    lights.Spotlight.Direction = glm::vec4(-MoonTranslation, 0.0f);
+    lights.Spotlight.Ka = glm::vec4(glm::vec3(0.1f), 0.0f);
+    lights.Spotlight.Kd = glm::vec4(79.0f/255.0f, 105.0f/255.0f, 136.0f/255.0f, 0.0f);
+    lights.Spotlight.Ks = glm::vec4(glm::vec3(1.0f), 0.0f);
+    lights.Spotlight.Attenuation = glm::vec4(1.0f, 0.00147f, 0.000007f, 0.0f);
+    lights.Spotlight.CutOff = glm::vec4(glm::cos(glm::radians(0.2f)), glm::cos(glm::radians(0.3f)), 0.0f, 0.0f);
+}
+
+/**
+ * @brief Floats the rug, keeps the moon in the sky and pulses the capstone
+ * lights. Updates the scene hierarchy
+ *
+ * @param scene Scene hierarchy
+ * @param nodes Scene nodes
+ * @param baseLights Lights from setupLights
+ * @param pointLightCount Number of point lights
+ * @param cameraPosition Camera position, the moon follows it
+ * @param rugOffset Offset the user moved the rug by
+ * @param time Seconds since start
+ * @param lights Receives the animated lights
+ */
+static void
+animateScene(TransformHierarchy& scene, const SceneNodes& nodes, const LightUniforms& baseLights, unsigned pointLightCount,
+             const glm::vec3& cameraPosition, const glm::vec3& rugOffset, float time, LightUniforms& lights) {
+    glm::vec3 MoonTranslation = 30.0f * (-LightDirection) + cameraPosition;
+    glm::vec3 RugPosition = glm::vec3(0.0f + rugOffset.x, 0.3f * cos(time) + rugOffset.y, 2.5f + rugOffset.z);
+    scene.SetPosition(nodes.Rug, RugPosition);
+    scene.SetPosition(nodes.Moon, MoonTranslation);
+    scene.Update();
+
+    const unsigned CapstoneNodes[] = { nodes.KhufuTop, nodes.KhafreTop, nodes.MenkaureTop };
+    float Pulse = (sin(time * 0.6f) + 1.0f) / 4.0f;
+    lights = baseLights;
+    for (unsigned LightIdx = 0; LightIdx < pointLightCount; ++LightIdx) {
+        PointLightUniforms& Light = lights.PointLights[LightIdx];
+        Light.Position = glm::vec4(scene.GetWorldPosition(CapstoneNodes[LightIdx]), 1.0f);
+        Light.Ka = glm::vec4(212.0f/255.0f * Pulse, 175.0f/255.0f * Pulse, 55.0f/255.0f * Pulse, 0.0f);
+        Light.Kd = glm::vec4(255.0f/255.0f * Pulse, 215.0f/255.0f * Pulse, 0.0f * Pulse, 0.0f);
+    }
+    lights.Spotlight.Position = glm::vec4(MoonTranslation, 1.0f);
+    lights.Spotlight.Direction = glm::vec4(RugPosition - MoonTranslation, 0.0f);
+}
+
+/**
+ * @brief Builds a ray query mesh from the finest level of detail of every
+ * mesh of a model
+ *
+ * @param model Imported model
+ * @param out Receives the mesh
+ */
+static void
+buildRayMesh(const Model& model, RayMesh& out) {
+    std::vector<float> Positions;
+    std::vector<unsigned> Indices;
+    for (unsigned MeshIdx = 0; MeshIdx < model.GetMeshCount(); ++MeshIdx) {
+        const Mesh& CurrMesh = model.GetMesh(MeshIdx);
+        if (!CurrMesh.GetLodCount()) {
+            continue;
+        }
+
+        // NOTE: Mesh vertices are position, normal, UV
+        unsigned BaseVertex = (unsigned)Positions.size() / 3;
+        for (unsigned VertexIdx = 0; VertexIdx < CurrMesh.GetVertexCount(); ++VertexIdx) {
+            Positions.insert(Positions.end(), &CurrMesh.mVertices[VertexIdx * 8], &CurrMesh.mVertices[VertexIdx * 8] + 3);
+        }
+        const MeshLod& Lod = CurrMesh.GetLod(0);
+        for (unsigned Idx = Lod.IndexOffset; Idx < Lod.IndexOffset + Lod.IndexCount; ++Idx) {
+            Indices.push_back(BaseVertex + CurrMesh.mIndices[Idx]);
+        }
+    }
+    out.Build(Positions.data(), (unsigned)Positions.size() / 3, 3, Indices.data(), (unsigned)Indices.size());
+}
+
+/**
+ * @brief Material textures of a model for the software renderer, per mesh
+ *
+ */
+struct SoftwareModel {
+    std::vector<SoftwareTexture> Textures;
+    std::vector<int> Diffuse;
+    std::vector<int> Specular;
+};
+
+/**
+ * @brief Loads the material textures of an imported model on jobs. Must run
+ * before Upload, which the software renderer never calls
+ *
+ * @param model Imported model
+ * @param out Receives the textures
+ */
+static void
+loadSoftwareModel(const Model& model, SoftwareModel& out) {
+    std::vector<std::string> Paths;
+    auto Find = [&Paths](const std::string& path) {
+        if (path.empty()) {
+            return -1;
+        }
+        std::vector<std::string>::iterator It = std::find(Paths.begin(), Paths.end(), path);
+        if (It != Paths.end()) {
+            return (int)(It - Paths.begin());
+        }
+        Paths.push_back(path);
+        return (int)Paths.size() - 1;
+    };
+    for (unsigned MeshIdx = 0; MeshIdx < model.GetMeshCount(); ++MeshIdx) {
+        out.Diffuse.push_back(Find(model.GetTexturePath(MeshIdx, aiTextureType_DIFFUSE)));
+        out.Specular.push_back(Find(model.GetTexturePath(MeshIdx, aiTextureType_SPECULAR)));
+    }
+
+    out.Textures.resize(Paths.size());
+    Jobs::ParallelFor((unsigned)Paths.size(), 1, [&out, &Paths](unsigned begin, unsigned end) {
+        for (unsigned TextureIdx = begin; TextureIdx < end; ++TextureIdx) {
+            out.Textures[TextureIdx].Load(Paths[TextureIdx]);
+        }
+    });
+}
+
+/**
+ * @brief Queues every mesh of a model at its finest level of detail
+ *
+ * @param rasterizer Software rasterizer
+ * @param model Imported model
+ * @param textures Textures from loadSoftwareModel
+ * @param world World matrix
+ * @param normal Normal matrix
+ */
+static void
+drawSoftwareModel(SoftwareRasterizer& rasterizer, const Model& model, const SoftwareModel& textures, const glm::mat4& world, const glm::mat3& normal) {
+    // NOTE: Mesh vertices are position, normal, UV
+    const SoftwareVertexLayout MeshLayout = { 8, 0, 3, 6 };
+    for (unsigned MeshIdx = 0; MeshIdx < model.GetMeshCount(); ++MeshIdx) {
+        const Mesh& CurrMesh = model.GetMesh(MeshIdx);
+        if (!CurrMesh.GetLodCount() || !CurrMesh.GetLod(0).IndexCount) {
+            continue;
+        }
+
+        SoftwareMaterial Material;
+        Material.Diffuse = textures.Diffuse[MeshIdx] >= 0 ? &textures.Textures[textures.Diffuse[MeshIdx]] : 0;
+        Material.Specular = textures.Specular[MeshIdx] >= 0 ? &textures.Textures[textures.Specular[MeshIdx]] : 0;
+        Material.Shininess = 128.0f;
+        Material.AlphaTest = Material.Diffuse && Material.Diffuse->HasAlpha;
+        const MeshLod& Lod = CurrMesh.GetLod(0);
+        rasterizer.Draw(CurrMesh.mVertices.data(), CurrMesh.GetVertexCount(), MeshLayout, CurrMesh.mIndices.data() + Lod.IndexOffset, Lod.IndexCount, world, normal, Material);
+    }
+}
+
+/**
+ * @brief Renders the scene on the CPU, without a window or GL context. The
+ * camera stays put while the scene animates at a fixed step
+ *
+ * @param argc Argument count
+ * @param argv Arguments: --software [frames] [output.ppm]
+ *
+ * @returns Process exit code
+ */
+static int
+runSoftware(int argc, char** argv) {
+    unsigned FrameCount = argc > 2 ? (unsigned)std::max(atoi(argv[2]), 1) : 300;
+    std::string OutputPath = argc > 3 ? argv[3] : "software.ppm";
+    Jobs::Init();
+
+    Model Moon("res/moon/moon.obj");
+    Model Pharaoh("res/pharaoh/pharaoh.obj");
+    Model Rug("res/rug/rug.obj");
+    bool MoonImported = false, PharaohImported = false, RugImported = false;
+    JobCounter Imports;
+    Jobs::Run([&Moon, &MoonImported]() { MoonImported = Moon.Import(); }, &Imports);
+    Jobs::Run([&Pharaoh, &PharaohImported]() { PharaohImported = Pharaoh.Import(); }, &Imports);
+    Jobs::Run([&Rug, &RugImported]() { RugImported = Rug.Import(); }, &Imports);
+
+    SoftwareTexture TextureSand, TextureSandSpecular, TexturePyramid, TextureGold;
+    TextureSand.Load("res/sand/sand.jpg");
+    TextureSandSpecular.Load("res/sand/sand_specular.jpg");
+    TexturePyramid.Load("res/pyramid/pyramid.jpeg");
+    TextureGold.Load("res/pyramid/gold.jpg");
+
+    Jobs::Wait(Imports);
+    if (!MoonImported || !PharaohImported || !RugImported) {
+        std::cerr << "Failed to load model" << std::endl;
+        Jobs::Shutdown();
+        return -1;
+    }
+    SoftwareModel MoonTextures, PharaohTextures, RugTextures;
+    loadSoftwareModel(Moon, MoonTextures);
+    loadSoftwareModel(Pharaoh, PharaohTextures);
+    loadSoftwareModel(Rug, RugTextures);
+
+    // NOTE: A fixed patch stands in for the streamed desert chunks
+    std::vector<float> GroundVertices;
+    std::vector<unsigned> GroundIndices;
+    Terrain::BuildPatch(512.0f, 128, GroundVertices, GroundIndices);
+
+    TransformHierarchy Scene;
+    SceneNodes Nodes;
+    buildScene(Scene, Nodes);
+    LightUniforms BaseLights, Lights;
+    std::memset((void*)&BaseLights, 0, sizeof(BaseLights));
+    unsigned PointLightCount = 0;
+    Camera.mPosition = glm::vec3(0.0f, 0.17f, 9.0f);
+    Camera.mFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    setupLights(BaseLights, PointLightCount, Camera.mPosition);
+
+    // NOTE: Pyramid and terrain vertices are position, UV, normal
+    const SoftwareVertexLayout PyramidLayout = { 8, 0, 5, 3 };
+    const SoftwareMaterial SandMaterial = { &TextureSand, &TextureSandSpecular, 128.0f, false };
+    const SoftwareMaterial PyramidMaterial = { &TexturePyramid, 0, 128.0f, false };
+    const SoftwareMaterial GoldMaterial = { &TextureGold, 0, 128.0f, false };
+    const unsigned PyramidNodes[] = { Nodes.Khufu, Nodes.Khafre, Nodes.Menkaure };
+    const unsigned CapstoneNodes[] = { Nodes.KhufuTop, Nodes.KhafreTop, Nodes.MenkaureTop };
+
+    SoftwareRasterizer Rasterizer(WindowWidth, WindowHeight);
+    glm::mat4 Projection = glm::perspective(45.0f, WindowWidth / (float)WindowHeight, 0.1f, 1000.0f);
+    glm::vec3 RugOffset(0.0f, 1.0f, 0.0f);
+    unsigned long long Triangles = 0, RejectedBlocks = 0;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (unsigned FrameIdx = 0; FrameIdx < FrameCount; ++FrameIdx) {
+        animateScene(Scene, Nodes, BaseLights, PointLightCount, Camera.mPosition, RugOffset, FrameIdx * TargetFrameTime, Lights);
+        glm::mat4 View = glm::lookAt(Camera.mPosition, Camera.mTarget, Camera.mUp);
+        Rasterizer.BeginFrame(View, Projection, Camera.mPosition, Lights, PointLightCount, glm::vec3(0.08f, 0.09f, 0.20f));
+
+        Rasterizer.Draw(GroundVertices.data(), (unsigned)GroundVertices.size() / 8, PyramidLayout, GroundIndices.data(), (unsigned)GroundIndices.size(),
+                        glm::mat4(1.0f), glm::mat3(1.0f), SandMaterial);
+        for (unsigned PyramidIdx = 0; PyramidIdx < 3; ++PyramidIdx) {
+            Rasterizer.Draw(PyramidVertices, PyramidVertexCount, PyramidLayout, 0, 0,
+                            Scene.GetWorld(PyramidNodes[PyramidIdx]), Scene.GetNormal(PyramidNodes[PyramidIdx]), PyramidMaterial);
+            Rasterizer.Draw(PyramidVertices, PyramidVertexCount, PyramidLayout, 0, 0,
+                            Scene.GetWorld(CapstoneNodes[PyramidIdx]), Scene.GetNormal(CapstoneNodes[PyramidIdx]), GoldMaterial);
+        }
+        drawSoftwareModel(Rasterizer, Rug, RugTextures, Scene.GetWorld(Nodes.Rug), Scene.GetNormal(Nodes.Rug));
+        drawSoftwareModel(Rasterizer, Pharaoh, PharaohTextures, Scene.GetWorld(Nodes.Pharaoh), Scene.GetNormal(Nodes.Pharaoh));
+        drawSoftwareModel(Rasterizer, Moon, MoonTextures, Scene.GetWorld(Nodes.Moon), Scene.GetNormal(Nodes.Moon));
+
+        Rasterizer.EndFrame();
+        Triangles += Rasterizer.GetTriangleCount();
+        RejectedBlocks += Rasterizer.GetRejectedBlocks();
+    }
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    std::cout << "Software renderer: " << FrameCount << " frames at " << WindowWidth << "x" << WindowHeight << " on " << Jobs::GetWorkerCount() << " workers" << std::endl;
+    std::cout << "  " << Seconds * 1e3 / FrameCount << " ms/frame, " << FrameCount / Seconds << " FPS" << std::endl;
+    std::cout << "  " << Triangles / FrameCount << " triangles/frame, " << RejectedBlocks / FrameCount << " depth blocks rejected/frame" << std::endl;
+    bool Written = Rasterizer.WritePpm(OutputPath);
+    if (Written) {
+        std::cout << "Last frame written to " << OutputPath << std::endl;
+    }
+    Jobs::Shutdown();
+    return Written ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    // NOTE: Needs no GL, so it runs before a window is created
+    if (argc > 1 && std::string(argv[1]) == "--software") {
+        return runSoftware(argc, argv);
+    }
+
+    // NOTE: --perf-test [frames] [baseline] renders the flythrough in a hidden
+    // window and compares frame times with the baseline, --perf-baseline
+    // takes the same arguments and writes the baseline instead
+    bool RunPerfTest = argc > 1 && (std::string(argv[1]) == "--perf-test" || std::string(argv[1]) == "--perf-baseline");
+
     GLFWwindow* Window = 0;
     if (!glfwInit()) {
         std::cerr << "Failed to init glfw" << std::endl;
@@ -136,6 +689,9 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwSetErrorCallback(ErrorCallback);
+    if (RunPerfTest) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     Window = glfwCreateWindow(WindowWidth, WindowHeight, WindowTitle.c_str(), 0, 0);
     if (!Window) {
@@ -156,80 +712,118 @@ int main() {
         return -1;
     }
 
-    Shader AlmightyShader("shaders/shader.vert", "shaders/shader.frag");
+    if (argc > 1 && std::string(argv[1]) == "--bench-particles") {
+        int Result = Bench::RunParticles(Window);
+        glfwTerminate();
+        return Result;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-import") {
+        int Result = Bench::RunImport(std::vector<std::string>(argv + 2, argv + argc));
+        glfwTerminate();
+        return Result;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--replay") {
+        int Result = Bench::RunReplay(Window, argv[2], argc > 3 ? (unsigned)std::max(atoi(argv[3]), 1) : 10);
+        glfwTerminate();
+        return Result;
+    }
+
+    // NOTE: --trace records from startup so loading shows up too
+    Trace::SetThreadName("Main");
+    for (int ArgIdx = 1; ArgIdx < argc; ++ArgIdx) {
+        if (std::string(argv[ArgIdx]) == "--trace") {
+            Trace::SetEnabled(true);
+        }
+    }
+
+    Shader::EnableParallelCompile();
+    Jobs::Init();
+    FrameMemory::Init();
+
+    // NOTE: Declared before anything owning GL objects so it runs last
+    ShutdownGuard Shutdown;
+
+    // NOTE: Sampler units and shininess never change, set once per variant
+    ShaderVariants SceneShaders("shaders/shader.vert", "shaders/shader.frag", [](const Shader& variant) {
+        variant.SetUniform1i("uMaterial.Kd", 0);
+        variant.SetUniform1i("uMaterial.Ks", 1);
+        variant.SetUniform1f("uMaterial.Shininess", 128.0f);
+    });
+
+    // NOTE: Issue the variants the desert, pyramids and models need up front,
+    // they compile while textures and models load below
+    for (unsigned LightCount = 0; LightCount <= MAX_POINT_LIGHTS; ++LightCount) {
+        SceneShaders.Prepare(MakeShaderKey(0, LightCount));
+        SceneShaders.Prepare(MakeShaderKey(SHADER_HAS_SPECULAR, LightCount));
+    }
+
+    // NOTE: Models are imported on jobs while the textures below load,
+    // only their uploads need the GL thread
+    Model Moon("res/moon/moon.obj");
+    Model Pharaoh("res/pharaoh/pharaoh.obj");
+    Model Rug("res/rug/rug.obj");
+    bool MoonImported = false, PharaohImported = false, RugImported = false;
+    JobCounter Imports;
+    Jobs::Run([&Moon, &MoonImported]() { MoonImported = Moon.Import(); }, &Imports);
+    Jobs::Run([&Pharaoh, &PharaohImported]() { PharaohImported = Pharaoh.Import(); }, &Imports);
+    Jobs::Run([&Rug, &RugImported]() { RugImported = Rug.Import(); }, &Imports);
 
     Texture textureSand("res/sand/sand.jpg");
 	Texture textureSandSpecular("res/sand/sand_specular.jpg");
     Texture texturePyramid("res/pyramid/pyramid.jpeg");
     Texture texturegoldPyramidTop("res/pyramid/gold.jpg");
 
+    Skybox Sky("res/skybox/skybox.jpg");
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
     Camera.mPosition = glm::vec3(0.0f, 0.17f,  9.0f);
     Camera.mFront = glm::vec3(0.0f, 0.0f, -1.0f);
-    float RenderDistance = 100.0f;
+    float RenderDistance = 1000.0f;
     float NearDistance = 0.1f;
     float AspectRatio = WindowWidth / (float)WindowHeight;
     glViewport(0, 0, WindowWidth, WindowHeight);
 
-    Model Moon("res/moon/moon.obj");
-    if(!Moon.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
-        glfwTerminate();
-        return -1;
+    // NOTE: Texture arrays batch the model materials but don't stream them
+    bool UseTextureArrays = false;
+    for (int ArgIdx = 1; ArgIdx < argc; ++ArgIdx) {
+        UseTextureArrays = UseTextureArrays || std::string(argv[ArgIdx]) == "--texture-arrays";
     }
+    TextureStreamer Streamer;
+    TextureArrays MaterialArrays;
+    TextureStreamer* ModelStreamer = UseTextureArrays ? 0 : &Streamer;
+    TextureArrays* ModelArrays = UseTextureArrays ? &MaterialArrays : 0;
 
-    Model Pharaoh("res/pharaoh/pharaoh.obj");
-    if(!Pharaoh.Load()) {
+    Jobs::Wait(Imports);
+    if (!MoonImported || !PharaohImported || !RugImported) {
         std::cerr << "Failed to load model" << std::endl;
-        glfwTerminate();
         return -1;
     }
 
-    Model Rug("res/rug/rug.obj");
-    if(!Rug.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
+    // NOTE: Ray query meshes for picking and camera collision build on jobs
+    // while the models upload. The ground is a fixed patch around the site
+    RayMesh PyramidRays, GroundRays, RugRays, PharaohRays, MoonRays;
+    JobCounter RayMeshBuilds;
+    Jobs::Run([&PyramidRays]() { PyramidRays.Build(PyramidVertices, PyramidVertexCount, 8, 0, 0); }, &RayMeshBuilds);
+    Jobs::Run([&GroundRays]() {
+        std::vector<float> GroundVertices;
+        std::vector<unsigned> GroundIndices;
+        Terrain::BuildPatch(256.0f, 128, GroundVertices, GroundIndices);
+        GroundRays.Build(GroundVertices.data(), (unsigned)GroundVertices.size() / 8, 8, GroundIndices.data(), (unsigned)GroundIndices.size());
+    }, &RayMeshBuilds);
+    Jobs::Run([&Rug, &RugRays]() { buildRayMesh(Rug, RugRays); }, &RayMeshBuilds);
+    Jobs::Run([&Pharaoh, &PharaohRays]() { buildRayMesh(Pharaoh, PharaohRays); }, &RayMeshBuilds);
+    Jobs::Run([&Moon, &MoonRays]() { buildRayMesh(Moon, MoonRays); }, &RayMeshBuilds);
+
+    Moon.Upload(ModelStreamer, ModelArrays);
+    Pharaoh.Upload(ModelStreamer, ModelArrays);
+    Rug.Upload(ModelStreamer, ModelArrays);
+    MaterialArrays.Build();
     
     glEnable(GL_DEPTH_TEST);
     glEnable (GL_CULL_FACE);
-
-    std::vector<float> SandVertices = {
-        -1.0f, 0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-         1.0f, 0.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-         1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-    	 1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-    	-1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-    	-1.0f, 0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f
-    };
-
-    std::vector<float> PyramidVertices = {
-        -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        -1.0f, 0.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-         1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-         1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-        -1.0f, 0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-         1.0f, 0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-
-         0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.00000f, 0.5547f,  0.83205f,
-    	-1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.00000f, 0.5547f,  0.83205f,
-         1.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.00000f, 0.5547f,  0.83205f,
-                                                             
-         0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.83205f, 0.5547f,  0.00000f,
-         1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.83205f, 0.5547f,  0.00000f,
-         1.0f, 0.0f, -1.0f, 1.0f, 0.0f,  0.83205f, 0.5547f,  0.00000f,
-                                         
-         0.0f, 1.5f,  0.0f, 0.5f, 1.0f,  0.00000f, 0.5547f, -0.83205f,
-         1.0f, 0.0f, -1.0f, 0.0f, 0.0f,  0.00000f, 0.5547f, -0.83205f,
-        -1.0f, 0.0f, -1.0f, 1.0f, 0.0f,  0.00000f, 0.5547f, -0.83205f,
-
-    	 0.0f, 1.5f,  0.0f, 0.5f, 1.0f, -0.83205f, 0.5547f,  0.00000f,
-        -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, -0.83205f, 0.5547f,  0.00000f,
-        -1.0f, 0.0f,  1.0f, 1.0f, 0.0f, -0.83205f, 0.5547f,  0.00000f
-    };
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     /*std::vector<float> RugVertices = {
         -0.5f,  0.48f, -0.5f, 0.2f, 0.16f,
@@ -275,36 +869,11 @@ int main() {
         -0.5f,  0.50f, -0.5f, 0.22f, 0.21f
     };*/
 
-    unsigned SandVAO;
-    glGenVertexArrays(1, &SandVAO);
-    glBindVertexArray(SandVAO);
-    unsigned SandVBO;
-    glGenBuffers(1, &SandVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, SandVBO);
-    glBufferData(GL_ARRAY_BUFFER, SandVertices.size() * sizeof(float), SandVertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*) 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Stride, (void*) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-	//std::vector<float> SandNormals = calculateTriangleNormals(SandVertices);
-	//unsigned SandVBO_normals;
-	//glGenBuffers(1, &SandVBO_normals);
-	//glBindBuffer(GL_ARRAY_BUFFER, SandVBO_normals);
-	//glBufferData(GL_ARRAY_BUFFER, SandNormals.size() * sizeof(float), SandNormals.data(), GL_STATIC_DRAW);
-	//glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*) 0);
-	//glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    
-    unsigned PyramidOfKhafreVAO;
-    glGenVertexArrays(1, &PyramidOfKhafreVAO);
+    unsigned PyramidOfKhafreVAO = GpuMemory::CreateVertexArray("PyramidOfKhafre");
     glBindVertexArray(PyramidOfKhafreVAO);
-    unsigned PyramidOfKhafreVBO;
-    glGenBuffers(1, &PyramidOfKhafreVBO);
+    unsigned PyramidOfKhafreVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "PyramidOfKhafre");
     glBindBuffer(GL_ARRAY_BUFFER, PyramidOfKhafreVBO);
-    glBufferData(GL_ARRAY_BUFFER, PyramidVertices.size() * sizeof(float), PyramidVertices.data(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(PyramidOfKhafreVBO, GL_ARRAY_BUFFER, sizeof(PyramidVertices), PyramidVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*) 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*) (3 * sizeof(float)));
@@ -321,13 +890,11 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    unsigned PyramidOfMenkaureVAO;
-    glGenVertexArrays(1, &PyramidOfMenkaureVAO);
+    unsigned PyramidOfMenkaureVAO = GpuMemory::CreateVertexArray("PyramidOfMenkaure");
     glBindVertexArray(PyramidOfMenkaureVAO);
-    unsigned PyramidOfMenkaureVBO;
-    glGenBuffers(1, &PyramidOfMenkaureVBO);
+    unsigned PyramidOfMenkaureVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "PyramidOfMenkaure");
     glBindBuffer(GL_ARRAY_BUFFER, PyramidOfMenkaureVBO);
-    glBufferData(GL_ARRAY_BUFFER, PyramidVertices.size() * sizeof(float), PyramidVertices.data(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(PyramidOfMenkaureVBO, GL_ARRAY_BUFFER, sizeof(PyramidVertices), PyramidVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*) 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*) (3 * sizeof(float)));
@@ -344,13 +911,11 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    unsigned PyramidOfKhufuVAO;
-    glGenVertexArrays(1, &PyramidOfKhufuVAO);
+    unsigned PyramidOfKhufuVAO = GpuMemory::CreateVertexArray("PyramidOfKhufu");
     glBindVertexArray(PyramidOfKhufuVAO);
-    unsigned PyramidOfKhufuVBO;
-    glGenBuffers(1, &PyramidOfKhufuVBO);
+    unsigned PyramidOfKhufuVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "PyramidOfKhufu");
     glBindBuffer(GL_ARRAY_BUFFER, PyramidOfKhufuVBO);
-    glBufferData(GL_ARRAY_BUFFER, PyramidVertices.size() * sizeof(float), PyramidVertices.data(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(PyramidOfKhufuVBO, GL_ARRAY_BUFFER, sizeof(PyramidVertices), PyramidVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*) 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*) (3 * sizeof(float)));
@@ -367,13 +932,11 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    unsigned PyramidTopVAO;
-    glGenVertexArrays(1, &PyramidTopVAO);
+    unsigned PyramidTopVAO = GpuMemory::CreateVertexArray("PyramidTop");
     glBindVertexArray(PyramidTopVAO);
-    unsigned PyramidTopVBO;
-    glGenBuffers(1, &PyramidTopVBO);
+    unsigned PyramidTopVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "PyramidTop");
     glBindBuffer(GL_ARRAY_BUFFER, PyramidTopVBO);
-    glBufferData(GL_ARRAY_BUFFER, PyramidVertices.size() * sizeof(float), PyramidVertices.data(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(PyramidTopVBO, GL_ARRAY_BUFFER, sizeof(PyramidVertices), PyramidVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*) 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*) (3 * sizeof(float)));
@@ -411,175 +974,358 @@ int main() {
     //glBindBuffer(GL_ARRAY_BUFFER, 0);
     //glBindVertexArray(0);
 
-    glm::vec3 moonPosition = glm::vec3(-10.0f, 20.0f, -40.0f);
-    glm::vec3 lightDir = glm::vec3(0.33f, -0.66f, 1.33f);
-    glm::vec3 moonTranslation = 30.0f * (-lightDir) + Camera.mPosition;
-
-    glUseProgram(AlmightyShader.GetId());
-    AlmightyShader.SetUniform3f("uDirLight.Direction", lightDir);
-    AlmightyShader.SetUniform3f("uDirLight.Ka", glm::vec3(0.1f));
-    AlmightyShader.SetUniform3f("uDirLight.Kd", glm::vec3(79.0f/255.0f, 105.0f/255.0f, 136.0f/255.0f));
-    AlmightyShader.SetUniform3f("uDirLight.Ks", glm::vec3(1.0f));
-
-    AlmightyShader.SetUniform3f("uPointLightKhufu.Position", glm::vec3(0.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhufu.Ka", glm::vec3(212.0f/255.0f, 175.0f/255.0f, 55.0f/255.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhufu.Kd", glm::vec3(255.0f/255.0f, 215.0f/255.0f, 0.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhufu.Ks", glm::vec3(1.0f));
-    AlmightyShader.SetUniform1f("uPointLightKhufu.Kc", 1.0f);
-    AlmightyShader.SetUniform1f("uPointLightKhufu.Kl", 0.5f);
-    AlmightyShader.SetUniform1f("uPointLightKhufu.Kq", 1.1f);
-
-    AlmightyShader.SetUniform3f("uPointLightKhafre.Position", glm::vec3(0.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhafre.Ka", glm::vec3(212.0f/255.0f, 175.0f/255.0f, 55.0f/255.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhafre.Kd", glm::vec3(255.0f/255.0f, 215.0f/255.0f, 0.0f));
-    AlmightyShader.SetUniform3f("uPointLightKhafre.Ks", glm::vec3(1.0f));
-    AlmightyShader.SetUniform1f("uPointLightKhafre.Kc", 1.0f);
-    AlmightyShader.SetUniform1f("uPointLightKhafre.Kl", 0.5f);
-    AlmightyShader.SetUniform1f("uPointLightKhafre.Kq", 1.1f);
-
-    AlmightyShader.SetUniform3f("uPointLightMenkaure.Position", glm::vec3(0.0f));
-    AlmightyShader.SetUniform3f("uPointLightMenkaure.Ka", glm::vec3(212.0f/255.0f, 175.0f/255.0f, 55.0f/255.0f));
-    AlmightyShader.SetUniform3f("uPointLightMenkaure.Kd", glm::vec3(255.0f/255.0f, 215.0f/255.0f, 0.0f));
-    AlmightyShader.SetUniform3f("uPointLightMenkaure.Ks", glm::vec3(1.0f));
-    AlmightyShader.SetUniform1f("uPointLightMenkaure.Kc", 1.0f);
-    AlmightyShader.SetUniform1f("uPointLightMenkaure.Kl", 0.5f);
-    AlmightyShader.SetUniform1f("uPointLightMenkaure.Kq", 1.1f);
-
-    AlmightyShader.SetUniform3f("uSpotlight.Position", moonTranslation);
-    AlmightyShader.SetUniform3f("uSpotlight.Direction", -moonTranslation);
-    AlmightyShader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.1f));
-    AlmightyShader.SetUniform3f("uSpotlight.Kd", glm::vec3(79.0f/255.0f, 105.0f/255.0f, 136.0f/255.0f));
-    AlmightyShader.SetUniform3f("uSpotlight.Ks", glm::vec3(1.0f));
-    AlmightyShader.SetUniform1f("uSpotlight.Kc", 1.0f);
-    AlmightyShader.SetUniform1f("uSpotlight.Kl", 0.00147f);
-    AlmightyShader.SetUniform1f("uSpotlight.Kq", 0.000007f);
-    AlmightyShader.SetUniform1f("uSpotlight.InnerCutOff", glm::cos(glm::radians(0.2f)));
-    AlmightyShader.SetUniform1f("uSpotlight.OuterCutOff", glm::cos(glm::radians(0.3f)));
-
-    AlmightyShader.SetUniform1i("uMaterial.Kd", 0);
-    AlmightyShader.SetUniform1i("uMaterial.Ks", 1);
-    AlmightyShader.SetUniform1f("uMaterial.Shininess", 128.0f);
-
-    unsigned int vertexLength = Stride / sizeof(float);
-    float x = 0.0f, y = 1.0f, z = 0.0f;
+    FrameUniforms Frame;
+    setupLights(Frame.Lights, Frame.PointLightCount, Camera.mPosition);
+
+    TransformHierarchy Scene;
+    SceneNodes Nodes;
+    buildScene(Scene, Nodes);
+    Scene.Update();
+
+    Jobs::Wait(RayMeshBuilds);
+    RayScene Colliders;
+    Colliders.AddInstance(GroundRays, glm::mat4(1.0f), "Desert");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.Khufu), "Pyramid of Khufu");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.Khafre), "Pyramid of Khafre");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.Menkaure), "Pyramid of Menkaure");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.KhufuTop), "Capstone of Khufu");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.KhafreTop), "Capstone of Khafre");
+    Colliders.AddInstance(PyramidRays, Scene.GetWorld(Nodes.MenkaureTop), "Capstone of Menkaure");
+    Colliders.AddInstance(PharaohRays, Scene.GetWorld(Nodes.Pharaoh), "Pharaoh");
+    const unsigned RugCollider = Colliders.AddInstance(RugRays, Scene.GetWorld(Nodes.Rug), "Rug");
+    const unsigned MoonCollider = Colliders.AddInstance(MoonRays, Scene.GetWorld(Nodes.Moon), "Moon");
+    Colliders.Build();
+    Camera.mCollider = &Colliders;
+
+    Terrain Desert;
+    ParticleSystem BlowingSand(200000);
+    MeshletCuller Culler;
+    OcclusionCuller Occlusion(WindowWidth, WindowHeight);
+    unsigned RugQuery = Occlusion.CreateQuery();
+    unsigned PharaohQuery = Occlusion.CreateQuery();
+    unsigned MoonQuery = Occlusion.CreateQuery();
+
+    if (!Shader::PollPending()) {
+        std::cout << "Waiting on " << Shader::GetPendingCount() << " shader programs" << std::endl;
+    }
+    if (Shader::FinishPending()) {
+        std::cerr << "[Err] Some shader programs failed to build" << std::endl;
+    }
+
+    // NOTE: Everything the lambda touches belongs to the simulation thread
+    // from here on, the render thread only reads snapshots
+    glm::vec3 RugOffset(0.0f, 1.0f, 0.0f);
+    const LightUniforms BaseLights = Frame.Lights;
+    const unsigned PointLightCount = Frame.PointLightCount;
+    bool PickHeld = false;
+
+    // NOTE: --camera-path file plays a recorded path instead of following the
+    // input, the perf test plays its flythrough unless given a path. Playback
+    // runs at a fixed step so every run renders the same views
+    CameraPath PlaybackPath;
+    for (int ArgIdx = 1; ArgIdx + 1 < argc; ++ArgIdx) {
+        if (std::string(argv[ArgIdx]) != "--camera-path") {
+            continue;
+        }
+        if (!PlaybackPath.Load(argv[ArgIdx + 1])) {
+            return -1;
+        }
+        if (PlaybackPath.IsEmpty()) {
+            std::cerr << "[Err] Camera path " << argv[ArgIdx + 1] << " has no keys" << std::endl;
+            return -1;
+        }
+    }
+    if (PlaybackPath.IsEmpty() && RunPerfTest) {
+        PlaybackPath = PerfTest::GetFlythrough();
+    }
+    const bool PlayPath = !PlaybackPath.IsEmpty();
+
+    // NOTE: K adds the current view as a key, L writes the keys to camera.path
+    CameraPath RecordedPath;
+    float RecordStart = 0.0f;
+    bool RecordKeyHeld = false, SavePathHeld = false;
+    Simulation Sim([&](const InputState& input, float time, float dt, RenderSnapshot& snapshot) {
+        TraceZone Phase("Camera");
+        if (PlayPath) {
+            glm::vec3 Position;
+            float Yaw, Pitch;
+            PlaybackPath.Sample(time, Position, Yaw, Pitch);
+            Camera.SetView(Position, Yaw, Pitch);
+        } else {
+            if (input.MouseDX != 0.0f || input.MouseDY != 0.0f)
+                Camera.Rotate(input.MouseDX, input.MouseDY, dt);
+            Camera.mMoveFaster = input.MoveFaster;
+            if (input.MoveForward)
+                Camera.Move(0.0f, 1.0f, dt);
+            if (input.MoveLeft)
+                Camera.Move(-1.0f, 0.0f, dt);
+            if (input.MoveBack)
+                Camera.Move(0.0f, -1.0f, dt);
+            if (input.MoveRight)
+                Camera.Move(1.0f, 0.0f, dt);
+        }
+        if (input.RecordKey && !RecordKeyHeld) {
+            if (RecordedPath.IsEmpty())
+                RecordStart = time;
+            RecordedPath.AddKey(time - RecordStart, Camera.mPosition, Camera.mYaw, Camera.mPitch);
+            std::cout << "Camera key " << RecordedPath.GetKeyCount() << " at " << time - RecordStart << " s" << std::endl;
+        }
+        RecordKeyHeld = input.RecordKey;
+        if (input.SavePath && !SavePathHeld && !RecordedPath.IsEmpty() && RecordedPath.Save("camera.path"))
+            std::cout << "Saved " << RecordedPath.GetKeyCount() << " camera keys to camera.path" << std::endl;
+        SavePathHeld = input.SavePath;
+
+        RugOffset += input.RugDelta;
+        Phase.Next("Animate scene");
+        animateScene(Scene, Nodes, BaseLights, PointLightCount, Camera.mPosition, RugOffset, time, snapshot.Lights);
+        Phase.Next("Colliders");
+        Colliders.SetTransform(RugCollider, Scene.GetWorld(Nodes.Rug));
+        Colliders.SetTransform(MoonCollider, Scene.GetWorld(Nodes.Moon));
+        Colliders.Refit();
+
+        // NOTE: The cursor is captured, so picking goes through the screen centre
+        if (input.Pick && !PickHeld) {
+            Ray PickRay;
+            PickRay.Origin = Camera.mPosition;
+            PickRay.Direction = Camera.mFront;
+            PickRay.MaxDistance = 1000.0f;
+            RayHit Hit;
+            if (Colliders.Intersect(PickRay, Hit))
+                std::cout << "Picked " << Colliders.GetName(Hit.Instance) << " at " << Hit.Distance << std::endl;
+            else
+                std::cout << "Picked nothing" << std::endl;
+        }
+        PickHeld = input.Pick;
+
+        Phase.Next("Snapshot");
+        snapshot.View = glm::lookAt(Camera.mPosition, Camera.mTarget, Camera.mUp);
+        snapshot.CameraPosition = Camera.mPosition;
+        snapshot.World.resize(Scene.GetNodeCount());
+        snapshot.Normal.resize(Scene.GetNodeCount());
+        for (unsigned Node = 0; Node < Scene.GetNodeCount(); ++Node) {
+            snapshot.World[Node] = Scene.GetWorld(Node);
+            snapshot.Normal[Node] = Scene.GetNormal(Node);
+        }
+    }, PlayPath ? TargetFrameTime : 0.0f);
+
+    const unsigned PyramidNodes[] = { Nodes.Khufu, Nodes.Khafre, Nodes.Menkaure, Nodes.KhufuTop, Nodes.KhafreTop, Nodes.MenkaureTop };
+    const unsigned PyramidVAOs[] = { PyramidOfKhufuVAO, PyramidOfKhafreVAO, PyramidOfMenkaureVAO, PyramidTopVAO, PyramidTopVAO, PyramidTopVAO };
+    const unsigned PyramidCount = sizeof(PyramidNodes) / sizeof(PyramidNodes[0]);
+    // NOTE: Recorded every frame, storage is reused. Every pass goes through
+    // one, so a capture holds the whole frame
+    CommandBuffer DesertCommands, PyramidCommands, RugCommands, PharaohCommands, MoonCommands;
+    CommandBuffer BoundsCommands, SkyCommands, ParticleCommands;
+
+    // NOTE: --capture frames [file] writes the command buffers of the first
+    // frames for --replay
+    FrameCapture Capture;
+    for (int ArgIdx = 1; ArgIdx + 1 < argc; ++ArgIdx) {
+        if (std::string(argv[ArgIdx]) == "--capture") {
+            std::string CapturePath = ArgIdx + 2 < argc && argv[ArgIdx + 2][0] != '-' ? argv[ArgIdx + 2] : "frames.capture";
+            Capture.Start(CapturePath, (unsigned)std::max(atoi(argv[ArgIdx + 1]), 1));
+        }
+    }
+
+    // NOTE: No vsync or pacing, the perf test measures the frame itself
+    PerfTest Perf;
+    if (RunPerfTest) {
+        // NOTE: Both are optional, other options like --camera-path may follow
+        bool HasFrames = argc > 2 && argv[2][0] != '-';
+        bool HasBaseline = HasFrames && argc > 3 && argv[3][0] != '-';
+        Perf.Start(HasFrames ? (unsigned)std::max(atoi(argv[2]), 1) : PERF_DEFAULT_FRAMES, HasBaseline ? argv[3] : "perf_baseline.txt",
+            std::string(argv[1]) == "--perf-baseline");
+        glfwSwapInterval(0);
+    }
+
     while (!glfwWindowShouldClose(Window)) {
+        TRACE_ZONE("Frame");
+        if (Perf.IsRunning())
+            Perf.BeginFrame();
+        TraceZone Phase("Input");
         glfwPollEvents();
+        InputState Input;
+        processInput(Window, Input);
+        Sim.SetInput(Input);
+        Phase.Next("Wait for simulation");
+        // NOTE: The simulation starts on the next frame as soon as this one is taken
+        const RenderSnapshot& Snap = Sim.BeginFrame();
+
+        Phase.Next("Uniforms");
         glClearColor(0.08f, 0.09f, 0.20f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         FrameStartTime = (float)glfwGetTime();
-        glUseProgram(AlmightyShader.GetId());
-
-		glm::mat4 FreeView = glm::lookAt(Camera.mPosition, Camera.mTarget, Camera.mUp);
-        AlmightyShader.SetView(FreeView);
 
+        const glm::mat4& FreeView = Snap.View;
+        const glm::vec3& CameraPosition = Snap.CameraPosition;
         glm::mat4 Projection = glm::perspective(45.0f, AspectRatio, NearDistance, RenderDistance);
-    	AlmightyShader.SetProjection(Projection);
-        
-        processInput(Window, x, y, z, dt);
-
-        moonTranslation = 30.0f * (-lightDir) + Camera.mPosition;
-
-        textureSand.Bind();
-        textureSandSpecular.Bind(1);
-        glBindTexture(GL_TEXTURE_2D, textureSandSpecular.GetRendererID());
-        glm::mat4 Model = glm::mat4(1.0f);
-        Model = glm::scale(Model, glm::vec3(15.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(SandVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)SandVertices.size() / vertexLength);
-        textureSandSpecular.Unbind();
-
-        texturePyramid.Bind();
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(2.5f, 0.0f, -5.0f));
-        Model = glm::scale(Model, glm::vec3(1.46f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidOfKhufuVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(0.0f, 0.0f, 0.0f));
-        Model = glm::scale(Model, glm::vec3(1.47f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidOfKhafreVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(-1.0f, 0.0f, 3.0f));
-        Model = glm::scale(Model, glm::vec3(0.65f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidOfMenkaureVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-
-        texturegoldPyramidTop.Bind();
-        float pulse = (sin(glfwGetTime() * 0.6f) + 1.0f) / 4.0f;
-
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(2.5f, 2.065f, -5.0f));
-        Model = glm::scale(Model, glm::vec3(0.084f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidTopVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-        AlmightyShader.SetUniform3f("uPointLightKhufu.Position", glm::vec3(2.5f, 2.065f, -5.0f));
-    	AlmightyShader.SetUniform3f("uPointLightKhufu.Ka", glm::vec3(212.0f/255.0f * pulse, 175.0f/255.0f * pulse, 55.0f/255.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightKhufu.Kd", glm::vec3(255.0f/255.0f * pulse, 215.0f/255.0f * pulse, 0.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightKhufu.Ks", glm::vec3(1.0f));
-
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(0.0f, 2.08f, 0.0f));
-        Model = glm::scale(Model, glm::vec3(0.084f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidTopVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-        AlmightyShader.SetUniform3f("uPointLightKhafre.Position", glm::vec3(0.0f, 2.08f, 0.0f));
-        AlmightyShader.SetUniform3f("uPointLightKhafre.Ka", glm::vec3(212.0f/255.0f * pulse, 175.0f/255.0f * pulse, 55.0f/255.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightKhafre.Kd", glm::vec3(255.0f/255.0f * pulse, 215.0f/255.0f * pulse, 0.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightKhafre.Ks", glm::vec3(1.0f));
-
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, glm::vec3(-1.0f, 0.85f, 3.0f));
-        Model = glm::scale(Model, glm::vec3(0.084f));
-        Model = glm::rotate(Model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        glBindVertexArray(PyramidTopVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)PyramidVertices.size() / vertexLength);
-        AlmightyShader.SetUniform3f("uPointLightMenkaure.Position", glm::vec3(-1.0f, 0.85f, 3.0f));
-        AlmightyShader.SetUniform3f("uPointLightMenkaure.Ka", glm::vec3(212.0f/255.0f * pulse, 175.0f/255.0f * pulse, 55.0f/255.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightMenkaure.Kd", glm::vec3(255.0f/255.0f * pulse, 215.0f/255.0f * pulse, 0.0f * pulse));
-	    AlmightyShader.SetUniform3f("uPointLightMenkaure.Ks", glm::vec3(1.0f));
-
-        glm::vec3 rugPosition = glm::vec3(0.0f + x, 0.3 * cos(glfwGetTime()) + y, 2.5f + z);
-        AlmightyShader.SetUniform3f("uSpotlight.Position", moonTranslation);
-        AlmightyShader.SetUniform3f("uSpotlight.Direction", rugPosition-moonTranslation);
-        Model = glm::mat4(1.0f);
-    	Model = glm::translate(Model, rugPosition);
-        Model = glm::rotate(Model, glm::radians(5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        Rug.Render();
-
-        Model = glm::mat4(1.0f);
-        Model = glm::translate(Model, glm::vec3(-0.3f, 0.0f, 3.7f));
-        Model = glm::rotate(Model, glm::radians(3.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        AlmightyShader.SetModel(Model);
-        Pharaoh.Render();
-
-        Model = glm::mat4(1.0f);
-        Model = glm::translate(Model, moonTranslation);
-        AlmightyShader.SetModel(Model);
-        Moon.Render();
-
+        float ProjectionScale = Projection[1][1] * WindowHeight * 0.5f;
+
+        Frame.Lights = Snap.Lights;
+        Frame.Camera.Projection = Projection;
+        Frame.Camera.View = FreeView;
+        Frame.Camera.ViewPosition = glm::vec4(CameraPosition, 1.0f);
+        Frame.Upload();
+        Capture.BeginFrame(Frame);
+
+        Phase.Next("Visibility");
+        glm::mat4 ViewProjection = Projection * FreeView;
+        Occlusion.BeginFrame(ViewProjection, CameraPosition);
+        Occlusion.SetShowBounds(ShowOcclusionBounds);
+
+        glm::vec3 RugMin, RugMax, PharaohMin, PharaohMax, MoonMin, MoonMax;
+        Rug.GetWorldBounds(Snap.GetWorld(Nodes.Rug), RugMin, RugMax);
+        Pharaoh.GetWorldBounds(Snap.GetWorld(Nodes.Pharaoh), PharaohMin, PharaohMax);
+        Moon.GetWorldBounds(Snap.GetWorld(Nodes.Moon), MoonMin, MoonMax);
+        bool RugVisible = Occlusion.IsVisible(RugMin, RugMax);
+        bool PharaohVisible = Occlusion.IsVisible(PharaohMin, PharaohMax);
+        bool MoonVisible = Occlusion.IsVisible(MoonMin, MoonMax);
+
+        // NOTE: Meshlet culling runs on jobs while terrain and pyramids are drawn
+        if (RugVisible) {
+            Rug.SelectLod(Snap.GetWorld(Nodes.Rug), CameraPosition, ProjectionScale);
+            Rug.SubmitCulling(Culler, Snap.GetWorld(Nodes.Rug), ViewProjection, CameraPosition);
+            Rug.RequestTextures(Streamer, Snap.GetWorld(Nodes.Rug), CameraPosition, ProjectionScale);
+        }
+        if (PharaohVisible) {
+            Pharaoh.SelectLod(Snap.GetWorld(Nodes.Pharaoh), CameraPosition, ProjectionScale);
+            Pharaoh.SubmitCulling(Culler, Snap.GetWorld(Nodes.Pharaoh), ViewProjection, CameraPosition);
+            Pharaoh.RequestTextures(Streamer, Snap.GetWorld(Nodes.Pharaoh), CameraPosition, ProjectionScale);
+        }
+        if (MoonVisible) {
+            Moon.SelectLod(Snap.GetWorld(Nodes.Moon), CameraPosition, ProjectionScale);
+            Moon.SubmitCulling(Culler, Snap.GetWorld(Nodes.Moon), ViewProjection, CameraPosition);
+            Moon.RequestTextures(Streamer, Snap.GetWorld(Nodes.Moon), CameraPosition, ProjectionScale);
+        }
+        Culler.Kick();
+        Streamer.Update();
+
+        // NOTE: Visibility tests stay on the GL thread, the pyramid draws are
+        // recorded on a job while the desert renders
+        bool PyramidVisible[PyramidCount];
+        glm::vec3 PyramidBoundsMin[PyramidCount], PyramidBoundsMax[PyramidCount];
+        for (unsigned PyramidIdx = 0; PyramidIdx < PyramidCount; ++PyramidIdx) {
+            PyramidVisible[PyramidIdx] = testOcclusion(Occlusion, Snap.GetWorld(PyramidNodes[PyramidIdx]), PyramidMin, PyramidMax,
+                                                       PyramidBoundsMin[PyramidIdx], PyramidBoundsMax[PyramidIdx]);
+        }
+        JobCounter Recording;
+        Jobs::Run([&]() {
+            TRACE_ZONE("Record pyramids");
+            PyramidCommands.Reset();
+            for (unsigned PyramidIdx = 0; PyramidIdx < PyramidCount; ++PyramidIdx) {
+                // NOTE: The first three are the pyramids, the rest their capstones
+                if (PyramidIdx == 0)
+                    PyramidCommands.BindTexture(0, TEXTURE_TARGET_2D, texturePyramid.GetRendererID());
+                if (PyramidIdx == 3)
+                    PyramidCommands.BindTexture(0, TEXTURE_TARGET_2D, texturegoldPyramidTop.GetRendererID());
+                if (PyramidVisible[PyramidIdx])
+                    recordPyramid(PyramidCommands, SceneShaders, Frame, Snap.GetWorld(PyramidNodes[PyramidIdx]), Snap.GetNormal(PyramidNodes[PyramidIdx]), PyramidVAOs[PyramidIdx], PyramidVertexCount);
+            }
+        }, &Recording);
+
+        Phase.Next("Desert");
+        Desert.Update(CameraPosition, ViewProjection, &Occlusion);
+        DesertCommands.Reset();
+        DesertCommands.BindTexture(0, TEXTURE_TARGET_2D, textureSand.GetRendererID());
+        DesertCommands.BindTexture(1, TEXTURE_TARGET_2D, textureSandSpecular.GetRendererID());
+        recordSceneVariant(DesertCommands, SceneShaders, Frame, SHADER_HAS_SPECULAR, glm::mat4(1.0f), glm::mat3(1.0f), CameraPosition, RenderDistance);
+        Desert.Record(DesertCommands);
+        DesertCommands.BindTexture(1, TEXTURE_TARGET_2D, 0);
+        Capture.Capture(DesertCommands);
+        DesertCommands.Execute(Frame);
+
+        Phase.Next("Pyramids");
+        Jobs::Wait(Recording);
+        Capture.Capture(PyramidCommands);
+        PyramidCommands.Execute(Frame);
+
+        // NOTE: Models that passed the depth pyramid test are still drawn
+        // conditionally on a query against this frame's depth. Each model is
+        // recorded on its own job, the query proxy goes in front of it
+        Phase.Next("Models");
+        Culler.Wait();
+        Jobs::Run([&]() {
+            TRACE_ZONE("Record rug");
+            RugCommands.Reset();
+            if (RugVisible) {
+                bool Conditional = Occlusion.RecordConditional(RugCommands, RugQuery, RugMin, RugMax);
+                recordModel(RugCommands, Rug, SceneShaders, Frame, Snap.GetWorld(Nodes.Rug), Snap.GetNormal(Nodes.Rug), RugMin, RugMax);
+                if (Conditional)
+                    RugCommands.EndConditional();
+            }
+        }, &Recording);
+        Jobs::Run([&]() {
+            TRACE_ZONE("Record pharaoh");
+            PharaohCommands.Reset();
+            if (PharaohVisible) {
+                bool Conditional = Occlusion.RecordConditional(PharaohCommands, PharaohQuery, PharaohMin, PharaohMax);
+                recordModel(PharaohCommands, Pharaoh, SceneShaders, Frame, Snap.GetWorld(Nodes.Pharaoh), Snap.GetNormal(Nodes.Pharaoh), PharaohMin, PharaohMax);
+                if (Conditional)
+                    PharaohCommands.EndConditional();
+            }
+        }, &Recording);
+        Jobs::Run([&]() {
+            TRACE_ZONE("Record moon");
+            MoonCommands.Reset();
+            if (MoonVisible) {
+                bool Conditional = Occlusion.RecordConditional(MoonCommands, MoonQuery, MoonMin, MoonMax);
+                recordModel(MoonCommands, Moon, SceneShaders, Frame, Snap.GetWorld(Nodes.Moon), Snap.GetNormal(Nodes.Moon), MoonMin, MoonMax);
+                if (Conditional)
+                    MoonCommands.EndConditional();
+            }
+        }, &Recording);
+        Jobs::Wait(Recording);
+
+        Capture.Capture(RugCommands);
+        RugCommands.Execute(Frame);
+        Capture.Capture(PharaohCommands);
+        PharaohCommands.Execute(Frame);
+        Capture.Capture(MoonCommands);
+        MoonCommands.Execute(Frame);
+        Occlusion.CaptureDepth();
+        // NOTE: After the capture, the boxes would otherwise occlude next frame
+        BoundsCommands.Reset();
+        Occlusion.RecordBounds(BoundsCommands, RugMin, RugMax, RugVisible);
+        Occlusion.RecordBounds(BoundsCommands, PharaohMin, PharaohMax, PharaohVisible);
+        Occlusion.RecordBounds(BoundsCommands, MoonMin, MoonMax, MoonVisible);
+        for (unsigned PyramidIdx = 0; PyramidIdx < PyramidCount; ++PyramidIdx) {
+            Occlusion.RecordBounds(BoundsCommands, PyramidBoundsMin[PyramidIdx], PyramidBoundsMax[PyramidIdx], PyramidVisible[PyramidIdx]);
+        }
+        Capture.Capture(BoundsCommands);
+        BoundsCommands.Execute(Frame);
+
+        Phase.Next("Sky");
+        SkyCommands.Reset();
+        Sky.Record(SkyCommands);
+        Capture.Capture(SkyCommands);
+        SkyCommands.Execute(Frame);
+
+        Phase.Next("Particles");
+        // NOTE: Playback steps the sand with the simulation so every run draws
+        // the same particles
+        BlowingSand.Update(PlayPath ? Snap.Dt : dt);
+        ParticleCommands.Reset();
+        BlowingSand.Record(ParticleCommands);
+        Capture.Capture(ParticleCommands);
+        ParticleCommands.Execute(Frame);
+
+        Phase.Next("Swap");
         glUseProgram(0);
+        Frame.EndFrame();
+        Capture.EndFrame();
         glfwSwapBuffers(Window);
+        if (Perf.IsRunning()) {
+            Perf.EndFrame();
+            if (Perf.IsDone())
+                glfwSetWindowShouldClose(Window, true);
+        }
+        // NOTE: Culling jobs were waited on above, nothing uses the arenas now
+        FrameMemory::EndFrame();
 
+        Phase.Next("Frame pacing");
         FrameEndTime = (float)glfwGetTime();
         dt = FrameEndTime - FrameStartTime;
-        if (dt < TargetFPS) {
+        if (dt < TargetFPS && !Perf.IsRunning()) {
             int DeltaMS = (int)((TargetFrameTime - dt) * 1e3f);
             std::this_thread::sleep_for(std::chrono::milliseconds(DeltaMS));
             FrameEndTime = (float)glfwGetTime();
@@ -587,6 +1333,14 @@ int main() {
         dt = FrameEndTime - FrameStartTime;
     }
 
-    glfwTerminate();
-    return 0;
+    int Result = Perf.IsRunning() ? Perf.Finish() : 0;
+    GpuMemory::DeleteVertexArray(PyramidOfKhafreVAO);
+    GpuMemory::DeleteBuffer(PyramidOfKhafreVBO);
+    GpuMemory::DeleteVertexArray(PyramidOfMenkaureVAO);
+    GpuMemory::DeleteBuffer(PyramidOfMenkaureVBO);
+    GpuMemory::DeleteVertexArray(PyramidOfKhufuVAO);
+    GpuMemory::DeleteBuffer(PyramidOfKhufuVBO);
+    GpuMemory::DeleteVertexArray(PyramidTopVAO);
+    GpuMemory::DeleteBuffer(PyramidTopVBO);
+    return Result;
 }
@@ -1,7 +1,56 @@
 #include "mesh.hpp"
+#include "simplify.hpp"
+#include "frustum.hpp"
 
-Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string &resPath) {
-    processMesh(mesh, material, resPath);
+#include <algorithm>
+
+// NOTE: Import runs one Build per job, each thread reuses its own buffers
+// across meshes instead of allocating them per mesh
+struct ImportScratch {
+    std::vector<unsigned> Ordered;
+    std::vector<unsigned> Previous;
+    std::vector<unsigned> Simplified;
+};
+
+static thread_local ImportScratch Scratch;
+
+/**
+ * @brief Largest index count a LOD level may have and still be kept, levels
+ * that simplify less than this end the chain
+ *
+ */
+static size_t
+lodLimit(size_t previousCount) {
+    return previousCount * 9 / 10;
+}
+
+Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string &resPath, TextureStreamer* streamer, TextureArrays* arrays)
+    : Mesh() {
+    Build(mesh);
+    Upload(mesh, material, resPath, streamer, arrays);
+}
+
+Mesh::Mesh()
+    : mVertexCount(0),
+      mIndexCount(0),
+      mOwnsTextures(true),
+      mDiffuseHasAlpha(false),
+      mCurrentLod(0),
+      mBoundsCenter(0.0f),
+      mBoundsRadius(0.0f),
+      mCullValid(false) {
+    mDiffuseSlice.Pool = mSpecularSlice.Pool = TEXTURE_SLICE_NONE;
+    mDiffuseSlice.Layer = mSpecularSlice.Layer = 0;
+}
+
+Mesh::~Mesh() {
+    GpuMemory::DeleteVertexArray(mVAO.Get());
+    GpuMemory::DeleteBuffer(mVBO.Get());
+    GpuMemory::DeleteBuffer(mEBO.Get());
+    if (mOwnsTextures) {
+        GpuMemory::DeleteTexture(mDiffuseTexture.Get());
+        GpuMemory::DeleteTexture(mSpecularTexture.Get());
+    }
 }
 
 void
@@ -18,9 +67,19 @@ Mesh::Render() const {
         glBindTexture(GL_TEXTURE_2D, mSpecularTexture);
     }
 
+    if (mIndexCount && mCullValid && mCurrentLod == 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+        if (!mDrawCounts.empty()) {
+            glMultiDrawElements(GL_TRIANGLES, mDrawCounts.data(), GL_UNSIGNED_INT, mDrawOffsets.data(), (GLsizei)mDrawCounts.size());
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        return;
+    }
+
     if (mIndexCount) {
+        const MeshLod& Lod = mLods[mCurrentLod];
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, (void*)0);
+        glDrawElements(GL_TRIANGLES, Lod.IndexCount, GL_UNSIGNED_INT, (void*)(Lod.IndexOffset * sizeof(unsigned)));
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         return;
     }
@@ -29,65 +88,264 @@ Mesh::Render() const {
     glBindVertexArray(0);
 }
 
+void
+Mesh::Record(CommandBuffer& commands) const {
+    commands.BindVertexArray(mVAO);
+
+    if (mDiffuseTexture) {
+        commands.BindTexture(0, TEXTURE_TARGET_2D, mDiffuseTexture);
+    }
+
+    if (mSpecularTexture) {
+        commands.BindTexture(1, TEXTURE_TARGET_2D, mSpecularTexture);
+    }
+
+    if (mIndexCount && mCullValid && mCurrentLod == 0) {
+        commands.BindIndexBuffer(mEBO);
+        commands.MultiDrawIndexed(mDrawCounts.data(), mDrawOffsets.data(), 0, (unsigned)mDrawCounts.size());
+        commands.BindIndexBuffer(0);
+        return;
+    }
+
+    if (mIndexCount) {
+        const MeshLod& Lod = mLods[mCurrentLod];
+        commands.BindIndexBuffer(mEBO);
+        commands.DrawIndexed(Lod.IndexCount, Lod.IndexOffset * sizeof(unsigned));
+        commands.BindIndexBuffer(0);
+        return;
+    }
+
+    commands.Draw(0, mVertexCount);
+    commands.BindVertexArray(0);
+}
+
+void
+Mesh::AppendDraws(unsigned indexBase, GLint baseVertex, std::vector<GLsizei>& counts, std::vector<const void*>& offsets, std::vector<GLint>& baseVertices) const {
+    if (!mIndexCount) {
+        return;
+    }
+
+    size_t Base = indexBase * sizeof(unsigned);
+    if (mCullValid && mCurrentLod == 0) {
+        for (unsigned DrawIdx = 0; DrawIdx < mDrawCounts.size(); ++DrawIdx) {
+            counts.push_back(mDrawCounts[DrawIdx]);
+            offsets.push_back((const void*)(Base + (size_t)mDrawOffsets[DrawIdx]));
+            baseVertices.push_back(baseVertex);
+        }
+        return;
+    }
+
+    const MeshLod& Lod = mLods[mCurrentLod];
+    counts.push_back(Lod.IndexCount);
+    offsets.push_back((const void*)(Base + Lod.IndexOffset * sizeof(unsigned)));
+    baseVertices.push_back(baseVertex);
+}
+
+void
+Mesh::SelectLod(float pixelsPerUnit, float pixelThreshold) {
+    if (mLods.empty()) {
+        return;
+    }
+
+    unsigned Lod = mCurrentLod;
+    while (Lod > 0 && mLods[Lod].Error * pixelsPerUnit > pixelThreshold * (1.0f + LOD_HYSTERESIS)) {
+        --Lod;
+    }
+    while (Lod + 1 < mLods.size() && mLods[Lod + 1].Error * pixelsPerUnit < pixelThreshold * (1.0f - LOD_HYSTERESIS)) {
+        ++Lod;
+    }
+    mCurrentLod = Lod;
+}
+
+unsigned
+Mesh::CullMeshlets(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    mDrawCounts.clear();
+    mDrawOffsets.clear();
+    if (mMeshlets.empty() || mCurrentLod != 0) {
+        mCullValid = false;
+        return 0;
+    }
+
+    // NOTE: Culling in object space avoids transforming every bounding sphere
+    Frustum ObjectFrustum(viewProjection * model);
+    glm::vec3 ObjectCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+    unsigned VisibleIndices = 0;
+    for (unsigned MeshletIdx = 0; MeshletIdx < mMeshlets.size(); ++MeshletIdx) {
+        const Meshlet& Current = mMeshlets[MeshletIdx];
+        if (!ObjectFrustum.IntersectsSphere(Current.Center, Current.Radius) || Meshlets::IsBackfacing(Current, ObjectCamera)) {
+            continue;
+        }
+
+        // NOTE: Neighbouring visible meshlets are contiguous, merge their ranges
+        const void* Offset = (const void*)(Current.IndexOffset * sizeof(unsigned));
+        if (!mDrawCounts.empty() && (const char*)mDrawOffsets.back() + mDrawCounts.back() * sizeof(unsigned) == Offset) {
+            mDrawCounts.back() += Current.IndexCount;
+        } else {
+            mDrawCounts.push_back(Current.IndexCount);
+            mDrawOffsets.push_back(Offset);
+        }
+        VisibleIndices += Current.IndexCount;
+    }
+    mCullValid = true;
+    return VisibleIndices / 3;
+}
+
 unsigned
-Mesh::loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type) {
+Mesh::loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type, TextureStreamer* streamer, int* channels) {
     if (material && material->GetTextureCount(type) > 0) {
         aiString Path;
         if (material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
             std::string FullPath = resPath + "/" + Path.data;
-            Texture texture = Texture(FullPath);
-            return texture.GetRendererID();
+            if (streamer) {
+                return streamer->Load(FullPath, channels);
+            }
+            Texture MeshTexture(FullPath);
+            if (channels) {
+                *channels = MeshTexture.GetChannels();
+            }
+            return MeshTexture.Release();
         }
     }
 
     return 0;
 }
 
+TextureSlice
+Mesh::loadMeshSlice(const aiMaterial* material, const std::string& resPath, aiTextureType type, TextureArrays& arrays, int* channels) {
+    TextureSlice Slice = { TEXTURE_SLICE_NONE, 0 };
+    if (material && material->GetTextureCount(type) > 0) {
+        aiString Path;
+        if (material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
+            Slice = arrays.Add(resPath + "/" + Path.data, channels);
+        }
+    }
+
+    return Slice;
+}
+
 void
-Mesh::processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath) {
+Mesh::Build(const aiMesh* mesh) {
     const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    const bool HasTexCoords = mesh->HasTextureCoords(0);
 
-    for (unsigned VertexIndex = 0; VertexIndex < mesh->mNumVertices; ++VertexIndex) {
-        std::vector<float> Position = { mesh->mVertices[VertexIndex].x, mesh->mVertices[VertexIndex].y, mesh->mVertices[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Position.begin(), Position.end());
-        std::vector<float> Normals = { mesh->mNormals[VertexIndex].x, mesh->mNormals[VertexIndex].y, mesh->mNormals[VertexIndex].z };
-        mVertices.insert(mVertices.end(), Normals.begin(), Normals.end());
-        const aiVector3D* TexCoords = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][VertexIndex]) : &Zero3D;
-        std::vector<float> UV = { TexCoords->x, TexCoords->y };
-        mVertices.insert(mVertices.end(), UV.begin(), UV.end());
+    // NOTE: Sized once and written in place, no per-vertex allocations
+    mVertices.resize((size_t)mesh->mNumVertices * 8);
+    float* Vertex = mVertices.data();
+    for (unsigned VertexIndex = 0; VertexIndex < mesh->mNumVertices; ++VertexIndex, Vertex += 8) {
+        const aiVector3D& Position = mesh->mVertices[VertexIndex];
+        const aiVector3D& Normal = mesh->mNormals[VertexIndex];
+        const aiVector3D& TexCoords = HasTexCoords ? mesh->mTextureCoords[0][VertexIndex] : Zero3D;
+        Vertex[0] = Position.x;
+        Vertex[1] = Position.y;
+        Vertex[2] = Position.z;
+        Vertex[3] = Normal.x;
+        Vertex[4] = Normal.y;
+        Vertex[5] = Normal.z;
+        Vertex[6] = TexCoords.x;
+        Vertex[7] = TexCoords.y;
     }
 
-    for (unsigned FaceIndex = 0; FaceIndex < mesh->mNumFaces; ++FaceIndex) {
+    // NOTE: Room for the LOD chain too, sized for every level hitting lodLimit
+    size_t Reserved = 0;
+    for (size_t Level = 0, Count = (size_t)mesh->mNumFaces * 3; Level < LOD_MAX_LEVELS; ++Level, Count = lodLimit(Count)) {
+        Reserved += Count;
+    }
+    mIndices.reserve(Reserved);
+    mIndices.resize((size_t)mesh->mNumFaces * 3);
+    unsigned* Index = mIndices.data();
+    for (unsigned FaceIndex = 0; FaceIndex < mesh->mNumFaces; ++FaceIndex, Index += 3) {
         const aiFace& Face = mesh->mFaces[FaceIndex];
-        mIndices.push_back(Face.mIndices[0]);
-        mIndices.push_back(Face.mIndices[1]);
-        mIndices.push_back(Face.mIndices[2]);
+        Index[0] = Face.mIndices[0];
+        Index[1] = Face.mIndices[1];
+        Index[2] = Face.mIndices[2];
     }
 
-    mVertexCount = mVertices.size() / 6;
-    mIndexCount = mIndices.size();
+    mVertexCount = mesh->mNumVertices;
+    mIndexCount = (unsigned)mIndices.size();
+
+    glm::vec3 Min(1e30f), Max(-1e30f);
+    for (unsigned VertexIndex = 0; VertexIndex < mVertexCount; ++VertexIndex) {
+        glm::vec3 Position(mVertices[VertexIndex * 8], mVertices[VertexIndex * 8 + 1], mVertices[VertexIndex * 8 + 2]);
+        Min = glm::min(Min, Position);
+        Max = glm::max(Max, Position);
+    }
+    mBoundsCenter = (Min + Max) * 0.5f;
+    mBoundsRadius = mVertexCount ? glm::length(Max - mBoundsCenter) : 0.0f;
 
-    mDiffuseTexture = loadMeshTexture(material, resPath, aiTextureType_DIFFUSE);
-    mSpecularTexture = loadMeshTexture(material, resPath, aiTextureType_SPECULAR);
+    if (mIndexCount / 3 >= MESHLET_MIN_TRIANGLES) {
+        std::vector<unsigned>& Ordered = Scratch.Ordered;
+        Meshlets::Build(mVertices.data(), mVertexCount, 8, mIndices, mMeshlets, Ordered);
+        // NOTE: Copied back rather than swapped so mIndices keeps its reserve
+        std::copy(Ordered.begin(), Ordered.end(), mIndices.begin());
+    }
+
+    buildLods();
+}
+
+void
+Mesh::Upload(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, TextureStreamer* streamer, TextureArrays* arrays) {
+    mOwnsTextures = streamer == 0;
+    int DiffuseChannels = 0;
+    if (arrays) {
+        mDiffuseSlice = loadMeshSlice(material, resPath, aiTextureType_DIFFUSE, *arrays, &DiffuseChannels);
+        mSpecularSlice = loadMeshSlice(material, resPath, aiTextureType_SPECULAR, *arrays);
+    } else {
+        mDiffuseTexture = loadMeshTexture(material, resPath, aiTextureType_DIFFUSE, streamer, &DiffuseChannels);
+        mSpecularTexture = loadMeshTexture(material, resPath, aiTextureType_SPECULAR, streamer);
+    }
+    mDiffuseHasAlpha = DiffuseChannels == 4;
 
-    glGenVertexArrays(1, &mVAO);
+    std::string Owner = resPath + "/" + mesh->mName.C_Str();
+    mVAO = GpuMemory::CreateVertexArray(Owner);
     glBindVertexArray(mVAO);
-    glGenBuffers(1, &mVBO);
+    mVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, Owner);
     glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
+    GpuMemory::BufferData(mVBO, GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     
     if (mIndexCount) {
-        glGenBuffers(1, &mEBO);
+        mEBO = GpuMemory::CreateBuffer(GPU_INDEX_BUFFER, Owner);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndexCount * sizeof(float), mIndices.data(), GL_STATIC_DRAW);
+        GpuMemory::BufferData(mEBO, GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned), mIndices.data(), GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     glBindVertexArray(0);
+}
+
+void
+Mesh::buildLods() {
+    mLods.clear();
+    mLods.reserve(LOD_MAX_LEVELS);
+    mLods.push_back({ 0, mIndexCount, 0.0f });
+    if (!mIndexCount) {
+        return;
+    }
+
+    std::vector<unsigned>& Previous = Scratch.Previous;
+    std::vector<unsigned>& Simplified = Scratch.Simplified;
+    Previous.assign(mIndices.begin(), mIndices.end());
+    for (unsigned Level = 1; Level < LOD_MAX_LEVELS; ++Level) {
+        unsigned Target = (unsigned)(Previous.size() / 2) / 3 * 3;
+        float Error = Simplifier::Simplify(mVertices.data(), mVertexCount, 8, Previous, Target, Simplified);
+
+        // NOTE: Stop once simplification stalls on locked borders and seams
+        if (Simplified.size() > lodLimit(Previous.size())) {
+            break;
+        }
+
+        MeshLod Lod;
+        Lod.IndexOffset = (unsigned)mIndices.size();
+        Lod.IndexCount = (unsigned)Simplified.size();
+        Lod.Error = std::max(Error, mLods.back().Error);
+        mLods.push_back(Lod);
+        mIndices.insert(mIndices.end(), Simplified.begin(), Simplified.end());
+        Previous.swap(Simplified);
+    }
 }
\ No newline at end of file
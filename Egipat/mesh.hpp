@@ -15,10 +15,35 @@
 #include<vector>
 #include <GL/glew.h>
 #include <iostream>
+#include <glm/glm.hpp>
+#include "commandbuffer.hpp"
 #include "texture.hpp"
+#include "meshlet.hpp"
+#include "texturestreamer.hpp"
+#include "texturearray.hpp"
+#include "gpumemory.hpp"
+
+#define LOD_MAX_LEVELS 4
+#define LOD_HYSTERESIS 0.25f
+// NOTE: Smaller meshes are cheaper to draw whole than to cull per cluster
+#define MESHLET_MIN_TRIANGLES 512
+// NOTE: Vertices, indices with room for the LOD chain, the LOD table and the
+// meshlets. Build sizes each once, everything else reuses per-thread scratch
+#define MESH_BUILD_ALLOCATIONS 4
+
+/**
+ * @brief Range of one level of detail inside the shared index buffer
+ *
+ */
+struct MeshLod {
+    unsigned IndexOffset;
+    unsigned IndexCount;
+    float Error;
+};
 
 class Mesh {
 public:
+    // NOTE: Index lists of all levels of detail, finest first. See mLods
     std::vector<unsigned> mIndices;
     std::vector<float> mVertices;
 
@@ -28,9 +53,47 @@ public:
      * @param mesh - Assimp mesh
      * @param MeshMaterial - Assimp material
      * @param resPath - Resource relative path. For loading textures, etc...
+     * @param streamer - Streams the material textures by mip level, optional
+     * @param arrays - Pools the material textures into texture arrays instead, optional
      * 
      */
-    Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, TextureStreamer* streamer = 0, TextureArrays* arrays = 0);
+
+    /**
+     * @brief Ctor - empty mesh, filled in by Build and then Upload
+     *
+     */
+    Mesh();
+
+    /**
+     * @brief Copies geometry out of Assimp and builds meshlets and levels of
+     * detail. Touches no GL state, so meshes can be built on jobs
+     *
+     * @param mesh - Assimp mesh
+     */
+    void Build(const aiMesh* mesh);
+
+    /**
+     * @brief Loads the material textures and buffers the built geometry. GL thread only
+     *
+     * @param mesh - Assimp mesh passed to Build
+     * @param material - Assimp material
+     * @param resPath - Resource relative path. For loading textures, etc...
+     * @param streamer - Streams the material textures by mip level, optional
+     * @param arrays - Pools the material textures into texture arrays instead, optional
+     */
+    void Upload(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath, TextureStreamer* streamer = 0, TextureArrays* arrays = 0);
+
+    /**
+     * @brief Dtor - deletes the buffers and the textures the mesh owns
+     *
+     */
+    ~Mesh();
+
+    // NOTE: Meshes own GL objects, they can only be moved
+    Mesh(Mesh&& other) = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
 
     /**
      * @brief Renders the current mesh
@@ -38,14 +101,93 @@ public:
      */
     void Render() const;
 
+    /**
+     * @brief Records what Render would draw. Touches no GL state
+     *
+     * @param commands - Command buffer
+     */
+    void Record(CommandBuffer& commands) const;
+
+    /**
+     * @brief Picks the coarsest level whose projected error stays under the
+     * threshold. Hysteresis keeps the current level near the switch distance
+     *
+     * @param pixelsPerUnit - Screen pixels covered by one object space unit at the mesh's distance
+     * @param pixelThreshold - Largest acceptable error in pixels
+     */
+    void SelectLod(float pixelsPerUnit, float pixelThreshold);
+
+    const glm::vec3& GetBoundsCenter() const { return mBoundsCenter; }
+    float GetBoundsRadius() const { return mBoundsRadius; }
+    unsigned GetLodCount() const { return (unsigned)mLods.size(); }
+    const MeshLod& GetLod(unsigned level) const { return mLods[level]; }
+    unsigned GetVertexCount() const { return mVertexCount; }
+    unsigned GetCurrentLod() const { return mCurrentLod; }
+
+    /**
+     * @brief Builds the draw list of meshlets that survive frustum and
+     * backface cone culling. Safe to call off the main thread. Only applies
+     * while the finest level of detail is selected
+     *
+     * @param model - Model matrix the mesh will be rendered with
+     * @param viewProjection - Projection * View
+     * @param cameraPosition - Camera position in world space
+     *
+     * @returns Visible triangle count
+     */
+    unsigned CullMeshlets(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+    /**
+     * @brief Appends the ranges Render would draw to a multi-draw list whose
+     * index buffer holds this mesh's indices at indexBase
+     *
+     * @param indexBase - First index of this mesh in the shared index buffer
+     * @param baseVertex - First vertex of this mesh in the shared vertex buffer
+     * @param counts - Index counts
+     * @param offsets - Byte offsets into the shared index buffer
+     * @param baseVertices - Base vertex of every range
+     */
+    void AppendDraws(unsigned indexBase, GLint baseVertex, std::vector<GLsizei>& counts, std::vector<const void*>& offsets, std::vector<GLint>& baseVertices) const;
+
+    /**
+     * @brief Drops the culled draw list, the next Render draws the whole level
+     *
+     */
+    void ResetCulling() { mCullValid = false; }
+
+    bool HasSpecularMap() const { return mSpecularTexture != 0 || mSpecularSlice.Pool != TEXTURE_SLICE_NONE; }
+    bool HasAlphaMap() const { return mDiffuseHasAlpha; }
+    unsigned GetDiffuseTexture() const { return mDiffuseTexture; }
+    unsigned GetSpecularTexture() const { return mSpecularTexture; }
+    const TextureSlice& GetDiffuseSlice() const { return mDiffuseSlice; }
+    const TextureSlice& GetSpecularSlice() const { return mSpecularSlice; }
+
+    unsigned GetMeshletCount() const { return (unsigned)mMeshlets.size(); }
+    unsigned GetMeshletTriangleCount() const { return mMeshlets.empty() || mCurrentLod ? 0 : mLods[0].IndexCount / 3; }
+
 private:
-    unsigned mVAO;
-    unsigned mVBO;
-    unsigned mEBO;
+    GpuHandle mVAO;
+    GpuHandle mVBO;
+    GpuHandle mEBO;
     unsigned mVertexCount;
     unsigned mIndexCount;
-    unsigned mDiffuseTexture;
-    unsigned mSpecularTexture;
-    unsigned loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type);
-    void processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
+    GpuHandle mDiffuseTexture;
+    GpuHandle mSpecularTexture;
+    // NOTE: Streamed textures belong to the TextureStreamer
+    bool mOwnsTextures;
+    TextureSlice mDiffuseSlice;
+    TextureSlice mSpecularSlice;
+    bool mDiffuseHasAlpha;
+    std::vector<MeshLod> mLods;
+    unsigned mCurrentLod;
+    glm::vec3 mBoundsCenter;
+    float mBoundsRadius;
+    // NOTE: Meshlets index into the finest level, which is stored in meshlet order
+    std::vector<Meshlet> mMeshlets;
+    std::vector<GLsizei> mDrawCounts;
+    std::vector<const void*> mDrawOffsets;
+    bool mCullValid;
+    void buildLods();
+    unsigned loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type, TextureStreamer* streamer, int* channels = 0);
+    TextureSlice loadMeshSlice(const aiMaterial* material, const std::string& resPath, aiTextureType type, TextureArrays& arrays, int* channels = 0);
 };
@@ -0,0 +1,258 @@
+#include "meshlet.hpp"
+#include "mesh.hpp"
+#include "framearena.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static const unsigned NotInMeshlet = 0xFFFFFFFF;
+
+// NOTE: Kept per thread and reused across meshes, buffers only grow
+struct BuildScratch {
+    std::vector<unsigned> AdjacencyStart;
+    std::vector<unsigned> Adjacency;
+    std::vector<unsigned> Fill;
+    std::vector<unsigned char> Emitted;
+    std::vector<unsigned> VertexMeshlet;
+    std::vector<unsigned> MeshletVertices;
+};
+
+static thread_local BuildScratch Scratch;
+
+static glm::vec3
+vertexPosition(const float* vertices, unsigned stride, unsigned index) {
+    const float* V = vertices + (size_t)index * stride;
+    return glm::vec3(V[0], V[1], V[2]);
+}
+
+static void
+computeBounds(const float* vertices, unsigned stride, const unsigned* indices, unsigned indexCount, Meshlet& meshlet) {
+    // NOTE: Ritter's sphere. Seed from an approximate diameter, then grow to
+    // cover the stragglers
+    glm::vec3 First = vertexPosition(vertices, stride, indices[0]);
+    glm::vec3 A = First;
+    float Best = -1.0f;
+    for (unsigned Idx = 0; Idx < indexCount; ++Idx) {
+        glm::vec3 P = vertexPosition(vertices, stride, indices[Idx]);
+        float Distance = glm::dot(P - First, P - First);
+        if (Distance > Best) {
+            Best = Distance;
+            A = P;
+        }
+    }
+    glm::vec3 B = A;
+    Best = -1.0f;
+    for (unsigned Idx = 0; Idx < indexCount; ++Idx) {
+        glm::vec3 P = vertexPosition(vertices, stride, indices[Idx]);
+        float Distance = glm::dot(P - A, P - A);
+        if (Distance > Best) {
+            Best = Distance;
+            B = P;
+        }
+    }
+
+    glm::vec3 Center = (A + B) * 0.5f;
+    float Radius = glm::length(B - A) * 0.5f;
+    for (unsigned Idx = 0; Idx < indexCount; ++Idx) {
+        glm::vec3 P = vertexPosition(vertices, stride, indices[Idx]);
+        float Distance = glm::length(P - Center);
+        if (Distance > Radius) {
+            float NewRadius = (Radius + Distance) * 0.5f;
+            Center += (P - Center) * ((NewRadius - Radius) / Distance);
+            Radius = NewRadius;
+        }
+    }
+    meshlet.Center = Center;
+    meshlet.Radius = Radius;
+
+    glm::vec3 AxisSum(0.0f);
+    // NOTE: Build never puts more than MESHLET_MAX_TRIANGLES in a meshlet
+    glm::vec3 Normals[MESHLET_MAX_TRIANGLES];
+    unsigned NormalCount = 0;
+    for (unsigned Idx = 0; Idx + 2 < indexCount; Idx += 3) {
+        glm::vec3 P0 = vertexPosition(vertices, stride, indices[Idx]);
+        glm::vec3 P1 = vertexPosition(vertices, stride, indices[Idx + 1]);
+        glm::vec3 P2 = vertexPosition(vertices, stride, indices[Idx + 2]);
+        glm::vec3 Normal = glm::cross(P1 - P0, P2 - P0);
+        float Length = glm::length(Normal);
+        if (Length > 0.0f) {
+            Normals[NormalCount] = Normal / Length;
+            AxisSum += Normals[NormalCount++];
+        }
+    }
+
+    meshlet.ConeAxis = glm::vec3(0.0f);
+    meshlet.ConeCutoff = 1.0f;
+    float AxisLength = glm::length(AxisSum);
+    if (!NormalCount || AxisLength <= 0.0f) {
+        return;
+    }
+
+    glm::vec3 Axis = AxisSum / AxisLength;
+    float MinDot = 1.0f;
+    for (unsigned Idx = 0; Idx < NormalCount; ++Idx) {
+        MinDot = std::min(MinDot, glm::dot(Axis, Normals[Idx]));
+    }
+    // NOTE: Cones wider than ~85 degrees almost never cull, don't bother
+    if (MinDot <= 0.1f) {
+        return;
+    }
+    meshlet.ConeAxis = Axis;
+    meshlet.ConeCutoff = std::sqrt(1.0f - MinDot * MinDot);
+}
+
+void
+Meshlets::Build(const float* vertices, unsigned vertexCount, unsigned stride,
+                const std::vector<unsigned>& indices,
+                std::vector<Meshlet>& meshlets, std::vector<unsigned>& meshletIndices) {
+    meshlets.clear();
+    meshletIndices.clear();
+    unsigned TriangleCount = (unsigned)indices.size() / 3;
+    if (!TriangleCount) {
+        return;
+    }
+
+    // NOTE: Vertex to triangle adjacency in compressed rows
+    std::vector<unsigned>& AdjacencyStart = Scratch.AdjacencyStart;
+    AdjacencyStart.assign(vertexCount + 1, 0);
+    for (unsigned Idx = 0; Idx < TriangleCount * 3; ++Idx) {
+        ++AdjacencyStart[indices[Idx] + 1];
+    }
+    for (unsigned Vertex = 0; Vertex < vertexCount; ++Vertex) {
+        AdjacencyStart[Vertex + 1] += AdjacencyStart[Vertex];
+    }
+    std::vector<unsigned>& Adjacency = Scratch.Adjacency;
+    Adjacency.resize(TriangleCount * 3);
+    std::vector<unsigned>& Fill = Scratch.Fill;
+    Fill.assign(AdjacencyStart.begin(), AdjacencyStart.end() - 1);
+    for (unsigned Idx = 0; Idx < TriangleCount * 3; ++Idx) {
+        Adjacency[Fill[indices[Idx]]++] = Idx / 3;
+    }
+
+    std::vector<unsigned char>& Emitted = Scratch.Emitted;
+    Emitted.assign(TriangleCount, 0);
+    std::vector<unsigned>& VertexMeshlet = Scratch.VertexMeshlet;
+    VertexMeshlet.assign(vertexCount, NotInMeshlet);
+    std::vector<unsigned>& MeshletVertices = Scratch.MeshletVertices;
+    MeshletVertices.clear();
+    MeshletVertices.reserve(MESHLET_MAX_VERTICES);
+    meshletIndices.reserve(TriangleCount * 3);
+    // NOTE: Upper bound. A triangle adds at most 3 vertices, so a meshlet only
+    // closes on the vertex limit once it holds MESHLET_MAX_VERTICES / 3 of them
+    const unsigned MinTriangles = std::min(MESHLET_MAX_VERTICES / 3, MESHLET_MAX_TRIANGLES);
+    meshlets.reserve((TriangleCount + MinTriangles - 1) / MinTriangles);
+
+    Meshlet Current = { 0, 0, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f };
+    unsigned Cursor = 0;
+    unsigned EmittedCount = 0;
+    while (EmittedCount < TriangleCount) {
+        unsigned MeshletIdx = (unsigned)meshlets.size();
+
+        // NOTE: Grow from the triangle sharing the most vertices with the cluster
+        unsigned Candidate = NotInMeshlet;
+        unsigned CandidateNew = 4;
+        for (unsigned VertexIdx = 0; VertexIdx < MeshletVertices.size() && CandidateNew > 0; ++VertexIdx) {
+            unsigned Vertex = MeshletVertices[VertexIdx];
+            for (unsigned AdjIdx = AdjacencyStart[Vertex]; AdjIdx < AdjacencyStart[Vertex + 1]; ++AdjIdx) {
+                unsigned Tri = Adjacency[AdjIdx];
+                if (Emitted[Tri]) {
+                    continue;
+                }
+                unsigned New = 0;
+                for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                    New += VertexMeshlet[indices[Tri * 3 + Corner]] != MeshletIdx;
+                }
+                if (New < CandidateNew) {
+                    CandidateNew = New;
+                    Candidate = Tri;
+                }
+            }
+        }
+
+        if (Candidate == NotInMeshlet) {
+            while (Emitted[Cursor]) {
+                ++Cursor;
+            }
+            Candidate = Cursor;
+            CandidateNew = 0;
+            for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                CandidateNew += VertexMeshlet[indices[Candidate * 3 + Corner]] != MeshletIdx;
+            }
+        }
+
+        if (MeshletVertices.size() + CandidateNew > MESHLET_MAX_VERTICES || Current.IndexCount / 3 >= MESHLET_MAX_TRIANGLES) {
+            computeBounds(vertices, stride, &meshletIndices[Current.IndexOffset], Current.IndexCount, Current);
+            meshlets.push_back(Current);
+            MeshletVertices.clear();
+            Current.IndexOffset = (unsigned)meshletIndices.size();
+            Current.IndexCount = 0;
+            ++MeshletIdx;
+        }
+
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Vertex = indices[Candidate * 3 + Corner];
+            if (VertexMeshlet[Vertex] != MeshletIdx) {
+                VertexMeshlet[Vertex] = MeshletIdx;
+                MeshletVertices.push_back(Vertex);
+            }
+            meshletIndices.push_back(Vertex);
+        }
+        Current.IndexCount += 3;
+        Emitted[Candidate] = 1;
+        ++EmittedCount;
+    }
+
+    computeBounds(vertices, stride, &meshletIndices[Current.IndexOffset], Current.IndexCount, Current);
+    meshlets.push_back(Current);
+}
+
+bool
+Meshlets::IsBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    glm::vec3 ToCenter = meshlet.Center - cameraPosition;
+    return glm::dot(ToCenter, meshlet.ConeAxis) >= meshlet.ConeCutoff * glm::length(ToCenter) + meshlet.Radius;
+}
+
+MeshletCuller::MeshletCuller()
+    : mVisible(0),
+      mSubmittedTriangles(0),
+      mVisibleTriangles(0) {
+}
+
+MeshletCuller::~MeshletCuller() {
+    Jobs::Wait(mCounter);
+}
+
+void
+MeshletCuller::Submit(Mesh* mesh, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    CullJob NewJob = { mesh, model, viewProjection, cameraPosition };
+    mPending.push_back(NewJob);
+}
+
+void
+MeshletCuller::Kick() {
+    Wait();
+    mActive.swap(mPending);
+    mPending.clear();
+    mVisible = FrameMemory::GetBuffered().AllocateArray<unsigned>(mActive.size());
+    std::fill(mVisible, mVisible + mActive.size(), 0u);
+    Jobs::ParallelFor((unsigned)mActive.size(), 1, [this](unsigned begin, unsigned end) {
+        TRACE_ZONE("Cull meshlets");
+        for (unsigned JobIdx = begin; JobIdx < end; ++JobIdx) {
+            const CullJob& Current = mActive[JobIdx];
+            mVisible[JobIdx] = Current.Target->CullMeshlets(Current.Model, Current.ViewProjection, Current.CameraPosition);
+        }
+    }, &mCounter);
+}
+
+void
+MeshletCuller::Wait() {
+    Jobs::Wait(mCounter);
+
+    mSubmittedTriangles = 0;
+    mVisibleTriangles = 0;
+    for (unsigned JobIdx = 0; JobIdx < mActive.size(); ++JobIdx) {
+        mSubmittedTriangles += mActive[JobIdx].Target->GetMeshletTriangleCount();
+        mVisibleTriangles += mVisible[JobIdx];
+    }
+}
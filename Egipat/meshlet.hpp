@@ -0,0 +1,118 @@
+/**
+ * @file meshlet.hpp
+ * @brief Meshlet partitioning and per-cluster culling. Meshes are split into
+ * small triangle clusters with a bounding sphere and normal cone, which are
+ * culled against the frustum and for backfacing on a worker thread
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "jobsystem.hpp"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+ * @brief Triangle cluster. Indices are a range of the owner's index list
+ * and reference the owner's vertex buffer
+ *
+ */
+struct Meshlet {
+    unsigned IndexOffset;
+    unsigned IndexCount;
+    glm::vec3 Center;
+    float Radius;
+    // NOTE: All triangle normals lie within ConeCutoff (sine of the half angle)
+    // of ConeAxis. Cutoff of 1 marks a cone that can't be used for culling
+    glm::vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+namespace Meshlets {
+    /**
+     * @brief Greedily grows clusters from adjacent triangles, preferring the
+     * triangle that adds the fewest new vertices
+     *
+     * @param vertices - Interleaved vertex data, position in the first three floats
+     * @param vertexCount - Vertex count
+     * @param stride - Floats per vertex
+     * @param indices - Source triangle list
+     * @param meshlets - Output clusters
+     * @param meshletIndices - Output triangle list, reordered so every cluster is a contiguous range
+     */
+    void Build(const float* vertices, unsigned vertexCount, unsigned stride,
+               const std::vector<unsigned>& indices,
+               std::vector<Meshlet>& meshlets, std::vector<unsigned>& meshletIndices);
+
+    /**
+     * @brief Tests whether every triangle of the cluster faces away from the camera
+     *
+     * @param meshlet - Cluster
+     * @param cameraPosition - Camera position in the cluster's space
+     *
+     * @returns true if the cluster can be skipped
+     */
+    bool IsBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+}
+
+class Mesh;
+
+/**
+ * @brief Culls the meshlets of submitted meshes on the job system while the
+ * main thread keeps issuing draws
+ *
+ */
+class MeshletCuller {
+public:
+    MeshletCuller();
+    ~MeshletCuller();
+
+    /**
+     * @brief Queues a mesh for culling. Takes effect on the next Kick
+     *
+     * @param mesh - Mesh with meshlets, must stay alive until Wait returns
+     * @param model - Model matrix the mesh will be rendered with
+     * @param viewProjection - Projection * View
+     * @param cameraPosition - Camera position in world space
+     */
+    void Submit(Mesh* mesh, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+    /**
+     * @brief Starts culling all submitted meshes, one job per mesh. Waits for
+     * the previous pass first
+     *
+     */
+    void Kick();
+
+    /**
+     * @brief Blocks until the last Kick is done
+     *
+     */
+    void Wait();
+
+    unsigned GetSubmittedTriangles() const { return mSubmittedTriangles; }
+    unsigned GetVisibleTriangles() const { return mVisibleTriangles; }
+
+private:
+    struct CullJob {
+        Mesh* Target;
+        glm::mat4 Model;
+        glm::mat4 ViewProjection;
+        glm::vec3 CameraPosition;
+    };
+
+    std::vector<CullJob> mPending;
+    std::vector<CullJob> mActive;
+    // NOTE: Visible triangles per active job, summed by Wait. Lives in the
+    // buffered frame arena since Kick sums it once more a frame later
+    unsigned* mVisible;
+    JobCounter mCounter;
+    unsigned mSubmittedTriangles;
+    unsigned mVisibleTriangles;
+};
@@ -1,29 +1,147 @@
 #include "model.hpp"
+#include "trace.hpp"
 
 Model::Model(std::string filename) {
     mFilename = filename;
     mDirectory = filename.substr(0, filename.find_last_of('/'));
     mNumVertices = 0;
     mNumIndices = 0;
+    mVAO = 0;
+    mArrays = 0;
+    mBatchVBO = 0;
+    mBatchEBO = 0;
+}
+
+Model::~Model() {
+    GpuMemory::DeleteVertexArray(mVAO);
+    GpuMemory::DeleteBuffer(mBatchVBO);
+    GpuMemory::DeleteBuffer(mBatchEBO);
+}
+
+bool
+Model::Load(TextureStreamer* streamer, TextureArrays* arrays) {
+    if (!Import()) {
+        return false;
+    }
+    Upload(streamer, arrays);
+    return true;
 }
 
 bool
-Model::Load() {
-    Assimp::Importer Importer;
-    const aiScene* Scene = Importer.ReadFile(mFilename, POSTPROCESS_FLAGS);
+Model::Import() {
+    TRACE_ZONE("Import model");
+    mImporter.reset(new Assimp::Importer());
+    const aiScene* Scene = mImporter->ReadFile(mFilename, POSTPROCESS_FLAGS);
 
     if (!Scene || Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !Scene->mRootNode) {
-        std::cerr << "[Err] Failed to load model:" << std::endl << Importer.GetErrorString() << std::endl;
+        std::cerr << "[Err] Failed to load model:" << std::endl << mImporter->GetErrorString() << std::endl;
+        mImporter.reset();
         return false;
     }
-    mMeshes.reserve(Scene->mNumMeshes);
-    for (unsigned MeshIdx = 0; MeshIdx < Scene->mNumMeshes; ++MeshIdx) {
+
+    // NOTE: Meshlets and LOD simplification dominate import, one job per mesh
+    mMeshes.clear();
+    mMeshes.resize(Scene->mNumMeshes);
+    Jobs::ParallelFor(Scene->mNumMeshes, 1, [this, Scene](unsigned begin, unsigned end) {
+        for (unsigned MeshIdx = begin; MeshIdx < end; ++MeshIdx) {
+            mMeshes[MeshIdx].Build(Scene->mMeshes[MeshIdx]);
+        }
+    });
+    return true;
+}
+
+void
+Model::Upload(TextureStreamer* streamer, TextureArrays* arrays) {
+    if (!mImporter || !mImporter->GetScene()) {
+        return;
+    }
+
+    const aiScene* Scene = mImporter->GetScene();
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
         aiMaterial* MeshMaterial = Scene->mMaterials[Scene->mMeshes[MeshIdx]->mMaterialIndex];
-        Mesh CurrMesh(Scene->mMeshes[MeshIdx], MeshMaterial, mDirectory);
-        mMeshes.push_back(CurrMesh);
+        mMeshes[MeshIdx].Upload(Scene->mMeshes[MeshIdx], MeshMaterial, mDirectory, arrays ? 0 : streamer, arrays);
     }
     std::cout << mFilename << " Loaded " << mMeshes.size() << " meshes" << std::endl;
-    return true;
+    mImporter.reset();
+
+    mArrays = arrays;
+    buildBatches();
+}
+
+void
+Model::buildBatches() {
+    mBatches.clear();
+    mUnbatched.clear();
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        const Mesh& CurrMesh = mMeshes[MeshIdx];
+        if (!mArrays || CurrMesh.GetDiffuseSlice().Pool == TEXTURE_SLICE_NONE || CurrMesh.mIndices.empty()) {
+            mUnbatched.push_back(MeshIdx);
+            continue;
+        }
+
+        unsigned BatchIdx = 0;
+        for (; BatchIdx < mBatches.size(); ++BatchIdx) {
+            const MeshBatch& Batch = mBatches[BatchIdx];
+            if (Batch.DiffusePool == CurrMesh.GetDiffuseSlice().Pool && Batch.SpecularPool == CurrMesh.GetSpecularSlice().Pool
+                && Batch.AlphaTest == CurrMesh.HasAlphaMap()) {
+                break;
+            }
+        }
+        if (BatchIdx == mBatches.size()) {
+            MeshBatch Batch;
+            Batch.DiffusePool = CurrMesh.GetDiffuseSlice().Pool;
+            Batch.SpecularPool = CurrMesh.GetSpecularSlice().Pool;
+            Batch.AlphaTest = CurrMesh.HasAlphaMap();
+            mBatches.push_back(Batch);
+        }
+        mBatches[BatchIdx].Meshes.push_back(MeshIdx);
+    }
+    if (mBatches.empty()) {
+        return;
+    }
+
+    // NOTE: Mesh layout plus the diffuse and specular layers
+    std::vector<float> Vertices;
+    std::vector<unsigned> Indices;
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        MeshBatch& Batch = mBatches[BatchIdx];
+        for (unsigned EntryIdx = 0; EntryIdx < Batch.Meshes.size(); ++EntryIdx) {
+            const Mesh& CurrMesh = mMeshes[Batch.Meshes[EntryIdx]];
+            Batch.BaseVertices.push_back((GLint)(Vertices.size() / 10));
+            Batch.IndexBases.push_back((unsigned)Indices.size());
+
+            float DiffuseLayer = (float)CurrMesh.GetDiffuseSlice().Layer;
+            float SpecularLayer = (float)CurrMesh.GetSpecularSlice().Layer;
+            for (unsigned VertexIdx = 0; VertexIdx + 8 <= CurrMesh.mVertices.size(); VertexIdx += 8) {
+                Vertices.insert(Vertices.end(), CurrMesh.mVertices.begin() + VertexIdx, CurrMesh.mVertices.begin() + VertexIdx + 8);
+                Vertices.push_back(DiffuseLayer);
+                Vertices.push_back(SpecularLayer);
+            }
+            Indices.insert(Indices.end(), CurrMesh.mIndices.begin(), CurrMesh.mIndices.end());
+        }
+    }
+
+    mVAO = GpuMemory::CreateVertexArray(mFilename);
+    glBindVertexArray(mVAO);
+    mBatchVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, mFilename);
+    glBindBuffer(GL_ARRAY_BUFFER, mBatchVBO);
+    GpuMemory::BufferData(mBatchVBO, GL_ARRAY_BUFFER, Vertices.size() * sizeof(float), Vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    mBatchEBO = GpuMemory::CreateBuffer(GPU_INDEX_BUFFER, mFilename);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBatchEBO);
+    GpuMemory::BufferData(mBatchEBO, GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned), Indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    std::cout << mFilename << " Batched " << mMeshes.size() - mUnbatched.size() << " meshes into " << mBatches.size() << " draws" << std::endl;
 }
 
 void
@@ -31,5 +149,126 @@ Model::Render() {
     for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
         Mesh& Mesh = mMeshes[MeshIdx];
         mMeshes[MeshIdx].Render();
+        mMeshes[MeshIdx].ResetCulling();
+    }
+}
+
+void
+Model::Record(CommandBuffer& commands, ShaderVariants& variants, unsigned pointLightCount) {
+    unsigned BoundKey = ~0u;
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        const MeshBatch& Batch = mBatches[BatchIdx];
+        bool HasSpecular = Batch.SpecularPool != TEXTURE_SLICE_NONE;
+        unsigned Features = SHADER_TEXTURE_ARRAY | (HasSpecular ? SHADER_HAS_SPECULAR : 0) | (Batch.AlphaTest ? SHADER_ALPHA_TEST : 0);
+        unsigned Key = MakeShaderKey(Features, pointLightCount);
+        if (Key != BoundKey) {
+            commands.BindPipeline(variants, Key);
+            BoundKey = Key;
+        }
+
+        commands.BindTexture(0, TEXTURE_TARGET_2D_ARRAY, mArrays->GetArray(Batch.DiffusePool));
+        if (HasSpecular) {
+            commands.BindTexture(1, TEXTURE_TARGET_2D_ARRAY, mArrays->GetArray(Batch.SpecularPool));
+        }
+
+        // NOTE: Every mesh contributes its current level or its culled meshlet ranges
+        mDrawCounts.clear();
+        mDrawOffsets.clear();
+        mDrawBaseVertices.clear();
+        for (unsigned EntryIdx = 0; EntryIdx < Batch.Meshes.size(); ++EntryIdx) {
+            Mesh& CurrMesh = mMeshes[Batch.Meshes[EntryIdx]];
+            CurrMesh.AppendDraws(Batch.IndexBases[EntryIdx], Batch.BaseVertices[EntryIdx], mDrawCounts, mDrawOffsets, mDrawBaseVertices);
+            CurrMesh.ResetCulling();
+        }
+        if (!mDrawCounts.empty()) {
+            commands.BindVertexArray(mVAO);
+            commands.MultiDrawIndexed(mDrawCounts.data(), mDrawOffsets.data(), mDrawBaseVertices.data(), (unsigned)mDrawCounts.size());
+        }
+    }
+    if (!mBatches.empty()) {
+        commands.BindVertexArray(0);
+        commands.BindTexture(1, TEXTURE_TARGET_2D_ARRAY, 0);
+        commands.BindTexture(0, TEXTURE_TARGET_2D_ARRAY, 0);
+    }
+
+    for (unsigned UnbatchedIdx = 0; UnbatchedIdx < mUnbatched.size(); ++UnbatchedIdx) {
+        Mesh& CurrMesh = mMeshes[mUnbatched[UnbatchedIdx]];
+        unsigned Features = (CurrMesh.HasSpecularMap() ? SHADER_HAS_SPECULAR : 0) | (CurrMesh.HasAlphaMap() ? SHADER_ALPHA_TEST : 0);
+        unsigned Key = MakeShaderKey(Features, pointLightCount);
+        if (Key != BoundKey) {
+            commands.BindPipeline(variants, Key);
+            BoundKey = Key;
+        }
+        CurrMesh.Record(commands);
+        CurrMesh.ResetCulling();
+    }
+}
+
+void
+Model::SelectLod(const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale, float pixelThreshold) {
+    float Scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        Mesh& CurrMesh = mMeshes[MeshIdx];
+        glm::vec3 Center = glm::vec3(model * glm::vec4(CurrMesh.GetBoundsCenter(), 1.0f));
+        float Distance = glm::length(Center - cameraPosition) - CurrMesh.GetBoundsRadius() * Scale;
+        // NOTE: Inside the bounds the mesh covers the screen, keep full detail
+        if (Distance <= 1e-3f) {
+            CurrMesh.SelectLod(1e30f, pixelThreshold);
+            continue;
+        }
+        CurrMesh.SelectLod(projectionScale * Scale / Distance, pixelThreshold);
+    }
+}
+
+void
+Model::RequestTextures(TextureStreamer& streamer, const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale) const {
+    float Scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        const Mesh& CurrMesh = mMeshes[MeshIdx];
+        glm::vec3 Center = glm::vec3(model * glm::vec4(CurrMesh.GetBoundsCenter(), 1.0f));
+        float Radius = CurrMesh.GetBoundsRadius() * Scale;
+        float Distance = glm::length(Center - cameraPosition) - Radius;
+        // NOTE: Inside the bounds the mesh covers the screen
+        float ScreenPixels = Distance <= 1e-3f ? 1e30f : 2.0f * Radius * projectionScale / Distance;
+        streamer.Request(CurrMesh.GetDiffuseTexture(), ScreenPixels);
+        streamer.Request(CurrMesh.GetSpecularTexture(), ScreenPixels);
+    }
+}
+
+void
+Model::SubmitCulling(MeshletCuller& culler, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        if (mMeshes[MeshIdx].GetMeshletCount()) {
+            culler.Submit(&mMeshes[MeshIdx], model, viewProjection, cameraPosition);
+        }
+    }
+}
+
+void
+Model::GetWorldBounds(const glm::mat4& model, glm::vec3& min, glm::vec3& max) const {
+    float Scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    min = glm::vec3(1e30f);
+    max = glm::vec3(-1e30f);
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        const Mesh& CurrMesh = mMeshes[MeshIdx];
+        glm::vec3 Center = glm::vec3(model * glm::vec4(CurrMesh.GetBoundsCenter(), 1.0f));
+        glm::vec3 Radius(CurrMesh.GetBoundsRadius() * Scale);
+        min = glm::min(min, Center - Radius);
+        max = glm::max(max, Center + Radius);
+    }
+}
+
+std::string
+Model::GetTexturePath(unsigned mesh, aiTextureType type) const {
+    const aiScene* Scene = mImporter ? mImporter->GetScene() : 0;
+    if (!Scene || mesh >= Scene->mNumMeshes) {
+        return std::string();
+    }
+
+    const aiMaterial* Material = Scene->mMaterials[Scene->mMeshes[mesh]->mMaterialIndex];
+    aiString Path;
+    if (Material->GetTextureCount(type) == 0 || Material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) != AI_SUCCESS) {
+        return std::string();
     }
+    return mDirectory + "/" + Path.data;
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <algorithm>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include <glm/glm.hpp>
@@ -23,6 +24,10 @@
 #include "mesh.hpp"
 #include "buffer.hpp"
 #include "irenderable.hpp"
+#include "meshlet.hpp"
+#include "frameuniforms.hpp"
+#include "shadervariants.hpp"
+#include "jobsystem.hpp"
 
 
 #define POSITION_LOCATION 0
@@ -38,12 +43,44 @@ enum EBufferType {
     BUFFER_COUNT = 4,
 };
 
+/**
+ * @brief Meshes whose materials live in the same texture array pools, drawn
+ * with one multi-draw from the model's shared buffers
+ *
+ */
+struct MeshBatch {
+    unsigned DiffusePool;
+    unsigned SpecularPool;
+    bool AlphaTest;
+    std::vector<unsigned> Meshes;
+    std::vector<unsigned> IndexBases;
+    std::vector<GLint> BaseVertices;
+};
+
 class Model {
 private:
     std::vector<Mesh> mMeshes;
+    // NOTE: Owns the imported scene between Import and Upload
+    std::unique_ptr<Assimp::Importer> mImporter;
     unsigned mVAO;
     unsigned mNumVertices;
     unsigned mNumIndices;
+    // NOTE: Texture array batching, see Load
+    TextureArrays* mArrays;
+    std::vector<MeshBatch> mBatches;
+    std::vector<unsigned> mUnbatched;
+    unsigned mBatchVBO;
+    unsigned mBatchEBO;
+    std::vector<GLsizei> mDrawCounts;
+    std::vector<const void*> mDrawOffsets;
+    std::vector<GLint> mDrawBaseVertices;
+
+    /**
+     * @brief Groups meshes by texture array pools and copies their vertices,
+     * with per-vertex layers, and indices into shared buffers
+     *
+     */
+    void buildBatches();
 
 public:
     std::string mFilename;
@@ -57,12 +94,42 @@ public:
      */
     Model(std::string filename);
 
+    /**
+     * @brief Dtor - deletes the batch buffers, meshes delete their own
+     *
+     */
+    ~Model();
+
     /**
      * @brief Loads all the meshes and model data
      *
+     * @param streamer - Streams material textures by mip level, optional.
+     * Without it textures are fully resident
+     * @param arrays - Pools material textures into texture arrays and batches
+     * meshes by pool, optional. Takes precedence over streamer, call
+     * TextureArrays::Build before the first Render
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Load(TextureStreamer* streamer = 0, TextureArrays* arrays = 0);
+
+    /**
+     * @brief First half of Load. Reads the file and builds the meshes on the
+     * job system. Touches no GL state, so models can be imported on jobs
+     * while the GL thread loads other assets
+     *
      * @returns true - Success, false - Failure
      */
-    bool Load();
+    bool Import();
+
+    /**
+     * @brief Second half of Load. Loads textures and buffers the imported
+     * meshes, then drops the Assimp scene. GL thread only
+     *
+     * @param streamer - See Load
+     * @param arrays - See Load
+     */
+    void Upload(TextureStreamer* streamer = 0, TextureArrays* arrays = 0);
 
     /**
      * @brief Renderable Render implementation
@@ -70,6 +137,72 @@ public:
      */
     void Render();
 
+    /**
+     * @brief Records every mesh with the shader variant its material needs.
+     * Transforms and light indices come from the Object block, see
+     * FrameUniforms::MakeObject. Touches no GL state, so models can be
+     * recorded on jobs, one model per job
+     *
+     * @param commands - Command buffer
+     * @param variants - Scene shader variants
+     * @param pointLightCount - Number of point lights pushed with the object
+     */
+    void Record(CommandBuffer& commands, ShaderVariants& variants, unsigned pointLightCount);
+
+    /**
+     * @brief Selects a level of detail for every mesh from its projected size
+     *
+     * @param model - Model matrix the model will be rendered with
+     * @param cameraPosition - Camera position in world space
+     * @param projectionScale - Pixels per world unit at distance 1 (projection[1][1] * viewport height / 2)
+     * @param pixelThreshold - Largest acceptable simplification error in pixels
+     */
+    void SelectLod(const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale, float pixelThreshold = 1.0f);
+
+    /**
+     * @brief Requests texture mip levels for every mesh from its projected size
+     *
+     * @param streamer - Streamer the model was loaded with
+     * @param model - Model matrix the model will be rendered with
+     * @param cameraPosition - Camera position in world space
+     * @param projectionScale - Pixels per world unit at distance 1
+     */
+    void RequestTextures(TextureStreamer& streamer, const glm::mat4& model, const glm::vec3& cameraPosition, float projectionScale) const;
+
+    /**
+     * @brief Computes a world space box enclosing the bounding spheres of all meshes
+     *
+     * @param model - Model matrix the model will be rendered with
+     * @param min - Box minimum corner
+     * @param max - Box maximum corner
+     */
+    void GetWorldBounds(const glm::mat4& model, glm::vec3& min, glm::vec3& max) const;
+
+    /**
+     * @brief Queues meshlet culling of all meshes for this frame. Call after
+     * SelectLod and wait on the culler before Render
+     *
+     * @param culler - Culling worker
+     * @param model - Model matrix the model will be rendered with
+     * @param viewProjection - Projection * View
+     * @param cameraPosition - Camera position in world space
+     */
+    void SubmitCulling(MeshletCuller& culler, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+    unsigned GetMeshCount() const { return (unsigned)mMeshes.size(); }
+    const Mesh& GetMesh(unsigned mesh) const { return mMeshes[mesh]; }
+
+    /**
+     * @brief Full path of a mesh's material texture. Only valid between
+     * Import and Upload while the Assimp scene is alive
+     *
+     * @param mesh - Mesh index
+     * @param type - Texture type
+     *
+     * @returns Path, empty when the material has no such texture
+     */
+    std::string GetTexturePath(unsigned mesh, aiTextureType type) const;
+
 };
 
 #define MESH_HP
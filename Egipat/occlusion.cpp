@@ -0,0 +1,275 @@
+#include "occlusion.hpp"
+#include "frameuniforms.hpp"
+#include "gpumemory.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// NOTE: Proxies the camera is this close to may be clipped by the near plane
+static const float ProxyCameraMargin = 0.5f;
+static const unsigned BoxTriangleIndexCount = 36;
+static const unsigned BoxLineIndexCount = 24;
+
+OcclusionCuller::OcclusionCuller(unsigned width, unsigned height)
+    : mWidth(width),
+      mHeight(height),
+      mBoundsShaders("shaders/bounds.vert", "shaders/bounds.frag"),
+      mNextReadback(0),
+      mPyramidViewProjection(1.0f),
+      mPyramidValid(false),
+      mViewProjection(1.0f),
+      mCameraPosition(0.0f),
+      mShowBounds(false),
+      mTested(0),
+      mOccluded(0) {
+    // NOTE: Unit cube corner i is (i & 1, (i >> 1) & 1, (i >> 2) & 1)
+    float Corners[8 * 3];
+    for (unsigned Corner = 0; Corner < 8; ++Corner) {
+        Corners[Corner * 3 + 0] = (float)(Corner & 1);
+        Corners[Corner * 3 + 1] = (float)((Corner >> 1) & 1);
+        Corners[Corner * 3 + 2] = (float)((Corner >> 2) & 1);
+    }
+    unsigned Indices[BoxTriangleIndexCount + BoxLineIndexCount] = {
+        0, 2, 6, 0, 6, 4,  1, 3, 7, 1, 7, 5,
+        0, 1, 5, 0, 5, 4,  2, 3, 7, 2, 7, 6,
+        0, 1, 3, 0, 3, 2,  4, 5, 7, 4, 7, 6,
+
+        0, 1, 2, 3, 4, 5, 6, 7,
+        0, 2, 1, 3, 4, 6, 5, 7,
+        0, 4, 1, 5, 2, 6, 3, 7,
+    };
+
+    mVAO = GpuMemory::CreateVertexArray("OcclusionCuller");
+    glBindVertexArray(mVAO);
+    mVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "OcclusionCuller");
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    GpuMemory::BufferData(mVBO, GL_ARRAY_BUFFER, sizeof(Corners), Corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    mEBO = GpuMemory::CreateBuffer(GPU_INDEX_BUFFER, "OcclusionCuller");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    GpuMemory::BufferData(mEBO, GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices), Indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    for (unsigned ReadbackIdx = 0; ReadbackIdx < OCCLUSION_READBACK_BUFFERS; ++ReadbackIdx) {
+        Readback& Current = mReadbacks[ReadbackIdx];
+        Current.PBO = GpuMemory::CreateBuffer(GPU_STAGING_BUFFER, "OcclusionCuller");
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, Current.PBO);
+        GpuMemory::BufferData(Current.PBO, GL_PIXEL_PACK_BUFFER, mWidth * mHeight * sizeof(float), 0, GL_STREAM_READ);
+        Current.Fence = 0;
+        Current.ViewProjection = glm::mat4(1.0f);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mBoundsShaders.Prepare(0);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    for (unsigned ReadbackIdx = 0; ReadbackIdx < OCCLUSION_READBACK_BUFFERS; ++ReadbackIdx) {
+        if (mReadbacks[ReadbackIdx].Fence) {
+            glDeleteSync(mReadbacks[ReadbackIdx].Fence);
+        }
+        GpuMemory::DeleteBuffer(mReadbacks[ReadbackIdx].PBO);
+    }
+    if (!mQueries.empty()) {
+        glDeleteQueries((GLsizei)mQueries.size(), mQueries.data());
+    }
+    GpuMemory::DeleteVertexArray(mVAO);
+    GpuMemory::DeleteBuffer(mVBO);
+    GpuMemory::DeleteBuffer(mEBO);
+}
+
+void
+OcclusionCuller::BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    mViewProjection = viewProjection;
+    mCameraPosition = cameraPosition;
+    mTested = 0;
+    mOccluded = 0;
+}
+
+bool
+OcclusionCuller::IsVisible(const glm::vec3& min, const glm::vec3& max) {
+    ++mTested;
+    if (!mPyramidValid) {
+        return true;
+    }
+
+    // NOTE: Project with the matrix the pyramid was rendered with, the depth
+    // it holds belongs to that view
+    glm::vec2 Lo(1e30f), Hi(-1e30f);
+    float MinDepth = 1.0f;
+    for (unsigned Corner = 0; Corner < 8; ++Corner) {
+        glm::vec3 Position((Corner & 1) ? max.x : min.x, (Corner & 2) ? max.y : min.y, (Corner & 4) ? max.z : min.z);
+        glm::vec4 Clip = mPyramidViewProjection * glm::vec4(Position, 1.0f);
+        if (Clip.w <= 1e-4f) {
+            return true;
+        }
+        glm::vec3 Ndc = glm::vec3(Clip) / Clip.w;
+        Lo = glm::min(Lo, glm::vec2(Ndc.x, Ndc.y));
+        Hi = glm::max(Hi, glm::vec2(Ndc.x, Ndc.y));
+        MinDepth = std::min(MinDepth, Ndc.z * 0.5f + 0.5f);
+    }
+    // NOTE: Outside the old view there is no depth to test against
+    if (Hi.x < -1.0f || Hi.y < -1.0f || Lo.x > 1.0f || Lo.y > 1.0f) {
+        return true;
+    }
+    Lo = glm::clamp(Lo, glm::vec2(-1.0f), glm::vec2(1.0f));
+    Hi = glm::clamp(Hi, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+    float X0 = (Lo.x * 0.5f + 0.5f) * mLevelWidth[0];
+    float X1 = (Hi.x * 0.5f + 0.5f) * mLevelWidth[0];
+    float Y0 = (Lo.y * 0.5f + 0.5f) * mLevelHeight[0];
+    float Y1 = (Hi.y * 0.5f + 0.5f) * mLevelHeight[0];
+
+    // NOTE: Pick the level where the rectangle spans at most 2x2 texels
+    float Extent = std::max(X1 - X0, Y1 - Y0);
+    unsigned Level = Extent > 1.0f ? (unsigned)std::ceil(std::log2(Extent)) : 0;
+    Level = std::min(Level, (unsigned)mLevels.size() - 1);
+    float Scale = 1.0f / (float)(1u << Level);
+    unsigned Width = mLevelWidth[Level];
+    unsigned Height = mLevelHeight[Level];
+    unsigned TX0 = std::min((unsigned)(X0 * Scale), Width - 1);
+    unsigned TX1 = std::min((unsigned)(X1 * Scale), Width - 1);
+    unsigned TY0 = std::min((unsigned)(Y0 * Scale), Height - 1);
+    unsigned TY1 = std::min((unsigned)(Y1 * Scale), Height - 1);
+
+    const std::vector<float>& Depth = mLevels[Level];
+    float MaxDepth = 0.0f;
+    for (unsigned Y = TY0; Y <= TY1; ++Y) {
+        for (unsigned X = TX0; X <= TX1; ++X) {
+            MaxDepth = std::max(MaxDepth, Depth[Y * Width + X]);
+        }
+    }
+
+    if (MinDepth > MaxDepth) {
+        ++mOccluded;
+        return false;
+    }
+    return true;
+}
+
+unsigned
+OcclusionCuller::CreateQuery() {
+    unsigned Query = 0;
+    glGenQueries(1, &Query);
+    mQueries.push_back(Query);
+    return Query;
+}
+
+bool
+OcclusionCuller::RecordConditional(CommandBuffer& commands, unsigned query, const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 Margin(ProxyCameraMargin);
+    glm::vec3 Closest = glm::clamp(mCameraPosition, min - Margin, max + Margin);
+    if (glm::length(Closest - mCameraPosition) <= 0.0f) {
+        return false;
+    }
+
+    BoundsUniforms Bounds;
+    Bounds.Min = glm::vec4(min, 1.0f);
+    Bounds.Max = glm::vec4(max, 1.0f);
+    Bounds.Color = glm::vec4(0.0f);
+
+    // NOTE: Depth test only, the proxy must not write anything
+    commands.SetRenderState(0);
+    commands.BindPipeline(mBoundsShaders, 0);
+    commands.SetConstants(OBJECT_BLOCK_BINDING, &Bounds, sizeof(Bounds));
+    commands.BindVertexArray(mVAO);
+    commands.BeginQuery(query);
+    commands.DrawIndexed(BoxTriangleIndexCount, 0);
+    commands.EndQuery();
+    commands.SetRenderState(RENDER_STATE_DEFAULT);
+
+    // NOTE: The GPU waits on the query, the CPU keeps submitting
+    commands.BeginConditional(query);
+    return true;
+}
+
+void
+OcclusionCuller::CaptureDepth() {
+    Readback& Oldest = mReadbacks[mNextReadback];
+    if (Oldest.Fence) {
+        GLenum Status = glClientWaitSync(Oldest.Fence, 0, 0);
+        if (Status != GL_ALREADY_SIGNALED && Status != GL_CONDITION_SATISFIED) {
+            // NOTE: GPU is behind, skip this frame's readback rather than stall
+            return;
+        }
+        glDeleteSync(Oldest.Fence);
+        Oldest.Fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, Oldest.PBO);
+        const float* Depth = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, mWidth * mHeight * sizeof(float), GL_MAP_READ_BIT);
+        if (Depth) {
+            buildPyramid(Depth);
+            mPyramidViewProjection = Oldest.ViewProjection;
+            mPyramidValid = true;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, Oldest.PBO);
+    glReadPixels(0, 0, mWidth, mHeight, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    Oldest.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    Oldest.ViewProjection = mViewProjection;
+    mNextReadback = (mNextReadback + 1) % OCCLUSION_READBACK_BUFFERS;
+}
+
+void
+OcclusionCuller::RecordBounds(CommandBuffer& commands, const glm::vec3& min, const glm::vec3& max, bool visible) {
+    if (!mShowBounds) {
+        return;
+    }
+
+    BoundsUniforms Bounds;
+    Bounds.Min = glm::vec4(min, 1.0f);
+    Bounds.Max = glm::vec4(max, 1.0f);
+    Bounds.Color = visible ? glm::vec4(0.0f, 1.0f, 0.0f, 1.0f) : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+
+    commands.BindPipeline(mBoundsShaders, 0);
+    commands.SetConstants(OBJECT_BLOCK_BINDING, &Bounds, sizeof(Bounds));
+    commands.BindVertexArray(mVAO);
+    commands.DrawIndexed(BoxLineIndexCount, BoxTriangleIndexCount * sizeof(unsigned), PRIMITIVE_LINES);
+}
+
+void
+OcclusionCuller::buildPyramid(const float* depth) {
+    unsigned Width = (mWidth + OCCLUSION_BASE_REDUCTION - 1) / OCCLUSION_BASE_REDUCTION;
+    unsigned Height = (mHeight + OCCLUSION_BASE_REDUCTION - 1) / OCCLUSION_BASE_REDUCTION;
+    mLevels.resize(1);
+    mLevelWidth.assign(1, Width);
+    mLevelHeight.assign(1, Height);
+
+    std::vector<float>& Base = mLevels[0];
+    Base.assign(Width * Height, 0.0f);
+    for (unsigned Y = 0; Y < mHeight; ++Y) {
+        const float* Row = depth + (size_t)Y * mWidth;
+        float* Target = &Base[(Y / OCCLUSION_BASE_REDUCTION) * Width];
+        for (unsigned X = 0; X < mWidth; ++X) {
+            float& Texel = Target[X / OCCLUSION_BASE_REDUCTION];
+            Texel = std::max(Texel, Row[X]);
+        }
+    }
+
+    while (Width > 1 || Height > 1) {
+        unsigned NextWidth = (Width + 1) / 2;
+        unsigned NextHeight = (Height + 1) / 2;
+        const std::vector<float>& Source = mLevels.back();
+        std::vector<float> Next(NextWidth * NextHeight);
+        for (unsigned Y = 0; Y < NextHeight; ++Y) {
+            unsigned Y0 = Y * 2;
+            unsigned Y1 = std::min(Y0 + 1, Height - 1);
+            for (unsigned X = 0; X < NextWidth; ++X) {
+                unsigned X0 = X * 2;
+                unsigned X1 = std::min(X0 + 1, Width - 1);
+                Next[Y * NextWidth + X] = std::max(std::max(Source[Y0 * Width + X0], Source[Y0 * Width + X1]),
+                                                   std::max(Source[Y1 * Width + X0], Source[Y1 * Width + X1]));
+            }
+        }
+        mLevels.push_back(std::move(Next));
+        mLevelWidth.push_back(NextWidth);
+        mLevelHeight.push_back(NextHeight);
+        Width = NextWidth;
+        Height = NextHeight;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file occlusion.hpp
+ * @brief Occlusion culling. Bounding boxes are tested on the CPU against a
+ * max-depth pyramid built from an asynchronous readback of a previous frame's
+ * depth buffer. Where that is unreliable, hardware occlusion queries drive
+ * conditional rendering so the CPU never waits on query results
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "commandbuffer.hpp"
+#include "shadervariants.hpp"
+
+// NOTE: Pyramid base is the depth buffer reduced by this factor on both axes
+#define OCCLUSION_BASE_REDUCTION 4
+#define OCCLUSION_READBACK_BUFFERS 3
+
+class OcclusionCuller {
+public:
+    /**
+     * @brief Ctor - creates readback buffers and the bounds proxy
+     *
+     * @param width - Framebuffer width
+     * @param height - Framebuffer height
+     */
+    OcclusionCuller(unsigned width, unsigned height);
+    ~OcclusionCuller();
+
+    /**
+     * @brief Sets the view the depth readback is taken with. Queries and
+     * debug bounds use the frame's Camera block
+     *
+     * @param viewProjection - Projection * View of the current frame
+     * @param cameraPosition - Camera position in world space
+     */
+    void BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+    /**
+     * @brief Tests a world space box against the depth pyramid
+     *
+     * @param min - Box minimum corner
+     * @param max - Box maximum corner
+     *
+     * @returns false if the box is certainly hidden, true otherwise
+     */
+    bool IsVisible(const glm::vec3& min, const glm::vec3& max);
+
+    /**
+     * @brief Creates an occlusion query for use with RecordConditional
+     *
+     * @returns Query id
+     */
+    unsigned CreateQuery();
+
+    /**
+     * @brief Records the box rasterized against the depth buffer inside the
+     * query, then the start of rendering conditioned on its result. Record the
+     * object, then EndConditional. Occluders must execute first
+     *
+     * @param commands - Receives the commands
+     * @param query - Query from CreateQuery
+     * @param min - Box minimum corner
+     * @param max - Box maximum corner
+     *
+     * @returns true if conditional rendering was recorded
+     */
+    bool RecordConditional(CommandBuffer& commands, unsigned query, const glm::vec3& min, const glm::vec3& max);
+
+    /**
+     * @brief Queues readback of the current depth buffer and rebuilds the
+     * pyramid from the oldest finished readback. Call after opaque geometry
+     *
+     */
+    void CaptureDepth();
+
+    /**
+     * @brief Records a box outline when bounds debugging is enabled
+     *
+     * @param commands - Receives the commands
+     * @param min - Box minimum corner
+     * @param max - Box maximum corner
+     * @param visible - Colors the box green if true, red otherwise
+     */
+    void RecordBounds(CommandBuffer& commands, const glm::vec3& min, const glm::vec3& max, bool visible);
+
+    void SetShowBounds(bool show) { mShowBounds = show; }
+    bool GetShowBounds() const { return mShowBounds; }
+    unsigned GetTestedCount() const { return mTested; }
+    unsigned GetOccludedCount() const { return mOccluded; }
+
+private:
+    struct Readback {
+        unsigned PBO;
+        GLsync Fence;
+        glm::mat4 ViewProjection;
+    };
+
+    // NOTE: Mirrors the Object block in bounds.vert and bounds.frag
+    struct BoundsUniforms {
+        glm::vec4 Min;
+        glm::vec4 Max;
+        glm::vec4 Color;
+    };
+
+    unsigned mWidth;
+    unsigned mHeight;
+    ShaderVariants mBoundsShaders;
+    unsigned mVAO;
+    unsigned mVBO;
+    unsigned mEBO;
+    std::vector<unsigned> mQueries;
+    Readback mReadbacks[OCCLUSION_READBACK_BUFFERS];
+    unsigned mNextReadback;
+
+    // NOTE: Max-depth pyramid, level 0 is the reduced depth buffer
+    std::vector<std::vector<float> > mLevels;
+    std::vector<unsigned> mLevelWidth;
+    std::vector<unsigned> mLevelHeight;
+    glm::mat4 mPyramidViewProjection;
+    bool mPyramidValid;
+
+    glm::mat4 mViewProjection;
+    glm::vec3 mCameraPosition;
+    bool mShowBounds;
+    unsigned mTested;
+    unsigned mOccluded;
+
+    void buildPyramid(const float* depth);
+};
@@ -0,0 +1,346 @@
+#include "particles.hpp"
+#include "frameuniforms.hpp"
+#include "gpumemory.hpp"
+#include "jobsystem.hpp"
+#include "simd.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// NOTE: Hash, random and fastSin mirror shaders/particle_update.vert exactly,
+// so both backends produce the same simulation
+static unsigned
+particleHash(unsigned x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static float
+particleRandom(unsigned& state) {
+    state = particleHash(state);
+    return (state & 0xFFFFFFu) / 16777216.0f;
+}
+
+static float
+fastSin(float x) {
+    x = x - 6.28318531f * std::floor((x + 3.14159265f) / 6.28318531f);
+    float Y = 1.27323954f * x - 0.405284735f * x * std::fabs(x);
+    return 0.225f * (Y * std::fabs(Y) - Y) + Y;
+}
+
+#ifdef EGIPAT_SSE
+static __m128
+floor4(__m128 x) {
+    __m128 Truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    __m128 Correction = _mm_and_ps(_mm_cmpgt_ps(Truncated, x), _mm_set1_ps(1.0f));
+    return _mm_sub_ps(Truncated, Correction);
+}
+
+static __m128
+abs4(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+static __m128
+fastSin4(__m128 x) {
+    const __m128 TwoPi = _mm_set1_ps(6.28318531f);
+    __m128 Wrap = floor4(_mm_div_ps(_mm_add_ps(x, _mm_set1_ps(3.14159265f)), TwoPi));
+    x = _mm_sub_ps(x, _mm_mul_ps(TwoPi, Wrap));
+    __m128 Y = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.27323954f), x),
+                          _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.405284735f), x), abs4(x)));
+    __m128 Refined = _mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(Y, abs4(Y)), Y));
+    return _mm_add_ps(Refined, Y);
+}
+
+static __m128
+select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+ParticleSettings::ParticleSettings()
+    : Wind(2.5f, 0.0f, 0.8f),
+      EmitterMin(-40.0f, 0.0f, -40.0f),
+      EmitterMax(40.0f, 2.5f, 40.0f),
+      Color(0.86f, 0.72f, 0.50f),
+      Lifetime(6.0f),
+      Gravity(0.4f),
+      Drag(0.8f),
+      Turbulence(1.5f),
+      Size(0.03f),
+      Opacity(0.6f) {
+}
+
+ParticleSystem::ParticleSystem(unsigned count, EBackend backend, const ParticleSettings& settings)
+    : mCount(count),
+      mBackend(backend),
+      mSettings(settings),
+      mTime(0.0f),
+      mFrame(0),
+      mUpdateShader("shaders/particle_update.vert", std::vector<std::string>{ "vPositionAge", "vVelocityLifetime" }),
+      mRenderShaders("shaders/particle.vert", "shaders/particle.frag"),
+      mCurrent(0) {
+    std::vector<glm::vec4> Initial;
+    seed(Initial);
+    setupBuffers(Initial);
+
+    if (mBackend == BACKEND_CPU) {
+        mParticles.swap(Initial);
+    }
+    mRenderShaders.Prepare(0);
+}
+
+ParticleSystem::~ParticleSystem() {
+    for (unsigned BufferIdx = 0; BufferIdx < 2; ++BufferIdx) {
+        GpuMemory::DeleteVertexArray(mRenderVAO[BufferIdx]);
+        GpuMemory::DeleteVertexArray(mUpdateVAO[BufferIdx]);
+        GpuMemory::DeleteBuffer(mVBO[BufferIdx]);
+    }
+    GpuMemory::DeleteBuffer(mQuadVBO);
+}
+
+void
+ParticleSystem::Update(float dt) {
+    if (mBackend == BACKEND_GPU) {
+        updateGpu(dt);
+    } else {
+        updateCpu(dt);
+    }
+    mTime += dt;
+    ++mFrame;
+}
+
+void
+ParticleSystem::Record(CommandBuffer& commands) {
+    RenderUniforms Uniforms;
+    Uniforms.Color = glm::vec4(mSettings.Color, mSettings.Opacity);
+    Uniforms.Size = glm::vec4(mSettings.Size, 0.0f, 0.0f, 0.0f);
+
+    commands.SetRenderState(RENDER_COLOR_WRITE);
+    commands.BindPipeline(mRenderShaders, 0);
+    commands.SetConstants(OBJECT_BLOCK_BINDING, &Uniforms, sizeof(Uniforms));
+    commands.BindVertexArray(mRenderVAO[mCurrent]);
+    commands.Draw(0, 4, mCount, PRIMITIVE_TRIANGLE_STRIP);
+    commands.SetRenderState(RENDER_STATE_DEFAULT);
+}
+
+void
+ParticleSystem::ReadBack(std::vector<glm::vec4>& out) {
+    if (mBackend == BACKEND_CPU) {
+        out = mParticles;
+        return;
+    }
+
+    out.resize(2 * mCount);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO[mCurrent]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, out.size() * sizeof(glm::vec4), out.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+ParticleSystem::seed(std::vector<glm::vec4>& particles) const {
+    particles.resize(2 * mCount);
+    for (unsigned Idx = 0; Idx < mCount; ++Idx) {
+        respawn(Idx, particles[2 * Idx], particles[2 * Idx + 1]);
+        // NOTE: Stagger ages so particles don't all respawn on the same frame
+        unsigned State = Idx * 2654435761u + 1u;
+        particles[2 * Idx].w = particles[2 * Idx + 1].w * particleRandom(State);
+    }
+}
+
+void
+ParticleSystem::setupBuffers(const std::vector<glm::vec4>& particles) {
+    const float Corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    mQuadVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "ParticleSystem");
+    glBindBuffer(GL_ARRAY_BUFFER, mQuadVBO);
+    GpuMemory::BufferData(mQuadVBO, GL_ARRAY_BUFFER, sizeof(Corners), Corners, GL_STATIC_DRAW);
+
+    unsigned Stride = 2 * sizeof(glm::vec4);
+    GLenum Usage = mBackend == BACKEND_GPU ? GL_DYNAMIC_COPY : GL_STREAM_DRAW;
+    for (unsigned BufferIdx = 0; BufferIdx < 2; ++BufferIdx) {
+        mVBO[BufferIdx] = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "ParticleSystem");
+        mRenderVAO[BufferIdx] = GpuMemory::CreateVertexArray("ParticleSystem");
+        mUpdateVAO[BufferIdx] = GpuMemory::CreateVertexArray("ParticleSystem");
+        glBindBuffer(GL_ARRAY_BUFFER, mVBO[BufferIdx]);
+        GpuMemory::BufferData(mVBO[BufferIdx], GL_ARRAY_BUFFER, particles.size() * sizeof(glm::vec4), particles.data(), Usage);
+
+        glBindVertexArray(mUpdateVAO[BufferIdx]);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Stride, (void*)sizeof(glm::vec4));
+        glEnableVertexAttribArray(1);
+
+        glBindVertexArray(mRenderVAO[BufferIdx]);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Stride, (void*)sizeof(glm::vec4));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, mQuadVBO);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+ParticleSystem::updateGpu(float dt) {
+    unsigned Next = 1 - mCurrent;
+
+    glUseProgram(mUpdateShader.GetId());
+    mUpdateShader.SetUniform1f("uDt", dt);
+    mUpdateShader.SetUniform1f("uTime", mTime);
+    glUniform1ui(glGetUniformLocation(mUpdateShader.GetId(), "uFrame"), mFrame);
+    mUpdateShader.SetUniform3f("uWind", mSettings.Wind);
+    mUpdateShader.SetUniform3f("uEmitterMin", mSettings.EmitterMin);
+    mUpdateShader.SetUniform3f("uEmitterMax", mSettings.EmitterMax);
+    mUpdateShader.SetUniform1f("uLifetime", mSettings.Lifetime);
+    mUpdateShader.SetUniform1f("uGravity", mSettings.Gravity);
+    mUpdateShader.SetUniform1f("uDrag", mSettings.Drag);
+    mUpdateShader.SetUniform1f("uTurbulence", mSettings.Turbulence);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(mUpdateVAO[mCurrent]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, mVBO[Next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, mCount);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    mCurrent = Next;
+}
+
+void
+ParticleSystem::updateCpu(float dt) {
+    // NOTE: Ranges start on multiples of the grain, so every one but the last
+    // is whole SIMD groups
+    Jobs::ParallelFor(mCount, PARTICLE_JOB_GRAIN, [this, dt](unsigned begin, unsigned end) {
+        TRACE_ZONE("Update particles");
+        updateRange(begin, end, dt);
+    });
+
+    // NOTE: Orphan the previous storage so the driver doesn't stall on it
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO[mCurrent]);
+    GpuMemory::BufferData(mVBO[mCurrent], GL_ARRAY_BUFFER, mParticles.size() * sizeof(glm::vec4), 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, mParticles.size() * sizeof(glm::vec4), mParticles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+ParticleSystem::respawn(unsigned index, glm::vec4& positionAge, glm::vec4& velocityLifetime) const {
+    unsigned State = index * 747796405u + mFrame * 2891336453u;
+    float RX = particleRandom(State);
+    float RY = particleRandom(State);
+    float RZ = particleRandom(State);
+    float Speed = 0.5f + particleRandom(State);
+    float Life = 0.5f + particleRandom(State);
+
+    glm::vec3 Position = mSettings.EmitterMin + (mSettings.EmitterMax - mSettings.EmitterMin) * glm::vec3(RX, RY, RZ);
+    positionAge = glm::vec4(Position, 0.0f);
+    velocityLifetime = glm::vec4(mSettings.Wind * Speed, mSettings.Lifetime * Life);
+}
+
+void
+ParticleSystem::updateRange(unsigned begin, unsigned end, float dt) {
+    const glm::vec3& Wind = mSettings.Wind;
+    float Drag = mSettings.Drag;
+    float Turbulence = mSettings.Turbulence;
+    float Gravity = mSettings.Gravity;
+    float Time = mTime;
+    unsigned Idx = begin;
+
+#ifdef EGIPAT_SSE
+    // NOTE: Four particles per iteration, transposed to SoA registers
+    const __m128 Dt4 = _mm_set1_ps(dt);
+    const __m128 Zero = _mm_setzero_ps();
+    for (; Idx + 4 <= end; Idx += 4) {
+        float* Base = &mParticles[2 * Idx].x;
+        __m128 PX = _mm_loadu_ps(Base + 0);
+        __m128 PY = _mm_loadu_ps(Base + 8);
+        __m128 PZ = _mm_loadu_ps(Base + 16);
+        __m128 Age = _mm_loadu_ps(Base + 24);
+        _MM_TRANSPOSE4_PS(PX, PY, PZ, Age);
+        __m128 VX = _mm_loadu_ps(Base + 4);
+        __m128 VY = _mm_loadu_ps(Base + 12);
+        __m128 VZ = _mm_loadu_ps(Base + 20);
+        __m128 Life = _mm_loadu_ps(Base + 28);
+        _MM_TRANSPOSE4_PS(VX, VY, VZ, Life);
+
+        Age = _mm_add_ps(Age, Dt4);
+        int Expired = _mm_movemask_ps(_mm_cmpge_ps(Age, Life));
+
+        __m128 T = _mm_set1_ps(Time);
+        __m128 GustX = fastSin4(_mm_add_ps(_mm_mul_ps(PZ, _mm_set1_ps(0.5f)), T));
+        __m128 GustY = _mm_mul_ps(fastSin4(_mm_add_ps(_mm_mul_ps(PX, _mm_set1_ps(0.7f)), _mm_mul_ps(T, _mm_set1_ps(1.3f)))), _mm_set1_ps(0.3f));
+        __m128 GustZ = fastSin4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(PX, _mm_set1_ps(0.5f)), _mm_mul_ps(T, _mm_set1_ps(0.9f))), _mm_set1_ps(1.57f)));
+
+        __m128 DragV = _mm_set1_ps(Drag);
+        __m128 TurbV = _mm_set1_ps(Turbulence);
+        VX = _mm_add_ps(VX, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Wind.x), VX), DragV), _mm_mul_ps(GustX, TurbV)), Dt4));
+        VY = _mm_add_ps(VY, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Wind.y), VY), DragV), _mm_mul_ps(GustY, TurbV)), Dt4));
+        VZ = _mm_add_ps(VZ, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Wind.z), VZ), DragV), _mm_mul_ps(GustZ, TurbV)), Dt4));
+        VY = _mm_sub_ps(VY, _mm_set1_ps(Gravity * dt));
+        PX = _mm_add_ps(PX, _mm_mul_ps(VX, Dt4));
+        PY = _mm_add_ps(PY, _mm_mul_ps(VY, Dt4));
+        PZ = _mm_add_ps(PZ, _mm_mul_ps(VZ, Dt4));
+
+        __m128 Below = _mm_cmplt_ps(PY, Zero);
+        PY = select4(Below, Zero, PY);
+        VY = select4(Below, _mm_mul_ps(VY, _mm_set1_ps(-0.3f)), VY);
+
+        _MM_TRANSPOSE4_PS(PX, PY, PZ, Age);
+        _mm_storeu_ps(Base + 0, PX);
+        _mm_storeu_ps(Base + 8, PY);
+        _mm_storeu_ps(Base + 16, PZ);
+        _mm_storeu_ps(Base + 24, Age);
+        _MM_TRANSPOSE4_PS(VX, VY, VZ, Life);
+        _mm_storeu_ps(Base + 4, VX);
+        _mm_storeu_ps(Base + 12, VY);
+        _mm_storeu_ps(Base + 20, VZ);
+        _mm_storeu_ps(Base + 28, Life);
+
+        if (Expired) {
+            for (unsigned Lane = 0; Lane < 4; ++Lane) {
+                if (Expired & (1 << Lane)) {
+                    respawn(Idx + Lane, mParticles[2 * (Idx + Lane)], mParticles[2 * (Idx + Lane) + 1]);
+                }
+            }
+        }
+    }
+#endif
+
+    for (; Idx < end; ++Idx) {
+        glm::vec4& PositionAge = mParticles[2 * Idx];
+        glm::vec4& VelocityLifetime = mParticles[2 * Idx + 1];
+        float Age = PositionAge.w + dt;
+        if (Age >= VelocityLifetime.w) {
+            respawn(Idx, PositionAge, VelocityLifetime);
+            continue;
+        }
+
+        glm::vec3 Position(PositionAge);
+        glm::vec3 Velocity(VelocityLifetime);
+        glm::vec3 Gust(fastSin(Position.z * 0.5f + Time),
+                       fastSin(Position.x * 0.7f + Time * 1.3f) * 0.3f,
+                       fastSin(Position.x * 0.5f + Time * 0.9f + 1.57f));
+        Velocity += ((Wind - Velocity) * Drag + Gust * Turbulence) * dt;
+        Velocity.y -= Gravity * dt;
+        Position += Velocity * dt;
+        if (Position.y < 0.0f) {
+            Position.y = 0.0f;
+            Velocity.y = -Velocity.y * 0.3f;
+        }
+
+        PositionAge = glm::vec4(Position, Age);
+        VelocityLifetime = glm::vec4(Velocity, VelocityLifetime.w);
+    }
+}
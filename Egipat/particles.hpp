@@ -0,0 +1,112 @@
+/**
+ * @file particles.hpp
+ * @brief Wind-blown sand particles. Simulation runs on the GPU with transform
+ * feedback, or on a multithreaded SIMD CPU path that follows the same update
+ * rules. Particles are rendered as instanced camera-facing billboards
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "commandbuffer.hpp"
+#include "shadervariants.hpp"
+
+// NOTE: Particles per CPU update job, a multiple of the SIMD width
+#define PARTICLE_JOB_GRAIN 8192
+
+struct ParticleSettings {
+    glm::vec3 Wind;
+    glm::vec3 EmitterMin;
+    glm::vec3 EmitterMax;
+    glm::vec3 Color;
+    float Lifetime;
+    float Gravity;
+    float Drag;
+    float Turbulence;
+    float Size;
+    float Opacity;
+
+    ParticleSettings();
+};
+
+class ParticleSystem {
+public:
+    enum EBackend {
+        BACKEND_GPU = 0,
+        BACKEND_CPU = 1,
+    };
+
+    /**
+     * @brief Ctor - seeds particles and creates simulation buffers
+     *
+     * @param count - Particle count
+     * @param backend - Where the simulation runs
+     * @param settings - Emitter and wind parameters
+     */
+    ParticleSystem(unsigned count, EBackend backend = BACKEND_GPU, const ParticleSettings& settings = ParticleSettings());
+    ~ParticleSystem();
+
+    /**
+     * @brief Advances the simulation. The CPU backend uploads the result here
+     *
+     * @param dt - Delta time
+     */
+    void Update(float dt);
+
+    /**
+     * @brief Records particles as blended billboards. Execute after opaque
+     * geometry. The view comes from the Camera block
+     *
+     * @param commands - Receives the commands
+     */
+    void Record(CommandBuffer& commands);
+
+    unsigned GetCount() const { return mCount; }
+    EBackend GetBackend() const { return mBackend; }
+
+    /**
+     * @brief Reads current particle state (PositionAge, VelocityLifetime pairs)
+     *
+     * @param out - Destination, resized to 2 * count
+     */
+    void ReadBack(std::vector<glm::vec4>& out);
+
+private:
+    // NOTE: Mirrors the Object block in particle.vert and particle.frag
+    struct RenderUniforms {
+        // NOTE: Alpha is the opacity
+        glm::vec4 Color;
+        // NOTE: Billboard half size in x
+        glm::vec4 Size;
+    };
+
+    unsigned mCount;
+    EBackend mBackend;
+    ParticleSettings mSettings;
+    float mTime;
+    unsigned mFrame;
+
+    Shader mUpdateShader;
+    ShaderVariants mRenderShaders;
+    unsigned mQuadVBO;
+    unsigned mVBO[2];
+    unsigned mRenderVAO[2];
+    unsigned mUpdateVAO[2];
+    unsigned mCurrent;
+
+    // NOTE: CPU backend state. Layout matches the GPU buffers
+    std::vector<glm::vec4> mParticles;
+
+    void seed(std::vector<glm::vec4>& particles) const;
+    void setupBuffers(const std::vector<glm::vec4>& particles);
+    void updateGpu(float dt);
+    void updateCpu(float dt);
+    void updateRange(unsigned begin, unsigned end, float dt);
+    void respawn(unsigned index, glm::vec4& positionAge, glm::vec4& velocityLifetime) const;
+};
@@ -0,0 +1,194 @@
+#include "perftest.hpp"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+// NOTE: Starts at the default view, circles the pyramids looking inwards and
+// ends on the west side
+static const CameraKey Flythrough[] = {
+    { 0.0f, glm::vec3(0.0f, 0.17f, 9.0f), -90.0f, 0.0f },
+    { 3.0f, glm::vec3(4.0f, 0.6f, 5.0f), -125.0f, -5.0f },
+    { 6.0f, glm::vec3(5.0f, 1.5f, -2.0f), -200.0f, -10.0f },
+    { 9.0f, glm::vec3(0.0f, 2.5f, -9.0f), -270.0f, -12.0f },
+    { 12.0f, glm::vec3(-5.0f, 0.8f, 0.0f), -360.0f, -3.0f },
+};
+static const unsigned FlythroughKeyCount = sizeof(Flythrough) / sizeof(Flythrough[0]);
+
+PerfTest::PerfTest()
+    : mFrameCount(0),
+      mFrame(0),
+      mWriteBaseline(false) {
+}
+
+PerfTest::~PerfTest() {
+    if (!mQueries.empty()) {
+        glDeleteQueries((GLsizei)mQueries.size(), &mQueries[0]);
+    }
+}
+
+void
+PerfTest::Start(unsigned frameCount, const std::string& baselinePath, bool writeBaseline) {
+    mFrameCount = std::max(frameCount, 1u);
+    mFrame = 0;
+    mBaselinePath = baselinePath;
+    mWriteBaseline = writeBaseline;
+    mCpuMs.clear();
+    mCpuMs.reserve(mFrameCount);
+    mQueries.resize(mFrameCount);
+    glGenQueries((GLsizei)mQueries.size(), &mQueries[0]);
+}
+
+static CameraPath
+buildFlythrough() {
+    CameraPath Path;
+    for (unsigned KeyIdx = 0; KeyIdx < FlythroughKeyCount; ++KeyIdx) {
+        Path.AddKey(Flythrough[KeyIdx].Time, Flythrough[KeyIdx].Position, Flythrough[KeyIdx].Yaw, Flythrough[KeyIdx].Pitch);
+    }
+    return Path;
+}
+
+const CameraPath&
+PerfTest::GetFlythrough() {
+    static const CameraPath Path = buildFlythrough();
+    return Path;
+}
+
+void
+PerfTest::BeginFrame() {
+    mFrameStart = std::chrono::steady_clock::now();
+    if (mFrame >= PERF_WARMUP_FRAMES && !IsDone()) {
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[mFrame - PERF_WARMUP_FRAMES]);
+    }
+}
+
+void
+PerfTest::EndFrame() {
+    if (mFrame >= PERF_WARMUP_FRAMES && !IsDone()) {
+        glEndQuery(GL_TIME_ELAPSED);
+        mCpuMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mFrameStart).count());
+    }
+    ++mFrame;
+}
+
+PerfTest::Percentiles
+PerfTest::computePercentiles(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    // NOTE: Nearest rank
+    Percentiles Result;
+    size_t Last = samples.size() - 1;
+    Result.P50 = samples[(size_t)(Last * 0.50 + 0.5)];
+    Result.P95 = samples[(size_t)(Last * 0.95 + 0.5)];
+    Result.P99 = samples[(size_t)(Last * 0.99 + 0.5)];
+    return Result;
+}
+
+bool
+PerfTest::compare(const char* name, double measured, double baseline, double tolerance) {
+    double Limit = std::max(baseline * (1.0 + tolerance), baseline + PERF_MIN_REGRESSION_MS);
+    if (measured <= Limit) {
+        return true;
+    }
+
+    std::cerr << "[Err] " << name << " regressed: " << measured << " ms, baseline " << baseline << " ms ("
+              << std::showpos << (measured / baseline - 1.0) * 100.0 << std::noshowpos << "%, limit " << Limit << " ms)" << std::endl;
+    return false;
+}
+
+bool
+PerfTest::writeBaseline(const Percentiles& cpu, const Percentiles& gpu) const {
+    std::ofstream File(mBaselinePath.c_str(), std::ios::trunc);
+    File << std::fixed << std::setprecision(3);
+    File << "# Frame time baseline in ms, written by --perf-baseline" << std::endl;
+    File << "# " << mFrameCount << " frames" << std::endl;
+    File << "renderer " << glGetString(GL_RENDERER) << std::endl;
+    File << "tolerance " << PERF_DEFAULT_TOLERANCE << std::endl;
+    File << "cpu_p50 " << cpu.P50 << std::endl << "cpu_p95 " << cpu.P95 << std::endl << "cpu_p99 " << cpu.P99 << std::endl;
+    File << "gpu_p50 " << gpu.P50 << std::endl << "gpu_p95 " << gpu.P95 << std::endl << "gpu_p99 " << gpu.P99 << std::endl;
+    if (!File) {
+        std::cerr << "[Err] Failed to write baseline " << mBaselinePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int
+PerfTest::Finish() {
+    glFinish();
+    std::vector<double> GpuMs(mCpuMs.size());
+    for (unsigned FrameIdx = 0; FrameIdx < GpuMs.size(); ++FrameIdx) {
+        GLuint64 Elapsed = 0;
+        glGetQueryObjectui64v(mQueries[FrameIdx], GL_QUERY_RESULT, &Elapsed);
+        GpuMs[FrameIdx] = Elapsed / 1e6;
+    }
+    if (mCpuMs.empty()) {
+        std::cerr << "[Err] Perf test ended before measuring a frame" << std::endl;
+        return -1;
+    }
+
+    Percentiles Cpu = computePercentiles(mCpuMs);
+    Percentiles Gpu = computePercentiles(GpuMs);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Perf test, " << mCpuMs.size() << " frames on " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << "  cpu p50 " << Cpu.P50 << " ms, p95 " << Cpu.P95 << " ms, p99 " << Cpu.P99 << " ms" << std::endl;
+    std::cout << "  gpu p50 " << Gpu.P50 << " ms, p95 " << Gpu.P95 << " ms, p99 " << Gpu.P99 << " ms" << std::endl;
+
+    if (mWriteBaseline) {
+        if (!writeBaseline(Cpu, Gpu)) {
+            return -1;
+        }
+        std::cout << "Wrote baseline " << mBaselinePath << std::endl;
+        return 0;
+    }
+
+    std::ifstream File(mBaselinePath.c_str());
+    if (!File) {
+        std::cerr << "[Err] No baseline at " << mBaselinePath << ", write one with --perf-baseline" << std::endl;
+        return -1;
+    }
+    std::map<std::string, double> Baseline;
+    std::string Renderer;
+    std::string Line;
+    while (std::getline(File, Line)) {
+        if (Line.empty() || Line[0] == '#') {
+            continue;
+        }
+        std::istringstream Fields(Line);
+        std::string Name;
+        double Value;
+        if (Line.compare(0, 9, "renderer ") == 0) {
+            Renderer = Line.substr(9);
+        } else if (Fields >> Name >> Value) {
+            Baseline[Name] = Value;
+        }
+    }
+
+    // NOTE: Timings only mean something on the machine that wrote them
+    std::string CurrentRenderer = (const char*)glGetString(GL_RENDERER);
+    if (Renderer.empty()) {
+        std::cerr << "[Err] Baseline " << mBaselinePath << " doesn't name its renderer, rewrite it with --perf-baseline" << std::endl;
+    } else if (Renderer != CurrentRenderer) {
+        std::cerr << "[Err] Baseline " << mBaselinePath << " was written on " << Renderer << ", not " << CurrentRenderer
+                  << ". Comparing anyway, regressions may be the hardware" << std::endl;
+    }
+
+    const char* Names[] = { "cpu_p50", "cpu_p95", "cpu_p99", "gpu_p50", "gpu_p95", "gpu_p99" };
+    const double Measured[] = { Cpu.P50, Cpu.P95, Cpu.P99, Gpu.P50, Gpu.P95, Gpu.P99 };
+    double Tolerance = Baseline.count("tolerance") ? Baseline["tolerance"] : PERF_DEFAULT_TOLERANCE;
+    bool Passed = true;
+    for (unsigned NameIdx = 0; NameIdx < sizeof(Names) / sizeof(Names[0]); ++NameIdx) {
+        if (!Baseline.count(Names[NameIdx])) {
+            std::cerr << "[Err] Baseline " << mBaselinePath << " has no " << Names[NameIdx] << std::endl;
+            Passed = false;
+            continue;
+        }
+        Passed = compare(Names[NameIdx], Measured[NameIdx], Baseline[Names[NameIdx]], Tolerance) && Passed;
+    }
+
+    std::cout << (Passed ? "Perf test passed" : "Perf test FAILED") << ", tolerance " << Tolerance * 100.0 << "%" << std::endl;
+    return Passed ? 0 : 1;
+}
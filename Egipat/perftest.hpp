@@ -0,0 +1,99 @@
+/**
+ * @file perftest.hpp
+ * @brief Frame time regression test. The main loop plays a camera path for a
+ * set number of frames at a fixed simulation step, without
+ * vsync or frame pacing. CPU and GPU frame time percentiles are compared
+ * against a baseline file and the run fails when one of them got slower
+ * than the baseline's tolerance allows
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "camerapath.hpp"
+
+#define PERF_DEFAULT_FRAMES 600
+// NOTE: Shader variants, texture streaming and terrain chunks settle first
+#define PERF_WARMUP_FRAMES 60
+#define PERF_DEFAULT_TOLERANCE 0.1
+// NOTE: Differences below this are noise whatever the tolerance says
+#define PERF_MIN_REGRESSION_MS 0.05
+
+class PerfTest {
+public:
+    PerfTest();
+    ~PerfTest();
+    PerfTest(const PerfTest&) = delete;
+    PerfTest& operator=(const PerfTest&) = delete;
+
+    /**
+     * @brief Starts measuring with the next BeginFrame
+     *
+     * @param frameCount - Measured frames, after the warmup
+     * @param baselinePath - Baseline file to compare against or write
+     * @param writeBaseline - Write the results as the new baseline instead of comparing
+     */
+    void Start(unsigned frameCount, const std::string& baselinePath, bool writeBaseline);
+
+    bool IsRunning() const { return mFrameCount != 0; }
+    bool IsDone() const { return mFrame >= PERF_WARMUP_FRAMES + mFrameCount; }
+
+    /**
+     * @brief Default camera path of the test, used unless --camera-path
+     * gives another one
+     *
+     */
+    static const CameraPath& GetFlythrough();
+
+    /**
+     * @brief Call at the top of the frame, before any GL command
+     *
+     */
+    void BeginFrame();
+
+    /**
+     * @brief Call right after swapping buffers
+     *
+     */
+    void EndFrame();
+
+    /**
+     * @brief Prints the percentiles and compares them with the baseline, or
+     * writes the baseline
+     *
+     * @returns Process exit code, non-zero on a regression or missing baseline
+     */
+    int Finish();
+
+private:
+    struct Percentiles {
+        double P50;
+        double P95;
+        double P99;
+    };
+
+    unsigned mFrameCount;
+    unsigned mFrame;
+    std::string mBaselinePath;
+    bool mWriteBaseline;
+    std::chrono::steady_clock::time_point mFrameStart;
+    std::vector<double> mCpuMs;
+    // NOTE: One query per measured frame, read once after the run
+    std::vector<unsigned> mQueries;
+
+    static Percentiles computePercentiles(std::vector<double> samples);
+    bool writeBaseline(const Percentiles& cpu, const Percentiles& gpu) const;
+
+    /**
+     * @brief Compares one percentile and reports it when it regressed
+     *
+     * @returns true - Within tolerance, false - Regression
+     */
+    static bool compare(const char* name, double measured, double baseline, double tolerance);
+};
@@ -0,0 +1,136 @@
+#include "ringbuffer.hpp"
+#include "gpumemory.hpp"
+
+#include <cstring>
+#include <iostream>
+
+// NOTE: Waiting longer than this means the GPU is hung, give up and overwrite
+static const GLuint64 FenceTimeout = 1000000000ull;
+
+RingBuffer::RingBuffer(GLenum target, size_t frameBytes, const char* owner)
+    : mTarget(target),
+      mId(0),
+      mFrameBytes(frameBytes),
+      mAlignment(16),
+      mMapped(0),
+      mRegion(0),
+      mHead(0),
+      mOverflowReported(false) {
+    for (unsigned RegionIdx = 0; RegionIdx < RING_FRAMES; ++RegionIdx) {
+        mFences[RegionIdx] = 0;
+    }
+    if (target == GL_UNIFORM_BUFFER) {
+        GLint Alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+        if (Alignment > 0) {
+            mAlignment = (size_t)Alignment;
+        }
+    }
+    mFrameBytes = (mFrameBytes + mAlignment - 1) / mAlignment * mAlignment;
+
+    mId = GpuMemory::CreateBuffer(target == GL_UNIFORM_BUFFER ? GPU_UNIFORM_BUFFER : GPU_STAGING_BUFFER, owner);
+    glBindBuffer(target, mId);
+    if (GLEW_ARB_buffer_storage || GLEW_VERSION_4_4) {
+        GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, mFrameBytes * RING_FRAMES, 0, Flags);
+        GpuMemory::SetBufferBytes(mId, mFrameBytes * RING_FRAMES);
+        mMapped = (unsigned char*)glMapBufferRange(target, 0, mFrameBytes * RING_FRAMES, Flags);
+        if (!mMapped) {
+            std::cerr << "[Err] Failed to map ring buffer, falling back to orphaning" << std::endl;
+            // NOTE: Immutable storage can't be respecified, start over with a fresh name
+            GpuMemory::DeleteBuffer(mId);
+            mId = GpuMemory::CreateBuffer(target == GL_UNIFORM_BUFFER ? GPU_UNIFORM_BUFFER : GPU_STAGING_BUFFER, owner);
+            glBindBuffer(target, mId);
+        }
+    }
+    if (!mMapped) {
+        // NOTE: The driver keeps the orphaned storage alive while the GPU
+        // reads it, so a single region is enough
+        GpuMemory::BufferData(mId, target, mFrameBytes, 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer(target, 0);
+}
+
+RingBuffer::~RingBuffer() {
+    for (unsigned RegionIdx = 0; RegionIdx < RING_FRAMES; ++RegionIdx) {
+        if (mFences[RegionIdx]) {
+            glDeleteSync(mFences[RegionIdx]);
+        }
+    }
+    if (mMapped) {
+        glBindBuffer(mTarget, mId);
+        glUnmapBuffer(mTarget);
+        glBindBuffer(mTarget, 0);
+    }
+    GpuMemory::DeleteBuffer(mId);
+}
+
+void
+RingBuffer::BeginFrame() {
+    mHead = 0;
+    if (!mMapped) {
+        glBindBuffer(mTarget, mId);
+        GpuMemory::BufferData(mId, mTarget, mFrameBytes, 0, GL_STREAM_DRAW);
+        glBindBuffer(mTarget, 0);
+        return;
+    }
+
+    mRegion = (mRegion + 1) % RING_FRAMES;
+    GLsync Fence = mFences[mRegion];
+    if (!Fence) {
+        return;
+    }
+    GLenum Status = glClientWaitSync(Fence, 0, 0);
+    if (Status == GL_TIMEOUT_EXPIRED) {
+        Status = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+    }
+    if (Status == GL_TIMEOUT_EXPIRED || Status == GL_WAIT_FAILED) {
+        std::cerr << "[Err] Ring buffer fence wait failed" << std::endl;
+    }
+    glDeleteSync(Fence);
+    mFences[mRegion] = 0;
+}
+
+void
+RingBuffer::EndFrame() {
+    if (!mMapped) {
+        return;
+    }
+    if (mFences[mRegion]) {
+        glDeleteSync(mFences[mRegion]);
+    }
+    mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t
+RingBuffer::Write(const void* data, size_t size) {
+    size_t Aligned = (size + mAlignment - 1) / mAlignment * mAlignment;
+    if (mHead + Aligned > mFrameBytes) {
+        if (!mOverflowReported) {
+            std::cerr << "[Err] Ring buffer region of " << mFrameBytes << " bytes is full" << std::endl;
+            mOverflowReported = true;
+        }
+        return RING_INVALID_OFFSET;
+    }
+
+    size_t Offset = mRegion * mFrameBytes + mHead;
+    if (mMapped) {
+        std::memcpy(mMapped + Offset, data, size);
+    } else {
+        glBindBuffer(mTarget, mId);
+        glBufferSubData(mTarget, Offset, size, data);
+        glBindBuffer(mTarget, 0);
+    }
+    mHead += Aligned;
+    return Offset;
+}
+
+bool
+RingBuffer::WriteAndBind(unsigned index, const void* data, size_t size) {
+    size_t Offset = Write(data, size);
+    if (Offset == RING_INVALID_OFFSET) {
+        return false;
+    }
+    glBindBufferRange(mTarget, index, mId, Offset, size);
+    return true;
+}
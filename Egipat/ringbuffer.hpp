@@ -0,0 +1,85 @@
+/**
+ * @file ringbuffer.hpp
+ * @brief Streaming buffer for data that changes every frame. Each frame
+ * writes linearly into its own region and the data is bound by offset, so
+ * per-draw constants cost a copy into mapped memory instead of a uniform call.
+ * With ARB_buffer_storage the buffer stays persistently mapped and regions are
+ * guarded by fences, otherwise the whole buffer is orphaned once per frame
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+// NOTE: Regions the GPU may still be reading while the CPU writes the next one
+#define RING_FRAMES 3
+#define RING_INVALID_OFFSET ((size_t)-1)
+
+class RingBuffer {
+public:
+    /**
+     * @brief Ctor
+     *
+     * @param target - Binding target the data is consumed through
+     * @param frameBytes - Space available to a single frame
+     * @param owner - Owning system, shown in GPU memory reports
+     */
+    RingBuffer(GLenum target, size_t frameBytes, const char* owner);
+    ~RingBuffer();
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /**
+     * @brief Moves to the next region, waiting on its fence if the GPU hasn't
+     * consumed it yet
+     *
+     */
+    void BeginFrame();
+
+    /**
+     * @brief Fences the current region. Call after the last draw reading it
+     *
+     */
+    void EndFrame();
+
+    /**
+     * @brief Copies data into the current region
+     *
+     * @param data - Source
+     * @param size - Size in bytes
+     *
+     * @returns Buffer offset of the copy, RING_INVALID_OFFSET once the region is full
+     */
+    size_t Write(const void* data, size_t size);
+
+    /**
+     * @brief Writes data and binds it to an indexed binding point
+     *
+     * @param index - Binding point
+     * @param data - Source
+     * @param size - Size in bytes
+     *
+     * @returns True if the data fit into the region
+     */
+    bool WriteAndBind(unsigned index, const void* data, size_t size);
+
+    unsigned GetId() const { return mId; }
+    bool IsPersistent() const { return mMapped != 0; }
+    size_t GetUsedBytes() const { return mHead; }
+
+private:
+    GLenum mTarget;
+    unsigned mId;
+    size_t mFrameBytes;
+    size_t mAlignment;
+    unsigned char* mMapped;
+    GLsync mFences[RING_FRAMES];
+    unsigned mRegion;
+    size_t mHead;
+    bool mOverflowReported;
+};
@@ -1,10 +1,45 @@
 #include "shader.hpp"
+#include "filecache.hpp"
 
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+struct ProgramCacheHeader {
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t Format;
+    uint32_t Length;
+};
+
+static const uint32_t ProgramCacheVersion = 1;
+
+// NOTE: Programs whose compile and link were issued but whose status hasn't
+// been read back yet. Reading status is what stalls on the driver
+struct PendingProgram {
+    unsigned Program;
+    unsigned Vertex;
+    unsigned Fragment;
+    std::string VertexPath;
+    std::string FragmentPath;
+    bool Cache;
+    uint64_t Key;
+};
+
+static std::vector<PendingProgram> PendingPrograms;
 
 Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath) {
+    mId = createProgram(vShaderPath, fShaderPath, std::vector<std::string>());
+}
+
+Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath, const std::vector<std::string>& defines) {
+    mId = createProgram(vShaderPath, fShaderPath, defines);
+}
+
+Shader::Shader(const std::string& vShaderPath, const std::vector<std::string>& feedbackVaryings) {
     unsigned vs = loadAndCompileShader(vShaderPath, GL_VERTEX_SHADER);
-    unsigned fs = loadAndCompileShader(fShaderPath, GL_FRAGMENT_SHADER);
-    mId = createBasicProgram(vs, fs);
+    mId = createFeedbackProgram(vs, feedbackVaryings);
 }
 
 void
@@ -27,9 +62,33 @@ Shader::SetUniform4m(const std::string& uniform, const glm::mat4& m) const {
     glUniformMatrix4fv(glGetUniformLocation(mId, uniform.c_str()), 1, GL_FALSE, &m[0][0]);
 }
 
+void
+Shader::SetUniform3m(const std::string& uniform, const glm::mat3& m) const {
+    glUniformMatrix3fv(glGetUniformLocation(mId, uniform.c_str()), 1, GL_FALSE, &m[0][0]);
+}
+
+void
+Shader::SetUniform1iv(const std::string& uniform, const int* v, unsigned count) const {
+    glUniform1iv(glGetUniformLocation(mId, uniform.c_str()), count, v);
+}
+
+void
+Shader::BindUniformBlock(const std::string& block, unsigned binding) const {
+    unsigned BlockIndex = glGetUniformBlockIndex(mId, block.c_str());
+    if (BlockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(mId, BlockIndex, binding);
+    }
+}
+
 void
 Shader::SetModel(const glm::mat4& m) const {
+    SetModel(m, glm::transpose(glm::inverse(glm::mat3(m))));
+}
+
+void
+Shader::SetModel(const glm::mat4& m, const glm::mat3& normal) const {
     SetUniform4m("uModel", m);
+    SetUniform3m("uNormalMatrix", normal);
 }
 
 void
@@ -47,9 +106,8 @@ Shader::GetId() const {
     return mId;
 }
 
-unsigned
-Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
-    unsigned ShaderID = 0;
+std::string
+Shader::loadSource(const std::string& filename, const std::vector<std::string>& defines) {
     std::ifstream In(filename);
     std::string Str;
 
@@ -58,33 +116,278 @@ Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
     In.seekg(0, std::ios::beg);
 
     Str.assign((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
-    const char* CharContent = Str.c_str();
 
-    ShaderID = glCreateShader(shaderType);
+    // NOTE: #version has to stay the first line, defines go right after it
+    if (!defines.empty()) {
+        std::string Defines;
+        for (unsigned DefineIdx = 0; DefineIdx < defines.size(); ++DefineIdx) {
+            Defines += "#define " + defines[DefineIdx] + "\n";
+        }
+        size_t VersionEnd = Str.compare(0, 8, "#version") == 0 ? Str.find('\n') : std::string::npos;
+        Str.insert(VersionEnd == std::string::npos ? 0 : VersionEnd + 1, Defines);
+    }
+
+    return Str;
+}
+
+unsigned
+Shader::compileShader(const std::string& source, GLuint shaderType) {
+    const char* CharContent = source.c_str();
+
+    unsigned ShaderID = glCreateShader(shaderType);
     glShaderSource(ShaderID, 1, &CharContent, NULL);
     glCompileShader(ShaderID);
 
+    return ShaderID;
+}
+
+bool
+Shader::checkShader(unsigned shader, GLuint shaderType, const std::string& filename) {
     int Success;
     char InfoLog[512];
-    glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &Success);
     if (!Success) {
-        glGetShaderInfoLog(ShaderID, 256, NULL, InfoLog);
+        glGetShaderInfoLog(shader, 256, NULL, InfoLog);
         std::string ShaderTypeName = shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment";
         std::cout << "Error while compiling shader [" << ShaderTypeName << "]:" << std::endl << InfoLog << std::endl;
-        return 0;
+        return false;
     }
 
     std::cout << "Loaded " << filename << " shader" << std::endl;
 
+    return true;
+}
+
+unsigned
+Shader::loadAndCompileShader(std::string filename, GLuint shaderType, const std::vector<std::string>& defines) {
+    unsigned ShaderID = compileShader(loadSource(filename, defines), shaderType);
+    if (!checkShader(ShaderID, shaderType, filename)) {
+        glDeleteShader(ShaderID);
+        return 0;
+    }
     return ShaderID;
 }
 
+void
+Shader::EnableParallelCompile() {
+    if (GLEW_KHR_parallel_shader_compile) {
+        // NOTE: 0xFFFFFFFF lets the driver pick the thread count
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+}
+
+bool
+Shader::PollPending() {
+    // NOTE: Without the extension there's no way to ask without blocking,
+    // report done and let FinishPending take the hit
+    if (!GLEW_KHR_parallel_shader_compile) {
+        return true;
+    }
+
+    for (unsigned PendingIdx = 0; PendingIdx < PendingPrograms.size(); ++PendingIdx) {
+        int Done = 0;
+        glGetProgramiv(PendingPrograms[PendingIdx].Program, GL_COMPLETION_STATUS_KHR, &Done);
+        if (!Done) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned
+Shader::FinishPending() {
+    unsigned Failed = 0;
+    for (unsigned PendingIdx = 0; PendingIdx < PendingPrograms.size(); ++PendingIdx) {
+        if (!finishProgram(PendingPrograms[PendingIdx])) {
+            ++Failed;
+        }
+    }
+    PendingPrograms.clear();
+    return Failed;
+}
+
+bool
+Shader::Finish() const {
+    for (unsigned PendingIdx = 0; PendingIdx < PendingPrograms.size(); ++PendingIdx) {
+        if (PendingPrograms[PendingIdx].Program == mId) {
+            bool Success = finishProgram(PendingPrograms[PendingIdx]);
+            PendingPrograms.erase(PendingPrograms.begin() + PendingIdx);
+            return Success;
+        }
+    }
+    return true;
+}
+
+unsigned
+Shader::GetPendingCount() {
+    return (unsigned)PendingPrograms.size();
+}
+
+bool
+Shader::binaryCacheSupported() {
+    if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1) {
+        return false;
+    }
+    GLint FormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+    return FormatCount > 0;
+}
+
+uint64_t
+Shader::programKey(const std::string& vSource, const std::string& fSource) {
+    uint64_t Key = FileCache::Hash(vSource);
+    Key = FileCache::Hash(fSource, Key);
+
+    // NOTE: Binaries are only valid for the driver that produced them
+    const GLenum DriverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (unsigned StringIdx = 0; StringIdx < 3; ++StringIdx) {
+        const char* Str = (const char*)glGetString(DriverStrings[StringIdx]);
+        Key = FileCache::Hash(Str ? std::string(Str) : std::string(), Key);
+    }
+
+    GLint FormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+    std::vector<GLint> Formats(FormatCount);
+    if (FormatCount) {
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, Formats.data());
+    }
+    return FileCache::Hash(Formats.data(), Formats.size() * sizeof(GLint), Key);
+}
+
+std::string
+Shader::programCachePath(uint64_t key) {
+    std::ostringstream Name;
+    Name << "program_" << std::hex << key << ".bin";
+    return FileCache::GetPath(Name.str());
+}
+
+unsigned
+Shader::loadProgramBinary(uint64_t key) {
+    std::vector<unsigned char> Data;
+    if (!FileCache::ReadFile(programCachePath(key), Data) || Data.size() < sizeof(ProgramCacheHeader)) {
+        return 0;
+    }
+
+    ProgramCacheHeader Header;
+    std::memcpy(&Header, Data.data(), sizeof(Header));
+    if (std::memcmp(Header.Magic, "EPRG", 4) || Header.Version != ProgramCacheVersion
+        || Header.Key != key || Data.size() != sizeof(Header) + Header.Length) {
+        return 0;
+    }
+
+    unsigned ProgramID = glCreateProgram();
+    glProgramBinary(ProgramID, Header.Format, Data.data() + sizeof(Header), Header.Length);
+
+    // NOTE: Drivers reject binaries after updates, caller recompiles
+    int Success;
+    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
+    if (!Success) {
+        glDeleteProgram(ProgramID);
+        return 0;
+    }
+    return ProgramID;
+}
+
+void
+Shader::storeProgramBinary(uint64_t key, unsigned program) {
+    GLint Length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &Length);
+    if (Length <= 0) {
+        return;
+    }
+
+    std::vector<unsigned char> Data(sizeof(ProgramCacheHeader) + Length);
+    GLenum Format = 0;
+    GLsizei Written = 0;
+    glGetProgramBinary(program, Length, &Written, &Format, Data.data() + sizeof(ProgramCacheHeader));
+    if (Written <= 0) {
+        return;
+    }
+
+    ProgramCacheHeader Header;
+    std::memcpy(Header.Magic, "EPRG", 4);
+    Header.Version = ProgramCacheVersion;
+    Header.Key = key;
+    Header.Format = Format;
+    Header.Length = (uint32_t)Written;
+    std::memcpy(Data.data(), &Header, sizeof(Header));
+    FileCache::WriteFile(programCachePath(key), Data.data(), sizeof(Header) + Written);
+}
+
 unsigned
-Shader::createBasicProgram(unsigned vShader, unsigned fShader) {
-    unsigned ProgramID = 0;
-    ProgramID = glCreateProgram();
+Shader::createProgram(const std::string& vShaderPath, const std::string& fShaderPath, const std::vector<std::string>& defines) {
+    std::string VertexSource = loadSource(vShaderPath, defines);
+    std::string FragmentSource = loadSource(fShaderPath, defines);
+
+    bool UseCache = binaryCacheSupported();
+    uint64_t Key = 0;
+    if (UseCache) {
+        Key = programKey(VertexSource, FragmentSource);
+        unsigned ProgramID = loadProgramBinary(Key);
+        if (ProgramID) {
+            std::cout << "Loaded " << vShaderPath << " + " << fShaderPath << " program from cache" << std::endl;
+            return ProgramID;
+        }
+    }
+
+    // NOTE: Nothing here queries status, so drivers that compile on their own
+    // threads keep working while textures and meshes load
+    PendingProgram Pending;
+    Pending.Vertex = compileShader(VertexSource, GL_VERTEX_SHADER);
+    Pending.Fragment = compileShader(FragmentSource, GL_FRAGMENT_SHADER);
+    Pending.VertexPath = vShaderPath;
+    Pending.FragmentPath = fShaderPath;
+    Pending.Cache = UseCache;
+    Pending.Key = Key;
+
+    Pending.Program = glCreateProgram();
+    glAttachShader(Pending.Program, Pending.Vertex);
+    glAttachShader(Pending.Program, Pending.Fragment);
+    if (UseCache) {
+        glProgramParameteri(Pending.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(Pending.Program);
+
+    PendingPrograms.push_back(Pending);
+    return Pending.Program;
+}
+
+bool
+Shader::finishProgram(const PendingProgram& pending) {
+    bool Compiled = checkShader(pending.Vertex, GL_VERTEX_SHADER, pending.VertexPath);
+    Compiled = checkShader(pending.Fragment, GL_FRAGMENT_SHADER, pending.FragmentPath) && Compiled;
+
+    int Success = 0;
+    if (Compiled) {
+        char InfoLog[512];
+        glGetProgramiv(pending.Program, GL_LINK_STATUS, &Success);
+        if (!Success) {
+            glGetProgramInfoLog(pending.Program, 512, NULL, InfoLog);
+            std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
+        }
+    }
+
+    glDetachShader(pending.Program, pending.Vertex);
+    glDetachShader(pending.Program, pending.Fragment);
+    glDeleteShader(pending.Vertex);
+    glDeleteShader(pending.Fragment);
+
+    if (Success && pending.Cache) {
+        storeProgramBinary(pending.Key, pending.Program);
+    }
+    return Success != 0;
+}
+
+unsigned
+Shader::createFeedbackProgram(unsigned vShader, const std::vector<std::string>& feedbackVaryings) {
+    unsigned ProgramID = glCreateProgram();
     glAttachShader(ProgramID, vShader);
-    glAttachShader(ProgramID, fShader);
+
+    std::vector<const char*> Varyings;
+    for (unsigned VaryingIdx = 0; VaryingIdx < feedbackVaryings.size(); ++VaryingIdx) {
+        Varyings.push_back(feedbackVaryings[VaryingIdx].c_str());
+    }
+    glTransformFeedbackVaryings(ProgramID, (GLsizei)Varyings.size(), Varyings.data(), GL_INTERLEAVED_ATTRIBS);
     glLinkProgram(ProgramID);
 
     int Success;
@@ -92,14 +395,12 @@ Shader::createBasicProgram(unsigned vShader, unsigned fShader) {
     glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
     if (!Success) {
         glGetProgramInfoLog(ProgramID, 512, NULL, InfoLog);
-        std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
+        std::cerr << "[Err] Failed to link feedback program:" << std::endl << InfoLog << std::endl;
         return 0;
     }
 
     glDetachShader(ProgramID, vShader);
-    glDetachShader(ProgramID, fShader);
     glDeleteShader(vShader);
-    glDeleteShader(fShader);
 
     return ProgramID;
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+struct PendingProgram;
+
 class Shader {
 public:
     static const unsigned POSITION_LOCATION = 0;
@@ -18,6 +21,61 @@ public:
      */
     Shader(const std::string& vShaderPath, const std::string& fShaderPath);
 
+    /**
+     * @brief Ctor - compiles both stages with preprocessor defines injected
+     * after the #version line
+     *
+     * @param vShaderPath Vertex shader file path
+     * @param fShaderPath Fragment shader file path
+     * @param defines Define bodies, e.g. "HAS_SPECULAR" or "POINT_LIGHT_COUNT 2"
+     */
+    Shader(const std::string& vShaderPath, const std::string& fShaderPath, const std::vector<std::string>& defines);
+
+    /**
+     * @brief Ctor - vertex only program whose outputs are captured with transform feedback
+     *
+     * @param vShaderPath Vertex shader file path
+     * @param feedbackVaryings Captured vertex shader outputs, written interleaved
+     */
+    Shader(const std::string& vShaderPath, const std::vector<std::string>& feedbackVaryings);
+
+    /**
+     * @brief Lets the driver compile on background threads when
+     * GL_KHR_parallel_shader_compile is available. Call once after glewInit
+     *
+     */
+    static void EnableParallelCompile();
+
+    /**
+     * @brief Checks without blocking whether every issued program finished
+     * compiling and linking
+     *
+     * @returns True if FinishPending won't stall, always true without
+     * GL_KHR_parallel_shader_compile
+     */
+    static bool PollPending();
+
+    /**
+     * @brief Reads back compile and link status of every issued program,
+     * logs failures and stores the cached binaries
+     *
+     * @returns Number of programs that failed
+     */
+    static unsigned FinishPending();
+
+    /**
+     * @brief Number of programs issued but not finished yet
+     *
+     */
+    static unsigned GetPendingCount();
+
+    /**
+     * @brief Finishes only this program, for programs created after startup
+     *
+     * @returns True if the program compiled and linked
+     */
+    bool Finish() const;
+
     /**
      * @brief Gets shader ID
      *
@@ -57,6 +115,32 @@ public:
      */
     void SetUniform4m(const std::string& uniform, const glm::mat4& m) const;
 
+    /**
+     * @brief Sets 3x3 matrix uniform value
+     *
+     * @param uniform Name of uniform
+     * @param m GLM matrix
+     */
+    void SetUniform3m(const std::string& uniform, const glm::mat3& m) const;
+
+    /**
+     * @brief Sets int array uniform value
+     *
+     * @param uniform Name of uniform
+     * @param v Values
+     * @param count Value count
+     */
+    void SetUniform1iv(const std::string& uniform, const int* v, unsigned count) const;
+
+    /**
+     * @brief Assigns a uniform block to a buffer binding point. Blocks the
+     * program doesn't use are ignored
+     *
+     * @param block Name of uniform block
+     * @param binding Binding point index
+     */
+    void BindUniformBlock(const std::string& block, unsigned binding) const;
+
     /**
      * @brief Sets the Model matrix
      *
@@ -64,6 +148,14 @@ public:
      */
     void SetModel(const glm::mat4& m) const;
 
+    /**
+     * @brief Sets the Model matrix and its precomputed Normal matrix
+     *
+     * @param m Model matrix
+     * @param normal Normal matrix, transpose(inverse(mat3(m)))
+     */
+    void SetModel(const glm::mat4& m, const glm::mat3& normal) const;
+
     /**
      * @brief Sets the View matrix
      *
@@ -80,22 +172,108 @@ public:
 private:
     unsigned mId;
 
+    /**
+     * @brief Reads a shader source and injects defines after the #version line
+     *
+     * @param filename File path to be loaded
+     * @param defines Define bodies
+     *
+     * @returns Source text
+     */
+    std::string loadSource(const std::string& filename, const std::vector<std::string>& defines);
+
+    /**
+     * @brief Issues a shader compile without waiting for its status
+     *
+     * @param source Source text
+     * @param shaderType Type of shader: vertex or fragment
+     *
+     * @returns Shader's ID
+     */
+    static unsigned compileShader(const std::string& source, GLuint shaderType);
+
+    /**
+     * @brief Reads back compile status, blocks until the compile is done
+     *
+     * @param shader Shader's ID
+     * @param shaderType Type of shader: vertex or fragment
+     * @param filename File path, for logging
+     *
+     * @returns True if the shader compiled
+     */
+    static bool checkShader(unsigned shader, GLuint shaderType, const std::string& filename);
+
+    /**
+     * @brief Checks and cleans up an issued program
+     *
+     * @param pending Issued program
+     *
+     * @returns True if both stages compiled and the program linked
+     */
+    static bool finishProgram(const PendingProgram& pending);
+
+    /**
+     * @brief Builds a vertex + fragment program, from the program binary
+     * cache when the driver supports it and a valid entry exists. Otherwise
+     * compile and link are only issued and the program stays pending until
+     * Finish or FinishPending
+     *
+     * @param vShaderPath Vertex shader file path
+     * @param fShaderPath Fragment shader file path
+     * @param defines Define bodies
+     *
+     * @returns Shader program ID
+     */
+    unsigned createProgram(const std::string& vShaderPath, const std::string& fShaderPath, const std::vector<std::string>& defines);
+
+    /**
+     * @brief Checks for program binary support with at least one binary format
+     *
+     */
+    static bool binaryCacheSupported();
+
+    /**
+     * @brief Cache key of a program: sources (with defines), driver vendor,
+     * renderer and version strings and the supported binary formats
+     *
+     */
+    static uint64_t programKey(const std::string& vSource, const std::string& fSource);
+    static std::string programCachePath(uint64_t key);
+
+    /**
+     * @brief Creates a program from a cached binary
+     *
+     * @param key Program cache key
+     *
+     * @returns Linked program ID, 0 if there's no entry or the driver rejected it
+     */
+    static unsigned loadProgramBinary(uint64_t key);
+
+    /**
+     * @brief Writes a linked program's binary to the cache
+     *
+     * @param key Program cache key
+     * @param program Linked program ID
+     */
+    static void storeProgramBinary(uint64_t key, unsigned program);
+
     /**
      * @brief Loads shader from file and returns the compiled shader's ID
      *
      * @param filename File path to be loaded
      * @param shadertType Type of shader: vertex or fragment
+     * @param defines Define bodies injected after the #version line
      *
      * @returns Compiled shader's ID
      */
-    unsigned loadAndCompileShader(std::string filename, GLuint shaderType);
+    unsigned loadAndCompileShader(std::string filename, GLuint shaderType, const std::vector<std::string>& defines = std::vector<std::string>());
     /**
-     * @brief Creates a shader program and returns the ID
+     * @brief Creates a vertex only transform feedback program and returns the ID
      *
-     * @param filename File path to be loaded
-     * @param shadertType Type of shader: vertex or fragment
+     * @param vShader Vertex shader ID
+     * @param feedbackVaryings Captured outputs
      *
      * @returns Shader program ID
      */
-    unsigned createBasicProgram(unsigned vShader, unsigned fShader);
+    unsigned createFeedbackProgram(unsigned vShader, const std::vector<std::string>& feedbackVaryings);
 };
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (std140) uniform Object {
+	vec4 uMin;
+	vec4 uMax;
+	vec4 uColor;
+};
+
+out vec4 FragColor;
+
+void main() {
+	FragColor = vec4(uColor.rgb, 1.0f);
+}
\ No newline at end of file
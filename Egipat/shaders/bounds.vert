@@ -0,0 +1,20 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Camera {
+	mat4 uProjection;
+	mat4 uView;
+	vec4 uViewPos;
+};
+
+// NOTE: Mirrors OcclusionCuller::BoundsUniforms
+layout (std140) uniform Object {
+	vec4 uMin;
+	vec4 uMax;
+	vec4 uColor;
+};
+
+void main() {
+	gl_Position = uProjection * uView * vec4(mix(uMin.xyz, uMax.xyz, aPos), 1.0f);
+}
\ No newline at end of file
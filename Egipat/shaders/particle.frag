@@ -0,0 +1,20 @@
+#version 330 core
+
+// NOTE: Alpha is the opacity
+layout (std140) uniform Object {
+	vec4 uColor;
+	vec4 uSize;
+};
+
+in vec2 vCorner;
+in float vFade;
+
+out vec4 FragColor;
+
+void main() {
+	float Radius = dot(vCorner, vCorner);
+	if (Radius > 1.0f) {
+		discard;
+	}
+	FragColor = vec4(uColor.rgb, (1.0f - Radius) * vFade * uColor.a);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aPositionAge;
+layout (location = 2) in vec4 aVelocityLifetime;
+
+layout (std140) uniform Camera {
+	mat4 uProjection;
+	mat4 uView;
+	vec4 uViewPos;
+};
+
+// NOTE: Mirrors ParticleSystem::RenderUniforms
+layout (std140) uniform Object {
+	vec4 uColor;
+	vec4 uSize;
+};
+
+out vec2 vCorner;
+out float vFade;
+
+void main() {
+	vec3 Right = vec3(uView[0][0], uView[1][0], uView[2][0]);
+	vec3 Up = vec3(uView[0][1], uView[1][1], uView[2][1]);
+
+	float Life = aPositionAge.w / aVelocityLifetime.w;
+	vFade = smoothstep(0.0f, 0.1f, Life) * (1.0f - smoothstep(0.7f, 1.0f, Life));
+	vCorner = aCorner;
+
+	vec3 WorldPosition = aPositionAge.xyz + (Right * aCorner.x + Up * aCorner.y) * uSize.x;
+	gl_Position = uProjection * uView * vec4(WorldPosition, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#version 330 core
+
+// NOTE: Must stay in sync with ParticleSystem::updateRange and
+// ParticleSystem::respawn so both backends simulate the same way
+
+layout (location = 0) in vec4 aPositionAge;
+layout (location = 1) in vec4 aVelocityLifetime;
+
+uniform float uDt;
+uniform float uTime;
+uniform uint uFrame;
+uniform vec3 uWind;
+uniform vec3 uEmitterMin;
+uniform vec3 uEmitterMax;
+uniform float uLifetime;
+uniform float uGravity;
+uniform float uDrag;
+uniform float uTurbulence;
+
+out vec4 vPositionAge;
+out vec4 vVelocityLifetime;
+
+uint hash(uint x) {
+	x ^= x >> 16u;
+	x *= 0x7feb352du;
+	x ^= x >> 15u;
+	x *= 0x846ca68bu;
+	x ^= x >> 16u;
+	return x;
+}
+
+float random(inout uint state) {
+	state = hash(state);
+	return float(state & 0xFFFFFFu) / 16777216.0f;
+}
+
+float fastSin(float x) {
+	x = x - 6.28318531f * floor((x + 3.14159265f) / 6.28318531f);
+	float Y = 1.27323954f * x - 0.405284735f * x * abs(x);
+	return 0.225f * (Y * abs(Y) - Y) + Y;
+}
+
+void main() {
+	vec3 Position = aPositionAge.xyz;
+	vec3 Velocity = aVelocityLifetime.xyz;
+	float Age = aPositionAge.w + uDt;
+	float Lifetime = aVelocityLifetime.w;
+
+	if (Age >= Lifetime) {
+		uint State = uint(gl_VertexID) * 747796405u + uFrame * 2891336453u;
+		float RX = random(State);
+		float RY = random(State);
+		float RZ = random(State);
+		float Speed = 0.5f + random(State);
+		float Life = 0.5f + random(State);
+
+		Position = uEmitterMin + (uEmitterMax - uEmitterMin) * vec3(RX, RY, RZ);
+		Velocity = uWind * Speed;
+		Lifetime = uLifetime * Life;
+		Age = 0.0f;
+	} else {
+		vec3 Gust = vec3(fastSin(Position.z * 0.5f + uTime),
+		                 fastSin(Position.x * 0.7f + uTime * 1.3f) * 0.3f,
+		                 fastSin(Position.x * 0.5f + uTime * 0.9f + 1.57f));
+		Velocity += ((uWind - Velocity) * uDrag + Gust * uTurbulence) * uDt;
+		Velocity.y -= uGravity * uDt;
+		Position += Velocity * uDt;
+		if (Position.y < 0.0f) {
+			Position.y = 0.0f;
+			Velocity.y = -Velocity.y * 0.3f;
+		}
+	}
+
+	vPositionAge = vec4(Position, Age);
+	vVelocityLifetime = vec4(Velocity, Lifetime);
+}
\ No newline at end of file
@@ -3,10 +3,24 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTex;
 layout (location = 2) in vec3 aNormal;
+#ifdef TEXTURE_ARRAY
+// NOTE: Diffuse and specular layers, see Model batches
+layout (location = 3) in vec2 aLayers;
+flat out vec2 vLayers;
+#endif
 
-uniform mat4 uProjection;
-uniform mat4 uView;
-uniform mat4 uModel;
+layout (std140) uniform Camera {
+	mat4 uProjection;
+	mat4 uView;
+	vec4 uViewPos;
+};
+
+// NOTE: Per-draw data, bound as a range of the frame ring buffer
+layout (std140) uniform Object {
+	mat4 uModel;
+	mat3 uNormalMatrix;
+	ivec4 uPointLightIndices;
+};
 
 out vec2 TexCoords;
 out vec3 vWorldSpaceFragment;
@@ -14,8 +28,11 @@ out vec3 vWorldSpaceNormal;
 
 void main() {
 	vWorldSpaceFragment = vec3(uModel * vec4(aPos, 1.0f));
-	vWorldSpaceNormal = normalize(mat3(transpose(inverse(uModel))) * aNormal);
+	vWorldSpaceNormal = normalize(uNormalMatrix * aNormal);
 
 	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
 	TexCoords = aTex;
+#ifdef TEXTURE_ARRAY
+	vLayers = aLayers;
+#endif
 }
\ No newline at end of file
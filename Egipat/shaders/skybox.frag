@@ -0,0 +1,11 @@
+#version 330 core
+
+uniform samplerCube uSkybox;
+
+in vec3 vDirection;
+
+out vec4 FragColor;
+
+void main() {
+	FragColor = vec4(texture(uSkybox, vDirection).rgb, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Camera {
+	mat4 uProjection;
+	mat4 uView;
+	vec4 uViewPos;
+};
+
+out vec3 vDirection;
+
+void main() {
+	vDirection = aPos;
+	// NOTE: Rotation only, the sky is infinitely far away
+	vec4 Position = uProjection * mat4(mat3(uView)) * vec4(aPos, 1.0f);
+	gl_Position = Position.xyww;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "shadervariants.hpp"
+#include "frameuniforms.hpp"
+
+ShaderVariants::ShaderVariants(const std::string& vShaderPath, const std::string& fShaderPath,
+                               const std::function<void(const Shader&)>& setup)
+    : mVertexPath(vShaderPath),
+      mFragmentPath(fShaderPath),
+      mSetup(setup) {
+}
+
+void
+ShaderVariants::Prepare(unsigned key) {
+    if (mVariants.find(key) == mVariants.end()) {
+        mVariants.insert(std::make_pair(key, Variant(Shader(mVertexPath, mFragmentPath, GetDefines(key)))));
+    }
+}
+
+const Shader&
+ShaderVariants::Get(unsigned key) {
+    Prepare(key);
+    Variant& Found = mVariants.find(key)->second;
+    if (Found.Configured) {
+        return Found.Program;
+    }
+
+    // NOTE: Setup is the first status query, so it waits for the compile
+    Found.Program.Finish();
+    Found.Configured = true;
+
+    GLint Program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &Program);
+    glUseProgram(Found.Program.GetId());
+    Found.Program.BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    Found.Program.BindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    Found.Program.BindUniformBlock("Object", OBJECT_BLOCK_BINDING);
+    if (mSetup) {
+        mSetup(Found.Program);
+    }
+    glUseProgram(Program);
+
+    return Found.Program;
+}
+
+const Shader&
+ShaderVariants::Use(unsigned key) {
+    const Shader& Variant = Get(key);
+    glUseProgram(Variant.GetId());
+    return Variant;
+}
+
+std::vector<std::string>
+ShaderVariants::GetDefines(unsigned key) {
+    std::vector<std::string> Defines;
+    Defines.push_back("MAX_POINT_LIGHTS " + std::to_string(MAX_POINT_LIGHTS));
+    Defines.push_back("POINT_LIGHT_COUNT " + std::to_string(key >> SHADER_LIGHT_COUNT_SHIFT));
+    if (key & SHADER_HAS_SPECULAR) {
+        Defines.push_back("HAS_SPECULAR");
+    }
+    if (key & SHADER_ALPHA_TEST) {
+        Defines.push_back("ALPHA_TEST");
+    }
+    if (key & SHADER_TEXTURE_ARRAY) {
+        Defines.push_back("TEXTURE_ARRAY");
+    }
+    return Defines;
+}
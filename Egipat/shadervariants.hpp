@@ -0,0 +1,107 @@
+/**
+ * @file shadervariants.hpp
+ * @brief Permutations of one shader source. Each feature key compiles the
+ * source with matching #defines once and the program is reused afterwards,
+ * so every draw only pays for the lights and texture fetches it needs
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "shader.hpp"
+
+enum EShaderFeature {
+    SHADER_HAS_SPECULAR = 1 << 0,
+    SHADER_ALPHA_TEST = 1 << 1,
+    // NOTE: Materials come from TextureArrays, layers are a vertex attribute
+    SHADER_TEXTURE_ARRAY = 1 << 2,
+};
+
+#define SHADER_LIGHT_COUNT_SHIFT 8
+
+/**
+ * @brief Builds a variant key
+ *
+ * @param features - EShaderFeature flags
+ * @param pointLightCount - Point lights evaluated by the variant
+ *
+ * @returns Variant key
+ */
+inline unsigned
+MakeShaderKey(unsigned features, unsigned pointLightCount) {
+    return features | (pointLightCount << SHADER_LIGHT_COUNT_SHIFT);
+}
+
+class ShaderVariants {
+public:
+    /**
+     * @brief Ctor - variants are compiled lazily on first use
+     *
+     * @param vShaderPath - Vertex shader file path
+     * @param fShaderPath - Fragment shader file path
+     * @param setup - Called once with every newly created variant bound, for
+     * uniforms that never change (sampler units, block bindings)
+     */
+    ShaderVariants(const std::string& vShaderPath, const std::string& fShaderPath,
+                   const std::function<void(const Shader&)>& setup = std::function<void(const Shader&)>());
+
+    /**
+     * @brief Issues the compile of a variant without waiting for it, so
+     * variants needed later can build in the background
+     *
+     * @param key - Key from MakeShaderKey
+     */
+    void Prepare(unsigned key);
+
+    /**
+     * @brief Gets the variant for a key, compiling it if it doesn't exist yet
+     *
+     * @param key - Key from MakeShaderKey
+     *
+     * @returns Variant program
+     */
+    const Shader& Get(unsigned key);
+
+    /**
+     * @brief Binds the variant for a key
+     *
+     * @param key - Key from MakeShaderKey
+     *
+     * @returns Bound variant program
+     */
+    const Shader& Use(unsigned key);
+
+    /**
+     * @brief Translates a key into define bodies for Shader
+     *
+     * @param key - Key from MakeShaderKey
+     *
+     * @returns Defines
+     */
+    static std::vector<std::string> GetDefines(unsigned key);
+
+    unsigned GetVariantCount() const { return (unsigned)mVariants.size(); }
+    const std::string& GetVertexPath() const { return mVertexPath; }
+    const std::string& GetFragmentPath() const { return mFragmentPath; }
+
+private:
+    struct Variant {
+        explicit Variant(const Shader& program) : Program(program), Configured(false) {}
+
+        Shader Program;
+        // NOTE: Block bindings and setup ran
+        bool Configured;
+    };
+
+    std::string mVertexPath;
+    std::string mFragmentPath;
+    std::function<void(const Shader&)> mSetup;
+    std::map<unsigned, Variant> mVariants;
+};
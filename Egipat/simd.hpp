@@ -0,0 +1,18 @@
+/**
+ * @file simd.hpp
+ * @brief SIMD instruction set detection. EGIPAT_SSE is defined when SSE2 (and
+ * everything up to it) can be used unconditionally, which holds for every x64
+ * build. Code must keep a scalar fallback for other targets.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EGIPAT_SSE
+#include <emmintrin.h>
+#endif
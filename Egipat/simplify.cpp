@@ -0,0 +1,287 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// NOTE: Symmetric 4x4 quadric stored as its 10 unique coefficients
+struct Quadric {
+    double A[10];
+
+    Quadric() {
+        std::fill(A, A + 10, 0.0);
+    }
+
+    void AddPlane(const glm::vec3& n, float d, float weight) {
+        double Plane[4] = { n.x, n.y, n.z, d };
+        unsigned Idx = 0;
+        for (unsigned Row = 0; Row < 4; ++Row) {
+            for (unsigned Col = Row; Col < 4; ++Col) {
+                A[Idx++] += weight * Plane[Row] * Plane[Col];
+            }
+        }
+    }
+
+    void Add(const Quadric& other) {
+        for (unsigned Idx = 0; Idx < 10; ++Idx) {
+            A[Idx] += other.A[Idx];
+        }
+    }
+
+    double Evaluate(const glm::vec3& p) const {
+        double X = p.x, Y = p.y, Z = p.z;
+        return A[0] * X * X + 2.0 * A[1] * X * Y + 2.0 * A[2] * X * Z + 2.0 * A[3] * X
+             + A[4] * Y * Y + 2.0 * A[5] * Y * Z + 2.0 * A[6] * Y
+             + A[7] * Z * Z + 2.0 * A[8] * Z
+             + A[9];
+    }
+};
+
+struct Collapse {
+    double Cost;
+    unsigned From;
+    unsigned To;
+
+    bool operator<(const Collapse& other) const {
+        return Cost > other.Cost;
+    }
+};
+
+// NOTE: Per-vertex triangle lists live in one pool as singly linked runs, so
+// collapsing a vertex splices its list onto the target instead of copying it
+struct TriangleLink {
+    unsigned Triangle;
+    unsigned Next;
+};
+
+static const unsigned LinkEnd = ~0u;
+
+// NOTE: Kept per thread and reused across calls, buffers only grow
+struct SimplifyScratch {
+    std::vector<unsigned> Triangles;
+    std::vector<unsigned char> TriangleAlive;
+    std::vector<TriangleLink> Links;
+    std::vector<unsigned> Head;
+    std::vector<unsigned> Tail;
+    std::vector<Quadric> Quadrics;
+    std::vector<unsigned char> Collapsed;
+    std::vector<unsigned char> Locked;
+    std::vector<std::pair<unsigned, unsigned> > Edges;
+    std::vector<Collapse> Heap;
+};
+
+static thread_local SimplifyScratch Scratch;
+
+static void
+pushCollapse(std::vector<Collapse>& heap, double cost, unsigned from, unsigned to) {
+    Collapse Entry = { cost, from, to };
+    heap.push_back(Entry);
+    std::push_heap(heap.begin(), heap.end());
+}
+
+static glm::vec3
+vertexPosition(const float* vertices, unsigned stride, unsigned index) {
+    const float* V = vertices + (size_t)index * stride;
+    return glm::vec3(V[0], V[1], V[2]);
+}
+
+float
+Simplifier::Simplify(const float* vertices, unsigned vertexCount, unsigned stride,
+                     const std::vector<unsigned>& indices, unsigned targetIndexCount,
+                     std::vector<unsigned>& out) {
+    unsigned TriangleCount = (unsigned)indices.size() / 3;
+    std::vector<unsigned>& Triangles = Scratch.Triangles;
+    std::vector<unsigned char>& TriangleAlive = Scratch.TriangleAlive;
+    std::vector<TriangleLink>& Links = Scratch.Links;
+    std::vector<unsigned>& Head = Scratch.Head;
+    std::vector<unsigned>& Tail = Scratch.Tail;
+    std::vector<Quadric>& Quadrics = Scratch.Quadrics;
+    std::vector<unsigned char>& Collapsed = Scratch.Collapsed;
+    std::vector<unsigned char>& Locked = Scratch.Locked;
+    Triangles.assign(indices.begin(), indices.begin() + TriangleCount * 3);
+    TriangleAlive.assign(TriangleCount, 1);
+    Links.resize(TriangleCount * 3);
+    Head.assign(vertexCount, LinkEnd);
+    Tail.assign(vertexCount, LinkEnd);
+    Quadrics.assign(vertexCount, Quadric());
+    Collapsed.assign(vertexCount, 0);
+    Locked.assign(vertexCount, 0);
+
+    for (unsigned Tri = 0; Tri < TriangleCount; ++Tri) {
+        glm::vec3 P0 = vertexPosition(vertices, stride, Triangles[Tri * 3 + 0]);
+        glm::vec3 P1 = vertexPosition(vertices, stride, Triangles[Tri * 3 + 1]);
+        glm::vec3 P2 = vertexPosition(vertices, stride, Triangles[Tri * 3 + 2]);
+        glm::vec3 Cross = glm::cross(P1 - P0, P2 - P0);
+        float Area = glm::length(Cross);
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Vertex = Triangles[Tri * 3 + Corner];
+            unsigned Link = Tri * 3 + Corner;
+            Links[Link].Triangle = Tri;
+            Links[Link].Next = LinkEnd;
+            if (Tail[Vertex] == LinkEnd) {
+                Head[Vertex] = Link;
+            } else {
+                Links[Tail[Vertex]].Next = Link;
+            }
+            Tail[Vertex] = Link;
+            if (Area > 0.0f) {
+                glm::vec3 Normal = Cross / Area;
+                Quadrics[Vertex].AddPlane(Normal, -glm::dot(Normal, P0), Area);
+            }
+        }
+    }
+
+    // NOTE: Vertices on open borders and UV/normal seams are locked, moving
+    // them would tear the surface
+    std::vector<std::pair<unsigned, unsigned> >& Edges = Scratch.Edges;
+    Edges.clear();
+    Edges.reserve(TriangleCount * 3);
+    for (unsigned Tri = 0; Tri < TriangleCount; ++Tri) {
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned A = Triangles[Tri * 3 + Corner];
+            unsigned B = Triangles[Tri * 3 + (Corner + 1) % 3];
+            Edges.push_back(std::make_pair(std::min(A, B), std::max(A, B)));
+        }
+    }
+    std::sort(Edges.begin(), Edges.end());
+    for (size_t Idx = 0; Idx < Edges.size();) {
+        size_t Next = Idx + 1;
+        while (Next < Edges.size() && Edges[Next] == Edges[Idx]) {
+            ++Next;
+        }
+        if (Next - Idx == 1) {
+            Locked[Edges[Idx].first] = 1;
+            Locked[Edges[Idx].second] = 1;
+        }
+        Idx = Next;
+    }
+    Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+
+    std::vector<Collapse>& Heap = Scratch.Heap;
+    Heap.clear();
+    for (size_t Idx = 0; Idx < Edges.size(); ++Idx) {
+        unsigned A = Edges[Idx].first;
+        unsigned B = Edges[Idx].second;
+        Quadric Combined = Quadrics[A];
+        Combined.Add(Quadrics[B]);
+        if (!Locked[A]) {
+            pushCollapse(Heap, Combined.Evaluate(vertexPosition(vertices, stride, B)), A, B);
+        }
+        if (!Locked[B]) {
+            pushCollapse(Heap, Combined.Evaluate(vertexPosition(vertices, stride, A)), B, A);
+        }
+    }
+
+    unsigned AliveCount = TriangleCount;
+    double MaxError = 0.0;
+    while (AliveCount * 3 > targetIndexCount && !Heap.empty()) {
+        std::pop_heap(Heap.begin(), Heap.end());
+        Collapse Current = Heap.back();
+        Heap.pop_back();
+        unsigned From = Current.From;
+        unsigned To = Current.To;
+        if (Collapsed[From] || Collapsed[To]) {
+            continue;
+        }
+
+        // NOTE: Lazy update, quadrics may have grown since the entry was pushed
+        Quadric Combined = Quadrics[From];
+        Combined.Add(Quadrics[To]);
+        glm::vec3 Target = vertexPosition(vertices, stride, To);
+        double Cost = Combined.Evaluate(Target);
+        if (Cost > Current.Cost * 1.0001 + 1e-12) {
+            pushCollapse(Heap, Cost, From, To);
+            continue;
+        }
+
+        // NOTE: Reject collapses that flip a remaining triangle
+        bool Flips = false;
+        bool Adjacent = false;
+        for (unsigned Link = Head[From]; Link != LinkEnd && !Flips; Link = Links[Link].Next) {
+            unsigned Tri = Links[Link].Triangle;
+            if (!TriangleAlive[Tri]) {
+                continue;
+            }
+            unsigned* Corners = &Triangles[Tri * 3];
+            if (Corners[0] == To || Corners[1] == To || Corners[2] == To) {
+                Adjacent = true;
+                continue;
+            }
+            glm::vec3 Before[3], After[3];
+            for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                Before[Corner] = vertexPosition(vertices, stride, Corners[Corner]);
+                After[Corner] = Corners[Corner] == From ? Target : Before[Corner];
+            }
+            glm::vec3 NormalBefore = glm::cross(Before[1] - Before[0], Before[2] - Before[0]);
+            glm::vec3 NormalAfter = glm::cross(After[1] - After[0], After[2] - After[0]);
+            if (glm::dot(NormalBefore, NormalAfter) <= 0.0f) {
+                Flips = true;
+            }
+        }
+        if (Flips || !Adjacent) {
+            continue;
+        }
+
+        for (unsigned Link = Head[From]; Link != LinkEnd; Link = Links[Link].Next) {
+            unsigned Tri = Links[Link].Triangle;
+            if (!TriangleAlive[Tri]) {
+                continue;
+            }
+            unsigned* Corners = &Triangles[Tri * 3];
+            if (Corners[0] == To || Corners[1] == To || Corners[2] == To) {
+                TriangleAlive[Tri] = 0;
+                --AliveCount;
+                continue;
+            }
+            for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                if (Corners[Corner] == From) {
+                    Corners[Corner] = To;
+                }
+            }
+        }
+        // NOTE: Dead triangles come along too, every walk skips them anyway
+        if (Head[From] != LinkEnd) {
+            if (Tail[To] == LinkEnd) {
+                Head[To] = Head[From];
+            } else {
+                Links[Tail[To]].Next = Head[From];
+            }
+            Tail[To] = Tail[From];
+            Head[From] = LinkEnd;
+            Tail[From] = LinkEnd;
+        }
+
+        Collapsed[From] = 1;
+        Quadrics[To] = Combined;
+        // NOTE: Quadric is an area weighted sum of squared plane distances, its
+        // trace is the total weight, so this is a mean squared distance
+        double Weight = Combined.A[0] + Combined.A[4] + Combined.A[7];
+        MaxError = std::max(MaxError, Cost / std::max(Weight, 1e-12));
+
+        for (unsigned Link = Head[To]; Link != LinkEnd; Link = Links[Link].Next) {
+            unsigned Tri = Links[Link].Triangle;
+            if (!TriangleAlive[Tri]) {
+                continue;
+            }
+            for (unsigned Corner = 0; Corner < 3; ++Corner) {
+                unsigned Neighbour = Triangles[Tri * 3 + Corner];
+                if (Neighbour == To || Locked[Neighbour]) {
+                    continue;
+                }
+                Quadric Edge = Quadrics[Neighbour];
+                Edge.Add(Quadrics[To]);
+                pushCollapse(Heap, Edge.Evaluate(Target), Neighbour, To);
+            }
+        }
+    }
+
+    out.clear();
+    out.reserve(AliveCount * 3);
+    for (unsigned Tri = 0; Tri < TriangleCount; ++Tri) {
+        if (TriangleAlive[Tri]) {
+            out.insert(out.end(), Triangles.begin() + Tri * 3, Triangles.begin() + Tri * 3 + 3);
+        }
+    }
+
+    return (float)std::sqrt(MaxError);
+}
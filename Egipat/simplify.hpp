@@ -0,0 +1,32 @@
+/**
+ * @file simplify.hpp
+ * @brief Quadric error metric mesh simplification. Edges are collapsed onto
+ * existing vertices, so simplified index buffers keep sharing the original
+ * vertex buffer
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <vector>
+
+namespace Simplifier {
+    /**
+     * @brief Collapses edges in order of quadric error until the target is reached
+     *
+     * @param vertices - Interleaved vertex data, position in the first three floats
+     * @param vertexCount - Vertex count
+     * @param stride - Floats per vertex
+     * @param indices - Source triangle list
+     * @param targetIndexCount - Desired index count of the result
+     * @param out - Simplified triangle list referencing the same vertices
+     *
+     * @returns Geometric error of the result in object space units
+     */
+    float Simplify(const float* vertices, unsigned vertexCount, unsigned stride,
+                   const std::vector<unsigned>& indices, unsigned targetIndexCount,
+                   std::vector<unsigned>& out);
+}
@@ -0,0 +1,128 @@
+#include "simulation.hpp"
+#include "trace.hpp"
+
+#include <GLFW/glfw3.h>
+#include <cstring>
+
+SnapshotBuffer::SnapshotBuffer()
+    : mBack(0),
+      mFront(1),
+      mMiddle(2) {
+    for (unsigned SlotIdx = 0; SlotIdx < 3; ++SlotIdx) {
+        RenderSnapshot& Slot = mSlots[SlotIdx];
+        Slot.Frame = 0;
+        Slot.Time = 0.0f;
+        Slot.Dt = 0.0f;
+        Slot.View = glm::mat4(1.0f);
+        Slot.CameraPosition = glm::vec3(0.0f);
+        // NOTE: glm types don't initialise themselves
+        std::memset((void*)&Slot.Lights, 0, sizeof(Slot.Lights));
+    }
+}
+
+void
+SnapshotBuffer::Publish() {
+    mBack = mMiddle.exchange(mBack | Fresh, std::memory_order_acq_rel) & ~Fresh;
+}
+
+const RenderSnapshot&
+SnapshotBuffer::Acquire() {
+    if (mMiddle.load(std::memory_order_acquire) & Fresh) {
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & ~Fresh;
+    }
+    return mSlots[mFront];
+}
+
+Simulation::Simulation(const StepFunction& step, float fixedStep)
+    : mStep(step),
+      mPublished(0),
+      mConsumed(0),
+      mStopping(false),
+      mLastTime((float)glfwGetTime()),
+      mFixedStep(fixedStep) {
+    std::memset((void*)&mInput, 0, sizeof(mInput));
+    this->step();
+    mThread = std::thread(&Simulation::threadLoop, this);
+}
+
+Simulation::~Simulation() {
+    {
+        std::lock_guard<std::mutex> Lock(mPaceMutex);
+        mStopping = true;
+    }
+    mPaceCondition.notify_all();
+    mThread.join();
+}
+
+void
+Simulation::SetInput(const InputState& input) {
+    std::lock_guard<std::mutex> Lock(mInputMutex);
+    float MouseDX = mInput.MouseDX + input.MouseDX;
+    float MouseDY = mInput.MouseDY + input.MouseDY;
+    mInput = input;
+    mInput.MouseDX = MouseDX;
+    mInput.MouseDY = MouseDY;
+}
+
+const RenderSnapshot&
+Simulation::BeginFrame() {
+    // NOTE: Without lockstep a frame reuses the last snapshot when the next
+    // one isn't ready, which makes fixed step runs differ between machines
+    if (mFixedStep > 0.0f) {
+        std::unique_lock<std::mutex> Lock(mPaceMutex);
+        mPublishCondition.wait(Lock, [this]() { return mPublished > mConsumed; });
+    }
+    const RenderSnapshot& Snapshot = mSnapshots.Acquire();
+    {
+        std::lock_guard<std::mutex> Lock(mPaceMutex);
+        mConsumed = Snapshot.Frame;
+    }
+    mPaceCondition.notify_one();
+    return Snapshot;
+}
+
+void
+Simulation::step() {
+    TRACE_ZONE("Simulation step");
+    InputState Input;
+    {
+        std::lock_guard<std::mutex> Lock(mInputMutex);
+        Input = mInput;
+        mInput.MouseDX = 0.0f;
+        mInput.MouseDY = 0.0f;
+    }
+
+    unsigned long long Frame = mPublished + 1;
+    // NOTE: glfwGetTime is safe to call from any thread
+    float Time = mFixedStep > 0.0f ? Frame * mFixedStep : (float)glfwGetTime();
+    float Dt = mFixedStep > 0.0f ? mFixedStep : Time - mLastTime;
+    mLastTime = Time;
+
+    RenderSnapshot& Snapshot = mSnapshots.GetBack();
+    Snapshot.Frame = Frame;
+    Snapshot.Time = Time;
+    Snapshot.Dt = Dt;
+    mStep(Input, Time, Dt, Snapshot);
+    mSnapshots.Publish();
+    {
+        std::lock_guard<std::mutex> Lock(mPaceMutex);
+        mPublished = Frame;
+    }
+    mPublishCondition.notify_one();
+}
+
+void
+Simulation::threadLoop() {
+    Trace::SetThreadName("Simulation");
+    for (;;) {
+        {
+            // NOTE: Stay at most one snapshot ahead of the render thread
+            std::unique_lock<std::mutex> Lock(mPaceMutex);
+            mPaceCondition.wait(Lock, [this]() { return mStopping || mConsumed >= mPublished; });
+            if (mStopping) {
+                return;
+            }
+        }
+        step();
+    }
+}
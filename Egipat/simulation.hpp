@@ -0,0 +1,163 @@
+/**
+ * @file simulation.hpp
+ * @brief Simulation thread. Input, camera, animation and transform updates
+ * run one frame ahead of the render thread and hand their results over as
+ * immutable snapshots, so building frame N+1 overlaps submitting frame N.
+ * Snapshots are triple buffered and exchanged without locks
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frameuniforms.hpp"
+
+/**
+ * @brief Input sampled on the window thread. Held keys are states, mouse
+ * motion accumulates until the simulation consumes it
+ *
+ */
+struct InputState {
+    bool MoveForward;
+    bool MoveBack;
+    bool MoveLeft;
+    bool MoveRight;
+    bool MoveFaster;
+    float MouseDX;
+    float MouseDY;
+    // NOTE: Held states, the simulation acts on the press
+    bool Pick;
+    bool RecordKey;
+    bool SavePath;
+    // NOTE: Applied once per simulation step while held
+    glm::vec3 RugDelta;
+};
+
+/**
+ * @brief Everything the render thread needs from the simulation for one frame
+ *
+ */
+struct RenderSnapshot {
+    unsigned long long Frame;
+    float Time;
+    float Dt;
+    glm::mat4 View;
+    glm::vec3 CameraPosition;
+    LightUniforms Lights;
+    // NOTE: Indexed by TransformHierarchy node handle
+    std::vector<glm::mat4> World;
+    std::vector<glm::mat3> Normal;
+
+    const glm::mat4& GetWorld(unsigned node) const { return World[node]; }
+    const glm::mat3& GetNormal(unsigned node) const { return Normal[node]; }
+};
+
+/**
+ * @brief Lock-free triple buffer. The writer fills its back slot and swaps it
+ * with the middle one, the reader swaps its front slot with the middle one
+ * when a newer snapshot is there. Neither side ever waits on the other
+ *
+ */
+class SnapshotBuffer {
+public:
+    SnapshotBuffer();
+
+    /**
+     * @brief Slot the writer fills next. Keeps whatever it held before, so
+     * vectors keep their capacity
+     *
+     */
+    RenderSnapshot& GetBack() { return mSlots[mBack]; }
+
+    /**
+     * @brief Makes the back slot the newest snapshot. Writer only
+     *
+     */
+    void Publish();
+
+    /**
+     * @brief Takes the newest snapshot if one was published since the last
+     * call, otherwise keeps the current one. Reader only
+     *
+     * @returns Snapshot that stays valid until the next Acquire
+     */
+    const RenderSnapshot& Acquire();
+
+private:
+    // NOTE: Set on the middle index while it holds an unread snapshot
+    static const unsigned Fresh = 4;
+
+    RenderSnapshot mSlots[3];
+    unsigned mBack;
+    unsigned mFront;
+    std::atomic<unsigned> mMiddle;
+};
+
+class Simulation {
+public:
+    typedef std::function<void(const InputState& input, float time, float dt, RenderSnapshot& snapshot)> StepFunction;
+
+    /**
+     * @brief Ctor - runs the first step on the calling thread, so a snapshot
+     * is always available, then starts the simulation thread
+     *
+     * @param step - Advances the simulation and fills a snapshot. Runs on the
+     * simulation thread, must not touch GL or GLFW input
+     * @param fixedStep - Seconds every step advances by, 0 to follow the clock.
+     * A fixed step also runs in lockstep with the render thread, so every
+     * rendered frame is exactly one step and runs see the same frames
+     */
+    Simulation(const StepFunction& step, float fixedStep = 0.0f);
+
+    /**
+     * @brief Dtor - stops and joins the simulation thread
+     *
+     */
+    ~Simulation();
+
+    /**
+     * @brief Hands the latest input to the simulation. Window thread only
+     *
+     */
+    void SetInput(const InputState& input);
+
+    /**
+     * @brief Takes the newest snapshot and lets the simulation start the next
+     * one. Render thread only
+     *
+     */
+    const RenderSnapshot& BeginFrame();
+
+    unsigned long long GetStepCount() const { return mPublished; }
+
+private:
+    StepFunction mStep;
+    SnapshotBuffer mSnapshots;
+    std::thread mThread;
+
+    std::mutex mInputMutex;
+    InputState mInput;
+
+    // NOTE: Only paces the simulation, snapshots never pass through it
+    std::mutex mPaceMutex;
+    std::condition_variable mPaceCondition;
+    // NOTE: Lockstep only, signalled on every publish
+    std::condition_variable mPublishCondition;
+    std::atomic<unsigned long long> mPublished;
+    std::atomic<unsigned long long> mConsumed;
+    bool mStopping;
+    float mLastTime;
+    float mFixedStep;
+
+    void step();
+    void threadLoop();
+};
@@ -0,0 +1,278 @@
+#include "skybox.hpp"
+#include "filecache.hpp"
+#include "gpumemory.hpp"
+#include "stb_image.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <glm/gtc/constants.hpp>
+
+struct CubemapCacheHeader {
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Key;
+    uint32_t FaceSize;
+    uint32_t LevelCount;
+};
+
+static const uint32_t CubemapCacheVersion = 1;
+
+static const float SkyboxVertices[] = {
+    -1.0f,  1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f, -1.0f,
+
+    -1.0f, -1.0f,  1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f,
+
+     1.0f, -1.0f, -1.0f,  1.0f, -1.0f,  1.0f,  1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f,  1.0f,  1.0f, -1.0f,  1.0f, -1.0f, -1.0f,
+
+    -1.0f, -1.0f,  1.0f, -1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f,  1.0f, -1.0f,  1.0f, -1.0f, -1.0f,  1.0f,
+
+    -1.0f,  1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f, -1.0f,
+
+    -1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f
+};
+
+/**
+ * @brief Direction through texel centre (u, v) in [-1, 1] of a cubemap face,
+ * following the GL cubemap face orientation table
+ *
+ */
+static glm::vec3
+faceDirection(unsigned face, float u, float v) {
+    switch (face) {
+    case 0: return glm::vec3(1.0f, -v, -u);
+    case 1: return glm::vec3(-1.0f, -v, u);
+    case 2: return glm::vec3(u, 1.0f, v);
+    case 3: return glm::vec3(u, -1.0f, -v);
+    case 4: return glm::vec3(u, -v, 1.0f);
+    default: return glm::vec3(-u, -v, -1.0f);
+    }
+}
+
+Skybox::Skybox(const std::string& equirectPath, unsigned faceSize)
+    : mShaders("shaders/skybox.vert", "shaders/skybox.frag", [](const Shader& variant) { variant.SetUniform1i("uSkybox", 0); }),
+      mCubemap(0),
+      mVAO(0),
+      mVBO(0),
+      mFaceSize(faceSize) {
+    std::vector<unsigned char> Source;
+    if (!FileCache::ReadFile(equirectPath, Source)) {
+        std::cerr << "[Err] Failed to read skybox: " << equirectPath << std::endl;
+        return;
+    }
+
+    uint64_t Key = FileCache::Hash(Source.data(), Source.size());
+    Key = FileCache::Hash(&mFaceSize, sizeof(mFaceSize), Key);
+
+    std::string Name = equirectPath.substr(equirectPath.find_last_of('/') + 1);
+    std::string CachePath = FileCache::GetPath(Name + ".cube");
+
+    CubeLevels Levels;
+    if (loadCache(CachePath, Key, Levels)) {
+        std::cout << "Loaded " << CachePath << " cached cubemap" << std::endl;
+    } else {
+        if (!convert(Source, Levels)) {
+            std::cerr << "[Err] Failed to decode skybox: " << equirectPath << std::endl;
+            return;
+        }
+        writeCache(CachePath, Key, Levels);
+        std::cout << "Converted " << equirectPath << " to cubemap" << std::endl;
+    }
+
+    upload(Levels);
+
+    mVAO = GpuMemory::CreateVertexArray(equirectPath);
+    glBindVertexArray(mVAO);
+    mVBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, equirectPath);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    GpuMemory::BufferData(mVBO, GL_ARRAY_BUFFER, sizeof(SkyboxVertices), SkyboxVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    mShaders.Prepare(0);
+}
+
+Skybox::~Skybox() {
+    GpuMemory::DeleteTexture(mCubemap);
+    GpuMemory::DeleteBuffer(mVBO);
+    GpuMemory::DeleteVertexArray(mVAO);
+}
+
+void
+Skybox::Record(CommandBuffer& commands) {
+    if (!mCubemap) {
+        return;
+    }
+
+    // NOTE: Vertex shader outputs z = w, so the sky lands exactly on the far
+    // plane and only passes where nothing was drawn
+    commands.SetRenderState(RENDER_COLOR_WRITE | RENDER_DEPTH_LEQUAL);
+    commands.BindPipeline(mShaders, 0);
+    commands.BindTexture(0, TEXTURE_TARGET_CUBE_MAP, mCubemap);
+    commands.BindVertexArray(mVAO);
+    commands.Draw(0, 36);
+    commands.BindTexture(0, TEXTURE_TARGET_CUBE_MAP, 0);
+    commands.SetRenderState(RENDER_STATE_DEFAULT);
+}
+
+bool
+Skybox::loadCache(const std::string& cachePath, uint64_t key, CubeLevels& levels) {
+    std::vector<unsigned char> Data;
+    if (!FileCache::ReadFile(cachePath, Data) || Data.size() < sizeof(CubemapCacheHeader)) {
+        return false;
+    }
+
+    CubemapCacheHeader Header;
+    std::memcpy(&Header, Data.data(), sizeof(Header));
+    if (std::memcmp(Header.Magic, "ECUB", 4) || Header.Version != CubemapCacheVersion
+        || Header.Key != key || Header.FaceSize != mFaceSize) {
+        return false;
+    }
+
+    size_t Offset = sizeof(Header);
+    levels.resize(Header.LevelCount);
+    for (unsigned Level = 0; Level < Header.LevelCount; ++Level) {
+        unsigned Size = std::max(mFaceSize >> Level, 1u);
+        size_t FaceBytes = (size_t)Size * Size * 3;
+        levels[Level].resize(6);
+        for (unsigned Face = 0; Face < 6; ++Face) {
+            if (Offset + FaceBytes > Data.size()) {
+                return false;
+            }
+            levels[Level][Face].assign(Data.begin() + Offset, Data.begin() + Offset + FaceBytes);
+            Offset += FaceBytes;
+        }
+    }
+
+    return true;
+}
+
+void
+Skybox::writeCache(const std::string& cachePath, uint64_t key, const CubeLevels& levels) {
+    CubemapCacheHeader Header;
+    std::memcpy(Header.Magic, "ECUB", 4);
+    Header.Version = CubemapCacheVersion;
+    Header.Key = key;
+    Header.FaceSize = mFaceSize;
+    Header.LevelCount = (uint32_t)levels.size();
+
+    std::vector<unsigned char> Data(sizeof(Header));
+    std::memcpy(Data.data(), &Header, sizeof(Header));
+    for (unsigned Level = 0; Level < levels.size(); ++Level) {
+        for (unsigned Face = 0; Face < 6; ++Face) {
+            Data.insert(Data.end(), levels[Level][Face].begin(), levels[Level][Face].end());
+        }
+    }
+
+    FileCache::WriteFile(cachePath, Data.data(), Data.size());
+}
+
+bool
+Skybox::convert(const std::vector<unsigned char>& source, CubeLevels& levels) {
+    int Width, Height, BPP;
+    // NOTE: Panorama rows stay top-down, cubemap faces use their own orientation
+    stbi_set_flip_vertically_on_load_thread(0);
+    unsigned char* Pixels = stbi_load_from_memory(source.data(), (int)source.size(), &Width, &Height, &BPP, 3);
+    stbi_set_flip_vertically_on_load_thread(1);
+    if (!Pixels) {
+        return false;
+    }
+
+    const float Pi = glm::pi<float>();
+    unsigned LevelCount = 1;
+    while ((mFaceSize >> (LevelCount - 1)) > 1) {
+        ++LevelCount;
+    }
+    levels.assign(LevelCount, std::vector<std::vector<unsigned char> >(6));
+
+    for (unsigned Face = 0; Face < 6; ++Face) {
+        std::vector<unsigned char>& Dst = levels[0][Face];
+        Dst.resize((size_t)mFaceSize * mFaceSize * 3);
+        for (unsigned Row = 0; Row < mFaceSize; ++Row) {
+            for (unsigned Col = 0; Col < mFaceSize; ++Col) {
+                float U = 2.0f * (Col + 0.5f) / mFaceSize - 1.0f;
+                float V = 2.0f * (Row + 0.5f) / mFaceSize - 1.0f;
+                glm::vec3 Dir = glm::normalize(faceDirection(Face, U, V));
+
+                float SrcX = (0.5f + std::atan2(Dir.z, Dir.x) / (2.0f * Pi)) * Width - 0.5f;
+                float SrcY = (0.5f - std::asin(Dir.y) / Pi) * Height - 0.5f;
+                int X0 = (int)std::floor(SrcX);
+                int Y0 = (int)std::floor(SrcY);
+                float FX = SrcX - X0;
+                float FY = SrcY - Y0;
+                int X1 = (X0 + 1 + Width) % Width;
+                X0 = (X0 + Width) % Width;
+                int Y1 = std::min(std::max(Y0 + 1, 0), Height - 1);
+                Y0 = std::min(std::max(Y0, 0), Height - 1);
+
+                for (unsigned Channel = 0; Channel < 3; ++Channel) {
+                    float P00 = Pixels[(Y0 * Width + X0) * 3 + Channel];
+                    float P10 = Pixels[(Y0 * Width + X1) * 3 + Channel];
+                    float P01 = Pixels[(Y1 * Width + X0) * 3 + Channel];
+                    float P11 = Pixels[(Y1 * Width + X1) * 3 + Channel];
+                    float Top = P00 + (P10 - P00) * FX;
+                    float Bottom = P01 + (P11 - P01) * FX;
+                    Dst[(Row * mFaceSize + Col) * 3 + Channel] = (unsigned char)(Top + (Bottom - Top) * FY + 0.5f);
+                }
+            }
+        }
+    }
+    stbi_image_free(Pixels);
+
+    // NOTE: 2x2 box filter down to 1x1 for the mip chain
+    for (unsigned Level = 1; Level < LevelCount; ++Level) {
+        unsigned SrcSize = std::max(mFaceSize >> (Level - 1), 1u);
+        unsigned DstSize = std::max(mFaceSize >> Level, 1u);
+        for (unsigned Face = 0; Face < 6; ++Face) {
+            const std::vector<unsigned char>& Src = levels[Level - 1][Face];
+            std::vector<unsigned char>& Dst = levels[Level][Face];
+            Dst.resize((size_t)DstSize * DstSize * 3);
+            for (unsigned Row = 0; Row < DstSize; ++Row) {
+                for (unsigned Col = 0; Col < DstSize; ++Col) {
+                    unsigned R0 = std::min(Row * 2, SrcSize - 1), R1 = std::min(Row * 2 + 1, SrcSize - 1);
+                    unsigned C0 = std::min(Col * 2, SrcSize - 1), C1 = std::min(Col * 2 + 1, SrcSize - 1);
+                    for (unsigned Channel = 0; Channel < 3; ++Channel) {
+                        unsigned Sum = Src[(R0 * SrcSize + C0) * 3 + Channel] + Src[(R0 * SrcSize + C1) * 3 + Channel]
+                                     + Src[(R1 * SrcSize + C0) * 3 + Channel] + Src[(R1 * SrcSize + C1) * 3 + Channel];
+                        Dst[(Row * DstSize + Col) * 3 + Channel] = (unsigned char)((Sum + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+Skybox::upload(const CubeLevels& levels) {
+    mCubemap = GpuMemory::CreateTexture("Skybox");
+    glBindTexture(GL_TEXTURE_CUBE_MAP, mCubemap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t Bytes = 0;
+    for (unsigned Level = 0; Level < levels.size(); ++Level) {
+        unsigned Size = std::max(mFaceSize >> Level, 1u);
+        for (unsigned Face = 0; Face < 6; ++Face) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face, Level, GL_RGB8, Size, Size, 0, GL_RGB, GL_UNSIGNED_BYTE, levels[Level][Face].data());
+            Bytes += (size_t)Size * Size * 4;
+        }
+    }
+    GpuMemory::SetTextureBytes(mCubemap, Bytes);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file skybox.hpp
+ * @brief Sky rendered from an equirectangular panorama. The panorama is
+ * reprojected into a mip-mapped cubemap once and the result is cached on disk,
+ * so later launches only upload the cached faces
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "commandbuffer.hpp"
+#include "shadervariants.hpp"
+
+class Skybox {
+public:
+    /**
+     * @brief Ctor - loads cached cubemap or converts the panorama and caches it
+     *
+     * @param equirectPath - Equirectangular panorama path
+     * @param faceSize - Cubemap face resolution in texels
+     */
+    Skybox(const std::string& equirectPath, unsigned faceSize = 1024);
+    ~Skybox();
+
+    /**
+     * @brief Records the sky at far depth. Execute after all opaque geometry
+     * so only uncovered pixels are shaded. The view comes from the Camera block
+     *
+     * @param commands - Receives the commands
+     */
+    void Record(CommandBuffer& commands);
+
+    unsigned GetCubemap() const { return mCubemap; }
+
+private:
+    ShaderVariants mShaders;
+    unsigned mCubemap;
+    unsigned mVAO;
+    unsigned mVBO;
+    unsigned mFaceSize;
+
+    /**
+     * @brief Cubemap texel data: Levels[level][face] is an RGB8 image
+     *
+     */
+    typedef std::vector<std::vector<std::vector<unsigned char> > > CubeLevels;
+
+    bool loadCache(const std::string& cachePath, uint64_t key, CubeLevels& levels);
+    void writeCache(const std::string& cachePath, uint64_t key, const CubeLevels& levels);
+    bool convert(const std::vector<unsigned char>& source, CubeLevels& levels);
+    void upload(const CubeLevels& levels);
+};
@@ -0,0 +1,717 @@
+#include "softrasterizer.hpp"
+#include "simd.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// NOTE: Vertices snap to 1/16 pixel so shared edges produce identical edge
+// functions in both triangles
+static const float SubpixelSteps = 16.0f;
+static const unsigned TransformGrain = 4096;
+
+// NOTE: Four lanes of floats and lane masks. SSE2 where available, plain
+// arrays otherwise, so the rasterizer and shading are written once
+#ifdef EGIPAT_SSE
+struct Lane4 {
+    __m128 V;
+    Lane4() {}
+    Lane4(__m128 v) : V(v) {}
+    explicit Lane4(float s) : V(_mm_set1_ps(s)) {}
+    Lane4(float a, float b, float c, float d) : V(_mm_setr_ps(a, b, c, d)) {}
+    static Lane4 Load(const float* p) { return _mm_loadu_ps(p); }
+    void Store(float* p) const { _mm_storeu_ps(p, V); }
+};
+
+struct Mask4 {
+    __m128 V;
+    Mask4(__m128 v) : V(v) {}
+    int Bits() const { return _mm_movemask_ps(V); }
+};
+
+static inline Lane4 operator+(Lane4 a, Lane4 b) { return _mm_add_ps(a.V, b.V); }
+static inline Lane4 operator-(Lane4 a, Lane4 b) { return _mm_sub_ps(a.V, b.V); }
+static inline Lane4 operator*(Lane4 a, Lane4 b) { return _mm_mul_ps(a.V, b.V); }
+static inline Lane4 operator/(Lane4 a, Lane4 b) { return _mm_div_ps(a.V, b.V); }
+static inline Lane4 laneMin(Lane4 a, Lane4 b) { return _mm_min_ps(a.V, b.V); }
+static inline Lane4 laneMax(Lane4 a, Lane4 b) { return _mm_max_ps(a.V, b.V); }
+static inline Lane4 laneSqrt(Lane4 a) { return _mm_sqrt_ps(a.V); }
+static inline Mask4 operator<(Lane4 a, Lane4 b) { return _mm_cmplt_ps(a.V, b.V); }
+static inline Mask4 operator>(Lane4 a, Lane4 b) { return _mm_cmpgt_ps(a.V, b.V); }
+static inline Mask4 operator>=(Lane4 a, Lane4 b) { return _mm_cmpge_ps(a.V, b.V); }
+static inline Mask4 operator==(Lane4 a, Lane4 b) { return _mm_cmpeq_ps(a.V, b.V); }
+static inline Mask4 operator&(Mask4 a, Mask4 b) { return _mm_and_ps(a.V, b.V); }
+static inline Mask4 operator|(Mask4 a, Mask4 b) { return _mm_or_ps(a.V, b.V); }
+static inline Mask4 maskAll(bool value) { return _mm_castsi128_ps(_mm_set1_epi32(value ? -1 : 0)); }
+static inline Lane4 select(Mask4 mask, Lane4 a, Lane4 b) { return _mm_or_ps(_mm_and_ps(mask.V, a.V), _mm_andnot_ps(mask.V, b.V)); }
+static inline void laneStore(Lane4 a, float* out) { _mm_storeu_ps(out, a.V); }
+#else
+struct Lane4 {
+    float V[4];
+    Lane4() {}
+    explicit Lane4(float s) { V[0] = V[1] = V[2] = V[3] = s; }
+    Lane4(float a, float b, float c, float d) { V[0] = a; V[1] = b; V[2] = c; V[3] = d; }
+    static Lane4 Load(const float* p) { return Lane4(p[0], p[1], p[2], p[3]); }
+    void Store(float* p) const { std::memcpy(p, V, sizeof(V)); }
+};
+
+struct Mask4 {
+    bool V[4];
+    int Bits() const { return (int)V[0] | (int)V[1] << 1 | (int)V[2] << 2 | (int)V[3] << 3; }
+};
+
+#define LANE_BINARY(op, expr) \
+    static inline Lane4 op(Lane4 a, Lane4 b) { Lane4 R; for (unsigned L = 0; L < 4; ++L) { R.V[L] = expr; } return R; }
+#define LANE_COMPARE(op, expr) \
+    static inline Mask4 op(Lane4 a, Lane4 b) { Mask4 R; for (unsigned L = 0; L < 4; ++L) { R.V[L] = expr; } return R; }
+LANE_BINARY(operator+, a.V[L] + b.V[L])
+LANE_BINARY(operator-, a.V[L] - b.V[L])
+LANE_BINARY(operator*, a.V[L] * b.V[L])
+LANE_BINARY(operator/, a.V[L] / b.V[L])
+LANE_BINARY(laneMin, std::min(a.V[L], b.V[L]))
+LANE_BINARY(laneMax, std::max(a.V[L], b.V[L]))
+LANE_COMPARE(operator<, a.V[L] < b.V[L])
+LANE_COMPARE(operator>, a.V[L] > b.V[L])
+LANE_COMPARE(operator>=, a.V[L] >= b.V[L])
+LANE_COMPARE(operator==, a.V[L] == b.V[L])
+#undef LANE_BINARY
+#undef LANE_COMPARE
+
+static inline Lane4 laneSqrt(Lane4 a) { return Lane4(std::sqrt(a.V[0]), std::sqrt(a.V[1]), std::sqrt(a.V[2]), std::sqrt(a.V[3])); }
+static inline Mask4 operator&(Mask4 a, Mask4 b) { Mask4 R; for (unsigned L = 0; L < 4; ++L) { R.V[L] = a.V[L] && b.V[L]; } return R; }
+static inline Mask4 operator|(Mask4 a, Mask4 b) { Mask4 R; for (unsigned L = 0; L < 4; ++L) { R.V[L] = a.V[L] || b.V[L]; } return R; }
+static inline Mask4 maskAll(bool value) { Mask4 R; R.V[0] = R.V[1] = R.V[2] = R.V[3] = value; return R; }
+static inline Lane4 select(Mask4 mask, Lane4 a, Lane4 b) { Lane4 R; for (unsigned L = 0; L < 4; ++L) { R.V[L] = mask.V[L] ? a.V[L] : b.V[L]; } return R; }
+static inline void laneStore(Lane4 a, float* out) { a.Store(out); }
+#endif
+
+static inline Lane4 laneClamp(Lane4 a, float lo, float hi) { return laneMin(laneMax(a, Lane4(lo)), Lane4(hi)); }
+
+struct Lane3 {
+    Lane4 X;
+    Lane4 Y;
+    Lane4 Z;
+};
+
+static inline Lane4
+dot(const Lane3& a, const Lane3& b) {
+    return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+}
+
+static inline Lane3
+normalize(const Lane3& a, Lane4& length) {
+    length = laneSqrt(dot(a, a));
+    Lane4 Inv = Lane4(1.0f) / length;
+    Lane3 R = { a.X * Inv, a.Y * Inv, a.Z * Inv };
+    return R;
+}
+
+static inline Lane3
+broadcast(const glm::vec3& v) {
+    Lane3 R = { Lane4(v.x), Lane4(v.y), Lane4(v.z) };
+    return R;
+}
+
+// NOTE: pow for the integer shininess exponents the scene uses
+static Lane4
+powInt(Lane4 base, unsigned exponent) {
+    Lane4 Result(1.0f);
+    while (exponent) {
+        if (exponent & 1) {
+            Result = Result * base;
+        }
+        base = base * base;
+        exponent >>= 1;
+    }
+    return Result;
+}
+
+/**
+ * @brief Nearest texel with GL_REPEAT wrapping. Missing textures are black
+ *
+ */
+static void
+sampleTexture(const SoftwareTexture* texture, Lane4 u, Lane4 v, Lane4& r, Lane4& g, Lane4& b, Lane4& a) {
+    if (!texture || texture->Texels.empty()) {
+        r = g = b = Lane4(0.0f);
+        a = Lane4(1.0f);
+        return;
+    }
+
+    float U[4], V[4], Texel[4][4];
+    laneStore(u, U);
+    laneStore(v, V);
+    for (unsigned Lane = 0; Lane < 4; ++Lane) {
+        float FU = U[Lane] - std::floor(U[Lane]);
+        float FV = V[Lane] - std::floor(V[Lane]);
+        // NOTE: NaN from lanes outside the triangle lands on texel 0
+        int X = std::min(std::max((int)(FU * texture->Width), 0), texture->Width - 1);
+        int Y = std::min(std::max((int)(FV * texture->Height), 0), texture->Height - 1);
+        unsigned Packed = texture->Texels[(size_t)Y * texture->Width + X];
+        for (unsigned Channel = 0; Channel < 4; ++Channel) {
+            Texel[Channel][Lane] = ((Packed >> (Channel * 8)) & 0xFF) * (1.0f / 255.0f);
+        }
+    }
+    r = Lane4::Load(Texel[0]);
+    g = Lane4::Load(Texel[1]);
+    b = Lane4::Load(Texel[2]);
+    a = Lane4::Load(Texel[3]);
+}
+
+struct ShadeInputs {
+    Lane3 Normal;
+    Lane3 ViewDirection;
+    Lane3 Diffuse;
+    Lane3 Specular;
+    bool HasSpecular;
+    unsigned Shininess;
+};
+
+/**
+ * @brief shade() from shader.frag
+ *
+ */
+static Lane3
+shadeLight(const ShadeInputs& in, const Lane3& lightVector, const glm::vec4& ka, const glm::vec4& kd, const glm::vec4& ks) {
+    Lane4 NDotL = dot(in.Normal, lightVector);
+    Lane4 Diffuse = laneMax(NDotL, Lane4(0.0f));
+    Lane3 Color = {
+        (Lane4(ka.x) + Diffuse * Lane4(kd.x)) * in.Diffuse.X,
+        (Lane4(ka.y) + Diffuse * Lane4(kd.y)) * in.Diffuse.Y,
+        (Lane4(ka.z) + Diffuse * Lane4(kd.z)) * in.Diffuse.Z
+    };
+    if (in.HasSpecular) {
+        // NOTE: reflect(-L, N) = 2 * dot(N, L) * N - L
+        Lane4 Twice = Lane4(2.0f) * NDotL;
+        Lane3 Reflect = { Twice * in.Normal.X - lightVector.X, Twice * in.Normal.Y - lightVector.Y, Twice * in.Normal.Z - lightVector.Z };
+        Lane4 Specular = powInt(laneMax(dot(in.ViewDirection, Reflect), Lane4(0.0f)), in.Shininess);
+        Color.X = Color.X + Specular * Lane4(ks.x) * in.Specular.X;
+        Color.Y = Color.Y + Specular * Lane4(ks.y) * in.Specular.Y;
+        Color.Z = Color.Z + Specular * Lane4(ks.z) * in.Specular.Z;
+    }
+    return Color;
+}
+
+static inline Lane4
+attenuate(const glm::vec4& attenuation, Lane4 distance) {
+    return Lane4(1.0f) / (Lane4(attenuation.x) + Lane4(attenuation.y) * distance + Lane4(attenuation.z) * distance * distance);
+}
+
+static inline void
+accumulate(Lane3& color, const Lane3& term, Lane4 scale) {
+    color.X = color.X + term.X * scale;
+    color.Y = color.Y + term.Y * scale;
+    color.Z = color.Z + term.Z * scale;
+}
+
+static unsigned
+packColor(float r, float g, float b) {
+    unsigned R = (unsigned)(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+    unsigned G = (unsigned)(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+    unsigned B = (unsigned)(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return R | G << 8 | B << 16 | 0xFF000000u;
+}
+
+bool
+SoftwareTexture::Load(const std::string& path) {
+    // NOTE: Loaded from jobs too, keep the flag to this thread
+    stbi_set_flip_vertically_on_load_thread(1);
+    int Components = 0;
+    unsigned char* Data = stbi_load(path.c_str(), &Width, &Height, &Components, 4);
+    if (!Data) {
+        std::cerr << "[Err] Failed to load texture: " << path << std::endl;
+        Width = Height = 0;
+        Texels.clear();
+        return false;
+    }
+
+    HasAlpha = Components == 4;
+    Texels.resize((size_t)Width * Height);
+    std::memcpy(Texels.data(), Data, Texels.size() * 4);
+    stbi_image_free(Data);
+    return true;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned width, unsigned height)
+    : mWidth(width),
+      mHeight(height),
+      mPitch((width + SOFTWARE_BLOCK_SIZE - 1) / SOFTWARE_BLOCK_SIZE * SOFTWARE_BLOCK_SIZE),
+      mTilesX((width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE),
+      mTilesY((height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE),
+      mBlocksX((width + SOFTWARE_BLOCK_SIZE - 1) / SOFTWARE_BLOCK_SIZE),
+      mViewProjection(1.0f),
+      mCameraPosition(0.0f),
+      mPointLightCount(0),
+      mClearColor(0xFF000000u),
+      mChunkCount(0),
+      mTriangleCount(0),
+      mRejectedBlocks(0),
+      mBlocksRejected(0) {
+    unsigned BlocksY = (height + SOFTWARE_BLOCK_SIZE - 1) / SOFTWARE_BLOCK_SIZE;
+    mColor.assign((size_t)mPitch * BlocksY * SOFTWARE_BLOCK_SIZE, mClearColor);
+    mDepth.assign((size_t)mPitch * BlocksY * SOFTWARE_BLOCK_SIZE, 1.0f);
+    mBlockMaxDepth.assign((size_t)mBlocksX * BlocksY, 1.0f);
+    std::memset((void*)&mLights, 0, sizeof(mLights));
+}
+
+void
+SoftwareRasterizer::BeginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition,
+                               const LightUniforms& lights, unsigned pointLightCount, const glm::vec3& clearColor) {
+    mViewProjection = projection * view;
+    mCameraPosition = cameraPosition;
+    mLights = lights;
+    mPointLightCount = std::min(pointLightCount, (unsigned)MAX_POINT_LIGHTS);
+    mClearColor = packColor(clearColor.x, clearColor.y, clearColor.z);
+    mDraws.clear();
+    mTransformed.clear();
+}
+
+void
+SoftwareRasterizer::Draw(const float* vertices, unsigned vertexCount, const SoftwareVertexLayout& layout,
+                         const unsigned* indices, unsigned indexCount,
+                         const glm::mat4& model, const glm::mat3& normal, const SoftwareMaterial& material) {
+    DrawCall NewDraw;
+    NewDraw.Vertices = vertices;
+    NewDraw.VertexCount = vertexCount;
+    NewDraw.Layout = layout;
+    NewDraw.Indices = indices;
+    NewDraw.TriangleCount = (indices ? indexCount : vertexCount) / 3;
+    NewDraw.Model = model;
+    NewDraw.Normal = normal;
+    NewDraw.Material = material;
+    NewDraw.HasSpecular = material.Specular && !material.Specular->Texels.empty();
+    NewDraw.FirstVertex = (unsigned)mTransformed.size();
+    if (!NewDraw.TriangleCount) {
+        return;
+    }
+    mDraws.push_back(NewDraw);
+    mTransformed.resize(mTransformed.size() + vertexCount);
+}
+
+void
+SoftwareRasterizer::EndFrame() {
+    JobCounter Transforms;
+    for (unsigned DrawIdx = 0; DrawIdx < mDraws.size(); ++DrawIdx) {
+        Jobs::ParallelFor(mDraws[DrawIdx].VertexCount, TransformGrain, [this, DrawIdx](unsigned begin, unsigned end) {
+            const DrawCall& Current = mDraws[DrawIdx];
+            DrawCall Range = Current;
+            Range.Vertices = Current.Vertices + (size_t)begin * Current.Layout.Stride;
+            Range.VertexCount = end - begin;
+            Range.FirstVertex = Current.FirstVertex + begin;
+            transformVertices(Range);
+        }, &Transforms);
+    }
+    Jobs::Wait(Transforms);
+
+    // NOTE: Chunks never span draws, so every chunk knows its draw and the
+    // bins of all chunks together keep submission order per tile
+    mChunkCount = 0;
+    for (unsigned DrawIdx = 0; DrawIdx < mDraws.size(); ++DrawIdx) {
+        for (unsigned First = 0; First < mDraws[DrawIdx].TriangleCount; First += SOFTWARE_SETUP_GRAIN) {
+            if (mChunkCount == mChunks.size()) {
+                mChunks.emplace_back();
+                mChunks.back().Bins.resize(mTilesX * mTilesY);
+            }
+            SetupChunk& Chunk = mChunks[mChunkCount++];
+            Chunk.Draw = DrawIdx;
+            Chunk.FirstTriangle = First;
+            Chunk.TriangleCount = std::min((unsigned)SOFTWARE_SETUP_GRAIN, mDraws[DrawIdx].TriangleCount - First);
+        }
+    }
+    Jobs::ParallelFor(mChunkCount, 1, [this](unsigned begin, unsigned end) {
+        for (unsigned ChunkIdx = begin; ChunkIdx < end; ++ChunkIdx) {
+            setupChunk(mChunks[ChunkIdx]);
+        }
+    });
+
+    mTriangleCount = 0;
+    for (unsigned ChunkIdx = 0; ChunkIdx < mChunkCount; ++ChunkIdx) {
+        mTriangleCount += (unsigned)mChunks[ChunkIdx].Triangles.size();
+    }
+
+    mBlocksRejected = 0;
+    Jobs::ParallelFor(mTilesX * mTilesY, 1, [this](unsigned begin, unsigned end) {
+        for (unsigned Tile = begin; Tile < end; ++Tile) {
+            rasterizeTile(Tile % mTilesX, Tile / mTilesX);
+        }
+    });
+    mRejectedBlocks = mBlocksRejected;
+}
+
+bool
+SoftwareRasterizer::WritePpm(const std::string& path) const {
+    std::ofstream Output(path.c_str(), std::ios::binary);
+    if (!Output) {
+        std::cerr << "[Err] Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    Output << "P6\n" << mWidth << " " << mHeight << "\n255\n";
+    std::vector<unsigned char> Row(mWidth * 3);
+    for (unsigned Y = 0; Y < mHeight; ++Y) {
+        for (unsigned X = 0; X < mWidth; ++X) {
+            unsigned Pixel = mColor[(size_t)Y * mPitch + X];
+            Row[X * 3 + 0] = (unsigned char)(Pixel & 0xFF);
+            Row[X * 3 + 1] = (unsigned char)((Pixel >> 8) & 0xFF);
+            Row[X * 3 + 2] = (unsigned char)((Pixel >> 16) & 0xFF);
+        }
+        Output.write((const char*)Row.data(), Row.size());
+    }
+    return (bool)Output;
+}
+
+void
+SoftwareRasterizer::transformVertices(const DrawCall& draw) {
+    glm::mat4 ClipFromObject = mViewProjection * draw.Model;
+    const SoftwareVertexLayout& Layout = draw.Layout;
+    for (unsigned VertexIdx = 0; VertexIdx < draw.VertexCount; ++VertexIdx) {
+        const float* Source = draw.Vertices + (size_t)VertexIdx * Layout.Stride;
+        glm::vec4 Position(Source[Layout.Position], Source[Layout.Position + 1], Source[Layout.Position + 2], 1.0f);
+        glm::vec3 Normal(Source[Layout.Normal], Source[Layout.Normal + 1], Source[Layout.Normal + 2]);
+
+        // NOTE: Same outputs as shader.vert
+        TransformedVertex& Target = mTransformed[draw.FirstVertex + VertexIdx];
+        Target.Clip = ClipFromObject * Position;
+        Target.World = glm::vec3(draw.Model * Position);
+        Target.Normal = glm::normalize(draw.Normal * Normal);
+        Target.TexCoords = glm::vec2(Source[Layout.TexCoords], Source[Layout.TexCoords + 1]);
+    }
+}
+
+void
+SoftwareRasterizer::setupChunk(SetupChunk& chunk) {
+    chunk.Triangles.clear();
+    for (unsigned Tile = 0; Tile < chunk.Bins.size(); ++Tile) {
+        chunk.Bins[Tile].clear();
+    }
+
+    const DrawCall& Draw = mDraws[chunk.Draw];
+    const TransformedVertex* Vertices = &mTransformed[Draw.FirstVertex];
+    for (unsigned Tri = chunk.FirstTriangle; Tri < chunk.FirstTriangle + chunk.TriangleCount; ++Tri) {
+        const TransformedVertex* Corners[3];
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            unsigned Index = Draw.Indices ? Draw.Indices[Tri * 3 + Corner] : Tri * 3 + Corner;
+            Corners[Corner] = &Vertices[Index];
+        }
+
+        // NOTE: Trivially reject triangles outside one frustum plane
+        unsigned OutsideAll = 0x3F;
+        unsigned OutsideNear = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            const glm::vec4& Clip = Corners[Corner]->Clip;
+            unsigned Outside = (Clip.x < -Clip.w ? 1 : 0) | (Clip.x > Clip.w ? 2 : 0) | (Clip.y < -Clip.w ? 4 : 0)
+                             | (Clip.y > Clip.w ? 8 : 0) | (Clip.z < -Clip.w ? 16 : 0) | (Clip.z > Clip.w ? 32 : 0);
+            OutsideAll &= Outside;
+            OutsideNear |= (Outside & 16) ? 1u << Corner : 0;
+        }
+        if (OutsideAll) {
+            continue;
+        }
+        if (!OutsideNear) {
+            setupTriangle(chunk, chunk.Draw, *Corners[0], *Corners[1], *Corners[2]);
+            continue;
+        }
+
+        // NOTE: Clip against the near plane z = -w, which keeps w positive
+        // for the perspective divide. At most one extra triangle comes out
+        auto Lerp = [](const TransformedVertex& from, const TransformedVertex& to, float t) {
+            TransformedVertex Result;
+            Result.Clip = from.Clip + (to.Clip - from.Clip) * t;
+            Result.World = from.World + (to.World - from.World) * t;
+            Result.Normal = from.Normal + (to.Normal - from.Normal) * t;
+            Result.TexCoords = from.TexCoords + (to.TexCoords - from.TexCoords) * t;
+            return Result;
+        };
+        TransformedVertex Polygon[4];
+        unsigned PolygonCount = 0;
+        for (unsigned Corner = 0; Corner < 3; ++Corner) {
+            const TransformedVertex& Current = *Corners[Corner];
+            const TransformedVertex& Next = *Corners[(Corner + 1) % 3];
+            float CurrentDistance = Current.Clip.z + Current.Clip.w;
+            float NextDistance = Next.Clip.z + Next.Clip.w;
+            if (CurrentDistance >= 0.0f) {
+                Polygon[PolygonCount++] = Current;
+            }
+            if ((CurrentDistance >= 0.0f) != (NextDistance >= 0.0f)) {
+                Polygon[PolygonCount++] = Lerp(Current, Next, CurrentDistance / (CurrentDistance - NextDistance));
+            }
+        }
+        for (unsigned Fan = 2; Fan < PolygonCount; ++Fan) {
+            setupTriangle(chunk, chunk.Draw, Polygon[0], Polygon[Fan - 1], Polygon[Fan]);
+        }
+    }
+}
+
+void
+SoftwareRasterizer::setupTriangle(SetupChunk& chunk, unsigned drawIdx, const TransformedVertex& a, const TransformedVertex& b, const TransformedVertex& c) {
+    const TransformedVertex* Corners[3] = { &a, &b, &c };
+    float X[3], Y[3], Values[3][PLANE_COUNT];
+    for (unsigned Corner = 0; Corner < 3; ++Corner) {
+        const TransformedVertex& Vertex = *Corners[Corner];
+        float InvW = 1.0f / Vertex.Clip.w;
+        // NOTE: Rows go top to bottom, GL's window origin is bottom left
+        X[Corner] = std::floor(((Vertex.Clip.x * InvW) * 0.5f + 0.5f) * mWidth * SubpixelSteps + 0.5f) / SubpixelSteps;
+        Y[Corner] = std::floor((0.5f - (Vertex.Clip.y * InvW) * 0.5f) * mHeight * SubpixelSteps + 0.5f) / SubpixelSteps;
+
+        // NOTE: Depth is linear in screen space, everything else is
+        // interpolated over w and divided back per pixel
+        float* Value = Values[Corner];
+        Value[PLANE_DEPTH] = (Vertex.Clip.z * InvW) * 0.5f + 0.5f;
+        Value[PLANE_INV_W] = InvW;
+        Value[PLANE_WORLD_X] = Vertex.World.x * InvW;
+        Value[PLANE_WORLD_Y] = Vertex.World.y * InvW;
+        Value[PLANE_WORLD_Z] = Vertex.World.z * InvW;
+        Value[PLANE_NORMAL_X] = Vertex.Normal.x * InvW;
+        Value[PLANE_NORMAL_Y] = Vertex.Normal.y * InvW;
+        Value[PLANE_NORMAL_Z] = Vertex.Normal.z * InvW;
+        Value[PLANE_U] = Vertex.TexCoords.x * InvW;
+        Value[PLANE_V] = Vertex.TexCoords.y * InvW;
+    }
+
+    // NOTE: With rows flipped, GL's counter-clockwise front faces have
+    // negative area. Back faces and degenerate triangles are dropped
+    float Area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (Area >= 0.0f) {
+        return;
+    }
+    std::swap(X[1], X[2]);
+    std::swap(Y[1], Y[2]);
+    for (unsigned Plane = 0; Plane < PLANE_COUNT; ++Plane) {
+        std::swap(Values[1][Plane], Values[2][Plane]);
+    }
+    Area = -Area;
+
+    Triangle Setup;
+    Setup.MinX = std::max((int)std::floor(std::min(X[0], std::min(X[1], X[2]))), 0);
+    Setup.MinY = std::max((int)std::floor(std::min(Y[0], std::min(Y[1], Y[2]))), 0);
+    Setup.MaxX = std::min((int)std::ceil(std::max(X[0], std::max(X[1], X[2]))), (int)mWidth);
+    Setup.MaxY = std::min((int)std::ceil(std::max(Y[0], std::max(Y[1], Y[2]))), (int)mHeight);
+    if (Setup.MinX >= Setup.MaxX || Setup.MinY >= Setup.MaxY) {
+        return;
+    }
+    Setup.MinDepth = std::min(Values[0][PLANE_DEPTH], std::min(Values[1][PLANE_DEPTH], Values[2][PLANE_DEPTH]));
+    if (Setup.MinDepth > 1.0f) {
+        return;
+    }
+
+    for (unsigned Edge = 0; Edge < 3; ++Edge) {
+        unsigned Next = (Edge + 1) % 3;
+        Setup.EdgeA[Edge] = Y[Edge] - Y[Next];
+        Setup.EdgeB[Edge] = X[Next] - X[Edge];
+        Setup.EdgeX[Edge] = X[Edge];
+        Setup.EdgeY[Edge] = Y[Edge];
+        // NOTE: Of two triangles sharing an edge exactly one sees it with
+        // this sign pattern, so pixel centers on the edge are drawn once
+        Setup.EdgeOwned[Edge] = Setup.EdgeA[Edge] > 0.0f || (Setup.EdgeA[Edge] == 0.0f && Setup.EdgeB[Edge] < 0.0f);
+    }
+
+    float InvArea = 1.0f / Area;
+    float DX1 = X[1] - X[0], DY1 = Y[1] - Y[0];
+    float DX2 = X[2] - X[0], DY2 = Y[2] - Y[0];
+    Setup.OriginX = X[0];
+    Setup.OriginY = Y[0];
+    for (unsigned Plane = 0; Plane < PLANE_COUNT; ++Plane) {
+        float F1 = Values[1][Plane] - Values[0][Plane];
+        float F2 = Values[2][Plane] - Values[0][Plane];
+        Setup.Base[Plane] = Values[0][Plane];
+        Setup.DX[Plane] = (F1 * DY2 - F2 * DY1) * InvArea;
+        Setup.DY[Plane] = (F2 * DX1 - F1 * DX2) * InvArea;
+    }
+    Setup.Draw = drawIdx;
+
+    unsigned Index = (unsigned)chunk.Triangles.size();
+    chunk.Triangles.push_back(Setup);
+    unsigned TileX0 = Setup.MinX / SOFTWARE_TILE_SIZE, TileX1 = (Setup.MaxX - 1) / SOFTWARE_TILE_SIZE;
+    unsigned TileY0 = Setup.MinY / SOFTWARE_TILE_SIZE, TileY1 = (Setup.MaxY - 1) / SOFTWARE_TILE_SIZE;
+    for (unsigned TileY = TileY0; TileY <= TileY1; ++TileY) {
+        for (unsigned TileX = TileX0; TileX <= TileX1; ++TileX) {
+            chunk.Bins[TileY * mTilesX + TileX].push_back(Index);
+        }
+    }
+}
+
+void
+SoftwareRasterizer::rasterizeTile(unsigned tileX, unsigned tileY) {
+    int MinX = tileX * SOFTWARE_TILE_SIZE;
+    int MinY = tileY * SOFTWARE_TILE_SIZE;
+    int MaxX = std::min(MinX + SOFTWARE_TILE_SIZE, (int)mWidth);
+    int MaxY = std::min(MinY + SOFTWARE_TILE_SIZE, (int)mHeight);
+
+    // NOTE: Cleared here rather than up front so the tile stays in cache
+    int ClearMaxX = std::min(MinX + SOFTWARE_TILE_SIZE, (int)mPitch);
+    int ClearMaxY = std::min(MinY + SOFTWARE_TILE_SIZE, (int)(mDepth.size() / mPitch));
+    for (int Y = MinY; Y < ClearMaxY; ++Y) {
+        std::fill_n(&mColor[(size_t)Y * mPitch + MinX], ClearMaxX - MinX, mClearColor);
+        std::fill_n(&mDepth[(size_t)Y * mPitch + MinX], ClearMaxX - MinX, 1.0f);
+    }
+    for (int BlockY = MinY / SOFTWARE_BLOCK_SIZE; BlockY < ClearMaxY / SOFTWARE_BLOCK_SIZE; ++BlockY) {
+        for (int BlockX = MinX / SOFTWARE_BLOCK_SIZE; BlockX < ClearMaxX / SOFTWARE_BLOCK_SIZE; ++BlockX) {
+            mBlockMaxDepth[BlockY * mBlocksX + BlockX] = 1.0f;
+        }
+    }
+
+    unsigned Tile = tileY * mTilesX + tileX;
+    unsigned Rejected = 0;
+    for (unsigned ChunkIdx = 0; ChunkIdx < mChunkCount; ++ChunkIdx) {
+        const SetupChunk& Chunk = mChunks[ChunkIdx];
+        const std::vector<unsigned>& Bin = Chunk.Bins[Tile];
+        for (unsigned BinIdx = 0; BinIdx < Bin.size(); ++BinIdx) {
+            rasterizeTriangle(Chunk.Triangles[Bin[BinIdx]], MinX, MinY, MaxX, MaxY, Rejected);
+        }
+    }
+    mBlocksRejected += Rejected;
+}
+
+void
+SoftwareRasterizer::rasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, unsigned& rejectedBlocks) {
+    int MinX = std::max(triangle.MinX, tileMinX);
+    int MinY = std::max(triangle.MinY, tileMinY);
+    int MaxX = std::min(triangle.MaxX, tileMaxX);
+    int MaxY = std::min(triangle.MaxY, tileMaxY);
+    if (MinX >= MaxX || MinY >= MaxY) {
+        return;
+    }
+
+    const DrawCall& Draw = mDraws[triangle.Draw];
+    const SoftwareMaterial& Material = Draw.Material;
+    const Lane4 LaneOffsets(0.0f, 1.0f, 2.0f, 3.0f);
+
+    // NOTE: Light terms that are the same for every pixel
+    glm::vec3 DirLightVector = glm::normalize(-glm::vec3(mLights.DirLight.Direction));
+    glm::vec3 SpotDirection = glm::normalize(-glm::vec3(mLights.Spotlight.Direction));
+    float SpotEpsilon = mLights.Spotlight.CutOff.x - mLights.Spotlight.CutOff.y;
+
+    for (int BlockY = MinY / SOFTWARE_BLOCK_SIZE; BlockY <= (MaxY - 1) / SOFTWARE_BLOCK_SIZE; ++BlockY) {
+        for (int BlockX = MinX / SOFTWARE_BLOCK_SIZE; BlockX <= (MaxX - 1) / SOFTWARE_BLOCK_SIZE; ++BlockX) {
+            float& BlockMax = mBlockMaxDepth[BlockY * mBlocksX + BlockX];
+            if (triangle.MinDepth >= BlockMax) {
+                ++rejectedBlocks;
+                continue;
+            }
+
+            // NOTE: Skip blocks entirely outside an edge, tested at the
+            // pixel center where that edge function is largest
+            int BlockPixelX = BlockX * SOFTWARE_BLOCK_SIZE;
+            int BlockPixelY = BlockY * SOFTWARE_BLOCK_SIZE;
+            bool Outside = false;
+            for (unsigned Edge = 0; Edge < 3 && !Outside; ++Edge) {
+                float CornerX = BlockPixelX + 0.5f + (triangle.EdgeA[Edge] > 0.0f ? SOFTWARE_BLOCK_SIZE - 1 : 0);
+                float CornerY = BlockPixelY + 0.5f + (triangle.EdgeB[Edge] > 0.0f ? SOFTWARE_BLOCK_SIZE - 1 : 0);
+                Outside = triangle.EdgeA[Edge] * (CornerX - triangle.EdgeX[Edge]) + triangle.EdgeB[Edge] * (CornerY - triangle.EdgeY[Edge]) < 0.0f;
+            }
+            if (Outside) {
+                continue;
+            }
+
+            bool Written = false;
+            int RowBegin = std::max(BlockPixelY, MinY);
+            int RowEnd = std::min(BlockPixelY + SOFTWARE_BLOCK_SIZE, MaxY);
+            for (int PixelY = RowBegin; PixelY < RowEnd; ++PixelY) {
+                for (int GroupX = BlockPixelX; GroupX < BlockPixelX + SOFTWARE_BLOCK_SIZE; GroupX += 4) {
+                    if (GroupX + 4 <= MinX || GroupX >= MaxX) {
+                        continue;
+                    }
+
+                    Lane4 LaneX = Lane4((float)GroupX) + LaneOffsets;
+                    Mask4 Cover = (LaneX >= Lane4((float)MinX)) & (LaneX < Lane4((float)MaxX));
+                    Lane4 PX = LaneX + Lane4(0.5f);
+                    Lane4 PY((float)PixelY + 0.5f);
+                    for (unsigned Edge = 0; Edge < 3; ++Edge) {
+                        Lane4 Value = Lane4(triangle.EdgeA[Edge]) * (PX - Lane4(triangle.EdgeX[Edge]))
+                                    + Lane4(triangle.EdgeB[Edge]) * (PY - Lane4(triangle.EdgeY[Edge]));
+                        Cover = Cover & ((Value > Lane4(0.0f)) | ((Value == Lane4(0.0f)) & maskAll(triangle.EdgeOwned[Edge])));
+                    }
+                    if (!Cover.Bits()) {
+                        continue;
+                    }
+
+                    Lane4 OffsetX = PX - Lane4(triangle.OriginX);
+                    Lane4 OffsetY = PY - Lane4(triangle.OriginY);
+#define PLANE(plane) (Lane4(triangle.Base[plane]) + Lane4(triangle.DX[plane]) * OffsetX + Lane4(triangle.DY[plane]) * OffsetY)
+                    float* DepthRow = &mDepth[(size_t)PixelY * mPitch + GroupX];
+                    Lane4 Depth = PLANE(PLANE_DEPTH);
+                    Lane4 OldDepth = Lane4::Load(DepthRow);
+                    Cover = Cover & (Depth < OldDepth);
+                    if (!Cover.Bits()) {
+                        continue;
+                    }
+
+                    Lane4 W = Lane4(1.0f) / PLANE(PLANE_INV_W);
+                    Lane3 World = { PLANE(PLANE_WORLD_X) * W, PLANE(PLANE_WORLD_Y) * W, PLANE(PLANE_WORLD_Z) * W };
+                    Lane4 U = PLANE(PLANE_U) * W;
+                    Lane4 V = PLANE(PLANE_V) * W;
+
+                    ShadeInputs In;
+                    In.Normal.X = PLANE(PLANE_NORMAL_X) * W;
+                    In.Normal.Y = PLANE(PLANE_NORMAL_Y) * W;
+                    In.Normal.Z = PLANE(PLANE_NORMAL_Z) * W;
+#undef PLANE
+                    Lane4 Alpha;
+                    sampleTexture(Material.Diffuse, U, V, In.Diffuse.X, In.Diffuse.Y, In.Diffuse.Z, Alpha);
+                    if (Material.AlphaTest) {
+                        Cover = Cover & (Alpha >= Lane4(0.5f));
+                        if (!Cover.Bits()) {
+                            continue;
+                        }
+                    }
+                    In.HasSpecular = Draw.HasSpecular;
+                    In.Shininess = (unsigned)(Material.Shininess + 0.5f);
+                    if (In.HasSpecular) {
+                        Lane4 Unused;
+                        sampleTexture(Material.Specular, U, V, In.Specular.X, In.Specular.Y, In.Specular.Z, Unused);
+                    }
+                    Lane3 ToCamera = { Lane4(mCameraPosition.x) - World.X, Lane4(mCameraPosition.y) - World.Y, Lane4(mCameraPosition.z) - World.Z };
+                    Lane4 Distance;
+                    In.ViewDirection = normalize(ToCamera, Distance);
+
+                    const DirectionalLightUniforms& Dir = mLights.DirLight;
+                    Lane3 Color = shadeLight(In, broadcast(DirLightVector), Dir.Ka, Dir.Kd, Dir.Ks);
+
+                    for (unsigned LightIdx = 0; LightIdx < mPointLightCount; ++LightIdx) {
+                        const PointLightUniforms& Light = mLights.PointLights[LightIdx];
+                        Lane3 ToLight = { Lane4(Light.Position.x) - World.X, Lane4(Light.Position.y) - World.Y, Lane4(Light.Position.z) - World.Z };
+                        Lane3 LightVector = normalize(ToLight, Distance);
+                        accumulate(Color, shadeLight(In, LightVector, Light.Ka, Light.Kd, Light.Ks), attenuate(Light.Attenuation, Distance));
+                    }
+
+                    const DirectionalLightUniforms& Spot = mLights.Spotlight;
+                    Lane3 ToSpot = { Lane4(Spot.Position.x) - World.X, Lane4(Spot.Position.y) - World.Y, Lane4(Spot.Position.z) - World.Z };
+                    Lane3 SpotVector = normalize(ToSpot, Distance);
+                    Lane4 Theta = dot(SpotVector, broadcast(SpotDirection));
+                    Lane4 Intensity = laneClamp((Theta - Lane4(Spot.CutOff.y)) / Lane4(SpotEpsilon), 0.0f, 1.0f);
+                    accumulate(Color, shadeLight(In, SpotVector, Spot.Ka, Spot.Kd, Spot.Ks), Intensity * attenuate(Spot.Attenuation, Distance));
+
+                    select(Cover, Depth, OldDepth).Store(DepthRow);
+                    float R[4], G[4], B[4];
+                    laneStore(Color.X, R);
+                    laneStore(Color.Y, G);
+                    laneStore(Color.Z, B);
+                    unsigned* ColorRow = &mColor[(size_t)PixelY * mPitch + GroupX];
+                    int Bits = Cover.Bits();
+                    for (unsigned Lane = 0; Lane < 4; ++Lane) {
+                        if (Bits & (1 << Lane)) {
+                            ColorRow[Lane] = packColor(R[Lane], G[Lane], B[Lane]);
+                        }
+                    }
+                    Written = true;
+                }
+            }
+
+            if (Written) {
+                Lane4 Farthest(0.0f);
+                for (int Row = 0; Row < SOFTWARE_BLOCK_SIZE; ++Row) {
+                    const float* DepthRow = &mDepth[(size_t)(BlockPixelY + Row) * mPitch + BlockPixelX];
+                    for (int Column = 0; Column < SOFTWARE_BLOCK_SIZE; Column += 4) {
+                        Farthest = laneMax(Farthest, Lane4::Load(DepthRow + Column));
+                    }
+                }
+                float Lanes[4];
+                laneStore(Farthest, Lanes);
+                BlockMax = std::max(std::max(Lanes[0], Lanes[1]), std::max(Lanes[2], Lanes[3]));
+            }
+        }
+    }
+}
@@ -0,0 +1,246 @@
+/**
+ * @file softrasterizer.hpp
+ * @brief CPU renderer for machines without a GPU. Draws the same vertex data,
+ * textures and lights as the GL path. Triangles are set up and binned into
+ * screen tiles on the job system, then every tile is rasterized by one job
+ * with SIMD edge functions against a depth buffer with a per-block max depth
+ * for hierarchical rejection. Shading is shader.frag evaluated four pixels at
+ * a time
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frameuniforms.hpp"
+#include "jobsystem.hpp"
+
+#define SOFTWARE_TILE_SIZE 64
+// NOTE: Depth blocks keep their farthest depth for hierarchical rejection
+#define SOFTWARE_BLOCK_SIZE 8
+// NOTE: Input triangles set up and binned per job
+#define SOFTWARE_SETUP_GRAIN 2048
+
+/**
+ * @brief RGBA8 texture in CPU memory, bottom row first like GL textures
+ *
+ */
+struct SoftwareTexture {
+    int Width;
+    int Height;
+    bool HasAlpha;
+    std::vector<unsigned> Texels;
+
+    SoftwareTexture() : Width(0), Height(0), HasAlpha(false) {}
+
+    /**
+     * @brief Loads an image file
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Load(const std::string& path);
+};
+
+/**
+ * @brief Float offsets of the attributes shader.vert reads within a vertex
+ *
+ */
+struct SoftwareVertexLayout {
+    unsigned Stride;
+    unsigned Position;
+    unsigned Normal;
+    unsigned TexCoords;
+};
+
+struct SoftwareMaterial {
+    // NOTE: Missing textures sample as black, like unbound GL samplers
+    const SoftwareTexture* Diffuse;
+    // NOTE: Specular lighting is only evaluated with a specular map, see HAS_SPECULAR
+    const SoftwareTexture* Specular;
+    float Shininess;
+    bool AlphaTest;
+};
+
+class SoftwareRasterizer {
+public:
+    /**
+     * @brief Ctor
+     *
+     * @param width - Framebuffer width in pixels
+     * @param height - Framebuffer height in pixels
+     */
+    SoftwareRasterizer(unsigned width, unsigned height);
+
+    /**
+     * @brief Starts a frame. Draws are queued until EndFrame
+     *
+     * @param view - View matrix
+     * @param projection - Projection matrix
+     * @param cameraPosition - Camera world position
+     * @param lights - Same block the GL path uploads
+     * @param pointLightCount - Point lights in use
+     * @param clearColor - Background colour
+     */
+    void BeginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition,
+                    const LightUniforms& lights, unsigned pointLightCount, const glm::vec3& clearColor);
+
+    /**
+     * @brief Queues a triangle list. Vertex and index data must stay alive
+     * until EndFrame returns. Faces wound clockwise are culled like GL_CULL_FACE
+     *
+     * @param vertices - Interleaved vertex data
+     * @param vertexCount - Vertex count
+     * @param layout - Attribute offsets within a vertex
+     * @param indices - Triangle list, 0 to draw the vertices in order
+     * @param indexCount - Index count, ignored without indices
+     * @param model - Model matrix
+     * @param normal - Normal matrix
+     * @param material - Textures and lighting parameters, copied
+     */
+    void Draw(const float* vertices, unsigned vertexCount, const SoftwareVertexLayout& layout,
+              const unsigned* indices, unsigned indexCount,
+              const glm::mat4& model, const glm::mat3& normal, const SoftwareMaterial& material);
+
+    /**
+     * @brief Transforms, sets up, bins and rasterizes every queued draw.
+     * Returns once the frame is complete
+     *
+     */
+    void EndFrame();
+
+    /**
+     * @brief Writes the last frame as a binary PPM
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool WritePpm(const std::string& path) const;
+
+    unsigned GetWidth() const { return mWidth; }
+    unsigned GetHeight() const { return mHeight; }
+
+    /**
+     * @brief RGBA8 pixels of the last frame, top row first, GetPitch pixels per row
+     *
+     */
+    const std::vector<unsigned>& GetColor() const { return mColor; }
+    unsigned GetPitch() const { return mPitch; }
+
+    /**
+     * @brief Triangles that survived clipping and culling in the last frame
+     *
+     */
+    unsigned GetTriangleCount() const { return mTriangleCount; }
+
+    /**
+     * @brief Depth blocks skipped in the last frame because a triangle lay
+     * entirely behind them
+     *
+     */
+    unsigned GetRejectedBlocks() const { return mRejectedBlocks; }
+
+private:
+    struct DrawCall {
+        const float* Vertices;
+        unsigned VertexCount;
+        SoftwareVertexLayout Layout;
+        const unsigned* Indices;
+        unsigned TriangleCount;
+        glm::mat4 Model;
+        glm::mat3 Normal;
+        SoftwareMaterial Material;
+        bool HasSpecular;
+        // NOTE: First vertex in mTransformed
+        unsigned FirstVertex;
+    };
+
+    struct TransformedVertex {
+        glm::vec4 Clip;
+        glm::vec3 World;
+        glm::vec3 Normal;
+        glm::vec2 TexCoords;
+    };
+
+    // NOTE: Every plane is f(x, y) = Base + DX * (x - OriginX) + DY * (y - OriginY)
+    enum EPlane {
+        PLANE_DEPTH = 0,
+        PLANE_INV_W,
+        PLANE_WORLD_X,
+        PLANE_WORLD_Y,
+        PLANE_WORLD_Z,
+        PLANE_NORMAL_X,
+        PLANE_NORMAL_Y,
+        PLANE_NORMAL_Z,
+        PLANE_U,
+        PLANE_V,
+        PLANE_COUNT
+    };
+
+    struct Triangle {
+        float OriginX;
+        float OriginY;
+        // NOTE: Edge i is EdgeA * (x - EdgeX) + EdgeB * (y - EdgeY), inside when positive
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeX[3];
+        float EdgeY[3];
+        bool EdgeOwned[3];
+        float Base[PLANE_COUNT];
+        float DX[PLANE_COUNT];
+        float DY[PLANE_COUNT];
+        int MinX;
+        int MinY;
+        int MaxX;
+        int MaxY;
+        float MinDepth;
+        unsigned Draw;
+    };
+
+    // NOTE: A range of one draw's triangles, set up and binned by one job.
+    // Buffers are reused from frame to frame
+    struct SetupChunk {
+        unsigned Draw;
+        unsigned FirstTriangle;
+        unsigned TriangleCount;
+        std::vector<Triangle> Triangles;
+        // NOTE: Triangle indices per tile, in submission order
+        std::vector<std::vector<unsigned> > Bins;
+    };
+
+    unsigned mWidth;
+    unsigned mHeight;
+    // NOTE: Rows padded to whole depth blocks so SIMD groups never run off the end
+    unsigned mPitch;
+    unsigned mTilesX;
+    unsigned mTilesY;
+    unsigned mBlocksX;
+    std::vector<unsigned> mColor;
+    std::vector<float> mDepth;
+    std::vector<float> mBlockMaxDepth;
+
+    glm::mat4 mViewProjection;
+    glm::vec3 mCameraPosition;
+    LightUniforms mLights;
+    unsigned mPointLightCount;
+    unsigned mClearColor;
+
+    std::vector<DrawCall> mDraws;
+    std::vector<TransformedVertex> mTransformed;
+    std::vector<SetupChunk> mChunks;
+    unsigned mChunkCount;
+
+    unsigned mTriangleCount;
+    unsigned mRejectedBlocks;
+    std::atomic<unsigned> mBlocksRejected;
+
+    void transformVertices(const DrawCall& draw);
+    void setupChunk(SetupChunk& chunk);
+    void setupTriangle(SetupChunk& chunk, unsigned drawIdx, const TransformedVertex& a, const TransformedVertex& b, const TransformedVertex& c);
+    void rasterizeTile(unsigned tileX, unsigned tileY);
+    void rasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, unsigned& rejectedBlocks);
+};
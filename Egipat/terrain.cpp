@@ -0,0 +1,414 @@
+#include "terrain.hpp"
+#include "gpumemory.hpp"
+#include "framearena.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// NOTE: Vertex layout matches shader.vert: position, UV, normal
+static const unsigned TerrainVertexElements = 8;
+static const float TerrainTextureTile = 30.0f;
+static const unsigned MaxUploadsPerFrame = 8;
+
+static float
+latticeNoise(int x, int z) {
+    unsigned Hash = (unsigned)x * 374761393u + (unsigned)z * 668265263u;
+    Hash = (Hash ^ (Hash >> 13)) * 1274126177u;
+    Hash ^= Hash >> 16;
+    return (Hash & 0xFFFF) / 65535.0f;
+}
+
+static float
+valueNoise(float x, float z) {
+    int X0 = (int)std::floor(x);
+    int Z0 = (int)std::floor(z);
+    float FX = x - X0;
+    float FZ = z - Z0;
+    FX = FX * FX * (3.0f - 2.0f * FX);
+    FZ = FZ * FZ * (3.0f - 2.0f * FZ);
+    float N00 = latticeNoise(X0, Z0);
+    float N10 = latticeNoise(X0 + 1, Z0);
+    float N01 = latticeNoise(X0, Z0 + 1);
+    float N11 = latticeNoise(X0 + 1, Z0 + 1);
+    float Top = N00 + (N10 - N00) * FX;
+    float Bottom = N01 + (N11 - N01) * FX;
+    return Top + (Bottom - Top) * FZ;
+}
+
+static void
+writeVertex(float x, float z, float cell, float* vertex) {
+    float Height = Terrain::GetHeight(x, z);
+    float DX = Terrain::GetHeight(x + cell, z) - Terrain::GetHeight(x - cell, z);
+    float DZ = Terrain::GetHeight(x, z + cell) - Terrain::GetHeight(x, z - cell);
+    glm::vec3 Normal = glm::normalize(glm::vec3(-DX, 2.0f * cell, -DZ));
+
+    vertex[0] = x;
+    vertex[1] = Height;
+    vertex[2] = z;
+    vertex[3] = x / TerrainTextureTile;
+    vertex[4] = z / TerrainTextureTile;
+    vertex[5] = Normal.x;
+    vertex[6] = Normal.y;
+    vertex[7] = Normal.z;
+}
+
+Terrain::Terrain(float chunkSize, unsigned chunkQuads, int viewRadius, unsigned triangleBudget)
+    : mChunkSize(chunkSize),
+      mChunkQuads(chunkQuads),
+      mViewRadius(viewRadius),
+      mTriangleBudget(triangleBudget),
+      mLodCount(0),
+      mTriangleCount(0),
+      mEBO(0),
+      mStopping(false) {
+    while ((mChunkQuads >> mLodCount) >= 1) {
+        ++mLodCount;
+    }
+    buildIndices();
+    mWorker = std::thread(&Terrain::workerLoop, this);
+}
+
+Terrain::~Terrain() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    mWorker.join();
+
+    for (auto& Entry : mChunks) {
+        if (Entry.second.State == CHUNK_READY) {
+            GpuMemory::DeleteBuffer(Entry.second.VBO);
+            GpuMemory::DeleteVertexArray(Entry.second.VAO);
+        }
+    }
+    GpuMemory::DeleteBuffer(mEBO);
+}
+
+float
+Terrain::GetHeight(float x, float z) {
+    // NOTE: Long wind-aligned dune ridges with noise on top. The site around
+    // the pyramids stays flat at height 0
+    float Ridges = std::sin(x * 0.035f + 2.0f * std::sin(z * 0.011f)) * 0.5f + 0.5f;
+    Ridges = Ridges * Ridges * 9.0f;
+    float Detail = 0.0f;
+    float Amplitude = 4.0f;
+    float Frequency = 0.02f;
+    for (unsigned Octave = 0; Octave < 4; ++Octave) {
+        Detail += valueNoise(x * Frequency, z * Frequency) * Amplitude;
+        Amplitude *= 0.5f;
+        Frequency *= 2.0f;
+    }
+
+    float Distance = std::sqrt(x * x + z * z);
+    float Blend = std::min(std::max((Distance - 20.0f) / 60.0f, 0.0f), 1.0f);
+    Blend = Blend * Blend * (3.0f - 2.0f * Blend);
+    return (Ridges + Detail) * Blend;
+}
+
+void
+Terrain::BuildPatch(float size, unsigned quads, std::vector<float>& vertices, std::vector<unsigned>& indices) {
+    unsigned Row = quads + 1;
+    float Cell = size / quads;
+    float Origin = -size * 0.5f;
+    vertices.resize(Row * Row * TerrainVertexElements);
+    for (unsigned Z = 0; Z < Row; ++Z) {
+        for (unsigned X = 0; X < Row; ++X) {
+            writeVertex(Origin + X * Cell, Origin + Z * Cell, Cell, &vertices[(Z * Row + X) * TerrainVertexElements]);
+        }
+    }
+
+    // NOTE: Same winding as the chunk index buffers
+    indices.clear();
+    indices.reserve(quads * quads * 6);
+    for (unsigned Z = 0; Z < quads; ++Z) {
+        for (unsigned X = 0; X < quads; ++X) {
+            unsigned V00 = Z * Row + X;
+            unsigned V10 = Z * Row + X + 1;
+            unsigned V01 = (Z + 1) * Row + X;
+            unsigned V11 = (Z + 1) * Row + X + 1;
+            unsigned Quad[] = { V00, V01, V10, V10, V01, V11 };
+            indices.insert(indices.end(), Quad, Quad + 6);
+        }
+    }
+}
+
+void
+Terrain::Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection, OcclusionCuller* occlusion) {
+    int CameraX = (int)std::floor(cameraPosition.x / mChunkSize);
+    int CameraZ = (int)std::floor(cameraPosition.z / mChunkSize);
+
+    // NOTE: Evict far chunks, pending ones are dropped once their data arrives
+    int EvictRadius = mViewRadius + 2;
+    for (auto It = mChunks.begin(); It != mChunks.end();) {
+        int DX = It->second.X - CameraX;
+        int DZ = It->second.Z - CameraZ;
+        if (DX * DX + DZ * DZ > EvictRadius * EvictRadius) {
+            if (It->second.State == CHUNK_READY) {
+                GpuMemory::DeleteBuffer(It->second.VBO);
+                GpuMemory::DeleteVertexArray(It->second.VAO);
+            }
+            It = mChunks.erase(It);
+        } else {
+            ++It;
+        }
+    }
+
+    FrameVector<std::pair<int, int> > Missing(FrameMemory::GetFrame());
+    for (int DZ = -mViewRadius; DZ <= mViewRadius; ++DZ) {
+        for (int DX = -mViewRadius; DX <= mViewRadius; ++DX) {
+            if (DX * DX + DZ * DZ > mViewRadius * mViewRadius) {
+                continue;
+            }
+            int X = CameraX + DX;
+            int Z = CameraZ + DZ;
+            if (mChunks.find(chunkKey(X, Z)) == mChunks.end()) {
+                Missing.push_back(std::make_pair(X, Z));
+            }
+        }
+    }
+
+    if (!Missing.empty()) {
+        std::sort(Missing.begin(), Missing.end(), [CameraX, CameraZ](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+            int DA = (a.first - CameraX) * (a.first - CameraX) + (a.second - CameraZ) * (a.second - CameraZ);
+            int DB = (b.first - CameraX) * (b.first - CameraX) + (b.second - CameraZ) * (b.second - CameraZ);
+            return DA < DB;
+        });
+        for (unsigned Idx = 0; Idx < Missing.size(); ++Idx) {
+            Chunk& NewChunk = mChunks[chunkKey(Missing[Idx].first, Missing[Idx].second)];
+            NewChunk.X = Missing[Idx].first;
+            NewChunk.Z = Missing[Idx].second;
+            NewChunk.State = CHUNK_PENDING;
+            NewChunk.VAO = 0;
+            NewChunk.VBO = 0;
+        }
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            mRequests.insert(mRequests.end(), Missing.begin(), Missing.end());
+        }
+        mCondition.notify_one();
+    }
+
+    FrameVector<GeneratedChunk> Completed(FrameMemory::GetFrame());
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        unsigned Count = std::min((unsigned)mCompleted.size(), MaxUploadsPerFrame);
+        Completed.reserve(Count);
+        for (unsigned Idx = 0; Idx < Count; ++Idx) {
+            Completed.push_back(std::move(mCompleted[Idx]));
+        }
+        mCompleted.erase(mCompleted.begin(), mCompleted.begin() + Count);
+    }
+    for (unsigned Idx = 0; Idx < Completed.size(); ++Idx) {
+        upload(Completed[Idx]);
+    }
+
+    Frustum ViewFrustum(viewProjection);
+    mVisible.clear();
+    for (auto& Entry : mChunks) {
+        const Chunk& Current = Entry.second;
+        if (Current.State != CHUNK_READY || !ViewFrustum.IntersectsBox(Current.BoundsMin, Current.BoundsMax)) {
+            continue;
+        }
+        if (occlusion && !occlusion->IsVisible(Current.BoundsMin, Current.BoundsMax)) {
+            continue;
+        }
+
+        glm::vec3 Closest = glm::clamp(cameraPosition, Current.BoundsMin, Current.BoundsMax);
+        VisibleChunk Visible;
+        Visible.Source = &Current;
+        Visible.Distance = glm::length(cameraPosition - Closest);
+        float Ratio = Visible.Distance / mChunkSize;
+        Visible.Lod = Ratio < 1.0f ? 0 : std::min((unsigned)std::log2(Ratio) + 1, mLodCount - 1);
+        mVisible.push_back(Visible);
+    }
+
+    // NOTE: Coarsen the furthest chunks first until the frame fits the budget
+    std::sort(mVisible.begin(), mVisible.end(), [](const VisibleChunk& a, const VisibleChunk& b) {
+        return a.Distance > b.Distance;
+    });
+    mTriangleCount = 0;
+    for (unsigned Idx = 0; Idx < mVisible.size(); ++Idx) {
+        mTriangleCount += mLodIndexCount[mVisible[Idx].Lod] / 3;
+    }
+    bool Coarsened = true;
+    while (mTriangleCount > mTriangleBudget && Coarsened) {
+        Coarsened = false;
+        for (unsigned Idx = 0; Idx < mVisible.size() && mTriangleCount > mTriangleBudget; ++Idx) {
+            VisibleChunk& Visible = mVisible[Idx];
+            if (Visible.Lod + 1 < mLodCount) {
+                mTriangleCount -= (mLodIndexCount[Visible.Lod] - mLodIndexCount[Visible.Lod + 1]) / 3;
+                ++Visible.Lod;
+                Coarsened = true;
+            }
+        }
+    }
+}
+
+void
+Terrain::Record(CommandBuffer& commands) const {
+    for (unsigned Idx = 0; Idx < mVisible.size(); ++Idx) {
+        const VisibleChunk& Visible = mVisible[Idx];
+        commands.BindVertexArray(Visible.Source->VAO);
+        commands.DrawIndexed(mLodIndexCount[Visible.Lod], mLodIndexOffset[Visible.Lod] * sizeof(unsigned));
+    }
+}
+
+long long
+Terrain::chunkKey(int x, int z) {
+    return ((long long)x << 32) ^ (long long)(unsigned)z;
+}
+
+void
+Terrain::buildIndices() {
+    unsigned Row = mChunkQuads + 1;
+    unsigned SkirtBase = Row * Row;
+    std::vector<unsigned> Indices;
+
+    for (unsigned Lod = 0; Lod < mLodCount; ++Lod) {
+        unsigned Step = 1u << Lod;
+        mLodIndexOffset.push_back((unsigned)Indices.size());
+
+        for (unsigned Z = 0; Z < mChunkQuads; Z += Step) {
+            for (unsigned X = 0; X < mChunkQuads; X += Step) {
+                unsigned V00 = Z * Row + X;
+                unsigned V10 = Z * Row + X + Step;
+                unsigned V01 = (Z + Step) * Row + X;
+                unsigned V11 = (Z + Step) * Row + X + Step;
+                unsigned Quad[] = { V00, V01, V10, V10, V01, V11 };
+                Indices.insert(Indices.end(), Quad, Quad + 6);
+            }
+        }
+
+        // NOTE: Skirts hang below every border so differing levels of
+        // neighbouring chunks never leave visible cracks
+        for (unsigned Edge = 0; Edge < 4; ++Edge) {
+            for (unsigned Idx = 0; Idx < mChunkQuads; Idx += Step) {
+                unsigned G0, G1;
+                switch (Edge) {
+                case 0: G0 = Idx; G1 = Idx + Step; break;
+                case 1: G0 = mChunkQuads * Row + Idx; G1 = mChunkQuads * Row + Idx + Step; break;
+                case 2: G0 = Idx * Row; G1 = (Idx + Step) * Row; break;
+                default: G0 = Idx * Row + mChunkQuads; G1 = (Idx + Step) * Row + mChunkQuads; break;
+                }
+                unsigned K0 = SkirtBase + Edge * Row + Idx;
+                unsigned K1 = SkirtBase + Edge * Row + Idx + Step;
+
+                if (Edge == 0 || Edge == 3) {
+                    unsigned Quad[] = { G0, G1, K0, G1, K1, K0 };
+                    Indices.insert(Indices.end(), Quad, Quad + 6);
+                } else {
+                    unsigned Quad[] = { G1, G0, K0, G1, K0, K1 };
+                    Indices.insert(Indices.end(), Quad, Quad + 6);
+                }
+            }
+        }
+
+        mLodIndexCount.push_back((unsigned)Indices.size() - mLodIndexOffset.back());
+    }
+
+    mEBO = GpuMemory::CreateBuffer(GPU_INDEX_BUFFER, "Terrain");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    GpuMemory::BufferData(mEBO, GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned), Indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void
+Terrain::generate(int chunkX, int chunkZ, GeneratedChunk& out) const {
+    unsigned Row = mChunkQuads + 1;
+    float Cell = mChunkSize / mChunkQuads;
+    float SkirtDepth = mChunkSize * 0.25f;
+    float OriginX = chunkX * mChunkSize;
+    float OriginZ = chunkZ * mChunkSize;
+
+    out.X = chunkX;
+    out.Z = chunkZ;
+    out.MinHeight = 1e30f;
+    out.MaxHeight = -1e30f;
+    out.Vertices.resize((Row * Row + 4 * Row) * TerrainVertexElements);
+
+    for (unsigned Z = 0; Z < Row; ++Z) {
+        for (unsigned X = 0; X < Row; ++X) {
+            float WorldX = OriginX + X * Cell;
+            float WorldZ = OriginZ + Z * Cell;
+            float* Vertex = &out.Vertices[(Z * Row + X) * TerrainVertexElements];
+            writeVertex(WorldX, WorldZ, Cell, Vertex);
+            float Height = Vertex[1];
+
+            out.MinHeight = std::min(out.MinHeight, Height);
+            out.MaxHeight = std::max(out.MaxHeight, Height);
+        }
+    }
+
+    for (unsigned Edge = 0; Edge < 4; ++Edge) {
+        for (unsigned Idx = 0; Idx < Row; ++Idx) {
+            unsigned Source;
+            switch (Edge) {
+            case 0: Source = Idx; break;
+            case 1: Source = mChunkQuads * Row + Idx; break;
+            case 2: Source = Idx * Row; break;
+            default: Source = Idx * Row + mChunkQuads; break;
+            }
+            float* Vertex = &out.Vertices[(Row * Row + Edge * Row + Idx) * TerrainVertexElements];
+            std::copy_n(&out.Vertices[Source * TerrainVertexElements], TerrainVertexElements, Vertex);
+            Vertex[1] -= SkirtDepth;
+        }
+    }
+    out.MinHeight -= SkirtDepth;
+}
+
+void
+Terrain::upload(const GeneratedChunk& generated) {
+    auto It = mChunks.find(chunkKey(generated.X, generated.Z));
+    if (It == mChunks.end() || It->second.State != CHUNK_PENDING) {
+        return;
+    }
+
+    Chunk& Target = It->second;
+    Target.BoundsMin = glm::vec3(generated.X * mChunkSize, generated.MinHeight, generated.Z * mChunkSize);
+    Target.BoundsMax = glm::vec3((generated.X + 1) * mChunkSize, generated.MaxHeight, (generated.Z + 1) * mChunkSize);
+
+    unsigned Stride = TerrainVertexElements * sizeof(float);
+    Target.VAO = GpuMemory::CreateVertexArray("Terrain chunk");
+    glBindVertexArray(Target.VAO);
+    Target.VBO = GpuMemory::CreateBuffer(GPU_VERTEX_BUFFER, "Terrain chunk");
+    glBindBuffer(GL_ARRAY_BUFFER, Target.VBO);
+    GpuMemory::BufferData(Target.VBO, GL_ARRAY_BUFFER, generated.Vertices.size() * sizeof(float), generated.Vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Stride, (void*)(5 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    Target.State = CHUNK_READY;
+}
+
+void
+Terrain::workerLoop() {
+    Trace::SetThreadName("Terrain");
+    for (;;) {
+        std::pair<int, int> Request;
+        {
+            std::unique_lock<std::mutex> Lock(mMutex);
+            mCondition.wait(Lock, [this]() { return mStopping || !mRequests.empty(); });
+            if (mStopping) {
+                return;
+            }
+            Request = mRequests.front();
+            mRequests.pop_front();
+        }
+
+        TRACE_ZONE("Generate chunk");
+        GeneratedChunk Generated;
+        generate(Request.first, Request.second, Generated);
+
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mCompleted.push_back(std::move(Generated));
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * @file terrain.hpp
+ * @brief Chunked heightfield desert. Chunks are generated on a background
+ * thread, drawn with geomipmapped levels of detail chosen by camera distance
+ * and kept under a triangle budget. Skirts along chunk borders hide cracks
+ * between neighbouring levels
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "commandbuffer.hpp"
+#include "frustum.hpp"
+#include "occlusion.hpp"
+
+class Terrain {
+public:
+    /**
+     * @brief Ctor - builds shared index buffers and starts the generator thread
+     *
+     * @param chunkSize - World size of a chunk edge
+     * @param chunkQuads - Quads per chunk edge at the finest level, power of two
+     * @param viewRadius - Radius in chunks around the camera kept resident
+     * @param triangleBudget - Upper bound of triangles drawn per frame
+     */
+    Terrain(float chunkSize = 32.0f, unsigned chunkQuads = 64, int viewRadius = 16, unsigned triangleBudget = 400000);
+    ~Terrain();
+
+    /**
+     * @brief Height of the terrain surface. Thread safe
+     *
+     * @param x - World X
+     * @param z - World Z
+     */
+    static float GetHeight(float x, float z);
+
+    /**
+     * @brief Builds one patch centred on the origin at the finest level, in
+     * the vertex layout of the chunks. For renderers that don't stream chunks
+     *
+     * @param size - World size of the patch edge
+     * @param quads - Quads per patch edge
+     * @param vertices - Receives the vertices
+     * @param indices - Receives the triangle list
+     */
+    static void BuildPatch(float size, unsigned quads, std::vector<float>& vertices, std::vector<unsigned>& indices);
+
+    /**
+     * @brief Streams chunks around the camera, uploads generated ones, culls
+     * and chooses levels of detail for the coming Record call
+     *
+     * @param cameraPosition - Camera world position
+     * @param viewProjection - Projection * View used for culling
+     * @param occlusion - Optional occlusion culler, chunks hidden behind
+     * previously drawn geometry are skipped
+     */
+    void Update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection, OcclusionCuller* occlusion = 0);
+
+    /**
+     * @brief Records chunks selected by the last Update. Expects the scene
+     * pipeline to be bound with an identity model matrix
+     *
+     * @param commands - Receives the commands
+     */
+    void Record(CommandBuffer& commands) const;
+
+    unsigned GetVisibleChunkCount() const { return (unsigned)mVisible.size(); }
+    unsigned GetTriangleCount() const { return mTriangleCount; }
+
+private:
+    enum EChunkState {
+        CHUNK_PENDING = 0,
+        CHUNK_READY = 1,
+    };
+
+    struct Chunk {
+        int X;
+        int Z;
+        EChunkState State;
+        glm::vec3 BoundsMin;
+        glm::vec3 BoundsMax;
+        unsigned VAO;
+        unsigned VBO;
+    };
+
+    struct GeneratedChunk {
+        int X;
+        int Z;
+        float MinHeight;
+        float MaxHeight;
+        std::vector<float> Vertices;
+    };
+
+    struct VisibleChunk {
+        const Chunk* Source;
+        float Distance;
+        unsigned Lod;
+    };
+
+    float mChunkSize;
+    unsigned mChunkQuads;
+    int mViewRadius;
+    unsigned mTriangleBudget;
+    unsigned mLodCount;
+    unsigned mTriangleCount;
+
+    unsigned mEBO;
+    std::vector<unsigned> mLodIndexOffset;
+    std::vector<unsigned> mLodIndexCount;
+
+    std::unordered_map<long long, Chunk> mChunks;
+    std::vector<VisibleChunk> mVisible;
+
+    // NOTE: Generator thread state
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::pair<int, int> > mRequests;
+    std::vector<GeneratedChunk> mCompleted;
+    bool mStopping;
+
+    static long long chunkKey(int x, int z);
+    void buildIndices();
+    void generate(int chunkX, int chunkZ, GeneratedChunk& out) const;
+    void upload(const GeneratedChunk& generated);
+    void workerLoop();
+};
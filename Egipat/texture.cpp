@@ -20,10 +20,12 @@ Texture::Texture(const std::string& path)
 	    default: InternalFormat = GL_RGB; break;
     }
 
-	glGenTextures(1, &mRendererID);
+	mRendererID = GpuMemory::CreateTexture(path);
 	glBindTexture(GL_TEXTURE_2D, mRendererID);
 	glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, mWidth, mHeight, 0, InternalFormat, GL_UNSIGNED_BYTE, mLocalBuffer);
 	glGenerateMipmap(GL_TEXTURE_2D);
+	// NOTE: RGB is padded to 4 bytes per texel by most drivers
+	GpuMemory::SetTextureBytes(mRendererID, GpuMemory::MipChainBytes(mWidth, mHeight, mBPP == 1 ? 1 : 4));
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -37,7 +39,7 @@ Texture::Texture(const std::string& path)
 }
 
 Texture::~Texture() {
-	//glDeleteTextures(1, &mRendererID);
+	GpuMemory::DeleteTexture(mRendererID);
 }
 
 void Texture::Bind(unsigned int slot) const {
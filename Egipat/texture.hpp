@@ -2,6 +2,7 @@
 #include <string>
 #include <GL/glew.h>
 #include "stb_image.h"
+#include "gpumemory.hpp"
 
 class Texture {
 private:
@@ -12,9 +13,20 @@ private:
 public:
 	Texture(const std::string& path);
 	~Texture();
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
 
 	void Bind(unsigned int slot = 0) const;
 	void Unbind() const;
 
 	unsigned GetRendererID() const { return mRendererID; }
+	int GetChannels() const { return mBPP; }
+
+	/**
+	 * @brief Hands the GL texture over to the caller, who deletes it with
+	 * GpuMemory::DeleteTexture
+	 *
+	 * @returns Texture name
+	 */
+	unsigned Release() { unsigned Id = mRendererID; mRendererID = 0; return Id; }
 };
\ No newline at end of file
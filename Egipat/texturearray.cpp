@@ -0,0 +1,113 @@
+#include "texturearray.hpp"
+#include "stb_image.h"
+#include "gpumemory.hpp"
+
+#include <iostream>
+
+TextureArrays::TextureArrays()
+    : mMaxLayers(256) {
+    GLint MaxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &MaxLayers);
+    if (MaxLayers > 0) {
+        mMaxLayers = (unsigned)MaxLayers;
+    }
+}
+
+TextureArrays::~TextureArrays() {
+    for (unsigned PoolIdx = 0; PoolIdx < mPools.size(); ++PoolIdx) {
+        GpuMemory::DeleteTexture(mPools[PoolIdx].Id);
+    }
+}
+
+TextureSlice
+TextureArrays::Add(const std::string& path, int* channels) {
+    std::map<std::string, TextureSlice>::iterator Found = mByPath.find(path);
+    if (Found != mByPath.end()) {
+        if (channels) {
+            *channels = mPools[Found->second.Pool].Channels;
+        }
+        return Found->second;
+    }
+
+    TextureSlice Slice = { TEXTURE_SLICE_NONE, 0 };
+    int Width = 0, Height = 0, Components = 0;
+    stbi_set_flip_vertically_on_load(1);
+    unsigned char* Data = stbi_load(path.c_str(), &Width, &Height, &Components, 0);
+    if (!Data) {
+        std::cerr << "[Err] Failed to load texture: " << path << std::endl;
+        return Slice;
+    }
+    // NOTE: Grey + alpha goes through RGBA like TextureStreamer
+    int Channels = Components == 2 ? 4 : Components;
+    if (Channels != Components) {
+        stbi_image_free(Data);
+        Data = stbi_load(path.c_str(), &Width, &Height, &Components, Channels);
+        if (!Data) {
+            std::cerr << "[Err] Failed to load texture: " << path << std::endl;
+            return Slice;
+        }
+    }
+
+    for (unsigned PoolIdx = 0; PoolIdx < mPools.size(); ++PoolIdx) {
+        const Pool& Current = mPools[PoolIdx];
+        if (!Current.Id && Current.Width == Width && Current.Height == Height
+            && Current.Channels == Channels && Current.Layers.size() < mMaxLayers) {
+            Slice.Pool = PoolIdx;
+            break;
+        }
+    }
+    if (Slice.Pool == TEXTURE_SLICE_NONE) {
+        Pool NewPool = { Width, Height, Channels, 0, std::vector<std::vector<unsigned char> >() };
+        Slice.Pool = (unsigned)mPools.size();
+        mPools.push_back(NewPool);
+    }
+
+    Pool& Target = mPools[Slice.Pool];
+    Slice.Layer = (unsigned)Target.Layers.size();
+    Target.Layers.push_back(std::vector<unsigned char>(Data, Data + (size_t)Width * Height * Channels));
+    stbi_image_free(Data);
+
+    mByPath[path] = Slice;
+    if (channels) {
+        *channels = Channels;
+    }
+    return Slice;
+}
+
+void
+TextureArrays::Build() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned PoolIdx = 0; PoolIdx < mPools.size(); ++PoolIdx) {
+        Pool& Current = mPools[PoolIdx];
+        if (Current.Id || Current.Layers.empty()) {
+            continue;
+        }
+
+        GLint Format = GL_RGB;
+        switch (Current.Channels) {
+        case 1: Format = GL_RED; break;
+        case 4: Format = GL_RGBA; break;
+        default: Format = GL_RGB; break;
+        }
+
+        Current.Id = GpuMemory::CreateTexture("TextureArrays");
+        glBindTexture(GL_TEXTURE_2D_ARRAY, Current.Id);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, Format, Current.Width, Current.Height, (GLsizei)Current.Layers.size(), 0, Format, GL_UNSIGNED_BYTE, 0);
+        for (unsigned LayerIdx = 0; LayerIdx < Current.Layers.size(); ++LayerIdx) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, LayerIdx, Current.Width, Current.Height, 1, Format, GL_UNSIGNED_BYTE, Current.Layers[LayerIdx].data());
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        GpuMemory::SetTextureBytes(Current.Id, GpuMemory::MipChainBytes(Current.Width, Current.Height, Current.Channels == 1 ? 1 : 4) * Current.Layers.size());
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        std::cout << "Built " << Current.Width << "x" << Current.Height << " texture array with "
+                  << Current.Layers.size() << " layers" << std::endl;
+        std::vector<std::vector<unsigned char> >().swap(Current.Layers);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file texturearray.hpp
+ * @brief Material texture pools. Textures of the same size and format share
+ * one GL_TEXTURE_2D_ARRAY, so meshes with different materials can be drawn
+ * with a single bind and merged into one multi-draw
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define TEXTURE_SLICE_NONE 0xFFFFFFFF
+
+/**
+ * @brief Location of one texture inside the pools
+ *
+ */
+struct TextureSlice {
+    unsigned Pool;
+    unsigned Layer;
+};
+
+class TextureArrays {
+public:
+    TextureArrays();
+    ~TextureArrays();
+
+    /**
+     * @brief Decodes a texture and assigns it a layer in a matching pool. The
+     * same path added twice returns the same slice
+     *
+     * @param path - Image path
+     * @param channels - Receives the image channel count, optional
+     *
+     * @returns Slice, Pool is TEXTURE_SLICE_NONE on failure
+     */
+    TextureSlice Add(const std::string& path, int* channels = 0);
+
+    /**
+     * @brief Uploads every pool that isn't built yet and frees the decoded
+     * images. Call once all models are loaded
+     *
+     */
+    void Build();
+
+    /**
+     * @brief Gets the array texture of a pool, 0 before Build
+     *
+     */
+    unsigned GetArray(unsigned pool) const { return pool < mPools.size() ? mPools[pool].Id : 0; }
+    unsigned GetPoolCount() const { return (unsigned)mPools.size(); }
+
+private:
+    struct Pool {
+        int Width;
+        int Height;
+        int Channels;
+        unsigned Id;
+        std::vector<std::vector<unsigned char> > Layers;
+    };
+
+    std::vector<Pool> mPools;
+    std::map<std::string, TextureSlice> mByPath;
+    unsigned mMaxLayers;
+};
@@ -0,0 +1,308 @@
+#include "texturestreamer.hpp"
+#include "stb_image.h"
+#include "gpumemory.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static GLint
+streamFormat(int channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 4: return GL_RGBA;
+    default: return GL_RGB;
+    }
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes)
+    : mBudget(budgetBytes),
+      mResidentBytes(0),
+      mFrame(0),
+      mInFlight(0) {
+}
+
+TextureStreamer::~TextureStreamer() {
+    Jobs::Wait(mDecodes);
+
+    for (unsigned TextureIdx = 0; TextureIdx < mTextures.size(); ++TextureIdx) {
+        GpuMemory::DeleteTexture(mTextures[TextureIdx].Id);
+    }
+}
+
+unsigned
+TextureStreamer::Load(const std::string& path, int* channels) {
+    std::map<std::string, unsigned>::iterator Found = mByPath.find(path);
+    if (Found != mByPath.end()) {
+        if (channels) {
+            *channels = mTextures[Found->second].Channels;
+        }
+        return mTextures[Found->second].Id;
+    }
+
+    StreamedTexture Texture;
+    int Components = 0;
+    if (!stbi_info(path.c_str(), &Texture.Width, &Texture.Height, &Components)) {
+        std::cerr << "[Err] Failed to load texture: " << path << std::endl;
+        return 0;
+    }
+
+    // NOTE: Grey + alpha is expanded so alpha survives the upload
+    Texture.Path = path;
+    Texture.Channels = Components == 2 ? 4 : Components;
+    Texture.LevelCount = 1;
+    while (std::max(Texture.Width, Texture.Height) >> Texture.LevelCount) {
+        ++Texture.LevelCount;
+    }
+    Texture.TailLevel = 0;
+    while (Texture.TailLevel + 1 < Texture.LevelCount
+           && std::max(levelSize(Texture.Width, Texture.TailLevel), levelSize(Texture.Height, Texture.TailLevel)) > STREAM_RESIDENT_SIZE) {
+        ++Texture.TailLevel;
+    }
+    Texture.BaseLevel = Texture.TailLevel;
+    Texture.RequestedLevel = Texture.LevelCount;
+    Texture.LastUsed = mFrame;
+    Texture.InFlight = false;
+
+    StreamJob Tail = { 0, path, Texture.Channels, Texture.TailLevel, Texture.LevelCount - 1 };
+    StreamResult Levels;
+    if (!decode(Tail, Levels)) {
+        std::cerr << "[Err] Failed to load texture: " << path << std::endl;
+        return 0;
+    }
+
+    Texture.Id = GpuMemory::CreateTexture(path);
+    glBindTexture(GL_TEXTURE_2D, Texture.Id);
+    for (unsigned Level = Texture.TailLevel; Level < Texture.LevelCount; ++Level) {
+        uploadLevel(Texture, Level, Levels.Levels[Level - Texture.TailLevel].data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Texture.BaseLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Texture.LevelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    mResidentBytes += levelBytes(Texture, Texture.TailLevel, Texture.LevelCount - 1);
+    GpuMemory::SetTextureBytes(Texture.Id, levelBytes(Texture, Texture.BaseLevel, Texture.LevelCount - 1));
+    mByPath[path] = (unsigned)mTextures.size();
+    mById[Texture.Id] = (unsigned)mTextures.size();
+    mTextures.push_back(Texture);
+
+    if (channels) {
+        *channels = Texture.Channels;
+    }
+    std::cout << "Loaded " << path << " from mip " << Texture.TailLevel << std::endl;
+    return Texture.Id;
+}
+
+void
+TextureStreamer::Request(unsigned texture, float screenPixels) {
+    std::map<unsigned, unsigned>::iterator Found = mById.find(texture);
+    if (Found == mById.end()) {
+        return;
+    }
+
+    // NOTE: Roughly one texel per pixel when the texture spans the surface once
+    StreamedTexture& Texture = mTextures[Found->second];
+    float Ratio = std::max(Texture.Width, Texture.Height) / std::max(screenPixels, 1.0f);
+    unsigned Level = Ratio <= 1.0f ? 0 : (unsigned)std::floor(std::log2(Ratio));
+    Level = std::min(Level, Texture.LevelCount - 1);
+
+    Texture.RequestedLevel = std::min(Texture.RequestedLevel, Level);
+    Texture.LastUsed = mFrame;
+}
+
+void
+TextureStreamer::Update() {
+    std::vector<StreamResult> Results;
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        Results.swap(mResults);
+    }
+
+    for (unsigned ResultIdx = 0; ResultIdx < Results.size(); ++ResultIdx) {
+        const StreamResult& Result = Results[ResultIdx];
+        StreamedTexture& Texture = mTextures[Result.Index];
+        Texture.InFlight = false;
+        --mInFlight;
+
+        unsigned LastLevel = Result.FirstLevel + (unsigned)Result.Levels.size() - 1;
+        if (Result.Levels.empty() || LastLevel + 1 != Texture.BaseLevel) {
+            continue;
+        }
+        size_t Bytes = levelBytes(Texture, Result.FirstLevel, LastLevel);
+        if (!evict(Bytes, Result.Index)) {
+            continue;
+        }
+
+        // NOTE: Levels go in coarse to fine, the base only moves once the
+        // whole range is defined so the texture stays complete
+        glBindTexture(GL_TEXTURE_2D, Texture.Id);
+        for (unsigned Level = LastLevel + 1; Level-- > Result.FirstLevel;) {
+            uploadLevel(Texture, Level, Result.Levels[Level - Result.FirstLevel].data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Result.FirstLevel);
+        Texture.BaseLevel = Result.FirstLevel;
+        mResidentBytes += Bytes;
+        GpuMemory::SetTextureBytes(Texture.Id, levelBytes(Texture, Texture.BaseLevel, Texture.LevelCount - 1));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // NOTE: The budget may have been lowered
+    evict(0, ~0u);
+
+    while (mInFlight < STREAM_MAX_IN_FLIGHT) {
+        // NOTE: Largest shortfall first
+        unsigned Best = ~0u;
+        unsigned BestGap = 0;
+        for (unsigned TextureIdx = 0; TextureIdx < mTextures.size(); ++TextureIdx) {
+            const StreamedTexture& Texture = mTextures[TextureIdx];
+            if (Texture.InFlight || Texture.RequestedLevel >= Texture.BaseLevel) {
+                continue;
+            }
+            if (Texture.BaseLevel - Texture.RequestedLevel > BestGap) {
+                BestGap = Texture.BaseLevel - Texture.RequestedLevel;
+                Best = TextureIdx;
+            }
+        }
+        if (Best == ~0u) {
+            break;
+        }
+
+        StreamedTexture& Texture = mTextures[Best];
+        unsigned FirstLevel = Texture.RequestedLevel;
+        Texture.RequestedLevel = Texture.LevelCount;
+        while (FirstLevel < Texture.BaseLevel && !evict(levelBytes(Texture, FirstLevel, Texture.BaseLevel - 1), Best)) {
+            ++FirstLevel;
+        }
+        if (FirstLevel == Texture.BaseLevel) {
+            continue;
+        }
+
+        StreamJob Job = { Best, Texture.Path, Texture.Channels, FirstLevel, Texture.BaseLevel - 1 };
+        Jobs::Run([this, Job]() { runJob(Job); }, &mDecodes);
+        Texture.InFlight = true;
+        ++mInFlight;
+    }
+
+    for (unsigned TextureIdx = 0; TextureIdx < mTextures.size(); ++TextureIdx) {
+        mTextures[TextureIdx].RequestedLevel = mTextures[TextureIdx].LevelCount;
+    }
+    ++mFrame;
+}
+
+void
+TextureStreamer::runJob(const StreamJob& job) {
+    TRACE_ZONE("Decode texture");
+    StreamResult Result;
+    Result.Index = job.Index;
+    Result.FirstLevel = job.FirstLevel;
+    if (!decode(job, Result)) {
+        std::cerr << "[Err] Failed to stream texture: " << job.Path << std::endl;
+        Result.Levels.clear();
+    }
+
+    std::lock_guard<std::mutex> Lock(mMutex);
+    mResults.push_back(std::move(Result));
+}
+
+bool
+TextureStreamer::decode(const StreamJob& job, StreamResult& result) {
+    // NOTE: Same orientation as Texture. Runs on jobs, so only this thread's
+    // flag is set, the global one belongs to the main thread loads
+    stbi_set_flip_vertically_on_load_thread(1);
+    int Width = 0, Height = 0, Components = 0;
+    unsigned char* Data = stbi_load(job.Path.c_str(), &Width, &Height, &Components, job.Channels);
+    if (!Data) {
+        return false;
+    }
+
+    std::vector<unsigned char> Current(Data, Data + (size_t)Width * Height * job.Channels);
+    stbi_image_free(Data);
+
+    std::vector<unsigned char> Next;
+    for (unsigned Level = 0; Level <= job.LastLevel; ++Level) {
+        if (Level >= job.FirstLevel) {
+            result.Levels.push_back(Current);
+        }
+        if (Level < job.LastLevel) {
+            downsample(Current, levelSize(Width, Level), levelSize(Height, Level), job.Channels, Next);
+            Current.swap(Next);
+        }
+    }
+    return true;
+}
+
+void
+TextureStreamer::downsample(const std::vector<unsigned char>& src, int width, int height, int channels, std::vector<unsigned char>& dst) {
+    int Width = std::max(width / 2, 1);
+    int Height = std::max(height / 2, 1);
+    dst.resize((size_t)Width * Height * channels);
+
+    for (int Y = 0; Y < Height; ++Y) {
+        const unsigned char* Row0 = &src[(size_t)std::min(Y * 2, height - 1) * width * channels];
+        const unsigned char* Row1 = &src[(size_t)std::min(Y * 2 + 1, height - 1) * width * channels];
+        for (int X = 0; X < Width; ++X) {
+            int X0 = std::min(X * 2, width - 1) * channels;
+            int X1 = std::min(X * 2 + 1, width - 1) * channels;
+            unsigned char* Out = &dst[((size_t)Y * Width + X) * channels];
+            for (int Channel = 0; Channel < channels; ++Channel) {
+                Out[Channel] = (unsigned char)((Row0[X0 + Channel] + Row0[X1 + Channel] + Row1[X0 + Channel] + Row1[X1 + Channel] + 2) / 4);
+            }
+        }
+    }
+}
+
+bool
+TextureStreamer::evict(size_t extraBytes, unsigned exclude) {
+    while (mResidentBytes + extraBytes > mBudget) {
+        unsigned Victim = ~0u;
+        for (unsigned TextureIdx = 0; TextureIdx < mTextures.size(); ++TextureIdx) {
+            const StreamedTexture& Texture = mTextures[TextureIdx];
+            if (TextureIdx == exclude || Texture.InFlight || Texture.LastUsed == mFrame || Texture.BaseLevel >= Texture.TailLevel) {
+                continue;
+            }
+            if (Victim == ~0u || Texture.LastUsed < mTextures[Victim].LastUsed) {
+                Victim = TextureIdx;
+            }
+        }
+        if (Victim == ~0u) {
+            return false;
+        }
+
+        // NOTE: Move the base first, then a zero sized image frees the level
+        StreamedTexture& Texture = mTextures[Victim];
+        GLint Format = streamFormat(Texture.Channels);
+        glBindTexture(GL_TEXTURE_2D, Texture.Id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Texture.BaseLevel + 1);
+        glTexImage2D(GL_TEXTURE_2D, Texture.BaseLevel, Format, 0, 0, 0, Format, GL_UNSIGNED_BYTE, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        mResidentBytes -= levelBytes(Texture, Texture.BaseLevel, Texture.BaseLevel);
+        ++Texture.BaseLevel;
+        GpuMemory::SetTextureBytes(Texture.Id, levelBytes(Texture, Texture.BaseLevel, Texture.LevelCount - 1));
+    }
+    return true;
+}
+
+void
+TextureStreamer::uploadLevel(const StreamedTexture& texture, unsigned level, const unsigned char* data) const {
+    GLint Format = streamFormat(texture.Channels);
+    // NOTE: RGB rows of odd width aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, level, Format, levelSize(texture.Width, level), levelSize(texture.Height, level), 0, Format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+size_t
+TextureStreamer::levelBytes(const StreamedTexture& texture, unsigned first, unsigned last) const {
+    // NOTE: Drivers pad RGB to 4 bytes per texel
+    size_t TexelBytes = texture.Channels == 1 ? 1 : 4;
+    size_t Bytes = 0;
+    for (unsigned Level = first; Level <= last; ++Level) {
+        Bytes += (size_t)levelSize(texture.Width, Level) * levelSize(texture.Height, Level) * TexelBytes;
+    }
+    return Bytes;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file texturestreamer.hpp
+ * @brief Mip level streaming for model textures. Only the coarse tail of each
+ * mip chain is uploaded at load, finer levels are decoded on the job system
+ * once something on screen is big enough to need them and the least recently
+ * used levels are dropped whenever residency goes over the memory budget
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "jobsystem.hpp"
+
+// NOTE: Levels no larger than this are uploaded at load and never evicted
+#define STREAM_RESIDENT_SIZE 128
+#define STREAM_MAX_IN_FLIGHT 2
+#define STREAM_DEFAULT_BUDGET (128u * 1024u * 1024u)
+
+class TextureStreamer {
+public:
+    /**
+     * @brief Ctor
+     *
+     * @param budgetBytes - Memory budget for all streamed levels
+     */
+    TextureStreamer(size_t budgetBytes = STREAM_DEFAULT_BUDGET);
+    ~TextureStreamer();
+
+    /**
+     * @brief Loads a texture with only its coarse mip levels resident. The
+     * same path loaded twice returns the same texture
+     *
+     * @param path - Image path
+     * @param channels - Receives the image channel count, optional
+     *
+     * @returns GL texture name, 0 on failure
+     */
+    unsigned Load(const std::string& path, int* channels = 0);
+
+    /**
+     * @brief Reports that a texture is drawn this frame
+     *
+     * @param texture - GL texture name returned by Load
+     * @param screenPixels - Approximate on screen size of the surface the
+     * texture is stretched over, in pixels
+     */
+    void Request(unsigned texture, float screenPixels);
+
+    /**
+     * @brief Uploads finished levels, evicts over budget and queues decodes
+     * for this frame's requests. Call once per frame after all Requests
+     *
+     */
+    void Update();
+
+    void SetBudget(size_t budgetBytes) { mBudget = budgetBytes; }
+    size_t GetBudget() const { return mBudget; }
+    size_t GetResidentBytes() const { return mResidentBytes; }
+
+private:
+    struct StreamedTexture {
+        std::string Path;
+        unsigned Id;
+        int Width;
+        int Height;
+        int Channels;
+        unsigned LevelCount;
+        // NOTE: Finest resident level, GL_TEXTURE_BASE_LEVEL
+        unsigned BaseLevel;
+        // NOTE: Finest level of the always resident tail
+        unsigned TailLevel;
+        // NOTE: Finest level requested this frame, LevelCount if unused
+        unsigned RequestedLevel;
+        unsigned long long LastUsed;
+        bool InFlight;
+    };
+
+    struct StreamJob {
+        unsigned Index;
+        std::string Path;
+        int Channels;
+        unsigned FirstLevel;
+        unsigned LastLevel;
+    };
+
+    struct StreamResult {
+        unsigned Index;
+        unsigned FirstLevel;
+        std::vector<std::vector<unsigned char> > Levels;
+    };
+
+    std::vector<StreamedTexture> mTextures;
+    std::map<std::string, unsigned> mByPath;
+    std::map<unsigned, unsigned> mById;
+    size_t mBudget;
+    size_t mResidentBytes;
+    unsigned long long mFrame;
+    unsigned mInFlight;
+
+    std::vector<StreamResult> mResults;
+    std::mutex mMutex;
+    JobCounter mDecodes;
+
+    /**
+     * @brief Decodes a job and queues its result for the next Update. Runs on
+     * a job system worker
+     *
+     */
+    void runJob(const StreamJob& job);
+
+    /**
+     * @brief Decodes an image and builds the requested range of its mip chain
+     *
+     * @param job - Decode job
+     * @param result - Receives levels FirstLevel to LastLevel, finest first
+     *
+     * @returns true - Success, false - Failure
+     */
+    static bool decode(const StreamJob& job, StreamResult& result);
+
+    /**
+     * @brief Box filters an image to half its size, odd edges are clamped
+     *
+     */
+    static void downsample(const std::vector<unsigned char>& src, int width, int height, int channels, std::vector<unsigned char>& dst);
+
+    /**
+     * @brief Drops finest levels of least recently used textures until the
+     * extra bytes fit in the budget. Textures used this frame, in flight or
+     * excluded are never touched
+     *
+     * @param extraBytes - Bytes about to be uploaded
+     * @param exclude - Texture index to keep
+     *
+     * @returns true if the extra bytes fit
+     */
+    bool evict(size_t extraBytes, unsigned exclude);
+
+    void uploadLevel(const StreamedTexture& texture, unsigned level, const unsigned char* data) const;
+    size_t levelBytes(const StreamedTexture& texture, unsigned first, unsigned last) const;
+    static int levelSize(int size, unsigned level) { return (size >> level) > 0 ? size >> level : 1; }
+};
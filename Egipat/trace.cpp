@@ -0,0 +1,150 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+typedef std::chrono::steady_clock TraceClock;
+
+// NOTE: Zones still open when recording stops can land this many slots past
+// the head a dump read, those slots are skipped on a full ring
+#define TRACE_DUMP_MARGIN 1024
+
+struct TraceEvent {
+    const char* Name;
+    unsigned long long Start;
+    unsigned long long End;
+};
+
+/**
+ * @brief Single writer ring. The owning thread fills a slot and then
+ * publishes it by bumping Head, readers only look at published slots
+ *
+ */
+struct ThreadTrace {
+    std::vector<TraceEvent> Events;
+    std::atomic<unsigned long long> Head;
+    unsigned Id;
+    // NOTE: Guarded by BuffersLock
+    std::string Name;
+};
+
+static std::atomic<bool> Enabled(false);
+static std::atomic<unsigned long long> EnabledAt(0);
+static const TraceClock::time_point Epoch = TraceClock::now();
+// NOTE: Rings outlive their threads so a dump still sees finished threads
+static std::vector<std::unique_ptr<ThreadTrace> > Buffers;
+static std::mutex BuffersLock;
+static thread_local ThreadTrace* CurrentBuffer = 0;
+
+static unsigned long long
+now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(TraceClock::now() - Epoch).count();
+}
+
+static ThreadTrace&
+threadBuffer() {
+    if (!CurrentBuffer) {
+        std::unique_ptr<ThreadTrace> Buffer(new ThreadTrace());
+        Buffer->Events.resize(TRACE_EVENTS_PER_THREAD);
+        Buffer->Head = 0;
+        std::lock_guard<std::mutex> Lock(BuffersLock);
+        Buffer->Id = (unsigned)Buffers.size() + 1;
+        CurrentBuffer = Buffer.get();
+        Buffers.push_back(std::move(Buffer));
+    }
+    return *CurrentBuffer;
+}
+
+void
+Trace::SetEnabled(bool enabled) {
+    if (enabled && !Enabled) {
+        EnabledAt = now();
+    }
+    Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool
+Trace::IsEnabled() {
+    return Enabled.load(std::memory_order_relaxed);
+}
+
+void
+Trace::SetThreadName(const std::string& name) {
+    ThreadTrace& Buffer = threadBuffer();
+    std::lock_guard<std::mutex> Lock(BuffersLock);
+    Buffer.Name = name;
+}
+
+void
+TraceZone::begin(const char* name) {
+    mName = Enabled.load(std::memory_order_relaxed) ? name : 0;
+    if (mName) {
+        mStart = now();
+    }
+}
+
+void
+TraceZone::end() {
+    if (!mName) {
+        return;
+    }
+
+    ThreadTrace& Buffer = threadBuffer();
+    unsigned long long Head = Buffer.Head.load(std::memory_order_relaxed);
+    TraceEvent& Event = Buffer.Events[Head % TRACE_EVENTS_PER_THREAD];
+    Event.Name = mName;
+    Event.Start = mStart;
+    Event.End = now();
+    Buffer.Head.store(Head + 1, std::memory_order_release);
+    mName = 0;
+}
+
+bool
+Trace::Dump(const std::string& path) {
+    SetEnabled(false);
+
+    std::ofstream File(path.c_str(), std::ios::trunc);
+    if (!File) {
+        std::cerr << "[Err] Failed to open trace file " << path << std::endl;
+        return false;
+    }
+
+    unsigned long long From = EnabledAt;
+    unsigned EventCount = 0;
+    File << std::fixed << std::setprecision(3);
+    File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::lock_guard<std::mutex> Lock(BuffersLock);
+    for (unsigned BufferIdx = 0; BufferIdx < Buffers.size(); ++BufferIdx) {
+        const ThreadTrace& Buffer = *Buffers[BufferIdx];
+        std::string Name = Buffer.Name.empty() ? "Thread " + std::to_string(Buffer.Id) : Buffer.Name;
+        File << (BufferIdx ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Buffer.Id
+            << ",\"args\":{\"name\":\"" << Name << "\"}}";
+
+        unsigned long long Head = Buffer.Head.load(std::memory_order_acquire);
+        unsigned long long First = Head > TRACE_EVENTS_PER_THREAD ? Head - TRACE_EVENTS_PER_THREAD + TRACE_DUMP_MARGIN : 0;
+        for (unsigned long long EventIdx = First; EventIdx < Head; ++EventIdx) {
+            const TraceEvent& Event = Buffer.Events[EventIdx % TRACE_EVENTS_PER_THREAD];
+            if (Event.Start < From) {
+                continue;
+            }
+            // NOTE: Chrome trace timestamps are microseconds
+            File << ",\n{\"name\":\"" << Event.Name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << Buffer.Id
+                << ",\"ts\":" << Event.Start * 1e-3 << ",\"dur\":" << (Event.End - Event.Start) * 1e-3 << "}";
+            ++EventCount;
+        }
+    }
+    File << "\n]}\n";
+    if (!File) {
+        std::cerr << "[Err] Failed to write trace file " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote " << EventCount << " trace zones to " << path << std::endl;
+    return true;
+}
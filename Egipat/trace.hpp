@@ -0,0 +1,79 @@
+/**
+ * @file trace.hpp
+ * @brief Scoped CPU trace zones. Every thread writes finished zones into its
+ * own ring buffer without locks, a dump turns the rings into a Chrome trace
+ * that chrome://tracing and Perfetto open. While tracing is off a zone is a
+ * single relaxed load and a branch
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <string>
+
+// NOTE: Per thread, the oldest zones are overwritten once a ring is full
+#define TRACE_EVENTS_PER_THREAD 65536
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/**
+ * @brief Traces the rest of the enclosing scope. The name must be a string
+ * literal or otherwise outlive the dump
+ *
+ */
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(TraceZone, __LINE__)(name)
+
+namespace Trace {
+    /**
+     * @brief Starts or stops recording. Starting drops the zones of earlier
+     * recordings from the next dump
+     *
+     */
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+
+    /**
+     * @brief Names the calling thread in dumps. Call once when it starts
+     *
+     * @param name - Thread name, copied
+     */
+    void SetThreadName(const std::string& name);
+
+    /**
+     * @brief Stops recording and writes every thread's zones as Chrome trace
+     * JSON
+     *
+     * @param path - Output file
+     *
+     * @returns true - Success, false - Failure
+     */
+    bool Dump(const std::string& path);
+}
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name) { begin(name); }
+    ~TraceZone() { end(); }
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+    /**
+     * @brief Ends the zone and starts another one right after it, so
+     * consecutive phases of a function don't need their own scopes
+     *
+     * @param name - Name of the next zone
+     */
+    void Next(const char* name) { end(); begin(name); }
+
+private:
+    // NOTE: 0 while tracing was off when the zone began
+    const char* mName;
+    unsigned long long mStart;
+
+    void begin(const char* name);
+    void end();
+};
@@ -0,0 +1,262 @@
+#include "transform.hpp"
+#include "simd.hpp"
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+TransformHierarchy::TransformHierarchy()
+    : mNeedsSort(false),
+      mUpdatedCount(0) {
+}
+
+unsigned
+TransformHierarchy::Add(unsigned parent) {
+    unsigned Handle = (unsigned)mSlotOf.size();
+    unsigned Slot = (unsigned)mParent.size();
+    unsigned ParentSlot = parent == INVALID_NODE ? INVALID_NODE : mSlotOf[parent];
+
+    mSlotOf.push_back(Slot);
+    mHandleOf.push_back(Handle);
+    mParent.push_back(ParentSlot);
+    mDepth.push_back(ParentSlot == INVALID_NODE ? 0 : mDepth[ParentSlot] + 1);
+    mPosition.push_back(glm::vec3(0.0f));
+    mRotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    mScale.push_back(glm::vec3(1.0f));
+    mLocal.push_back(glm::mat4(1.0f));
+    mWorld.push_back(glm::mat4(1.0f));
+    mNormal.push_back(glm::mat3(1.0f));
+    mLocalDirty.push_back(1);
+    mWorldChanged.push_back(0);
+    mNeedsSort = true;
+
+    return Handle;
+}
+
+void
+TransformHierarchy::SetPosition(unsigned node, const glm::vec3& position) {
+    unsigned Slot = mSlotOf[node];
+    mPosition[Slot] = position;
+    mLocalDirty[Slot] = 1;
+}
+
+void
+TransformHierarchy::SetRotation(unsigned node, const glm::quat& rotation) {
+    unsigned Slot = mSlotOf[node];
+    mRotation[Slot] = rotation;
+    mLocalDirty[Slot] = 1;
+}
+
+void
+TransformHierarchy::SetScale(unsigned node, const glm::vec3& scale) {
+    unsigned Slot = mSlotOf[node];
+    mScale[Slot] = scale;
+    mLocalDirty[Slot] = 1;
+}
+
+const glm::mat4&
+TransformHierarchy::GetWorld(unsigned node) const {
+    return mWorld[mSlotOf[node]];
+}
+
+const glm::mat3&
+TransformHierarchy::GetNormal(unsigned node) const {
+    return mNormal[mSlotOf[node]];
+}
+
+glm::vec3
+TransformHierarchy::GetWorldPosition(unsigned node) const {
+    return glm::vec3(mWorld[mSlotOf[node]][3]);
+}
+
+void
+TransformHierarchy::Update() {
+    if (mNeedsSort) {
+        sortBreadthFirst();
+    }
+
+    mUpdatedCount = 0;
+    for (unsigned Level = 0; Level + 1 < mLevelStart.size(); ++Level) {
+        mBatch.clear();
+        for (unsigned Slot = mLevelStart[Level]; Slot < mLevelStart[Level + 1]; ++Slot) {
+            unsigned Parent = mParent[Slot];
+            bool ParentChanged = Parent != INVALID_NODE && mWorldChanged[Parent];
+            mWorldChanged[Slot] = mLocalDirty[Slot] || ParentChanged;
+            if (!mWorldChanged[Slot]) {
+                continue;
+            }
+
+            if (mLocalDirty[Slot]) {
+                glm::mat4 Local = glm::mat4_cast(mRotation[Slot]);
+                Local[0] *= mScale[Slot].x;
+                Local[1] *= mScale[Slot].y;
+                Local[2] *= mScale[Slot].z;
+                Local[3] = glm::vec4(mPosition[Slot], 1.0f);
+                mLocal[Slot] = Local;
+                mLocalDirty[Slot] = 0;
+            }
+            mBatch.push_back(Slot);
+        }
+
+        // NOTE: Slots within a level only read their parents, which are done
+        unsigned Count = (unsigned)mBatch.size();
+        if (Count >= TRANSFORM_PARALLEL_MIN) {
+            Jobs::ParallelFor(Count, TRANSFORM_JOB_GRAIN, [this](unsigned begin, unsigned end) {
+                multiplyBatch(begin, end);
+                normalBatch(begin, end);
+            });
+        } else {
+            multiplyBatch(0, Count);
+            normalBatch(0, Count);
+        }
+        mUpdatedCount += (unsigned)mBatch.size();
+    }
+}
+
+void
+TransformHierarchy::sortBreadthFirst() {
+    unsigned Count = (unsigned)mParent.size();
+    std::vector<unsigned> Order(Count);
+    for (unsigned Slot = 0; Slot < Count; ++Slot) {
+        Order[Slot] = Slot;
+    }
+    std::stable_sort(Order.begin(), Order.end(), [this](unsigned a, unsigned b) {
+        return mDepth[a] < mDepth[b];
+    });
+
+    std::vector<unsigned> NewSlotOfOld(Count);
+    for (unsigned NewSlot = 0; NewSlot < Count; ++NewSlot) {
+        NewSlotOfOld[Order[NewSlot]] = NewSlot;
+    }
+
+    std::vector<unsigned> Parent(Count), Depth(Count), HandleOf(Count);
+    std::vector<glm::vec3> Position(Count), Scale(Count);
+    std::vector<glm::quat> Rotation(Count);
+    std::vector<glm::mat4> Local(Count), World(Count);
+    std::vector<glm::mat3> Normal(Count);
+    std::vector<unsigned char> LocalDirty(Count);
+    for (unsigned NewSlot = 0; NewSlot < Count; ++NewSlot) {
+        unsigned Old = Order[NewSlot];
+        Parent[NewSlot] = mParent[Old] == INVALID_NODE ? INVALID_NODE : NewSlotOfOld[mParent[Old]];
+        Depth[NewSlot] = mDepth[Old];
+        HandleOf[NewSlot] = mHandleOf[Old];
+        Position[NewSlot] = mPosition[Old];
+        Rotation[NewSlot] = mRotation[Old];
+        Scale[NewSlot] = mScale[Old];
+        Local[NewSlot] = mLocal[Old];
+        World[NewSlot] = mWorld[Old];
+        Normal[NewSlot] = mNormal[Old];
+        // NOTE: Everything is rebuilt once after a re-sort
+        LocalDirty[NewSlot] = 1;
+        mSlotOf[HandleOf[NewSlot]] = NewSlot;
+    }
+
+    mParent.swap(Parent);
+    mDepth.swap(Depth);
+    mHandleOf.swap(HandleOf);
+    mPosition.swap(Position);
+    mRotation.swap(Rotation);
+    mScale.swap(Scale);
+    mLocal.swap(Local);
+    mWorld.swap(World);
+    mNormal.swap(Normal);
+    mLocalDirty.swap(LocalDirty);
+
+    mLevelStart.clear();
+    for (unsigned Slot = 0; Slot < Count; ++Slot) {
+        while (mLevelStart.size() <= mDepth[Slot]) {
+            mLevelStart.push_back(Slot);
+        }
+    }
+    mLevelStart.push_back(Count);
+    mNeedsSort = false;
+}
+
+void
+TransformHierarchy::multiplyBatch(unsigned begin, unsigned end) {
+    for (unsigned BatchIdx = begin; BatchIdx < end; ++BatchIdx) {
+        unsigned Slot = mBatch[BatchIdx];
+        unsigned Parent = mParent[Slot];
+        if (Parent == INVALID_NODE) {
+            mWorld[Slot] = mLocal[Slot];
+            continue;
+        }
+
+#ifdef EGIPAT_SSE
+        const float* A = &mWorld[Parent][0][0];
+        const float* B = &mLocal[Slot][0][0];
+        float* R = &mWorld[Slot][0][0];
+        __m128 A0 = _mm_loadu_ps(A);
+        __m128 A1 = _mm_loadu_ps(A + 4);
+        __m128 A2 = _mm_loadu_ps(A + 8);
+        __m128 A3 = _mm_loadu_ps(A + 12);
+        for (unsigned Col = 0; Col < 4; ++Col) {
+            const float* BCol = B + 4 * Col;
+            __m128 Res = _mm_mul_ps(A0, _mm_set1_ps(BCol[0]));
+            Res = _mm_add_ps(Res, _mm_mul_ps(A1, _mm_set1_ps(BCol[1])));
+            Res = _mm_add_ps(Res, _mm_mul_ps(A2, _mm_set1_ps(BCol[2])));
+            Res = _mm_add_ps(Res, _mm_mul_ps(A3, _mm_set1_ps(BCol[3])));
+            _mm_storeu_ps(R + 4 * Col, Res);
+        }
+#else
+        mWorld[Slot] = mWorld[Parent] * mLocal[Slot];
+#endif
+    }
+}
+
+void
+TransformHierarchy::normalBatch(unsigned begin, unsigned end) {
+    unsigned Count = end;
+    unsigned BatchIdx = begin;
+
+#ifdef EGIPAT_SSE
+    // NOTE: Four matrices per iteration, one per SSE lane. Normal matrix is
+    // the cofactor matrix divided by the determinant
+    for (; BatchIdx + 4 <= Count; BatchIdx += 4) {
+        alignas(16) float M[9][4];
+        for (unsigned Lane = 0; Lane < 4; ++Lane) {
+            const glm::mat4& W = mWorld[mBatch[BatchIdx + Lane]];
+            for (unsigned Col = 0; Col < 3; ++Col) {
+                for (unsigned Row = 0; Row < 3; ++Row) {
+                    M[Row * 3 + Col][Lane] = W[Col][Row];
+                }
+            }
+        }
+
+        __m128 A00 = _mm_load_ps(M[0]), A01 = _mm_load_ps(M[1]), A02 = _mm_load_ps(M[2]);
+        __m128 A10 = _mm_load_ps(M[3]), A11 = _mm_load_ps(M[4]), A12 = _mm_load_ps(M[5]);
+        __m128 A20 = _mm_load_ps(M[6]), A21 = _mm_load_ps(M[7]), A22 = _mm_load_ps(M[8]);
+
+        __m128 C[9];
+        C[0] = _mm_sub_ps(_mm_mul_ps(A11, A22), _mm_mul_ps(A12, A21));
+        C[1] = _mm_sub_ps(_mm_mul_ps(A12, A20), _mm_mul_ps(A10, A22));
+        C[2] = _mm_sub_ps(_mm_mul_ps(A10, A21), _mm_mul_ps(A11, A20));
+        C[3] = _mm_sub_ps(_mm_mul_ps(A02, A21), _mm_mul_ps(A01, A22));
+        C[4] = _mm_sub_ps(_mm_mul_ps(A00, A22), _mm_mul_ps(A02, A20));
+        C[5] = _mm_sub_ps(_mm_mul_ps(A01, A20), _mm_mul_ps(A00, A21));
+        C[6] = _mm_sub_ps(_mm_mul_ps(A01, A12), _mm_mul_ps(A02, A11));
+        C[7] = _mm_sub_ps(_mm_mul_ps(A02, A10), _mm_mul_ps(A00, A12));
+        C[8] = _mm_sub_ps(_mm_mul_ps(A00, A11), _mm_mul_ps(A01, A10));
+
+        __m128 Det = _mm_add_ps(_mm_mul_ps(A00, C[0]), _mm_add_ps(_mm_mul_ps(A01, C[1]), _mm_mul_ps(A02, C[2])));
+        __m128 InvDet = _mm_div_ps(_mm_set1_ps(1.0f), Det);
+
+        for (unsigned Idx = 0; Idx < 9; ++Idx) {
+            _mm_store_ps(M[Idx], _mm_mul_ps(C[Idx], InvDet));
+        }
+
+        for (unsigned Lane = 0; Lane < 4; ++Lane) {
+            glm::mat3& N = mNormal[mBatch[BatchIdx + Lane]];
+            for (unsigned Col = 0; Col < 3; ++Col) {
+                for (unsigned Row = 0; Row < 3; ++Row) {
+                    N[Col][Row] = M[Row * 3 + Col][Lane];
+                }
+            }
+        }
+    }
+#endif
+
+    for (; BatchIdx < Count; ++BatchIdx) {
+        unsigned Slot = mBatch[BatchIdx];
+        mNormal[Slot] = glm::transpose(glm::inverse(glm::mat3(mWorld[Slot])));
+    }
+}
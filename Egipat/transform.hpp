@@ -0,0 +1,137 @@
+/**
+ * @file transform.hpp
+ * @brief Scene transform hierarchy. Nodes are stored breadth-first in SoA
+ * arrays so that every depth level is a contiguous range whose parents are
+ * already resolved, which lets world and normal matrices be rebuilt in SIMD
+ * batches. Only dirty subtrees are recomputed.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// NOTE: Levels with fewer dirty nodes than this aren't worth splitting into jobs
+#define TRANSFORM_PARALLEL_MIN 1024
+#define TRANSFORM_JOB_GRAIN 256
+
+class TransformHierarchy {
+public:
+    static const unsigned INVALID_NODE = 0xFFFFFFFF;
+
+    TransformHierarchy();
+
+    /**
+     * @brief Adds a node with identity local transform
+     *
+     * @param parent - Parent node handle or INVALID_NODE for a root node
+     *
+     * @returns Node handle. Handles stay valid across re-sorting
+     */
+    unsigned Add(unsigned parent = INVALID_NODE);
+
+    /**
+     * @brief Sets local translation and marks the node's subtree dirty
+     *
+     * @param node - Node handle
+     * @param position - Translation relative to the parent
+     */
+    void SetPosition(unsigned node, const glm::vec3& position);
+
+    /**
+     * @brief Sets local rotation and marks the node's subtree dirty
+     *
+     * @param node - Node handle
+     * @param rotation - Rotation relative to the parent
+     */
+    void SetRotation(unsigned node, const glm::quat& rotation);
+
+    /**
+     * @brief Sets local scale and marks the node's subtree dirty
+     *
+     * @param node - Node handle
+     * @param scale - Scale relative to the parent
+     */
+    void SetScale(unsigned node, const glm::vec3& scale);
+
+    /**
+     * @brief Recomputes world and normal matrices of all dirty subtrees
+     *
+     */
+    void Update();
+
+    /**
+     * @brief Gets world (model) matrix computed by the last Update
+     *
+     * @param node - Node handle
+     */
+    const glm::mat4& GetWorld(unsigned node) const;
+
+    /**
+     * @brief Gets normal matrix, transpose(inverse(mat3(world))), computed by the last Update
+     *
+     * @param node - Node handle
+     */
+    const glm::mat3& GetNormal(unsigned node) const;
+
+    /**
+     * @brief Gets world space position of the node
+     *
+     * @param node - Node handle
+     */
+    glm::vec3 GetWorldPosition(unsigned node) const;
+
+    /**
+     * @brief Number of nodes whose world matrix was rebuilt by the last Update
+     *
+     */
+    unsigned GetUpdatedCount() const { return mUpdatedCount; }
+
+    unsigned GetNodeCount() const { return (unsigned)mParent.size(); }
+
+private:
+    // NOTE: Handle -> slot indirection. Slots are kept in breadth-first order
+    std::vector<unsigned> mSlotOf;
+    std::vector<unsigned> mHandleOf;
+    std::vector<unsigned> mLevelStart;
+    bool mNeedsSort;
+    unsigned mUpdatedCount;
+
+    // NOTE: Per-slot SoA data
+    std::vector<unsigned> mParent;
+    std::vector<unsigned> mDepth;
+    std::vector<glm::vec3> mPosition;
+    std::vector<glm::quat> mRotation;
+    std::vector<glm::vec3> mScale;
+    std::vector<glm::mat4> mLocal;
+    std::vector<glm::mat4> mWorld;
+    std::vector<glm::mat3> mNormal;
+    std::vector<unsigned char> mLocalDirty;
+    std::vector<unsigned char> mWorldChanged;
+
+    // NOTE: Scratch list of slots rebuilt in the current level
+    std::vector<unsigned> mBatch;
+
+    /**
+     * @brief Re-sorts slots breadth-first after nodes were added and rebuilds level ranges
+     *
+     */
+    void sortBreadthFirst();
+
+    /**
+     * @brief World = ParentWorld * Local for mBatch[begin, end)
+     *
+     */
+    void multiplyBatch(unsigned begin, unsigned end);
+
+    /**
+     * @brief Normal = transpose(inverse(mat3(World))) for mBatch[begin, end)
+     *
+     */
+    void normalBatch(unsigned begin, unsigned end);
+};